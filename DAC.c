@@ -127,5 +127,29 @@ void DAC_SetValue(uint16 value) {
 }
 
 
+/******************************************************************************
+* Function Name: DAC_MaxValue
+*******************************************************************************
+*
+* Summary:
+*  Largest value the selected voltage source can take, the 8-bit VDAC would
+*  wrap a larger value around to near 0
+*
+* Global variables:
+*  selected_voltage_source:  voltage source that is set to run, 
+*      [VDAC_IS_VDAC or VDAC_IS_DVDAC]
+*
+* Return:
+*  DAC_DVDAC_MAX or DAC_VDAC_MAX
+*
+*******************************************************************************/
+
+uint16 DAC_MaxValue(void) {
+    if (selected_voltage_source == VDAC_IS_DVDAC) {
+        return DAC_DVDAC_MAX;
+    }
+    return DAC_VDAC_MAX;
+}
+
 
 /* [] END OF FILE */
@@ -19,6 +19,14 @@
 #include "globals.h"
 
     
+/***************************************
+*        Constants
+***************************************/
+
+#define DAC_VDAC_MAX 255  // 8-bit VDAC_source
+#define DAC_DVDAC_MAX 4095  // 12-bit dithered DVDAC
+    
+    
 /***************************************
 *        Variables
 ***************************************/     
@@ -34,6 +42,7 @@ void DAC_Start(void);
 void DAC_Sleep(void);
 void DAC_Wakeup(void);
 void DAC_SetValue(uint16 value);
+uint16 DAC_MaxValue(void);
     
 #endif
 /* [] END OF FILE */
@@ -0,0 +1,274 @@
+/*******************************************************************************
+* File Name: adaptive_cv.c
+*
+* Description:
+*  Cyclic voltammetry where the dac step follows the shape of the current.
+*  It runs from the isr_adcAmp tick and takes one data point at the end of
+*  each step.  When the current changes a lot over a step, or bends away from
+*  the line through the last two points as it does at the top of a peak, the
+*  next step is made smaller, down to 1 dac count.  When the current is flat the
+*  step is doubled up to the largest step set.  The dwell of a step is its
+*  size times the ticks per dac count, so the scan rate and the charging
+*  current stay the same whatever the step is and only the number of data
+*  points changes.  Each data point is saved as a dac value / current pair so
+*  the computer can put the curve back together
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include <project.h>
+#include <stdio.h>
+#include "string.h"
+
+#include "adaptive_cv.h"
+#include "adc_profile.h"
+#include "DAC.h"
+#include "data_export.h"
+#include "trace.h"
+#include "usb_protocols.h"
+
+extern char usb_str[];
+void HardwareSleep(void);  // in main.c
+
+static struct AdaptiveSettings settings;
+static volatile uint8 running = false;
+
+/* state of the sweep */
+static uint16 dac_value;  // dac value of the step being measured
+static uint16 target_value;  // vertex on the way out, start value on the way back
+static int8 direction;  // 1 or -1
+static uint8 returning;  // the vertex has been passed
+static uint8 step;  // size of the next step
+static uint8 step_taken;  // size of the step that was just measured, smaller than step when it was cut off at the target
+static uint32 dwell_left;  // ticks left in the step
+static uint16 points;  // data points saved
+
+/* history used to pick the step size */
+static int16 last_sample;
+static int32 last_change;  // current change over the step before
+static uint8 last_step;
+static uint8 have_sample;  // last_sample is set
+static uint8 have_change;  // last_change is set and on the same side of the vertex
+
+/* state of the data block being filled */
+static uint8 block_channel;
+static uint16 block_index;
+
+/***************************************
+* Forward function references
+***************************************/
+static void adaptive_choose_step(int16 sample);
+static void adaptive_record(int16 sample);
+static void adaptive_flush(void);
+static void adaptive_finish(void);
+
+
+/******************************************************************************
+* Function Name: Adaptive_Start
+*******************************************************************************
+*
+* Summary:
+*  Check the settings and set the dac to the start value.  The caller wakes up
+*  the hardware before this and enables the tick interrupt after it
+*
+* Parameters:
+*  struct AdaptiveSettings *_settings: scan to run
+*
+* Return:
+*  true if the scan is started, false if the settings are not valid or
+*  the scan goes past the dac being used
+*
+*******************************************************************************/
+
+uint8 Adaptive_Start(struct AdaptiveSettings *_settings) {
+    if (running || (_settings->start_value == _settings->vertex_value) || (_settings->start_value > DAC_MaxValue()) ||
+        (_settings->vertex_value > DAC_MaxValue()) || (_settings->max_step == 0) ||
+        (_settings->max_step > ADAPTIVE_MAX_STEP) || (_settings->ticks_per_count == 0) ||
+        (_settings->block_size == 0) || (_settings->block_size > ADAPTIVE_MAX_BLOCK)) {
+        return false;
+    }
+    settings = *_settings;
+    dac_value = settings.start_value;
+    target_value = settings.vertex_value;
+    direction = (target_value > dac_value) ? 1 : -1;
+    returning = false;
+    step = 1;  // start fine, the step grows if the current is flat
+    step_taken = 1;
+    dwell_left = settings.ticks_per_count;
+    points = 0;
+    have_sample = false;
+    have_change = false;
+    block_channel = 0;
+    block_index = 0;
+    DAC_SetValue(dac_value);
+    running = true;
+    return true;
+}
+
+/******************************************************************************
+* Function Name: Adaptive_Tick
+*******************************************************************************
+*
+* Summary:
+*  Called every isr_adcAmp tick.  At the end of a step the current is saved
+*  with the dac value, the size of the next step is picked and the dac moved
+*
+*******************************************************************************/
+
+void Adaptive_Tick(void) {
+    int16 sample = AdcProfile_GetResult();
+    if (!running) {
+        return;
+    }
+    dwell_left--;
+    if (dwell_left) {
+        return;
+    }
+    adaptive_record(sample);
+    adaptive_choose_step(sample);
+    if (dac_value == target_value) {
+        if (returning) {
+            adaptive_finish();
+            return;
+        }
+        returning = true;  // turn around at the vertex
+        target_value = settings.start_value;
+        direction = -direction;
+        have_change = false;  // the current jumps at the vertex, don't use it to predict the next step
+    }
+    uint16 distance = (direction > 0) ? (target_value - dac_value) : (dac_value - target_value);
+    step_taken = (step < distance) ? step : distance;
+    dac_value += direction * step_taken;
+    DAC_SetValue(dac_value);
+    dwell_left = (uint32)step_taken * settings.ticks_per_count;
+}
+
+/******************************************************************************
+* Function Name: Adaptive_Stop
+*******************************************************************************
+*
+* Summary:
+*  Stop the scan without telling the computer, used by the 'X' command
+*
+*******************************************************************************/
+
+void Adaptive_Stop(void) {
+    running = false;
+}
+
+uint8 Adaptive_IsRunning(void) {
+    return running;
+}
+
+/******************************************************************************
+* Function Name: adaptive_choose_step
+*******************************************************************************
+*
+* Summary:
+*  Pick the size of the next step from how much the current changed over the
+*  step just measured, plus how far it bent away from the line through the
+*  point before.  The bend is what keeps the step small over the top of a
+*  peak where the current is flat for a moment.  The step shrinks by how many
+*  times the change was over the limit so a sharp peak is not stepped over
+*
+* Parameters:
+*  int16 sample: current at the end of the step
+*
+*******************************************************************************/
+
+static void adaptive_choose_step(int16 sample) {
+    if (!have_sample) {
+        last_sample = sample;
+        have_sample = true;
+        return;
+    }
+    int32 change = sample - last_sample;
+    int32 size = (change < 0) ? -change : change;
+    if (have_change) {
+        int32 bend = change - (last_change * step_taken) / last_step;
+        size += (bend < 0) ? -bend : bend;
+    }
+    last_sample = sample;
+    last_change = change;
+    last_step = step_taken;
+    have_change = true;
+
+    if (size > settings.change_limit) {  // at least halve the step, more if the change was much too big
+        uint32 smaller = ((uint32)step_taken * settings.change_limit) / size;
+        if (smaller > step / 2) {
+            smaller = step / 2;
+        }
+        step = (smaller < 1) ? 1 : smaller;
+    }
+    else if (size < settings.change_limit / ADAPTIVE_GROW_DIVIDER) {
+        step *= 2;
+        if (step > settings.max_step) {
+            step = settings.max_step;
+        }
+    }
+}
+
+/******************************************************************************
+* Function Name: adaptive_record
+*******************************************************************************
+*
+* Summary:
+*  Save a dac value / current pair in the current block and send the block when it is full
+*
+*******************************************************************************/
+
+static void adaptive_record(int16 sample) {
+    ADC_array[block_channel].data[2*block_index] = dac_value;
+    ADC_array[block_channel].data[2*block_index+1] = sample;
+    block_index++;
+    points++;
+    export_sequence++;
+    if (block_index >= settings.block_size) {
+        adaptive_flush();
+    }
+}
+
+/******************************************************************************
+* Function Name: adaptive_flush
+*******************************************************************************
+*
+* Summary:
+*  Mark the end of the block and tell the computer it can be read.  Sends
+*  "RD" + channel + | + data points, each data point is 2 int16 values
+*
+*******************************************************************************/
+
+static void adaptive_flush(void) {
+    if (block_index == 0) {
+        return;
+    }
+    ADC_array[block_channel].data[2*block_index] = ADC_DATA_DONE_CODE;
+    sprintf(usb_str, "RD%d|%04d", block_channel, block_index);
+    Export_Notify((uint8*)usb_str, strlen(usb_str)+1);
+    block_channel = (block_channel + 1) % adc_ring_channels;
+    block_index = 0;
+}
+
+/******************************************************************************
+* Function Name: adaptive_finish
+*******************************************************************************
+*
+* Summary:
+*  Send the partly filled block, stop the interrupt and tell the computer the
+*  scan is done and how many data points it took
+*
+*******************************************************************************/
+
+static void adaptive_finish(void) {
+    running = false;
+    isr_adcAmp_Disable();
+    HardwareSleep();
+    TRACE(TRACE_RUN_DONE, 'D', points);
+    adaptive_flush();
+    sprintf(usb_str, "RDDone|%05u", points);
+    Export_Notify((uint8*)usb_str, strlen(usb_str)+1);
+}
+
+/* [] END OF FILE */
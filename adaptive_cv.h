@@ -0,0 +1,54 @@
+/*******************************************************************************
+* File Name: adaptive_cv.h
+*
+* Description:
+*  This file contains the function prototypes, structures and constants used
+*  for cyclic voltammetry with a dac step that changes with the shape of the
+*  current, see adaptive_cv.c
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#if !defined(ADAPTIVE_CV_H)
+#define ADAPTIVE_CV_H
+
+#include "cytypes.h"
+#include "globals.h"
+
+/**************************************
+*      Constants
+**************************************/
+
+#define ADAPTIVE_MAX_STEP 64  // largest dac step that can be set for the flat parts of the scan
+#define ADAPTIVE_MAX_BLOCK ((MAX_LUT_SIZE - 1) / 2)  // data points are dac value / current pairs
+#define ADAPTIVE_GROW_DIVIDER 4  // the step is doubled when the change is under change_limit / this
+
+
+/**************************************
+*      Structures
+**************************************/
+
+struct AdaptiveSettings {
+    uint16 start_value;  // dac value at the start and end of the scan
+    uint16 vertex_value;  // dac value the scan turns around at
+    uint8 max_step;  // largest dac step, the smallest is 1 dac count
+    uint16 ticks_per_count;  // PWM_isr ticks for each dac count, the dwell of a step grows with its size so the scan rate stays the same
+    uint16 change_limit;  // adc counts, the step is made smaller if the current of a step changes more than this
+    uint16 block_size;  // data points in an ADC_array block
+};
+
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+uint8 Adaptive_Start(struct AdaptiveSettings *settings);
+void Adaptive_Tick(void);
+void Adaptive_Stop(void);
+uint8 Adaptive_IsRunning(void);
+
+#endif
+
+/* [] END OF FILE */
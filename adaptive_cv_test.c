@@ -0,0 +1,132 @@
+/*******************************************************************************
+* File Name: adaptive_cv_test.c
+*
+* Description:
+*  Runs an adaptive step cyclic voltammetry scan on a computer against the
+*  simulated cell with a made up peak on top of its current.  Checks the scan
+*  takes far fewer data points than 1 dac count steps would, still steps
+*  finely enough over the peak to measure its height and place it, and that
+*  a scan past the dac being used is refused
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "adaptive_cv.h"
+#include "DAC.h"
+#include "sequencer_hal_sim.h"
+#include "sim_test.h"
+#include "usb_sim.h"
+
+#define TEST_START 2000
+#define TEST_VERTEX 2600
+#define TEST_OHMS 1000000.0  // 1 adc count per dac count of background slope
+#define TEST_PEAK 2300  // dac value and adc counts of the peak
+#define TEST_HEIGHT 2000
+#define TEST_WIDTH 10.0  // standard deviation of the peak in dac counts
+#define TEST_MAX_STEP 16
+#define TEST_TICKS 100000  // the scan has to finish in fewer ticks than this
+
+char usb_str[40];  // in main.c
+void HardwareSleep(void) {}
+
+static float64 peak_counts(uint16 dac_value) {
+    float64 x = ((float64)dac_value - TEST_PEAK) / TEST_WIDTH;
+    return TEST_HEIGHT * exp(-0.5 * x * x);
+}
+
+static struct AdaptiveSettings test_settings(void) {
+    struct AdaptiveSettings settings;
+    settings.start_value = TEST_START;
+    settings.vertex_value = TEST_VERTEX;
+    settings.max_step = TEST_MAX_STEP;
+    settings.ticks_per_count = 1;
+    settings.change_limit = 40;
+    settings.block_size = ADAPTIVE_MAX_BLOCK;  // the whole scan fits in ADC_array[0]
+    return settings;
+}
+
+/* run the scan a tick at a time, the adc reads the cell current at the dac value of the tick */
+static void run_scan(void) {
+    for (uint32 tick = 0; (tick < TEST_TICKS) && Adaptive_IsRunning(); tick++) {
+        SimCell_Advance(&sim_cell, sim_dac_value, SimHAL_TickSeconds());
+        sim_adc_result = SimCell_Reading(&sim_cell) + lround(peak_counts(sim_dac_value));
+        Adaptive_Tick();
+    }
+}
+
+static void test_scan(void) {
+    struct AdaptiveSettings settings = test_settings();
+    char done[20];
+    selected_voltage_source = VDAC_IS_DVDAC;
+    SimCell_Resistor(&sim_cell, TEST_OHMS);
+    SimUSB_ClearLog();
+    SIM_CHECK(Adaptive_Start(&settings));
+    run_scan();
+    SIM_CHECK(!Adaptive_IsRunning());
+
+    // the dac value / current pairs up to the done code, on the way out and back
+    uint16 points = 0;
+    uint16 near_peak = 0;
+    uint16 widest_near_peak = 0;
+    int16 highest = -32768;
+    uint16 highest_dac = 0;
+    while ((points < ADAPTIVE_MAX_BLOCK) && ((uint16)ADC_array[0].data[2*points] != ADC_DATA_DONE_CODE)) {
+        uint16 dac_value = ADC_array[0].data[2*points];
+        int16 current = ADC_array[0].data[2*points+1];
+        if (points && (abs(dac_value - TEST_PEAK) <= TEST_WIDTH)) {
+            uint16 step = abs(dac_value - (uint16)ADC_array[0].data[2*points-2]);
+            near_peak++;
+            widest_near_peak = (step > widest_near_peak) ? step : widest_near_peak;
+        }
+        if (current > highest) {
+            highest = current;
+            highest_dac = dac_value;
+        }
+        points++;
+    }
+    sprintf(done, "RDDone|%05u", points);
+    SIM_CHECK((sim_usb_log_size > strlen(done)) &&
+              (strcmp((char*)&sim_usb_log[sim_usb_log_size - strlen(done) - 1], done) == 0));  // the last message
+
+    // 1 dac count steps would take 2*600 points, the largest step 2*600/16
+    SIM_CHECK(points < (TEST_VERTEX - TEST_START));
+    SIM_CHECK(points > 2*(TEST_VERTEX - TEST_START) / TEST_MAX_STEP);
+    // over the peak the steps are small enough to see its shape on both sweeps
+    SIM_CHECK(near_peak >= 2*TEST_WIDTH);
+    SIM_CHECK(widest_near_peak <= 2);
+    float64 background = (float64)(highest_dac - sim_cell.dac_ground) * 1e6 / TEST_OHMS;
+    SIM_CHECK(highest - background > 0.98 * TEST_HEIGHT);
+    SIM_CHECK(abs(highest_dac - TEST_PEAK) <= 2);
+}
+
+static void test_limits(void) {
+    struct AdaptiveSettings settings = test_settings();
+    selected_voltage_source = VDAC_IS_DVDAC;
+    settings.vertex_value = DAC_MaxValue() + 1;
+    SIM_CHECK(!Adaptive_Start(&settings));
+    settings = test_settings();
+    settings.start_value = DAC_MaxValue() + 1;
+    SIM_CHECK(!Adaptive_Start(&settings));
+    selected_voltage_source = VDAC_IS_VDAC;  // only 8 bits
+    settings = test_settings();
+    SIM_CHECK(!Adaptive_Start(&settings));
+    settings.start_value = 10;
+    settings.vertex_value = DAC_MaxValue();
+    SIM_CHECK(Adaptive_Start(&settings));
+    Adaptive_Stop();
+}
+
+int main(void) {
+    test_scan();
+    test_limits();
+    return sim_test_failures;
+}
+
+/* [] END OF FILE */
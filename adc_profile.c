@@ -0,0 +1,146 @@
+/*******************************************************************************
+* File Name: adc_profile.c
+*
+* Description:
+*  Named profiles for the delta sigma ADC.  Each profile is one of the
+*  ADC_SigDel configurations set in the schematic, so the resolution, rate
+*  and input buffer of all of them are set up by the component and changed
+*  with ADC_SigDel_SelectConfiguration.  The profile table has to match the
+*  schematic, a profile whose configuration is not in the component can not
+*  be selected.  The resolution and rate of a configuration the component has
+*  are taken from its ADC_SigDel_CFGN_XXX macros, the board only has CFG1 so
+*  the others are what is planned for CFG2 and CFG3.  Results with more than 16 bits are shifted down so ADC_array
+*  still holds int16, results with fewer bits are saved as they are and the
+*  computer gets the bits from the ExportFormat
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include <project.h>
+
+#include "adc_profile.h"
+
+static const struct AdcProfile profiles[ADC_PROFILES] = {
+    {"Standard", 1, ADC_SigDel_CFG1_RESOLUTION, ADC_SigDel_CFG1_SRATE, ADC_BUFFER_LEVEL_SHIFT},
+#if (ADC_SigDel_DEFAULT_NUM_CONFIGS >= 2)
+    {"Fast", 2, ADC_SigDel_CFG2_RESOLUTION, ADC_SigDel_CFG2_SRATE, ADC_BUFFER_RAIL_TO_RAIL},
+#else
+    {"Fast", 2, 12, 48000, ADC_BUFFER_RAIL_TO_RAIL},  // not in the component, can not be selected
+#endif
+#if (ADC_SigDel_DEFAULT_NUM_CONFIGS >= 3)
+    {"Precise", 3, ADC_SigDel_CFG3_RESOLUTION, ADC_SigDel_CFG3_SRATE, ADC_BUFFER_LEVEL_SHIFT}
+#else
+    {"Precise", 3, 20, 187, ADC_BUFFER_LEVEL_SHIFT}  // not in the component, can not be selected
+#endif
+};
+
+static uint8 profile_selected = ADC_PROFILE_STANDARD;
+static uint8 result_shift = 0;  // bits to shift the result down to fit in an int16
+
+
+/******************************************************************************
+* Function Name: AdcProfile_Select
+*******************************************************************************
+*
+* Summary:
+*  Load the ADC_SigDel configuration of a profile.  The configuration sets the
+*  buffer gain of the schematic so the gain being used is put back.  Only call
+*  when no experiment is running, the ADC is left asleep like HardwareSleep does
+*
+* Parameters:
+*  uint8 profile: ADC_PROFILE_XXX
+*  uint8 adc_buffer: index for ADC_SigDel_SetBufferGain
+*
+* Return:
+*  true if the profile was selected, false if the component does not have its configuration
+*
+*******************************************************************************/
+
+uint8 AdcProfile_Select(uint8 profile, uint8 adc_buffer) {
+    if ((profile >= ADC_PROFILES) || (profiles[profile].config > ADC_SigDel_DEFAULT_NUM_CONFIGS)) {
+        return false;
+    }
+#if (ADC_SigDel_DEFAULT_NUM_CONFIGS > 1)
+    ADC_SigDel_SelectConfiguration(profiles[profile].config, 1);
+    ADC_SigDel_SetBufferGain(adc_buffer);
+    ADC_SigDel_Sleep();
+#endif
+    profile_selected = profile;
+    result_shift = 0;
+    if (profiles[profile].resolution > ADC_PROFILE_SAMPLE_BITS) {
+        result_shift = profiles[profile].resolution - ADC_PROFILE_SAMPLE_BITS;
+    }
+    return true;
+}
+
+uint8 AdcProfile_Current(void) {
+    return profile_selected;
+}
+
+const struct AdcProfile* AdcProfile_Get(uint8 profile) {
+    if (profile >= ADC_PROFILES) {
+        return 0;
+    }
+    return &profiles[profile];
+}
+
+/******************************************************************************
+* Function Name: AdcProfile_GetResult
+*******************************************************************************
+*
+* Summary:
+*  Read the last conversion as an int16 for ADC_array, use in place of
+*  ADC_SigDel_GetResult16 which only returns the low 16 bits of a longer result
+*
+* Return:
+*  conversion result, the top 16 bits if the profile has more
+*
+*******************************************************************************/
+
+int16 AdcProfile_GetResult(void) {
+    if (result_shift) {
+        return (int16)(ADC_SigDel_GetResult32() >> result_shift);
+    }
+    return ADC_SigDel_GetResult16();
+}
+
+/******************************************************************************
+* Function Name: AdcProfile_SampleBits
+*******************************************************************************
+*
+* Summary:
+*  Bits in the saved results, the computer scales the adc counts with this
+*
+* Return:
+*  bits of the profile being used, at most ADC_PROFILE_SAMPLE_BITS
+*
+*******************************************************************************/
+
+uint8 AdcProfile_SampleBits(void) {
+    return profiles[profile_selected].resolution - result_shift;
+}
+
+/******************************************************************************
+* Function Name: AdcProfile_TickAllowed
+*******************************************************************************
+*
+* Summary:
+*  Check the PWM_isr tick is not shorter than a conversion of the profile, a
+*  faster tick would read the same result more than once
+*
+* Parameters:
+*  uint32 tick_ns: time between adc reads, see SampleClock_TickNs
+*
+* Return:
+*  true if a new conversion is ready every tick
+*
+*******************************************************************************/
+
+uint8 AdcProfile_TickAllowed(uint32 tick_ns) {
+    uint32 conversion_ns = (1000000000 + profiles[profile_selected].rate_sps - 1) / profiles[profile_selected].rate_sps;
+    return tick_ns >= conversion_ns;
+}
+
+/* [] END OF FILE */
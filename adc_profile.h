@@ -0,0 +1,61 @@
+/*******************************************************************************
+* File Name: adc_profile.h
+*
+* Description:
+*  This file contains the function prototypes, structures and constants used
+*  to pick the resolution and conversion rate of the delta sigma ADC for each
+*  experiment, see adc_profile.c
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#if !defined(ADC_PROFILE_H)
+#define ADC_PROFILE_H
+
+#include "cytypes.h"
+#include "globals.h"
+
+/**************************************
+*      Constants
+**************************************/
+
+#define ADC_PROFILE_STANDARD 0  // CFG1, what every mode used before the profiles
+#define ADC_PROFILE_FAST 1  // CFG2, lower resolution for fast cyclic voltammetry
+#define ADC_PROFILE_PRECISE 2  // CFG3, highest resolution for slow amperometry
+#define ADC_PROFILES 3
+
+#define ADC_BUFFER_LEVEL_SHIFT 0  // input buffer modes of the ADC_SigDel configurations
+#define ADC_BUFFER_RAIL_TO_RAIL 1
+
+#define ADC_PROFILE_SAMPLE_BITS 16  // ADC_array saves int16, results with more bits are shifted down to this
+
+
+/**************************************
+*      Structures
+**************************************/
+
+struct AdcProfile {
+    char name[10];  // sent back by the 'AP' command
+    uint8 config;  // ADC_SigDel configuration in the schematic, 1 to 4
+    uint8 resolution;  // bits of the conversion result
+    uint32 rate_sps;  // conversions each second in continuous mode
+    uint8 buffer_mode;  // ADC_BUFFER_XXX
+};
+
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+uint8 AdcProfile_Select(uint8 profile, uint8 adc_buffer);
+uint8 AdcProfile_Current(void);
+const struct AdcProfile* AdcProfile_Get(uint8 profile);
+int16 AdcProfile_GetResult(void);
+uint8 AdcProfile_SampleBits(void);
+uint8 AdcProfile_TickAllowed(uint32 tick_ns);
+
+#endif
+
+/* [] END OF FILE */
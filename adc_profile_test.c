@@ -0,0 +1,60 @@
+/*******************************************************************************
+* File Name: adc_profile_test.c
+*
+* Description:
+*  Checks the adc profiles on a computer.  The board only has CFG1, this test
+*  is built with ADC_SigDel_DEFAULT_NUM_CONFIGS 3 so the simulated component
+*  has the configurations of all the profiles.  The profiles take their
+*  resolution and rate from the component, longer results are shifted down
+*  to 16 bits and a tick faster than a conversion is refused
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include <project.h>
+#include "adc_profile.h"
+#include "sim_test.h"
+
+static void test_profiles(void) {
+    SIM_CHECK(AdcProfile_Get(ADC_PROFILE_STANDARD)->rate_sps == ADC_SigDel_CFG1_SRATE);
+    SIM_CHECK(AdcProfile_Get(ADC_PROFILE_STANDARD)->resolution == ADC_SigDel_CFG1_RESOLUTION);
+    SIM_CHECK(AdcProfile_Get(ADC_PROFILE_FAST)->rate_sps == ADC_SigDel_CFG2_SRATE);
+    SIM_CHECK(AdcProfile_Get(ADC_PROFILE_PRECISE)->resolution == ADC_SigDel_CFG3_RESOLUTION);
+    SIM_CHECK(AdcProfile_Get(ADC_PROFILES) == 0);
+    SIM_CHECK(!AdcProfile_Select(ADC_PROFILES, 0));
+    for (uint8 profile = 0; profile < ADC_PROFILES; profile++) {
+        SIM_CHECK(AdcProfile_Select(profile, 0));
+        SIM_CHECK(AdcProfile_Current() == profile);
+    }
+}
+
+static void test_results(void) {
+    SIM_CHECK(AdcProfile_Select(ADC_PROFILE_PRECISE, 0));  // 20 bits, the top 16 are saved
+    SIM_CHECK(AdcProfile_SampleBits() == 16);
+    sim_adc_result = -300000;
+    SIM_CHECK(AdcProfile_GetResult() == -300000 / 16);
+    SIM_CHECK(AdcProfile_Select(ADC_PROFILE_FAST, 0));  // 12 bits are saved as they are
+    SIM_CHECK(AdcProfile_SampleBits() == 12);
+    sim_adc_result = -1500;
+    SIM_CHECK(AdcProfile_GetResult() == -1500);
+}
+
+static void test_ticks(void) {
+    SIM_CHECK(AdcProfile_Select(ADC_PROFILE_STANDARD, 0));
+    SIM_CHECK(AdcProfile_TickAllowed(80000));  // 12.5 kHz
+    SIM_CHECK(!AdcProfile_TickAllowed(79999));
+    SIM_CHECK(AdcProfile_Select(ADC_PROFILE_FAST, 0));
+    SIM_CHECK(AdcProfile_TickAllowed(25000));  // 40 kHz
+    SIM_CHECK(AdcProfile_Select(ADC_PROFILE_STANDARD, 0));
+}
+
+int main(void) {
+    test_profiles();
+    test_results();
+    test_ticks();
+    return sim_test_failures;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,187 @@
+/*******************************************************************************
+* File Name: amperometry.c
+*
+* Description:
+*  Save the data points of an amperometry run from the isr_adcAmp tick into
+*  the ring of ADC_array channels, and the 'AP' and 'H' commands that set up
+*  the adc and the tick for it.  The simulated board in sim/ builds this file
+*  too, so what the computer side is tested against is the code the board runs
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include <project.h>
+#include <stdio.h>
+#include "string.h"
+
+#include "amperometry.h"
+#include "adc_profile.h"
+#include "DAC.h"
+#include "data_export.h"
+#include "ir_compensation.h"
+#include "mains_filter.h"
+#include "sample_clock.h"
+#include "trace.h"
+#include "usb_protocols.h"
+
+static uint16 amp_index;  // where the next data point goes in the channel being filled
+static uint16 amp_block_points;  // data points in each channel
+static uint8 amp_channel;  // ADC_array channel being filled
+static uint16 amp_dac_value;  // dac value of the run, the iR compensation corrects from this
+static uint8 amp_tia_resistor;  // gain settings saved with each block
+static uint8 amp_adc_buffer;
+static char amp_message[8];  // "DoneX" is sent from the isr, the push queue copies it
+
+
+/******************************************************************************
+* Function Name: Amp_BufferAllowed
+*******************************************************************************
+*
+* Summary:
+*  Check a block of data points fits in an ADC_array channel with the done
+*  code after it, and tell the computer if not
+*
+* Parameters:
+*  uint16 buffer_pts: data points in each block
+*
+* Return:
+*  true if the run can be set up with this block size
+*
+*******************************************************************************/
+
+uint8 Amp_BufferAllowed(uint16 buffer_pts) {
+    if ((buffer_pts == 0) || (buffer_pts >= MAX_LUT_SIZE)) {  // the isr would write past the ADC_array channel
+        USB_Export_Data((uint8*)"Error1", 7);
+        return false;
+    }
+    return true;
+}
+
+/******************************************************************************
+* Function Name: Amp_Setup
+*******************************************************************************
+*
+* Summary:
+*  Set the dac and start filling ADC_array from channel 0, call with the
+*  hardware awake and before the isr is enabled
+*
+* Parameters:
+*  uint16 dac_value: dac value to hold the electrode at
+*  uint16 buffer_pts: data points in each block, checked with Amp_BufferAllowed
+*  uint8 tia_resistor: TIA resistor index being used
+*  uint8 adc_buffer: adc buffer gain index being used
+*
+*******************************************************************************/
+
+void Amp_Setup(uint16 dac_value, uint16 buffer_pts, uint8 tia_resistor, uint8 adc_buffer) {
+    amp_index = 0;
+    amp_channel = 0;
+    amp_block_points = buffer_pts;
+    amp_dac_value = dac_value;
+    amp_tia_resistor = tia_resistor;
+    amp_adc_buffer = adc_buffer;
+    DAC_SetValue(dac_value);
+    Export_Reset(EXPORT_RING, buffer_pts);
+}
+
+/******************************************************************************
+* Function Name: Amp_Sample
+*******************************************************************************
+*
+* Summary:
+*  Save the adc reading of a tick, the body of the amperometry isr.  When a
+*  channel is full the done code is put after it, the block is time stamped
+*  and the computer is told which channel to pick up
+*
+*******************************************************************************/
+
+void Amp_Sample(void) {
+    int16 sample = AdcProfile_GetResult();
+    if (mains_cycles && !Mains_AddSample(sample, &sample)) {  // only save the average of whole mains cycles
+        return;
+    }
+    ADC_array[amp_channel].data[amp_index] = sample;
+    if (ir_enabled) {
+        DAC_SetValue(IR_Correct(amp_dac_value, sample));
+    }
+    export_sequence++;
+    amp_index++;
+    if (amp_index >= amp_block_points) {
+        uint8 done_channel = amp_channel;
+        ADC_array[done_channel].data[amp_index] = ADC_DATA_DONE_CODE;
+        amp_index = 0;
+        amp_channel = (amp_channel + 1) % adc_ring_channels;
+        TRACE(TRACE_BUFFER_FULL, done_channel, amp_block_points);
+        Export_BlockDone(done_channel, amp_block_points, amp_tia_resistor, amp_adc_buffer);  // so the computer can time stamp the block
+
+        sprintf(amp_message, "Done%d", done_channel);  // tell the user the data is ready to pick up and which channel its on
+        Export_Notify((uint8*)amp_message, 6);  // use the 'F' command to retreive the data
+    }
+}
+
+/******************************************************************************
+* Function Name: Amp_SelectProfile
+*******************************************************************************
+*
+* Summary:
+*  The 'AP' command, select an adc profile and send back AP|N|name|bits|rate.
+*  The caller checks no experiment is running
+*
+* Parameters:
+*  uint8 profile: ADC_PROFILE_XXX
+*  uint8 adc_buffer: adc buffer gain index being used
+*
+* Return:
+*  true if the profile was selected
+*
+*******************************************************************************/
+
+uint8 Amp_SelectProfile(uint8 profile, uint8 adc_buffer) {
+    char reply[40];
+    if (!AdcProfile_Select(profile, adc_buffer)) {
+        USB_Export_Data((uint8*)"Error ADC Profile", 18);
+        return false;
+    }
+    const struct AdcProfile *adc_profile = AdcProfile_Get(profile);
+    sprintf(reply, "AP|%d|%s|%02d|%06lu", profile, adc_profile->name, adc_profile->resolution,
+            (unsigned long)adc_profile->rate_sps);
+    USB_Export_Data((uint8*)reply, strlen(reply)+1);
+    return true;
+}
+
+/******************************************************************************
+* Function Name: Amp_SetClock
+*******************************************************************************
+*
+* Summary:
+*  The 'H' command, set the sample clock and send back H|DDDDD|PPPPP|RRRRRRRRRR,
+*  the divider, PWM period and the rate made in mHz
+*
+* Parameters:
+*  uint8 mode: 'R' to set the rate in mHz, 'P' to set the period in ns
+*  uint32 request: the rate or period
+*
+*******************************************************************************/
+
+void Amp_SetClock(uint8 mode, uint32 request) {
+    struct SampleClockSetting clock_setting;
+    char reply[40];
+    uint8 clock_set = false;
+    if (mode == 'R') {
+        clock_set = SampleClock_SetRate(request, &clock_setting);
+    }
+    else if (mode == 'P') {
+        clock_set = SampleClock_SetPeriodNs(request, &clock_setting);
+    }
+    if (!clock_set) {
+        USB_Export_Data((uint8*)"Error Rate", 11);
+        return;
+    }
+    sprintf(reply, "H|%05u|%05u|%010lu", clock_setting.divider, clock_setting.period,
+            (unsigned long)clock_setting.rate_millihz);
+    USB_Export_Data((uint8*)reply, strlen(reply)+1);
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,32 @@
+/*******************************************************************************
+* File Name: amperometry.h
+*
+* Description:
+*  This file contains the function prototypes used for saving the data
+*  points of an amperometry run and the commands that set one up, shared by
+*  main.c and the simulated board (sim/sim_device.c)
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#if !defined(AMPEROMETRY_H)
+#define AMPEROMETRY_H
+
+#include "cytypes.h"
+#include "globals.h"
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+uint8 Amp_BufferAllowed(uint16 buffer_pts);
+void Amp_Setup(uint16 dac_value, uint16 buffer_pts, uint8 tia_resistor, uint8 adc_buffer);
+void Amp_Sample(void);
+uint8 Amp_SelectProfile(uint8 profile, uint8 adc_buffer);
+void Amp_SetClock(uint8 mode, uint32 request);
+
+#endif
+
+/* [] END OF FILE */
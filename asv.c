@@ -0,0 +1,87 @@
+/*******************************************************************************
+* File Name: asv.c
+*
+* Description:
+*  Anodic stripping voltammetry.  The deposition, quiet time and stripping
+*  sweep are loaded into the sequencer as one program so there is no
+*  computer involvement between the phases
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include "asv.h"
+#include "DAC.h"
+
+
+/******************************************************************************
+* Function Name: ASV_Load
+*******************************************************************************
+*
+* Summary:
+*  Replace the sequencer program with an anodic stripping voltammetry
+*  experiment: hold at the deposition value, an optional quiet time at the
+*  start value, then a recorded linear or square wave sweep to the end value
+*
+* Parameters:
+*  struct ASVSettings *settings: parameters of the experiment
+*
+* Return:
+*  true if the program was loaded, false if the settings are not valid
+*
+*******************************************************************************/
+
+uint8 ASV_Load(struct ASVSettings *settings) {
+    struct SequenceStep step;
+    uint16 pulse = 0;
+    
+    if (settings->sweep_type == ASV_SQUARE_WAVE) {
+        pulse = settings->pulse_amplitude;
+    }
+    else if (settings->sweep_type != ASV_LINEAR_SWEEP) {
+        return false;
+    }
+    // make sure the square wave pulses stay inside the dac range
+    uint16 low = (settings->start_value < settings->end_value) ? settings->start_value : settings->end_value;
+    uint16 high = (settings->start_value < settings->end_value) ? settings->end_value : settings->start_value;
+    if ((low < pulse) || (high + pulse > DAC_MaxValue()) || (settings->timer_period == 0)) {
+        return false;
+    }
+    
+    if (!Sequencer_Clear()) {
+        return false;
+    }
+    step.tia_resistor = settings->tia_resistor;
+    step.adc_buffer = settings->adc_buffer;
+    step.pulse_amplitude = 0;
+    step.timer_period = ASV_HOLD_PERIOD;
+    step.route = SEQ_ROUTE_NONE;
+    step.mode = SEQ_MODE_HOLD;
+    
+    step.start_value = settings->deposition_value;
+    step.end_value = settings->deposition_value;
+    step.length = settings->deposition_time / ASV_MS_PER_HOLD_TICK;
+    if (!Sequencer_AddStep(&step)) {
+        return false;
+    }
+    if (settings->quiet_time >= ASV_MS_PER_HOLD_TICK) {
+        step.start_value = settings->start_value;
+        step.end_value = settings->start_value;
+        step.length = settings->quiet_time / ASV_MS_PER_HOLD_TICK;
+        if (!Sequencer_AddStep(&step)) {
+            return false;
+        }
+    }
+    
+    // stripping sweep
+    step.mode = (settings->sweep_type == ASV_SQUARE_WAVE) ? SEQ_MODE_SWV : SEQ_MODE_RAMP;
+    step.route = SEQ_ROUTE_STREAM;
+    step.start_value = settings->start_value;
+    step.end_value = settings->end_value;
+    step.pulse_amplitude = pulse;
+    step.timer_period = settings->timer_period;
+    return Sequencer_AddStep(&step);
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,56 @@
+/*******************************************************************************
+* File Name: asv.h
+*
+* Description:
+*  This file contains the function prototypes and constants used for
+*  anodic stripping voltammetry
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#if !defined(ASV_H)
+#define ASV_H
+
+#include "cytypes.h"
+#include "sequencer.h"
+
+/**************************************
+*      Constants
+**************************************/
+
+#define ASV_HOLD_PERIOD 23999  // PWM_isr period for the deposition and quiet steps, period+1 counts of the 2.4 MHz Clock_PWM is 10 ms
+#define ASV_MS_PER_HOLD_TICK 10
+
+#define ASV_LINEAR_SWEEP 'L'
+#define ASV_SQUARE_WAVE 'S'
+
+
+/**************************************
+*      Structures
+**************************************/
+
+struct ASVSettings {
+    uint16 deposition_value;  // dac value to plate the metals on the electrode
+    uint32 deposition_time;  // ms
+    uint32 quiet_time;  // ms to hold at the stripping start value, 0 for no quiet time
+    uint16 start_value;  // dac value to start stripping from
+    uint16 end_value;  // dac value to stop stripping at
+    uint8 sweep_type;  // ASV_LINEAR_SWEEP or ASV_SQUARE_WAVE
+    uint16 pulse_amplitude;  // dac counts for square wave stripping
+    uint16 timer_period;  // PWM_isr period of the stripping sweep
+    uint8 tia_resistor;
+    uint8 adc_buffer;
+};
+
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+uint8 ASV_Load(struct ASVSettings *settings);
+
+#endif
+
+/* [] END OF FILE */
@@ -0,0 +1,100 @@
+/*******************************************************************************
+* File Name: asv_test.c
+*
+* Description:
+*  Runs an anodic stripping voltammetry program on a computer against the
+*  simulated hardware in sim/.  Checks the deposition and quiet steps hold
+*  for 10 ms ticks, the sweep follows them without a gap and settings the
+*  sequencer can't run are refused
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include "asv.h"
+#include "DAC.h"
+#include "sequencer_hal_sim.h"
+#include "sim_test.h"
+
+#define TEST_DEPOSITION 1000
+#define TEST_START 2000
+#define TEST_END 2010
+#define TEST_PULSE 25
+
+static struct ASVSettings test_settings(void) {
+    struct ASVSettings settings;
+    settings.deposition_value = TEST_DEPOSITION;
+    settings.deposition_time = 50;  // 5 ticks
+    settings.quiet_time = 35;  // 3 ticks, the part of a tick left over is dropped
+    settings.start_value = TEST_START;
+    settings.end_value = TEST_END;
+    settings.sweep_type = ASV_LINEAR_SWEEP;
+    settings.pulse_amplitude = TEST_PULSE;  // not used by a linear sweep
+    settings.timer_period = 2399;  // 1 ms ticks
+    settings.tia_resistor = 1;
+    settings.adc_buffer = 0;
+    return settings;
+}
+
+static void test_run(void) {
+    struct ASVSettings settings = test_settings();
+    uint16 dac_history[32];
+    uint16 period_history[32];
+
+    SIM_CHECK(PWM_CLOCK_HZ / (ASV_HOLD_PERIOD + 1) == 1000 / ASV_MS_PER_HOLD_TICK);
+    SIM_CHECK(ASV_Load(&settings));
+    SIM_CHECK(Sequencer_GetLength() == 3);
+    SimHAL_Reset();
+    SIM_CHECK(Sequencer_Start(4));
+    while (Sequencer_IsRunning() && (sim_ticks < 100)) {
+        if (sim_ticks < 32) {
+            dac_history[sim_ticks] = sim_dac_value;
+            period_history[sim_ticks] = sim_pwm_period;
+        }
+        SimHAL_Advance();
+        Sequencer_Tick();
+    }
+    SIM_CHECK(sim_finished);
+    SIM_CHECK(sim_ticks == 5 + 3 + 11);
+    SIM_CHECK((dac_history[0] == TEST_DEPOSITION) && (dac_history[4] == TEST_DEPOSITION));
+    SIM_CHECK(period_history[4] == ASV_HOLD_PERIOD);
+    SIM_CHECK((dac_history[5] == TEST_START) && (dac_history[7] == TEST_START));
+    SIM_CHECK(period_history[7] == ASV_HOLD_PERIOD);
+    SIM_CHECK(dac_history[8] == TEST_START);  // the sweep starts on the tick after the quiet time ends
+    SIM_CHECK(dac_history[18] == TEST_END);
+    SIM_CHECK(period_history[18] == 2399);
+
+    settings.quiet_time = 0;  // no quiet step
+    SIM_CHECK(ASV_Load(&settings));
+    SIM_CHECK(Sequencer_GetLength() == 2);
+}
+
+static void test_limits(void) {
+    struct ASVSettings settings = test_settings();
+    selected_voltage_source = VDAC_IS_DVDAC;
+    settings.sweep_type = 'X';
+    SIM_CHECK(!ASV_Load(&settings));
+    settings = test_settings();
+    settings.sweep_type = ASV_SQUARE_WAVE;
+    settings.end_value = DAC_MaxValue() - TEST_PULSE + 1;  // the last pulse would go past the dac
+    SIM_CHECK(!ASV_Load(&settings));
+    settings.end_value = DAC_MaxValue() - TEST_PULSE;
+    SIM_CHECK(ASV_Load(&settings));
+    settings = test_settings();
+    settings.deposition_time = ASV_MS_PER_HOLD_TICK - 1;  // shorter than a tick
+    SIM_CHECK(!ASV_Load(&settings));
+    settings = test_settings();
+    settings.timer_period = 0;
+    SIM_CHECK(!ASV_Load(&settings));
+}
+
+int main(void) {
+    DAC_Start();
+    selected_voltage_source = VDAC_IS_DVDAC;
+    test_run();
+    test_limits();
+    return sim_test_failures;
+}
+
+/* [] END OF FILE */
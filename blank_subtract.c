@@ -0,0 +1,233 @@
+/*******************************************************************************
+* File Name: blank_subtract.c
+*
+* Description:
+*  Background subtraction for cyclic voltammetry.  A run of the blank
+*  electrolyte is saved in ADC_array[BLANK_CHANNEL] with a key made from the
+*  look up table, PWM period and gain settings.  Later runs with the same key
+*  have the blank, times a scale, subtracted from each current in the adc isr
+*  so the exported data and the on device processing (features, averaging)
+*  already have the background removed.
+*  Once a blank is saved adc_ring_channels is cut so the block modes leave
+*  ADC_array[BLANK_CHANNEL] alone, and a CRC of the saved blank is still
+*  checked before it is used
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include <project.h>
+
+#include "blank_subtract.h"
+#include "helper_functions.h"
+#include "sample_clock.h"
+
+extern uint16 waveform_lut[];  // in main.c
+
+uint8 blank_state = BLANK_IDLE;
+
+static uint8 capture_requested = false;
+static uint8 subtract_enabled = false;
+static uint16 blank_scale = BLANK_SCALE_ONE;
+static uint8 blank_saved = false;
+static uint16 blank_key;  // key of the saved blank
+static uint16 blank_crc;  // CRC of the saved blank data
+static uint16 run_key;  // key of the run that is armed
+static int16 *blank_data = ADC_array[BLANK_CHANNEL].data;
+
+/***************************************
+* Forward function references
+***************************************/
+static uint16 blank_make_key(uint16 length, uint16 period, uint8 tia_resistor, uint8 adc_buffer);
+
+
+/******************************************************************************
+* Function Name: Blank_Capture
+*******************************************************************************
+*
+* Summary:
+*  Save the next cyclic voltammetry run as the blank
+*
+*******************************************************************************/
+
+void Blank_Capture(void) {
+    capture_requested = true;
+}
+
+/******************************************************************************
+* Function Name: Blank_Enable
+*******************************************************************************
+*
+* Summary:
+*  Subtract the blank from the next runs that have the same key
+*
+* Parameters:
+*  uint16 scale: amount of the blank to subtract, BLANK_SCALE_ONE is 1.0
+*
+*******************************************************************************/
+
+void Blank_Enable(uint16 scale) {
+    blank_scale = scale;
+    subtract_enabled = true;
+}
+
+void Blank_Disable(void) {
+    subtract_enabled = false;
+    capture_requested = false;
+}
+
+/******************************************************************************
+* Function Name: Blank_Arm
+*******************************************************************************
+*
+* Summary:
+*  Decide what to do with the blank in the cyclic voltammetry run being armed
+*
+* Parameters:
+*  uint16 length: look up table length
+*  uint16 period: PWM_isr period
+*  uint8 tia_resistor: TIA resistor index
+*  uint8 adc_buffer: adc buffer gain index
+*
+* Return:
+*  BLANK_CAPTURE, BLANK_SUBTRACT, BLANK_IDLE if the blank is not used or
+*  BLANK_ERROR if a capture or subtraction was asked for but can not be done,
+*  there is no room for the blank or no good saved blank for this waveform
+*
+*******************************************************************************/
+
+uint8 Blank_Arm(uint16 length, uint16 period, uint8 tia_resistor, uint8 adc_buffer) {
+    blank_state = BLANK_IDLE;
+    if (!capture_requested && !subtract_enabled) {
+        return blank_state;
+    }
+    if (length > MAX_LUT_SIZE - 1) {  // no room for the blank
+        return BLANK_ERROR;
+    }
+    run_key = blank_make_key(length, period, tia_resistor, adc_buffer);
+    if (capture_requested) {
+        blank_state = BLANK_CAPTURE;
+    }
+    else if (blank_saved && (run_key == blank_key) && 
+             (helper_CRC16(HELPER_CRC16_START, (uint8*)blank_data, 2*length) == blank_crc)) {
+        blank_state = BLANK_SUBTRACT;
+    }
+    else {
+        return BLANK_ERROR;
+    }
+    return blank_state;
+}
+
+/******************************************************************************
+* Function Name: Blank_Process
+*******************************************************************************
+*
+* Summary:
+*  Subtract the scaled blank from a current, called from the adc isr.  The
+*  result is clamped to the int16 range so it can not wrap around
+*
+* Parameters:
+*  uint16 index: look up table index of the data point
+*  int16 current: adc count
+*
+* Return:
+*  the current with the blank subtracted if a subtract run is going, or the current
+*
+*******************************************************************************/
+
+int16 Blank_Process(uint16 index, int16 current) {
+    if (blank_state != BLANK_SUBTRACT) {
+        return current;
+    }
+    int32 corrected = current - (((int32)blank_data[index] * blank_scale) >> 14);
+    if (corrected > 32767) {
+        corrected = 32767;
+    }
+    else if (corrected < -32768) {
+        corrected = -32768;
+    }
+    return corrected;
+}
+
+/******************************************************************************
+* Function Name: Blank_EndRun
+*******************************************************************************
+*
+* Summary:
+*  Called when a cyclic voltammetry run is done with the currents in
+*  ADC_array[0].  If the run was a capture they are saved as the blank
+*
+* Parameters:
+*  uint16 length: number of data points in the run
+*
+*******************************************************************************/
+
+void Blank_EndRun(uint16 length) {
+    if (blank_state == BLANK_CAPTURE) {
+        capture_requested = false;
+        for (uint16 i = 0; i < length; i++) {
+            blank_data[i] = ADC_array[0].data[i];
+        }
+        blank_data[length] = ADC_DATA_DONE_CODE;  // so the blank can be read with 'E'
+        blank_key = run_key;
+        blank_crc = helper_CRC16(HELPER_CRC16_START, (uint8*)blank_data, 2*length);
+        blank_saved = true;
+        adc_ring_channels = BLANK_CHANNEL;  // the block modes use the channels below the blank from now on
+    }
+    blank_state = BLANK_IDLE;
+}
+
+/******************************************************************************
+* Function Name: Blank_Stop
+*******************************************************************************
+*
+* Summary:
+*  Stop using the blank in a run that was stopped early, a capture that was
+*  stopped is not saved
+*
+*******************************************************************************/
+
+void Blank_Stop(void) {
+    blank_state = BLANK_IDLE;
+}
+
+/******************************************************************************
+* Function Name: Blank_Key
+*******************************************************************************
+*
+* Summary:
+*  Get the key of the saved blank so the computer can check which waveform it is for
+*
+* Return:
+*  key of the saved blank or 0 if no blank is saved
+*
+*******************************************************************************/
+
+uint16 Blank_Key(void) {
+    if (!blank_saved) {
+        return 0;
+    }
+    return blank_key;
+}
+
+/******************************************************************************
+* Function Name: blank_make_key
+*******************************************************************************
+*
+* Summary:
+*  Make a key for a run from a CRC of the look up table and the settings that
+*  change the background current, the PWM period and Clock_PWM divider set the
+*  scan rate
+*
+*******************************************************************************/
+
+static uint16 blank_make_key(uint16 length, uint16 period, uint8 tia_resistor, uint8 adc_buffer) {
+    uint16 divider = SampleClock_Divider();
+    uint8 settings[8] = {length & 0xFF, length >> 8, period & 0xFF, period >> 8, 
+                         divider & 0xFF, divider >> 8, tia_resistor, adc_buffer};
+    uint16 key = helper_CRC16(HELPER_CRC16_START, (uint8*)waveform_lut, 2*length);
+    return helper_CRC16(key, settings, sizeof(settings));
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,55 @@
+/*******************************************************************************
+* File Name: blank_subtract.h
+*
+* Description:
+*  This file contains the function prototypes and constants used for
+*  subtracting a stored blank cyclic voltammetry trace while measuring
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#if !defined(BLANK_SUBTRACT_H)
+#define BLANK_SUBTRACT_H
+
+#include "cytypes.h"
+#include "globals.h"
+
+/**************************************
+*      Constants
+**************************************/
+
+#define BLANK_CHANNEL (ADC_CHANNELS - 1)  // ADC_array channel the blank trace is kept in, the last so the ring can skip it
+#define BLANK_SCALE_ONE 16384  // scale of 1.0, the scale has 14 fractional bits
+
+// what the blank does during a cyclic voltammetry run
+#define BLANK_IDLE 0
+#define BLANK_CAPTURE 1  // save the run as the blank
+#define BLANK_SUBTRACT 2  // subtract the blank from the run
+#define BLANK_ERROR 3  // returned by Blank_Arm when the blank that was asked for can not be used, the run is idle
+
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+void Blank_Capture(void);
+void Blank_Enable(uint16 scale);
+void Blank_Disable(void);
+uint8 Blank_Arm(uint16 length, uint16 period, uint8 tia_resistor, uint8 adc_buffer);
+int16 Blank_Process(uint16 index, int16 current);
+void Blank_EndRun(uint16 length);
+void Blank_Stop(void);
+uint16 Blank_Key(void);
+
+
+/***************************************
+* Global variables external identifier
+***************************************/
+
+extern uint8 blank_state;  // BLANK_XXX for the run that is going
+
+#endif
+
+/* [] END OF FILE */
@@ -0,0 +1,162 @@
+/*******************************************************************************
+* File Name: block_stats.c
+*
+* Description:
+*  Streaming block statistics for long amperometry runs.  The mean, variance,
+*  min and max of each window of data points are updated one point at a time
+*  (Welford's method in fixed point) and only a small record is sent for each
+*  window.  The raw data of a window can also be sent if its variance is over
+*  a threshold
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include "block_stats.h"
+#include "data_export.h"
+#include "usb_protocols.h"
+
+static union block_stats_usb_union stats;
+
+/* settings */
+static uint16 window_length;
+static uint32 threshold_q8;
+static uint8 keep_raw;
+
+/* running statistics of the window */
+static uint32 count;
+static int32 mean_q8;
+static int64 m2_q16;  // sum of the squared differences from the mean, 16 fractional bits
+static int16 min_value;
+static int16 max_value;
+static uint32 window_number;
+static uint8 raw_channel;
+
+/***************************************
+* Forward function references
+***************************************/
+static void BlockStats_ClearWindow(void);
+static void BlockStats_EndWindow(void);
+
+
+/******************************************************************************
+* Function Name: BlockStats_Start
+*******************************************************************************
+*
+* Summary:
+*  Set up the statistics for a new run
+*
+* Parameters:
+*  uint16 window_size: number of data points in each window
+*  uint32 variance_threshold: windows with a larger variance (adc counts squared) 
+*                             have their raw data kept if send_raw is true
+*  uint8 send_raw: true to keep the raw data of noisy windows
+*
+* Return:
+*  true if the settings are valid
+*
+*******************************************************************************/
+
+uint8 BlockStats_Start(uint16 window_size, uint32 variance_threshold, uint8 send_raw) {
+    if ((window_size < 2) || (send_raw && (window_size >= MAX_LUT_SIZE))) {
+        return false;
+    }
+    window_length = window_size;
+    threshold_q8 = 0xFFFFFFFF;
+    if (variance_threshold < (0xFFFFFFFF >> 8)) {
+        threshold_q8 = variance_threshold << 8;
+    }
+    keep_raw = send_raw;
+    window_number = 0;
+    raw_channel = 0;
+    BlockStats_ClearWindow();
+    return true;
+}
+
+/******************************************************************************
+* Function Name: BlockStats_AddSample
+*******************************************************************************
+*
+* Summary:
+*  Update the window statistics with a new data point, called from the adc isr
+*
+* Parameters:
+*  int16 sample: adc reading
+*
+*******************************************************************************/
+
+void BlockStats_AddSample(int16 sample) {
+    int32 sample_q8 = (int32)sample << 8;
+    
+    if (keep_raw) {
+        ADC_array[raw_channel].data[count] = sample;
+    }
+    count++;
+    int32 delta = sample_q8 - mean_q8;
+    mean_q8 += delta / (int32)count;
+    m2_q16 += (int64)delta * (sample_q8 - mean_q8);
+    if (sample < min_value) {
+        min_value = sample;
+    }
+    if (sample > max_value) {
+        max_value = sample;
+    }
+    if (count >= window_length) {
+        BlockStats_EndWindow();
+    }
+}
+
+/******************************************************************************
+* Function Name: BlockStats_ClearWindow
+*******************************************************************************
+*
+* Summary:
+*  Reset the running statistics for the next window
+*
+*******************************************************************************/
+
+static void BlockStats_ClearWindow(void) {
+    count = 0;
+    mean_q8 = 0;
+    m2_q16 = 0;
+    min_value = 32767;
+    max_value = -32768;
+}
+
+/******************************************************************************
+* Function Name: BlockStats_EndWindow
+*******************************************************************************
+*
+* Summary:
+*  Send the record for the window that just finished.  If the variance is 
+*  over the threshold and the raw data is being kept, the data is left in 
+*  the ADC_array channel to export with 'F' and the next channel is used
+*
+*******************************************************************************/
+
+static void BlockStats_EndWindow(void) {
+    int64 variance_q8 = (m2_q16 / (count - 1)) >> 8;
+    if (variance_q8 > 0xFFFFFFFF) {
+        variance_q8 = 0xFFFFFFFF;
+    }
+    stats.record.tag[0] = 'B';
+    stats.record.tag[1] = 'S';
+    stats.record.window = window_number;
+    stats.record.count = count;
+    stats.record.mean_q8 = mean_q8;
+    stats.record.variance_q8 = variance_q8;
+    stats.record.min = min_value;
+    stats.record.max = max_value;
+    stats.record.raw_channel = BLOCK_STATS_NO_RAW;
+    if (keep_raw && (stats.record.variance_q8 > threshold_q8)) {
+        ADC_array[raw_channel].data[count] = ADC_DATA_DONE_CODE;
+        stats.record.raw_channel = raw_channel;
+        raw_channel = (raw_channel + 1) % adc_ring_channels;
+    }
+    Export_Notify(stats.usb, sizeof(struct BlockStatsRecord));
+    window_number++;
+    BlockStats_ClearWindow();
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,56 @@
+/*******************************************************************************
+* File Name: block_stats.h
+*
+* Description:
+*  This file contains the function prototypes and constants used for
+*  the streaming block statistics amperometry mode
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#if !defined(BLOCK_STATS_H)
+#define BLOCK_STATS_H
+
+#include "cytypes.h"
+#include "globals.h"
+
+/**************************************
+*      Constants
+**************************************/
+
+#define BLOCK_STATS_NO_RAW 0xFFFF  // raw_channel value when the raw data of a window was not kept
+
+
+/**************************************
+*      Structures
+**************************************/
+
+struct BlockStatsRecord {
+    char tag[2];  // "BS"
+    uint16 raw_channel;  // ADC_array channel with the raw data of the window or BLOCK_STATS_NO_RAW
+    uint32 window;  // number of the window since the run started
+    uint32 count;  // data points in the window
+    int32 mean_q8;  // mean adc count with 8 fractional bits
+    uint32 variance_q8;  // sample variance in adc counts squared with 8 fractional bits
+    int16 min;
+    int16 max;
+};
+
+union block_stats_usb_union {
+    uint8 usb[sizeof(struct BlockStatsRecord)];
+    struct BlockStatsRecord record;
+};
+
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+uint8 BlockStats_Start(uint16 window_size, uint32 variance_threshold, uint8 send_raw);
+void BlockStats_AddSample(int16 sample);
+
+#endif
+
+/* [] END OF FILE */
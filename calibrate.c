@@ -14,18 +14,42 @@
 #include <stdio.h>
 #include "stdlib.h"
 
+#include "adc_profile.h"
 #include "calibrate.h"
+#include "helper_functions.h"
 #include "usb_protocols.h"
 
 //extern char LCD_str[];  // for debug
 const uint16 calibrate_TIA_resistor_list[] = {20, 30, 40, 80, 120, 250, 500, 1000}; 
 uint16 static ADC_value;
 
+// states of the calibration, it is run from the main loop a step at a time so USB commands are still handled
+#define CAL_IDLE 0
+#define CAL_WARMUP 1
+#define CAL_MEASURE 2
+#define CAL_SETTLE_US 100000  // time to let the TIA / ADC settle after each change
+
+struct CalibrateStep {
+    uint8 polarity;
+    uint16 IDAC_value;
+    uint8 IDAC_index;
+};
+
+static uint8 cal_state = CAL_IDLE;
+static uint8 cal_step_index;
+static uint32 cal_step_start;
+static struct CalibrateStep cal_steps[Number_calibration_points];
+static uint8 cal_valid = false;  // calibrate_array holds a finished calibration made with the gain below
+static uint8 cal_tia_resistor;
+static uint8 cal_adc_buffer;
+static uint8 cal_adc_profile;  // the counts per amp change with the adc resolution
+
 /***************************************
 * Forward function references
 ***************************************/
 static void Calibrate_Hardware_Wakeup(void);
-static void calibrate_step(uint16 IDAC_value, uint8 IDAC_index);
+static void calibrate_load_step(uint8 step_index);
+static void calibrate_read_step(uint8 step_index);
 static void Calibrate_Hardware_Sleep(void);
 
 /**/
@@ -35,15 +59,14 @@ static void Calibrate_Hardware_Sleep(void);
 *******************************************************************************
 *
 * Summary:
-*  Calibrate the TIA circuit each time the current gain settings are changed
+*  Calibrate the TIA circuit each time the current gain settings are changed.
+*  Only starts the calibration, calibrate_Poll has to be called from the main loop
+*  until it is finished
 *
 * Parameters:
 *  uint8 TIA_resistor_value_index: index of whick TIA resistor to use, Supplied by USB input
 *  uint8 ADC_buffer_index: which ADC buffer is used, gain = 2**ADC_buffer_index
 *
-* Return:
-*  array of 20 bytes is loaded into the USB in endpoint (into the computer)
-*
 *******************************************************************************/
 
 void calibrate_TIA(uint8 TIA_resistor_value_index, uint8 ADC_buffer_index) {
@@ -53,15 +76,10 @@ void calibrate_TIA(uint8 TIA_resistor_value_index, uint8 ADC_buffer_index) {
     IDAC_calibrate_SetValue(0);
     // start the hardware required
     Calibrate_Hardware_Wakeup();
-    CyDelay(100);
     // decide what currents to use based on TIA resistor and ADC buffer settings
     uint16 resistor_value = calibrate_TIA_resistor_list[TIA_resistor_value_index];
     uint var = 2;
-    uint16 IDAC_setting = 0;
     uint8 ADC_buffer_value = pow(var, ADC_buffer_index);
-    // set input current to zero and read ADC
-    ADC_SigDel_StartConvert();
-    calibrate_step(IDAC_setting, 2);
     // calculate the IDAC value needed to get a 1 Volt in the ADC
     // the 8000 is because the IDAC has a 1/8 uA per bit and 8000=1000mV/(1/8 uA per bit)
     float32 transfer = 8000./(ADC_buffer_value*resistor_value);
@@ -69,45 +87,185 @@ void calibrate_TIA(uint8 TIA_resistor_value_index, uint8 ADC_buffer_index) {
     if (transfer_int > 250) {  // the TIA needs too much current, reduce needs by half.  Is needed for the 20k resistor setting
         transfer_int /= 2;
     }
-    // is not DRY but not sure how to fix
-    IDAC_calibrate_SetPolarity(IDAC_calibrate_SINK);
-    calibrate_step(transfer_int, 0);
-    calibrate_step(transfer_int/2, 1);
-    IDAC_calibrate_SetPolarity(IDAC_calibrate_SOURCE);
-    calibrate_step(transfer_int/2, 3);
-    calibrate_step(transfer_int, 4);
+    // zero input current first, then the sink and source currents
+    struct CalibrateStep steps[Number_calibration_points] = {
+        {IDAC_calibrate_SINK, 0, 2},
+        {IDAC_calibrate_SINK, transfer_int, 0},
+        {IDAC_calibrate_SINK, transfer_int/2, 1},
+        {IDAC_calibrate_SOURCE, transfer_int/2, 3},
+        {IDAC_calibrate_SOURCE, transfer_int, 4}
+    };
+    for (uint8 i = 0; i < Number_calibration_points; i++) {
+        cal_steps[i] = steps[i];
+    }
+    cal_valid = false;
+    cal_tia_resistor = TIA_resistor_value_index;
+    cal_adc_buffer = ADC_buffer_index;
+    cal_adc_profile = AdcProfile_Current();
+    cal_step_start = helper_ReadCycleCounter();
+    cal_state = CAL_WARMUP;
+}
+
+/******************************************************************************
+* Function Name: calibrate_Poll
+*******************************************************************************
+*
+* Summary:
+*  Move the calibration forward once the hardware has settled, replaces the
+*  CyDelay calls so the main loop keeps reading commands while calibrating
+*
+* Return:
+*  true (1) if the calibration finished this call, the 20 bytes of
+*  calibrate_array are loaded into the USB in endpoint (into the computer)
+*
+*******************************************************************************/
+
+uint8 calibrate_Poll(void) {
+    if (cal_state == CAL_IDLE) {
+        return false;
+    }
+    if (helper_CyclesToUs(helper_ReadCycleCounter() - cal_step_start) < CAL_SETTLE_US) {
+        return false;
+    }
+    if (cal_state == CAL_WARMUP) {
+        ADC_SigDel_StartConvert();
+        cal_step_index = 0;
+        calibrate_load_step(cal_step_index);
+        cal_state = CAL_MEASURE;
+        return false;
+    }
+    calibrate_read_step(cal_step_index);
+    cal_step_index++;
+    if (cal_step_index < Number_calibration_points) {
+        calibrate_load_step(cal_step_index);
+        return false;
+    }
     IDAC_calibrate_SetValue(0);
     Calibrate_Hardware_Sleep();
+    cal_state = CAL_IDLE;
+    cal_valid = true;
     
 //    LCD_Position(0,0);
 //    sprintf(LCD_str, "in:%d |%d| ", resistor_value, ADC_buffer_value);
 //    LCD_PrintString(LCD_str);
         
     USB_Export_Data(calibrate_array.usb, 20);
+    return true;
+}
+
+/******************************************************************************
+* Function Name: calibrate_Abort
+*******************************************************************************
+*
+* Summary:
+*  Stop a calibration that is running and put the hardware to sleep
+*
+*******************************************************************************/
+
+void calibrate_Abort(void) {
+    if (cal_state != CAL_IDLE) {
+        IDAC_calibrate_SetValue(0);
+        Calibrate_Hardware_Sleep();
+        cal_state = CAL_IDLE;
+    }
+}
+
+/******************************************************************************
+* Function Name: calibrate_GetFit
+*******************************************************************************
+*
+* Summary:
+*  Fit a line through the calibration points so the computer can change adc
+*  counts into current with 1 multiply, without having to know the layout of
+*  calibrate_array or the IDAC step size
+*
+* Parameters:
+*  struct CalibrationFit *fit: where to put the fit, fit->valid is false if
+*                              there is no calibration to fit
+*
+*******************************************************************************/
+
+void calibrate_GetFit(struct CalibrationFit *fit) {
+    fit->valid = false;
+    fit->tia_resistor = cal_tia_resistor;
+    fit->adc_buffer = cal_adc_buffer;
+    fit->adc_profile = cal_adc_profile;
+    fit->zero_count = calibrate_array.data[2+Number_calibration_points];
+    fit->femtoamps_per_count = 0;
+    if (!cal_valid) {
+        return;
+    }
+    float32 current[Number_calibration_points];
+    float32 mean_count = 0;
+    float32 mean_current = 0;
+    for (uint8 i = 0; i < Number_calibration_points; i++) {
+        current[i] = CALIBRATE_IDAC_FA_PER_BIT * calibrate_array.data[i];
+        if (i < 2) {  // the first 2 points sink current
+            current[i] = -current[i];
+        }
+        mean_count += calibrate_array.data[i+Number_calibration_points];
+        mean_current += current[i];
+    }
+    mean_count /= Number_calibration_points;
+    mean_current /= Number_calibration_points;
+    float32 covariance = 0;
+    float32 variance = 0;
+    for (uint8 i = 0; i < Number_calibration_points; i++) {
+        float32 count_offset = calibrate_array.data[i+Number_calibration_points] - mean_count;
+        covariance += count_offset * (current[i] - mean_current);
+        variance += count_offset * count_offset;
+    }
+    if (variance == 0) {  // the adc did not see the IDAC
+        return;
+    }
+    float32 slope = covariance / variance;
+    if ((slope > 2147483647.0f) || (slope < -2147483647.0f)) {
+        return;
+    }
+    fit->femtoamps_per_count = (int32)slope;
+    fit->valid = true;
+}
+
+/******************************************************************************
+* Function Name: calibrate_load_step
+*******************************************************************************
+*
+* Summary:
+*  Set the calibration IDAC for a calibration data point and start the settling time
+*
+* Parameters:
+*  uint8 step_index: which of the calibration steps to load
+*
+*******************************************************************************/
+
+static void calibrate_load_step(uint8 step_index) {
+    if (step_index) {  // the zero current point does not need a polarity
+        IDAC_calibrate_SetPolarity(cal_steps[step_index].polarity);
+    }
+    IDAC_calibrate_SetValue(cal_steps[step_index].IDAC_value);
+    cal_step_start = helper_ReadCycleCounter();  // allow the ADC to settle
 }
 
 /******************************************************************************
-* Function Name: calibrate_step
+* Function Name: calibrate_read_step
 *******************************************************************************
 *
 * Summary:
-*  Gets a single calibration data point by setting the calibration IDAC and reading
-*  the ADC count and saving them in the calibration_array
+*  Gets a single calibration data point by reading the ADC count and saving
+*  it with the IDAC value in the calibration_array
 *
 * Parameters:
-*  uint16 IDAC_value: value to set the calibration  IDAC to before measuring with the ADC
-*  uint8 IDAC_index: index of where in calibration_array to save the IDAC and ADC data
+*  uint8 step_index: which of the calibration steps was measured
 *
 * Global variables:
 *  calibration_array: array of saved IDAC and ADC values
 *
 *******************************************************************************/
 
-static void calibrate_step(uint16 IDAC_value, uint8 IDAC_index) {
-    IDAC_calibrate_SetValue(IDAC_value);
-    CyDelay(100);  // allow the ADC to settle
-    ADC_value = ADC_SigDel_GetResult16();
-    calibrate_array.data[IDAC_index] = IDAC_value;
+static void calibrate_read_step(uint8 step_index) {
+    uint8 IDAC_index = cal_steps[step_index].IDAC_index;
+    ADC_value = AdcProfile_GetResult();
+    calibrate_array.data[IDAC_index] = cal_steps[step_index].IDAC_value;
     calibrate_array.data[IDAC_index+5] = ADC_value;  // 5 because of the way the array is set up
 }
 
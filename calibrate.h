@@ -22,6 +22,7 @@
 #define AMux_TIA_calibrat_ch 0
 #define AMux_TIA_measure_ch 1    
 #define Number_calibration_points 5
+#define CALIBRATE_IDAC_FA_PER_BIT 125000000.0f  // the IDAC is 1/8 uA per bit
   
     
 union calibrate_data_usb_union {
@@ -37,11 +38,23 @@ ADC reading 0 IDAC input, ADC reading for 2nd lowest IDAC value, ADC reading for
     
 extern char LCD_str[];
 
+struct CalibrationFit {
+    uint8 valid;  // true if a calibration has finished
+    uint8 tia_resistor;  // gain settings the calibration was made with
+    uint8 adc_buffer;
+    uint8 adc_profile;  // ADC_PROFILE_XXX the calibration was made with
+    int32 femtoamps_per_count;  // least squares slope of the calibration points, current is positive when the IDAC sources
+    int16 zero_count;  // adc reading with no current
+};
+
 
 /***************************************
 *        Function Prototypes
 ***************************************/  
 void calibrate_TIA(uint8 TIA_resistor_value, uint8 ADC_buffer_index);
+uint8 calibrate_Poll(void);
+void calibrate_Abort(void);
+void calibrate_GetFit(struct CalibrationFit *fit);
 
 #endif
 /* [] END OF FILE */
@@ -0,0 +1,191 @@
+/*******************************************************************************
+* File Name: command_queue.c
+*
+* Description:
+*  Queue of USB OUT packets.  The packets are read from the OUT endpoint in
+*  its interrupt so the computer can send commands while the main loop is
+*  busy with another command.  A stop command ('X') also stops the
+*  experiment interrupts right away in the endpoint interrupt and sets
+*  usb_abort so long running functions can give up.  While a waveform is
+*  being uploaded the packets go to waveform_upload.c instead of the queue
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include "command_queue.h"
+#include "cyapicallbacks.h"
+#include "waveform_upload.h"
+#include "trace.h"
+
+volatile uint8 usb_abort = false;
+
+static uint8 queue[CMD_QUEUE_DEPTH][CMD_QUEUE_PACKET_SIZE];
+static volatile uint8 queue_head = 0;  // next slot to write, only changed by the isr
+static volatile uint8 queue_tail = 0;  // next slot to read, only changed by the main loop
+static uint8 discard[CMD_QUEUE_PACKET_SIZE];
+static struct CommandQueueStats queue_stats;
+#if (USBFS_EP_MANAGEMENT_DMA_AUTO)
+static volatile uint8 out_arrived = false;  // set by the endpoint isr, the packet is taken when the DMA is done
+#endif
+
+
+/***************************************
+* Forward function references
+***************************************/
+static void command_queue_take(void);
+
+
+/******************************************************************************
+* Function Name: USBFS_EP_2_ISR_ExitCallback
+*******************************************************************************
+*
+* Summary:
+*  Called by the USBFS component at the end of the OUT endpoint interrupt.
+*  Copy the packet into the queue and let the endpoint take the next packet.
+*  With DMA automatic buffer management the DMA moves the packet after the
+*  endpoint interrupt, so CommandQueue_Poll takes it instead
+*
+*******************************************************************************/
+
+void USBFS_EP_2_ISR_ExitCallback(void) {
+    #if (USBFS_EP_MANAGEMENT_DMA_AUTO)
+    out_arrived = true;
+    #else
+    if (USBFS_GetEPState(OUT_ENDPOINT) != USBFS_OUT_BUFFER_FULL) {
+        return;
+    }
+    command_queue_take();
+    #endif
+}
+
+/******************************************************************************
+* Function Name: CommandQueue_Poll
+*******************************************************************************
+*
+* Summary:
+*  Called from the main loop and the USB_Export_Data wait loop.  Only does
+*  something with DMA automatic buffer management, where the endpoint state
+*  stays USBFS_OUT_BUFFER_FULL after the endpoint isr until the DMA has moved the packet
+*
+*******************************************************************************/
+
+void CommandQueue_Poll(void) {
+    #if (USBFS_EP_MANAGEMENT_DMA_AUTO)
+    if (out_arrived && (USBFS_GetEPState(OUT_ENDPOINT) != USBFS_OUT_BUFFER_FULL)) {
+        out_arrived = false;
+        command_queue_take();
+    }
+    #endif
+}
+
+/******************************************************************************
+* Function Name: command_queue_take
+*******************************************************************************
+*
+* Summary:
+*  Copy the OUT packet into the queue and let the endpoint take the next packet
+*
+*******************************************************************************/
+
+static void command_queue_take(void) {
+    if (Upload_IsActive()) {  // waveform data, not a command so it is not checked for the stop command
+        Upload_ReadPacket();
+        USBFS_EnableOutEP(OUT_ENDPOINT);
+        queue_stats.received++;
+        return;
+    }
+    uint8 count = USBFS_GetEPCount(OUT_ENDPOINT);
+    if (count > CMD_QUEUE_PACKET_SIZE) {
+        count = CMD_QUEUE_PACKET_SIZE;
+    }
+    uint8 depth = (queue_head - queue_tail) & 0xFF;
+    uint8 *slot = discard;
+    if (depth < CMD_QUEUE_DEPTH) {
+        slot = queue[queue_head & (CMD_QUEUE_DEPTH - 1)];
+    }
+    USB_ReadOut(slot, count);
+    for (uint8 i = count; i < CMD_QUEUE_PACKET_SIZE; i++) {
+        slot[i] = 0;  // clear what is left of an older packet so short commands don't pick up old sub commands
+    }
+    // the last slot is saved for a stop command so usb_abort always gets cleared by the main loop
+    if ((depth == CMD_QUEUE_DEPTH - 1) && (slot[0] != CMD_URGENT_STOP)) {
+        slot = discard;
+    }
+    USBFS_EnableOutEP(OUT_ENDPOINT);
+    queue_stats.received++;
+    
+    if (slot[0] == CMD_URGENT_STOP) {  // stop the experiment now, the main loop cleans up when it gets the command
+        isr_dac_Disable();
+        isr_adc_Disable();
+        isr_adcAmp_Disable();
+        usb_abort = true;
+        TRACE(TRACE_URGENT_STOP, 0, 0);
+    }
+    if (slot == discard) {
+        queue_stats.drops++;
+        TRACE(TRACE_QUEUE_DROP, slot[0], 0);
+        return;
+    }
+    queue_head++;
+    depth++;
+    if (depth > queue_stats.high_water) {
+        queue_stats.high_water = depth;
+    }
+}
+
+/******************************************************************************
+* Function Name: CommandQueue_Pop
+*******************************************************************************
+*
+* Summary:
+*  Take the oldest packet out of the queue
+*
+* Parameters:
+*  uint8 buffer[]: where to copy the packet, at least CMD_QUEUE_PACKET_SIZE long
+*
+* Return:
+*  true (1) if a packet was copied or false (0) if the queue is empty
+*
+*******************************************************************************/
+
+uint8 CommandQueue_Pop(uint8 buffer[]) {
+    if (queue_head == queue_tail) {
+        return false;
+    }
+    uint8 *slot = queue[queue_tail & (CMD_QUEUE_DEPTH - 1)];
+    for (uint8 i = 0; i < CMD_QUEUE_PACKET_SIZE; i++) {
+        buffer[i] = slot[i];
+    }
+    queue_tail++;
+    return true;
+}
+
+uint8 CommandQueue_IsEmpty(void) {  // with DMA a packet the DMA is still moving is not empty, it has no isr to wake the CPU
+    #if (USBFS_EP_MANAGEMENT_DMA_AUTO)
+    if (out_arrived) {
+        return false;
+    }
+    #endif
+    return (queue_head == queue_tail);
+}
+
+/******************************************************************************
+* Function Name: CommandQueue_GetStats
+*******************************************************************************
+*
+* Summary:
+*  Get the queue counters
+*
+* Parameters:
+*  struct CommandQueueStats *stats: where to put the counters
+*
+*******************************************************************************/
+
+void CommandQueue_GetStats(struct CommandQueueStats *stats) {
+    *stats = queue_stats;
+    stats->depth = (queue_head - queue_tail) & 0xFF;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,58 @@
+/*******************************************************************************
+* File Name: command_queue.h
+*
+* Description:
+*  This file contains the function prototypes and constants used for
+*  the queue of USB OUT packets filled by the OUT endpoint interrupt
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#if !defined(COMMAND_QUEUE_H)
+#define COMMAND_QUEUE_H
+
+#include <project.h>
+#include "usb_protocols.h"
+
+/**************************************
+*      Constants
+**************************************/
+
+#define CMD_QUEUE_DEPTH 8  // has to be a power of 2
+#define CMD_QUEUE_PACKET_SIZE MAX_BUFFER_SIZE
+#define CMD_URGENT_STOP 'X'  // command that stops the isrs as soon as it is received
+
+
+/**************************************
+*      Structures
+**************************************/
+
+struct CommandQueueStats {
+    uint8 depth;  // packets waiting
+    uint8 high_water;  // most packets that have been waiting at one time
+    uint16 drops;  // packets thrown away because the queue was full
+    uint32 received;  // packets received
+};
+
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+void CommandQueue_Poll(void);
+uint8 CommandQueue_Pop(uint8 buffer[]);
+uint8 CommandQueue_IsEmpty(void);
+void CommandQueue_GetStats(struct CommandQueueStats *stats);
+
+
+/***************************************
+* Global variables external identifier
+***************************************/
+
+extern volatile uint8 usb_abort;  // set when a stop command comes in so blocking functions can return
+
+#endif
+
+/* [] END OF FILE */
@@ -0,0 +1,192 @@
+/*******************************************************************************
+* File Name: cv_average.c
+*
+* Description:
+*  Coherent averaging of repeated cyclic voltammetry cycles.  The look up
+*  table is played again right after the last point without stopping the
+*  interrupts so every cycle has the same timing, and each current is added
+*  to a 32 bit sum for its look up table index.  At the end the average is
+*  put in ADC_array[0] so it is read with the 'E' command like a single run.
+*  If asked for, the mean squared difference of each cycle from the average
+*  of the cycles before it is worked out while the samples come in so cycles
+*  with drift or noise bursts can be found
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include <project.h>
+
+#include "cv_average.h"
+
+uint8 cv_average_cycles = 0;
+
+static int32 *sums = ADC_array[AVERAGE_SUM_CHANNEL].data32;  // MAX_LUT_SIZE sums run into the next channel
+static uint16 average_points;
+static uint8 cycles_done;
+static uint8 variance_enabled;
+static int64 squared_difference;  // sum of the squared differences of the cycle being run
+static volatile uint8 average_ready = false;
+
+union cv_average_usb_union {
+    uint8 usb[sizeof(struct CVAverageRecord)];
+    struct CVAverageRecord record;
+};
+static union cv_average_usb_union average_record;
+
+
+/******************************************************************************
+* Function Name: CVAverage_Start
+*******************************************************************************
+*
+* Summary:
+*  Clear the sums before a cyclic voltammetry run that will be averaged, call
+*  after the run is armed
+*
+* Parameters:
+*  uint8 cycles: how many times to play the look up table, 2 to AVERAGE_MAX_CYCLES
+*  uint8 variance_on: true to work out the variance of each cycle
+*  uint16 points: length of the look up table
+*  int16 first_sample: adc reading taken when the run was armed, the first data point of cycle 0
+*
+* Return:
+*  true (1) if averaging is on or false (0) if the settings can not be used
+*
+*******************************************************************************/
+
+uint8 CVAverage_Start(uint8 cycles, uint8 variance_on, uint16 points, int16 first_sample) {
+    if ((cycles < 2) || (cycles > AVERAGE_MAX_CYCLES) || (points == 0) || (points > AVERAGE_MAX_POINTS)) {
+        cv_average_cycles = 0;
+        return false;
+    }
+    for (uint16 i = 0; i < points; i++) {
+        sums[i] = 0;
+    }
+    average_points = points;
+    cycles_done = 0;
+    variance_enabled = variance_on;
+    squared_difference = 0;
+    average_ready = false;
+    average_record.record.variance[0] = 0;
+    cv_average_cycles = cycles;
+    CVAverage_AddSample(0, first_sample);
+    return true;
+}
+
+/******************************************************************************
+* Function Name: CVAverage_AddSample
+*******************************************************************************
+*
+* Summary:
+*  Add a current to the sum of its look up table index, called from the adc isr.
+*  The difference from the average of the earlier cycles is worked out as
+*  current*cycles_done - sum so no division is needed in the isr
+*
+* Parameters:
+*  uint16 index: look up table index of the data point
+*  int16 current: adc count
+*
+*******************************************************************************/
+
+void CVAverage_AddSample(uint16 index, int16 current) {
+    if (index >= average_points) {
+        return;
+    }
+    if (variance_enabled && cycles_done) {
+        int32 difference = (int32)current * cycles_done - sums[index];
+        squared_difference += (int64)difference * difference;
+    }
+    sums[index] += current;
+}
+
+/******************************************************************************
+* Function Name: CVAverage_EndCycle
+*******************************************************************************
+*
+* Summary:
+*  Called from the dac isr at the end of the look up table
+*
+* Return:
+*  true (1) if the look up table should be played again or false (0) if all
+*  the cycles are done and the main loop should call CVAverage_Finish
+*
+*******************************************************************************/
+
+uint8 CVAverage_EndCycle(void) {
+    if (variance_enabled && cycles_done) {
+        uint64 scale = (uint64)cycles_done * cycles_done * average_points;
+        average_record.record.variance[cycles_done] = (squared_difference + scale/2) / scale;
+    }
+    squared_difference = 0;
+    cycles_done++;
+    if (cycles_done < cv_average_cycles) {
+        return true;
+    }
+    average_ready = true;
+    return false;
+}
+
+uint8 CVAverage_Ready(void) {
+    return average_ready;
+}
+
+/******************************************************************************
+* Function Name: CVAverage_Finish
+*******************************************************************************
+*
+* Summary:
+*  Put the average of the cycles in ADC_array[0] with the ADC_DATA_DONE_CODE
+*  after the last point and turn the averaging off
+*
+* Parameters:
+*  uint16 *record_size: where to put the number of bytes of the variance record
+*
+* Return:
+*  pointer to the variance record or 0 if the variance was not asked for
+*
+*******************************************************************************/
+
+uint8* CVAverage_Finish(uint16 *record_size) {
+    int32 half = cv_average_cycles / 2;
+    for (uint16 i = 0; i < average_points; i++) {
+        int32 sum = sums[i];
+        if (sum >= 0) {  // round to the nearest count
+            ADC_array[0].data[i] = (sum + half) / cv_average_cycles;
+        }
+        else {
+            ADC_array[0].data[i] = (sum - half) / cv_average_cycles;
+        }
+    }
+    ADC_array[0].data[average_points] = ADC_DATA_DONE_CODE;
+    average_ready = false;
+    uint8 cycles = cv_average_cycles;
+    cv_average_cycles = 0;
+    if (!variance_enabled) {
+        *record_size = 0;
+        return 0;
+    }
+    average_record.record.tag[0] = 'C';
+    average_record.record.tag[1] = 'A';
+    average_record.record.cycles = cycles;
+    average_record.record.points = average_points;
+    average_record.record.reserved = 0;
+    *record_size = sizeof(struct CVAverageRecord) - sizeof(uint32)*(AVERAGE_MAX_CYCLES - cycles);
+    return average_record.usb;
+}
+
+/******************************************************************************
+* Function Name: CVAverage_Stop
+*******************************************************************************
+*
+* Summary:
+*  Turn the averaging off without finishing, used by the 'X' command
+*
+*******************************************************************************/
+
+void CVAverage_Stop(void) {
+    cv_average_cycles = 0;
+    average_ready = false;
+}
+
+/* [] END OF FILE */
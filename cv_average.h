@@ -0,0 +1,62 @@
+/*******************************************************************************
+* File Name: cv_average.h
+*
+* Description:
+*  This file contains the function prototypes and constants used for
+*  averaging repeated cyclic voltammetry cycles on the device
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#if !defined(CV_AVERAGE_H)
+#define CV_AVERAGE_H
+
+#include "cytypes.h"
+#include "globals.h"
+
+/**************************************
+*      Constants
+**************************************/
+
+#define AVERAGE_SUM_CHANNEL 1  // the int32 sums take ADC_array[1] and ADC_array[2]
+#define AVERAGE_MAX_POINTS (MAX_LUT_SIZE - 1)  // leave room for the ADC_DATA_DONE_CODE
+#define AVERAGE_MAX_CYCLES 64
+
+
+/**************************************
+*      Structures
+**************************************/
+
+struct CVAverageRecord {
+    char tag[2];  // "CA"
+    uint16 cycles;  // number of cycles averaged
+    uint16 points;  // data points in each cycle
+    uint16 reserved;
+    uint32 variance[AVERAGE_MAX_CYCLES];  // mean squared difference of each cycle from the average of the cycles
+    // before it in adc counts squared, cycle 0 is always 0.  Only the first cycles entries are sent
+};
+
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+uint8 CVAverage_Start(uint8 cycles, uint8 variance_on, uint16 points, int16 first_sample);
+void CVAverage_AddSample(uint16 index, int16 current);
+uint8 CVAverage_EndCycle(void);
+uint8 CVAverage_Ready(void);
+uint8* CVAverage_Finish(uint16 *record_size);
+void CVAverage_Stop(void);
+
+
+/***************************************
+* Global variables external identifier
+***************************************/
+
+extern uint8 cv_average_cycles;  // cycles to average, 0 when the averaging is off
+
+#endif
+
+/* [] END OF FILE */
@@ -0,0 +1,316 @@
+/*******************************************************************************
+* File Name: cv_features.c
+*
+* Description:
+*  Find the peak potentials, peak currents and half wave potentials of a
+*  cyclic voltammetry run as the data comes in so only a small record has to
+*  be sent to the computer.  Each sample is smoothed with a moving average,
+*  a straight baseline is fit to the start of each sweep and the largest
+*  peak (dac increasing) and valley (dac decreasing) above the baseline
+*  are kept.  The half wave potentials are found at the end of the cycle from
+*  the raw data in ADC_array[0].  The dac value of a data point is looked up
+*  in waveform_lut as an uploaded look up table can step more than 1 dac count
+*  between data points
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include "cv_features.h"
+#include "lut_protocols.h"
+#include "stdlib.h"
+
+uint8 cv_features_mode = CV_FEATURES_OFF;
+
+struct PeakTracker {
+    int16 best;  // largest baseline corrected current found, 0 if none
+    uint16 index;  // index in ADC_array[0] of the peak
+    uint16 dac;
+    int16 baseline;
+    uint16 segment_start;  // index in ADC_array[0] the baseline is measured from
+    int32 baseline_start;
+    int32 baseline_slope_q8;  // change in the baseline per data point, 8 fractional bits
+};
+
+static union cv_features_usb_union features;
+static uint16 cycle_count = 0;
+static uint8 cycle_done = false;
+
+/* moving average */
+static int16 smooth_ring[CV_SMOOTH_POINTS];
+static int32 smooth_sum;
+static uint8 ring_index;
+
+/* sweep segment being measured */
+static int8 direction;  // 1 if the dac is increasing, -1 if decreasing, 0 at the start
+static uint16 last_dac;
+static uint16 segment_points;
+static uint16 segment_start;
+static int32 baseline_sum1;
+static int32 baseline_sum2;
+static int32 baseline_start;
+static int32 baseline_slope_q8;
+static uint8 baseline_ready;
+
+static struct PeakTracker rising_tracker;
+static struct PeakTracker falling_tracker;
+
+/***************************************
+* Forward function references
+***************************************/
+static void CVFeatures_NewSegment(int8 new_direction);
+static int32 CVFeatures_Baseline(int32 start, int32 slope_q8, uint16 point);
+static uint16 CVFeatures_DacValue(uint16 index);
+static void CVFeatures_MakePeak(struct PeakTracker *tracker, struct CVPeak *peak);
+
+
+/******************************************************************************
+* Function Name: CVFeatures_SetMode
+*******************************************************************************
+*
+* Summary:
+*  Turn the feature extraction on or off and restart the cycle count
+*
+* Parameters:
+*  uint8 mode: CV_FEATURES_OFF, CV_FEATURES_ONLY or CV_FEATURES_WITH_RAW
+*
+*******************************************************************************/
+
+void CVFeatures_SetMode(uint8 mode) {
+    if (mode > CV_FEATURES_WITH_RAW) {
+        mode = CV_FEATURES_OFF;
+    }
+    cv_features_mode = mode;
+    cycle_count = 0;
+    cycle_done = false;
+}
+
+/******************************************************************************
+* Function Name: CVFeatures_Reset
+*******************************************************************************
+*
+* Summary:
+*  Clear the measurements, call before each cyclic voltammetry run
+*
+*******************************************************************************/
+
+void CVFeatures_Reset(void) {
+    for (uint8 i = 0; i < CV_SMOOTH_POINTS; i++) {
+        smooth_ring[i] = 0;
+    }
+    smooth_sum = 0;
+    ring_index = 0;
+    direction = 0;
+    last_dac = 0;
+    CVFeatures_NewSegment(0);
+    rising_tracker.best = 0;
+    falling_tracker.best = 0;
+}
+
+/******************************************************************************
+* Function Name: CVFeatures_AddSample
+*******************************************************************************
+*
+* Summary:
+*  Add a data point to the measurements, called from the adc isr so it only
+*  does a fixed amount of work for each data point
+*
+* Parameters:
+*  uint16 index: where the data point is saved in ADC_array[0]
+*  uint16 dac_value: dac value the current was measured at
+*  int16 current: adc reading
+*
+*******************************************************************************/
+
+void CVFeatures_AddSample(uint16 index, uint16 dac_value, int16 current) {
+    smooth_sum += current - smooth_ring[ring_index];
+    smooth_ring[ring_index] = current;
+    ring_index = (ring_index + 1) & (CV_SMOOTH_POINTS - 1);
+    
+    int8 new_direction = direction;
+    if (dac_value > last_dac) {
+        new_direction = 1;
+    }
+    else if (dac_value < last_dac) {
+        new_direction = -1;
+    }
+    last_dac = dac_value;
+    if (new_direction != direction) {  // the sweep turned around
+        CVFeatures_NewSegment(new_direction);
+    }
+    segment_points++;
+    if ((direction == 0) || (segment_points < CV_SMOOTH_POINTS)) {  
+        return;  // wait till the moving average only has data from this sweep
+    }
+    
+    int16 smoothed = smooth_sum >> CV_SMOOTH_SHIFT;
+    uint16 point = segment_points - CV_SMOOTH_POINTS;
+    if (point == 0) {
+        segment_start = index - CV_SMOOTH_POINTS/2;  // the moving average is centered half a window back
+    }
+    if (!baseline_ready) {
+        if (point < CV_BASELINE_POINTS) {
+            baseline_sum1 += smoothed;
+        }
+        else {
+            baseline_sum2 += smoothed;
+            if (point == 2*CV_BASELINE_POINTS - 1) {
+                baseline_start = baseline_sum1 / CV_BASELINE_POINTS;
+                baseline_slope_q8 = ((baseline_sum2 - baseline_sum1) << 8) / (CV_BASELINE_POINTS * CV_BASELINE_POINTS);
+                baseline_ready = true;
+            }
+        }
+        return;
+    }
+    
+    int32 baseline = CVFeatures_Baseline(baseline_start, baseline_slope_q8, point);
+    int32 corrected = smoothed - baseline;
+    if (corrected > 32767) {
+        corrected = 32767;
+    }
+    else if (corrected < -32768) {
+        corrected = -32768;
+    }
+    struct PeakTracker *tracker = (direction > 0) ? &rising_tracker : &falling_tracker;
+    if (((direction > 0) && (corrected > tracker->best)) || ((direction < 0) && (corrected < tracker->best))) {
+        tracker->best = corrected;
+        tracker->index = index - CV_SMOOTH_POINTS/2;
+        tracker->dac = CVFeatures_DacValue(tracker->index);
+        tracker->baseline = baseline;
+        tracker->segment_start = segment_start;
+        tracker->baseline_start = baseline_start;
+        tracker->baseline_slope_q8 = baseline_slope_q8;
+    }
+}
+
+/******************************************************************************
+* Function Name: CVFeatures_EndCycle
+*******************************************************************************
+*
+* Summary:
+*  Mark that a cycle is done so the main loop can finish the record
+*
+*******************************************************************************/
+
+void CVFeatures_EndCycle(void) {
+    cycle_count++;
+    cycle_done = true;
+}
+
+uint8 CVFeatures_Ready(void) {
+    return cycle_done;
+}
+
+/******************************************************************************
+* Function Name: CVFeatures_Finish
+*******************************************************************************
+*
+* Summary:
+*  Find the half wave potentials and fill in the feature record of the last
+*  cycle.  Should be called from the main loop, not an isr, as it searches
+*  back through the raw data
+*
+* Return:
+*  uint8*: the feature record to export, sizeof(struct CVFeatureRecord) bytes long
+*
+*******************************************************************************/
+
+uint8* CVFeatures_Finish(void) {
+    cycle_done = false;
+    features.record.tag[0] = 'C';
+    features.record.tag[1] = 'F';
+    features.record.cycle = cycle_count;
+    CVFeatures_MakePeak(&rising_tracker, &features.record.rising);
+    CVFeatures_MakePeak(&falling_tracker, &features.record.falling);
+    return features.usb;
+}
+
+/******************************************************************************
+* Function Name: CVFeatures_NewSegment
+*******************************************************************************
+*
+* Summary:
+*  Start measuring a new sweep, the baseline has to be fit again
+*
+*******************************************************************************/
+
+static void CVFeatures_NewSegment(int8 new_direction) {
+    direction = new_direction;
+    segment_points = 0;
+    baseline_sum1 = 0;
+    baseline_sum2 = 0;
+    baseline_ready = false;
+}
+
+/******************************************************************************
+* Function Name: CVFeatures_Baseline
+*******************************************************************************
+*
+* Summary:
+*  Get the baseline at a point of a sweep.  baseline_start is the average of
+*  the first CV_BASELINE_POINTS so it is centered at (CV_BASELINE_POINTS-1)/2
+*
+*******************************************************************************/
+
+static int32 CVFeatures_Baseline(int32 start, int32 slope_q8, uint16 point) {
+    return start + ((2*(int32)point - (CV_BASELINE_POINTS-1)) * slope_q8) / 512;
+}
+
+/******************************************************************************
+* Function Name: CVFeatures_DacValue
+*******************************************************************************
+*
+* Summary:
+*  Get the dac value a data point was measured at.  The dac isr moves
+*  lut_index past the value it sets before the adc isr saves the current at
+*  lut_index, so ADC_array[0].data[index] was measured at waveform_lut[index-1]
+*
+*******************************************************************************/
+
+static uint16 CVFeatures_DacValue(uint16 index) {
+    return waveform_lut[(index > 0) ? index - 1 : 0];
+}
+
+/******************************************************************************
+* Function Name: CVFeatures_MakePeak
+*******************************************************************************
+*
+* Summary:
+*  Copy a peak into the record and search back from the peak through
+*  ADC_array[0] for where the corrected current drops to half the peak current
+*
+* Parameters:
+*  struct PeakTracker *tracker: peak that was found
+*  struct CVPeak *peak: where to put the result
+*
+*******************************************************************************/
+
+static void CVFeatures_MakePeak(struct PeakTracker *tracker, struct CVPeak *peak) {
+    peak->peak_dac = 0;
+    peak->peak_current = 0;
+    peak->baseline_current = 0;
+    peak->half_wave_dac = 0;
+    if (tracker->best == 0) {
+        return;
+    }
+    peak->peak_dac = tracker->dac;
+    peak->peak_current = tracker->best;
+    peak->baseline_current = tracker->baseline;
+    
+    for (uint16 index = tracker->index; (index > tracker->segment_start) && (index >= CV_SMOOTH_POINTS/2); index--) {
+        int32 sum = 0;
+        for (uint16 i = index - CV_SMOOTH_POINTS/2; i < index + CV_SMOOTH_POINTS/2; i++) {
+            sum += ADC_array[0].data[i];
+        }
+        int32 baseline = CVFeatures_Baseline(tracker->baseline_start, tracker->baseline_slope_q8, 
+                                             index - tracker->segment_start);
+        int32 corrected = (sum >> CV_SMOOTH_SHIFT) - baseline;
+        if (2*abs(corrected) <= abs(tracker->best)) {
+            peak->half_wave_dac = CVFeatures_DacValue(index);
+            return;
+        }
+    }
+}
+
+/* [] END OF FILE */
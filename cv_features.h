@@ -0,0 +1,76 @@
+/*******************************************************************************
+* File Name: cv_features.h
+*
+* Description:
+*  This file contains the function prototypes and constants used for
+*  finding the peaks of a cyclic voltammetry run on the device
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#if !defined(CV_FEATURES_H)
+#define CV_FEATURES_H
+
+#include "cytypes.h"
+#include "globals.h"
+
+/**************************************
+*      Constants
+**************************************/
+
+#define CV_FEATURES_OFF 0  // export the raw data only
+#define CV_FEATURES_ONLY 1  // only send the feature record at the end of the run
+#define CV_FEATURES_WITH_RAW 2  // send the feature record and the raw data can still be read with 'E'
+
+#define CV_SMOOTH_POINTS 8  // moving average length, has to be a power of 2
+#define CV_SMOOTH_SHIFT 3  // log2(CV_SMOOTH_POINTS)
+#define CV_BASELINE_POINTS 16  // smoothed points in each half of the baseline fit at the start of a sweep
+
+
+/**************************************
+*      Structures
+**************************************/
+
+struct CVPeak {
+    uint16 peak_dac;  // dac value at the peak, 0 if no peak was found
+    int16 peak_current;  // baseline corrected current at the peak in adc counts
+    int16 baseline_current;  // baseline under the peak in adc counts
+    uint16 half_wave_dac;  // dac value where the corrected current is half the peak current
+};
+
+struct CVFeatureRecord {
+    char tag[2];  // "CF" so the computer can tell the record from other messages
+    uint16 cycle;  // number of cycles since the features were turned on
+    struct CVPeak rising;  // largest peak while the dac is increasing
+    struct CVPeak falling;  // largest valley while the dac is decreasing
+};
+
+union cv_features_usb_union {
+    uint8 usb[sizeof(struct CVFeatureRecord)];
+    struct CVFeatureRecord record;
+};
+
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+void CVFeatures_SetMode(uint8 mode);
+void CVFeatures_Reset(void);
+void CVFeatures_AddSample(uint16 index, uint16 dac_value, int16 current);
+void CVFeatures_EndCycle(void);
+uint8 CVFeatures_Ready(void);
+uint8* CVFeatures_Finish(void);
+
+
+/***************************************
+* Global variables external identifier
+***************************************/
+
+extern uint8 cv_features_mode;
+
+#endif
+
+/* [] END OF FILE */
@@ -0,0 +1,95 @@
+/*******************************************************************************
+* File Name: cv_features_test.c
+*
+* Description:
+*  Checks the cyclic voltammetry features on a computer.  A look up table
+*  with a peak on each sweep over a sloped baseline is fed in the way the adc
+*  isr does, with 1 and with several dac counts between the data points as an
+*  uploaded look up table can have, the peak and half wave potentials found
+*  should be where the peaks were put
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cv_features.h"
+#include "lut_protocols.h"
+#include "sim_test.h"
+
+#define TEST_START 2000  // dac values of the sweep
+#define TEST_END 2600
+#define TEST_RISING_PEAK 2300  // dac value and adc counts of the peaks
+#define TEST_RISING_HEIGHT 2000
+#define TEST_FALLING_PEAK 2250
+#define TEST_FALLING_HEIGHT -1500
+#define TEST_WIDTH 30.0  // standard deviation of the peaks in dac counts
+#define TEST_HALF_WIDTH (TEST_WIDTH * 1.1774)  // from the peak to half its height
+
+static float64 peak(uint16 dac_value, uint16 center, int16 height) {
+    float64 x = ((float64)dac_value - center) / TEST_WIDTH;
+    return height * exp(-0.5 * x * x);
+}
+
+/* a triangle from TEST_START to TEST_END and back, step dac counts between the data points */
+static uint16 make_lut(uint16 step) {
+    uint16 length = 0;
+    for (uint16 value = TEST_START; value < TEST_END; value += step) {
+        waveform_lut[length++] = value;
+    }
+    for (uint16 value = TEST_END; value > TEST_START; value -= step) {
+        waveform_lut[length++] = value;
+    }
+    waveform_lut[length++] = TEST_START;
+    return length;
+}
+
+/* the data points as the adc isr saves them, ADC_array[0].data[i] is measured at waveform_lut[i-1] */
+static struct CVFeatureRecord run_cycle(uint16 lut_length) {
+    struct CVFeatureRecord record;
+    CVFeatures_SetMode(CV_FEATURES_WITH_RAW);
+    CVFeatures_Reset();
+    for (uint16 i = 1; i < lut_length; i++) {
+        uint16 dac_value = waveform_lut[i-1];
+        uint8 rising = (i < 2) || (waveform_lut[i-1] > waveform_lut[i-2]);
+        float64 current = 100 + 0.2 * (dac_value - TEST_START);  // the charging current slopes with the potential
+        if (rising) {
+            current += peak(dac_value, TEST_RISING_PEAK, TEST_RISING_HEIGHT);
+        }
+        else {
+            current += peak(dac_value, TEST_FALLING_PEAK, TEST_FALLING_HEIGHT) - 300;
+        }
+        ADC_array[0].data[i] = (int16)lround(current);
+        CVFeatures_AddSample(i, dac_value, ADC_array[0].data[i]);
+    }
+    CVFeatures_EndCycle();
+    SIM_CHECK(CVFeatures_Ready());
+    memcpy(&record, CVFeatures_Finish(), sizeof(record));
+    return record;
+}
+
+static void test_step(uint16 step) {
+    struct CVFeatureRecord record = run_cycle(make_lut(step));
+    SIM_CHECK((record.tag[0] == 'C') && (record.tag[1] == 'F'));
+    // the peaks are found to the nearest data point
+    SIM_CHECK(abs(record.rising.peak_dac - TEST_RISING_PEAK) <= step + 1);
+    SIM_CHECK(abs(record.falling.peak_dac - TEST_FALLING_PEAK) <= step + 1);
+    SIM_CHECK(record.rising.peak_current > TEST_RISING_HEIGHT * 9 / 10);
+    SIM_CHECK(record.falling.peak_current < TEST_FALLING_HEIGHT * 9 / 10);
+    // the half wave is before the peak in the direction of the sweep, the moving average widens it a little
+    SIM_CHECK(fabs(record.rising.half_wave_dac - (TEST_RISING_PEAK - TEST_HALF_WIDTH)) <= step + 3);
+    SIM_CHECK(fabs(record.falling.half_wave_dac - (TEST_FALLING_PEAK + TEST_HALF_WIDTH)) <= step + 3);
+}
+
+int main(void) {
+    test_step(1);
+    test_step(3);
+    test_step(5);
+    return sim_test_failures;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,23 @@
+/* ========================================
+ *
+ * Copyright YOUR COMPANY, THE YEAR
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF your company.
+ *
+ * ========================================
+*/
+#ifndef CYAPICALLBACKS_H
+#define CYAPICALLBACKS_H
+    
+    /*Define your macro callbacks here */
+    /*For more information, refer to the Writing Code topic in the PSoC Creator Help.*/
+
+    /* read USB OUT packets into the command queue as soon as they arrive, see command_queue.c */
+    #define USBFS_EP_2_ISR_EXIT_CALLBACK
+    void USBFS_EP_2_ISR_ExitCallback(void);
+    
+#endif /* CYAPICALLBACKS_H */   
+/* [] */
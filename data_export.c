@@ -0,0 +1,495 @@
+/*******************************************************************************
+* File Name: data_export.c
+*
+* Description:
+*  Export parts of the ADC_array data.  A range of a channel can be sent, or 
+*  all the data saved since a sequence number so the computer can follow a
+*  long run without waiting for the end or getting the same data again.  
+*  The sizes are checked once when the command comes in.
+*  While the data is pushed the messages from the isrs are held back for the
+*  main loop, an isr sending while the main loop is part way through a push
+*  would put its message inside the pushed data
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include "data_export.h"
+#include "adc_profile.h"
+#include "calibrate.h"
+#include "DAC.h"
+#include "helper_functions.h"
+#include "string.h"
+#include "usb_protocols.h"
+
+volatile uint32 export_sequence = 0;
+
+static uint8 export_layout = EXPORT_LINEAR;
+static uint16 export_block_size = 1;
+static uint8 export_point_words = 1;  // int16 values saved for each data point, 2 for dac value / current pairs
+static uint32 export_sample_period_ns = 0;
+static uint32 export_block_number;
+static struct BlockInfo block_info[ADC_CHANNELS];
+static union export_header_usb_union export_header;
+static uint16 push_points = 0;  // data points to collect before they are pushed to the computer, 0 is off
+static uint32 push_sequence = 0;  // sequence number of the next data point to push
+
+/* isr messages waiting for the main loop, the isrs move notice_in on and the main loop notice_out.
+   Both count to 2*EXPORT_NOTICES so a full queue is not mistaken for an empty one */
+static struct {
+    uint8 size;
+    uint8 message[EXPORT_NOTICE_SIZE];
+} notices[EXPORT_NOTICES];
+static volatile uint8 notice_in = 0;
+static volatile uint8 notice_out = 0;
+static volatile uint8 notices_dropped = false;
+
+/***************************************
+* Forward function references
+***************************************/
+static uint32 export_since(uint32 sequence);
+static void export_send_notices(uint8 last);
+
+
+/******************************************************************************
+* Function Name: Export_Reset
+*******************************************************************************
+*
+* Summary:
+*  Set how the data of the next run is laid out in ADC_array, call at the start of a run.
+*  Each data point is 1 value until Export_SetPairs is called
+*
+* Parameters:
+*  uint8 layout: EXPORT_LINEAR or EXPORT_RING
+*  uint16 block_size: data points in each channel for EXPORT_RING
+*
+*******************************************************************************/
+
+void Export_Reset(uint8 layout, uint16 block_size) {
+    export_layout = layout;
+    export_block_size = (block_size == 0) ? 1 : block_size;
+    export_point_words = 1;
+    export_sequence = 0;
+    export_block_number = 0;
+    memset(block_info, 0, sizeof(block_info));
+    push_sequence = 0;
+}
+
+/******************************************************************************
+* Function Name: Export_SetPairs
+*******************************************************************************
+*
+* Summary:
+*  Each data point of the run is a dac value / current pair, so 2 values are
+*  sent for every sequence number.  Only adaptive cyclic voltammetry uses this,
+*  its steps are not even so the dac value is the x axis of each point.  The
+*  board has no adc on the electrode, so it is the value set and not a reading.
+*  Call after Export_Reset
+*
+*******************************************************************************/
+
+void Export_SetPairs(void) {
+    export_point_words = 2;
+}
+
+/******************************************************************************
+* Function Name: Export_Pairs
+*******************************************************************************
+*
+* Summary:
+*  If the data points of the last run are dac value / current pairs
+*
+* Return:
+*  uint8: true if Export_SetPairs was called after the last Export_Reset
+*
+*******************************************************************************/
+
+uint8 Export_Pairs(void) {
+    return (export_point_words == 2);
+}
+
+/******************************************************************************
+* Function Name: Export_Range
+*******************************************************************************
+*
+* Summary:
+*  Send part of an ADC_array channel
+*
+* Parameters:
+*  uint8 channel: ADC_array channel
+*  uint16 offset: first data point to send
+*  uint16 length: number of data points to send
+*
+* Return:
+*  true if the range is inside the channel and was sent
+*
+*******************************************************************************/
+
+uint8 Export_Range(uint8 channel, uint16 offset, uint16 length) {
+    if ((channel >= ADC_CHANNELS) || (length == 0) || ((uint32)offset + length > MAX_LUT_SIZE)) {
+        return false;
+    }
+    USB_Export_Data(&ADC_array[channel].usb[2*offset], 2*length);
+    return true;
+}
+
+/******************************************************************************
+* Function Name: Export_Since
+*******************************************************************************
+*
+* Summary:
+*  Send an ExportHeader and then the data points saved since a sequence
+*  number.  If the data has already been written over, the oldest data still
+*  saved is sent, the header tells the computer where the data starts.  For
+*  EXPORT_RING the channel being written to is not sent from.  The header tag
+*  is "EP" instead of "ES" if each data point is a dac value / current pair
+*
+* Parameters:
+*  uint32 sequence: sequence number of the first data point wanted, i.e. 
+*                   first_sequence + count of the last export
+*
+*******************************************************************************/
+
+void Export_Since(uint32 sequence) {
+    export_since(sequence);
+}
+
+/******************************************************************************
+* Function Name: Export_SetPush
+*******************************************************************************
+*
+* Summary:
+*  Turn on pushing the data to the computer.  The main loop sends the same
+*  ExportHeader and data points as the 'ES' command every time this many
+*  new data points are saved, and the rest when the run ends, so the computer
+*  only has to read and does not have to ask for each block.  A computer that
+*  falls behind sees the gap in the first_sequence of the next header
+*
+* Parameters:
+*  uint16 points: data points to collect before they are sent, 0 turns pushing off
+*
+*******************************************************************************/
+
+void Export_SetPush(uint16 points) {
+    if (points > EXPORT_MAX_POINTS) {
+        points = EXPORT_MAX_POINTS;
+    }
+    push_sequence = export_sequence;  // don't send the data saved before pushing was turned on
+    push_points = points;
+    if (!push_points) {  // the isrs send their own messages again
+        export_send_notices(notice_in);
+    }
+}
+
+/******************************************************************************
+* Function Name: Export_PushReady
+*******************************************************************************
+*
+* Summary:
+*  Check if enough new data points are saved to push them, used by the main
+*  loop so it does not sleep with data waiting
+*
+* Return:
+*  true if Export_Push will send data or an isr message is waiting
+*
+*******************************************************************************/
+
+uint8 Export_PushReady(void) {
+    return (notice_in != notice_out) || (push_points && (export_sequence >= push_sequence + push_points));
+}
+
+/******************************************************************************
+* Function Name: Export_Push
+*******************************************************************************
+*
+* Summary:
+*  Send the new data points if pushing is on and enough are saved, then the
+*  isr messages that are waiting, call from the main loop.  The data saved
+*  before a message is always sent before it
+*
+* Parameters:
+*  uint8 flush: true when no run is going, sends the data points left over
+*               at the end of the run even if there are fewer than the push size
+*
+*******************************************************************************/
+
+void Export_Push(uint8 flush) {
+    if (!push_points) {
+        return;
+    }
+    uint8 last_notice = notice_in;  // read before the data so every message waiting was made before newest
+    uint32 newest = export_sequence;  // read once, the isr can change it
+    if (newest < push_sequence) {  // a new cycle or run started over the sequence numbers
+        push_sequence = newest;
+    }
+    if (last_notice != notice_out) {  // the data before a message goes first
+        flush = true;
+    }
+    if ((newest >= push_sequence + push_points) || (flush && (newest > push_sequence))) {
+        while (push_sequence < newest) {  // more than EXPORT_MAX_POINTS takes more than 1 header
+            uint32 sent = export_since(push_sequence);
+            if (sent == push_sequence) {
+                break;
+            }
+            push_sequence = sent;
+        }
+    }
+    export_send_notices(last_notice);
+}
+
+/******************************************************************************
+* Function Name: Export_Notify
+*******************************************************************************
+*
+* Summary:
+*  Send a message from an isr, i.e. a block is done or the run ended.  When
+*  pushing is off it is sent right away, when it is on it waits for the main
+*  loop so it goes between the pushed data.  A message that does not fit in
+*  the queue is lost and "Error Notice" is sent after the ones that fit
+*
+* Parameters:
+*  uint8 message[]: bytes to send
+*  uint16 size: number of bytes, at most EXPORT_NOTICE_SIZE while pushing
+*
+*******************************************************************************/
+
+void Export_Notify(uint8 message[], uint16 size) {
+    if (!push_points) {
+        USB_Export_Data(message, size);
+        return;
+    }
+    uint8 waiting = (notice_in + 2*EXPORT_NOTICES - notice_out) % (2*EXPORT_NOTICES);
+    if ((waiting >= EXPORT_NOTICES) || (size > EXPORT_NOTICE_SIZE)) {
+        notices_dropped = true;
+        return;
+    }
+    uint8 slot = notice_in % EXPORT_NOTICES;
+    memcpy(notices[slot].message, message, size);
+    notices[slot].size = size;
+    notice_in = (notice_in + 1) % (2*EXPORT_NOTICES);
+}
+
+/******************************************************************************
+* Function Name: export_send_notices
+*******************************************************************************
+*
+* Summary:
+*  Send the isr messages that are waiting, from the main loop
+*
+* Parameters:
+*  uint8 last: notice_in read by the caller, messages after it are left for the next call
+*
+*******************************************************************************/
+
+static void export_send_notices(uint8 last) {
+    while (notice_out != last) {
+        uint8 slot = notice_out % EXPORT_NOTICES;
+        USB_Export_Data(notices[slot].message, notices[slot].size);
+        notice_out = (notice_out + 1) % (2*EXPORT_NOTICES);
+    }
+    if (notices_dropped) {
+        notices_dropped = false;
+        USB_Export_Data((uint8*)"Error Notice", 13);
+    }
+}
+
+/******************************************************************************
+* Function Name: export_since
+*******************************************************************************
+*
+* Summary:
+*  Send an ExportHeader and the data points, see Export_Since
+*
+* Parameters:
+*  uint32 sequence: sequence number of the first data point wanted
+*
+* Return:
+*  sequence number of the data point after the last one sent
+*
+*******************************************************************************/
+
+static uint32 export_since(uint32 sequence) {
+    uint32 newest = export_sequence;  // read once, the isr can change it
+    uint32 oldest = 0;
+    
+    if (export_layout == EXPORT_RING) {
+        uint32 span = (uint32)(adc_ring_channels - 1) * export_block_size;
+        if (newest > span) {
+            oldest = newest - span;
+        }
+    }
+    if (sequence < oldest) {
+        sequence = oldest;
+    }
+    if (sequence > newest) {
+        sequence = newest;
+    }
+    uint32 count = newest - sequence;
+    if (count > EXPORT_MAX_POINTS / export_point_words) {
+        count = EXPORT_MAX_POINTS / export_point_words;
+    }
+    export_header.header.tag[0] = 'E';
+    export_header.header.tag[1] = (export_point_words == 2) ? 'P' : 'S';
+    export_header.header.count = count;
+    export_header.header.first_sequence = sequence;
+    USB_Export_Data(export_header.usb, sizeof(struct ExportHeader));
+    
+    while (count > 0) {
+        uint8 channel = 0;
+        uint16 index = sequence;
+        uint32 points = count;
+        if (export_layout == EXPORT_RING) {
+            channel = (sequence / export_block_size) % adc_ring_channels;
+            index = sequence % export_block_size;
+            if (points > (uint32)(export_block_size - index)) {  // only send to the end of the block
+                points = export_block_size - index;
+            }
+        }
+        USB_Export_Data(&ADC_array[channel].usb[2*export_point_words*index], 2*export_point_words*points);
+        sequence += points;
+        count -= points;
+    }
+    return sequence;
+}
+
+/******************************************************************************
+* Function Name: Export_Format
+*******************************************************************************
+*
+* Summary:
+*  Send an ExportFormat that tells the computer how the exported data is laid
+*  out and how to change adc counts into current, so it can use the data as
+*  it comes in without parsing text or fitting the calibration itself
+*
+* Parameters:
+*  uint8 pairs: true if the last run saved dac value / current pairs
+*  uint8 tia_resistor: TIA resistor index being used
+*  uint8 adc_buffer: adc buffer gain index being used
+*
+*******************************************************************************/
+
+void Export_Format(uint8 pairs, uint8 tia_resistor, uint8 adc_buffer) {
+    union {
+        uint8 usb[sizeof(struct ExportFormat)];
+        struct ExportFormat format;
+    } export_format;
+    struct CalibrationFit fit;
+
+    calibrate_GetFit(&fit);
+    export_format.format.tag[0] = 'X';
+    export_format.format.tag[1] = 'F';
+    export_format.format.done_code = ADC_DATA_DONE_CODE;
+    export_format.format.pairs = pairs;
+    export_format.format.tia_resistor = tia_resistor;
+    export_format.format.adc_buffer = adc_buffer;
+    export_format.format.calibrated = fit.valid && (fit.tia_resistor == tia_resistor) && (fit.adc_buffer == adc_buffer) &&
+                                      (fit.adc_profile == AdcProfile_Current());
+    for (uint8 i = 0; i < 2*Number_calibration_points; i++) {
+        export_format.format.calibration[i] = calibrate_array.data[i];
+    }
+    export_format.format.femtoamps_per_count = fit.femtoamps_per_count;
+    export_format.format.zero_count = fit.zero_count;
+    export_format.format.adc_profile = AdcProfile_Current();
+    export_format.format.sample_bits = AdcProfile_SampleBits();
+    USB_Export_Data(export_format.usb, sizeof(struct ExportFormat));
+}
+
+/******************************************************************************
+* Function Name: Export_SetSamplePeriod
+*******************************************************************************
+*
+* Summary:
+*  Save the time between the data points of the run for the BlockInfo and
+*  DeviceHeader records, call when the run starts
+*
+*******************************************************************************/
+
+void Export_SetSamplePeriod(uint32 period_ns) {
+    export_sample_period_ns = period_ns;
+}
+
+/******************************************************************************
+* Function Name: Export_BlockDone
+*******************************************************************************
+*
+* Summary:
+*  Save what the computer needs to place a block in time, called by the isr
+*  when an EXPORT_RING block is full and export_sequence includes its data points
+*
+* Parameters:
+*  uint8 channel: ADC_array channel of the block
+*  uint16 count: data points in the block
+*  uint8 tia_resistor: TIA resistor index the block was taken with
+*  uint8 adc_buffer: adc buffer gain index the block was taken with
+*
+*******************************************************************************/
+
+void Export_BlockDone(uint8 channel, uint16 count, uint8 tia_resistor, uint8 adc_buffer) {
+    struct BlockInfo *info = &block_info[channel];
+    export_block_number++;
+    info->block_number = export_block_number;
+    info->first_sequence = export_sequence - count;
+    info->sample_period_ns = export_sample_period_ns;
+    info->count = count;
+    info->tia_resistor = tia_resistor;
+    info->adc_buffer = adc_buffer;
+}
+
+/******************************************************************************
+* Function Name: Export_BlockInfo
+*******************************************************************************
+*
+* Summary:
+*  Send the BlockInfo of each ADC_array channel, channel 0 first.  The copy is
+*  made with the interrupts off so a block that finishes during the export
+*  does not send half old and half new values
+*
+*******************************************************************************/
+
+void Export_BlockInfo(void) {
+    union {
+        uint8 usb[sizeof(block_info)];
+        struct BlockInfo info[ADC_CHANNELS];
+    } block_copy;
+
+    uint8 interrupt_state = CyEnterCriticalSection();
+    memcpy(block_copy.info, block_info, sizeof(block_info));
+    CyExitCriticalSection(interrupt_state);
+    USB_Export_Data(block_copy.usb, sizeof(block_info));
+}
+
+/******************************************************************************
+* Function Name: Export_DeviceHeader
+*******************************************************************************
+*
+* Summary:
+*  Send a DeviceHeader and an ExportFormat, everything the computer needs to
+*  start a self describing recording of this board
+*
+* Parameters:
+*  uint8 tia_resistor: TIA resistor index being used
+*  uint8 adc_buffer: adc buffer gain index being used
+*
+*******************************************************************************/
+
+void Export_DeviceHeader(uint8 tia_resistor, uint8 adc_buffer) {
+    union {
+        uint8 usb[sizeof(struct DeviceHeader)];
+        struct DeviceHeader header;
+    } device_header;
+
+    device_header.header.tag[0] = 'D';
+    device_header.header.tag[1] = 'H';
+    device_header.header.firmware_version = FIRMWARE_VERSION;
+    CyGetUniqueId(device_header.header.unique_id);
+    device_header.header.dac_source = selected_voltage_source;
+    device_header.header.tia_resistor = tia_resistor;
+    device_header.header.adc_buffer = adc_buffer;
+    device_header.header.reserved = 0;
+    device_header.header.sample_period_ns = export_sample_period_ns;
+    USB_Export_Data(device_header.usb, sizeof(struct DeviceHeader));
+    Export_Format(Export_Pairs(), tia_resistor, adc_buffer);
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,109 @@
+/*******************************************************************************
+* File Name: data_export.h
+*
+* Description:
+*  This file contains the function prototypes and constants used for
+*  exporting parts of the ADC_array data while an experiment is running
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#if !defined(DATA_EXPORT_H)
+#define DATA_EXPORT_H
+
+#include "cytypes.h"
+#include "globals.h"
+
+/**************************************
+*      Constants
+**************************************/
+
+#define EXPORT_LINEAR 0  // data is saved from the start of ADC_array[0], i.e. cyclic voltammetry
+#define EXPORT_RING 1  // data is saved in blocks that go around the ADC_array channels, i.e. amperometry
+
+#define EXPORT_MAX_POINTS MAX_LUT_SIZE  // most data points sent by 1 command
+#define EXPORT_NOTICES 8  // isr messages that can wait for the main loop while pushing
+#define EXPORT_NOTICE_SIZE 32  // longest isr message, a BlockStatsRecord is the largest
+
+
+/**************************************
+*      Structures
+**************************************/
+
+struct ExportHeader {
+    char tag[2];  // "ES", or "EP" if each data point is a dac value / current pair (adaptive cyclic voltammetry)
+    uint16 count;  // number of data points after the header
+    uint32 first_sequence;  // sequence number of the first data point
+};
+
+struct ExportFormat {  // sent by the 'UK' command so the computer can read the exports as binary
+    char tag[2];  // "XF"
+    uint16 done_code;  // ADC_DATA_DONE_CODE, put after the last data point of a block or run
+    uint8 pairs;  // true if the last run saved dac value / current pairs (adaptive cyclic voltammetry), false for only currents
+    uint8 tia_resistor;  // gain settings being used
+    uint8 adc_buffer;
+    uint8 calibrated;  // true if the calibration below was made with the gain settings and adc profile being used
+    int16 calibration[10];  // calibrate_array as sent after a calibration, 5 IDAC values then 5 adc readings
+    int32 femtoamps_per_count;  // current = femtoamps_per_count * (reading - zero_count), see calibrate_GetFit
+    int16 zero_count;
+    uint8 adc_profile;  // ADC_PROFILE_XXX being used
+    uint8 sample_bits;  // bits in each current value, see AdcProfile_SampleBits
+};
+
+struct DeviceHeader {  // sent by the 'UH' command, followed by an ExportFormat with the calibration
+    char tag[2];  // "DH"
+    uint16 firmware_version;  // FIRMWARE_VERSION
+    uint32 unique_id[2];  // CyGetUniqueId, tells the boards apart
+    uint8 dac_source;  // VDAC_IS_VDAC or VDAC_IS_DVDAC
+    uint8 tia_resistor;  // gain settings being used
+    uint8 adc_buffer;
+    uint8 reserved;
+    uint32 sample_period_ns;  // time between the data points of the last run
+};
+
+struct BlockInfo {  // 1 for each ADC_array channel, sent by the 'UM' command
+    uint32 block_number;  // blocks finished since the run started, 0 if the channel has no block yet
+    uint32 first_sequence;  // sequence number of the first data point, it was taken first_sequence * sample_period_ns after the run started
+    uint32 sample_period_ns;
+    uint16 count;  // data points in the block
+    uint8 tia_resistor;  // gain settings the block was taken with
+    uint8 adc_buffer;
+};
+
+union export_header_usb_union {
+    uint8 usb[sizeof(struct ExportHeader)];
+    struct ExportHeader header;
+};
+
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+void Export_Reset(uint8 layout, uint16 block_size);
+void Export_SetPairs(void);
+uint8 Export_Pairs(void);
+uint8 Export_Range(uint8 channel, uint16 offset, uint16 length);
+void Export_Since(uint32 sequence);
+void Export_SetPush(uint16 points);
+uint8 Export_PushReady(void);
+void Export_Push(uint8 flush);
+void Export_Notify(uint8 message[], uint16 size);
+void Export_Format(uint8 pairs, uint8 tia_resistor, uint8 adc_buffer);
+void Export_SetSamplePeriod(uint32 period_ns);
+void Export_BlockDone(uint8 channel, uint16 count, uint8 tia_resistor, uint8 adc_buffer);
+void Export_BlockInfo(void);
+void Export_DeviceHeader(uint8 tia_resistor, uint8 adc_buffer);
+
+
+/***************************************
+* Global variables external identifier
+***************************************/
+
+extern volatile uint32 export_sequence;  // number of data points saved since the run started, set by the isrs
+
+#endif
+
+/* [] END OF FILE */
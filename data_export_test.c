@@ -0,0 +1,149 @@
+/*******************************************************************************
+* File Name: data_export_test.c
+*
+* Description:
+*  Checks the pushed exports on a computer.  Data points are saved around the
+*  ring like the amperometry isr does, with the isr messages in between, and
+*  what USB_Export_Data sends is read back from the usb_sim.c log: the data
+*  has to come before the messages made after it and none can be lost without
+*  an "Error Notice"
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "data_export.h"
+#include "globals.h"
+#include "sim_test.h"
+#include "usb_sim.h"
+
+#define TEST_BLOCK 100
+#define TEST_PUSH 30
+
+static uint16 test_index = 0;
+static uint8 test_channel = 0;
+static char test_message[8];
+
+// what adcAmpInterrupt does with a reading, the value is the sequence number so it can be checked
+static void test_isr(void) {
+    ADC_array[test_channel].data[test_index] = (int16)export_sequence;
+    export_sequence++;
+    test_index++;
+    if (test_index >= TEST_BLOCK) {
+        test_index = 0;
+        Export_BlockDone(test_channel, TEST_BLOCK, 0, 0);
+        sprintf(test_message, "Done%d", test_channel);
+        Export_Notify((uint8*)test_message, 6);
+        test_channel = (test_channel + 1) % adc_ring_channels;
+    }
+}
+
+static void test_start(void) {
+    test_index = 0;
+    test_channel = 0;
+    Export_Reset(EXPORT_RING, TEST_BLOCK);
+    Export_SetPush(TEST_PUSH);
+    SimUSB_ClearLog();
+}
+
+/* read the log back: the data points have to be in order with none missing,
+   and each "Done" has to come after the last point of its block */
+static uint32 test_read_log(uint32 *notices, uint8 *error_notice) {
+    uint32 offset = 0;
+    uint32 next = 0;
+    uint8 in_order = true;
+    *notices = 0;
+    *error_notice = false;
+    while (offset < sim_usb_log_size) {
+        uint8 *record = &sim_usb_log[offset];
+        if ((record[0] == 'E') && (record[1] == 'S')) {
+            struct ExportHeader header;
+            memcpy(&header, record, sizeof(header));
+            in_order = in_order && (header.first_sequence == next);
+            int16 *points = (int16*)(record + sizeof(header));
+            for (uint16 i = 0; i < header.count; i++) {
+                in_order = in_order && (points[i] == (int16)(next + i));
+            }
+            next = header.first_sequence + header.count;
+            offset += sizeof(header) + 2*header.count;
+        }
+        else if (memcmp(record, "Done", 4) == 0) {
+            in_order = in_order && (next >= (*notices + 1) * TEST_BLOCK) &&
+                       (record[4] - '0' == *notices % adc_ring_channels);
+            (*notices)++;
+            offset += 6;
+        }
+        else if (strcmp((char*)record, "Error Notice") == 0) {
+            *error_notice = true;
+            offset += 13;
+        }
+        else {
+            SIM_CHECK(!"unknown record");  // the line is printed, the rest of the log can't be read
+            return 0;
+        }
+    }
+    SIM_CHECK(in_order);
+    return next;
+}
+
+static void test_ordering(void) {
+    uint32 notices;
+    uint8 error_notice;
+    test_start();
+    for (uint16 i = 0; i < 1000; i++) {
+        test_isr();
+        if (i % 7 == 0) {  // the main loop comes around every so often
+            Export_Push(false);
+        }
+    }
+    Export_Push(true);
+    SIM_CHECK(test_read_log(&notices, &error_notice) == 1000);
+    SIM_CHECK(notices == 1000 / TEST_BLOCK);
+    SIM_CHECK(!error_notice);
+    SIM_CHECK(!Export_PushReady());
+}
+
+static void test_dropped_notices(void) {
+    test_start();
+    for (uint8 i = 0; i < EXPORT_NOTICES + 3; i++) {  // more messages than the queue holds before the main loop comes
+        Export_Notify((uint8*)"Done0", 6);
+    }
+    SIM_CHECK(sim_usb_exports == 0);
+    SIM_CHECK(Export_PushReady());
+    Export_Push(false);
+    SIM_CHECK(sim_usb_exports == EXPORT_NOTICES + 1);
+    SIM_CHECK(sim_usb_log_size == 6*EXPORT_NOTICES + 13);
+    SIM_CHECK(strcmp((char*)&sim_usb_log[6*EXPORT_NOTICES], "Error Notice") == 0);
+    SimUSB_ClearLog();
+    Export_Push(false);  // the error is only sent once
+    SIM_CHECK(sim_usb_exports == 0);
+}
+
+static void test_push_off(void) {
+    test_start();
+    for (uint16 i = 0; i < 2 * TEST_BLOCK; i++) {
+        test_isr();
+    }
+    Export_SetPush(0);  // the waiting messages go out, the isrs send their own after that
+    SIM_CHECK(sim_usb_exports == 2);
+    SimUSB_ClearLog();
+    for (uint16 i = 0; i < TEST_BLOCK; i++) {
+        test_isr();
+    }
+    SIM_CHECK(sim_usb_exports == 1);
+    Export_Push(true);  // nothing is pushed with pushing off
+    SIM_CHECK(sim_usb_exports == 1);
+}
+
+int main(void) {
+    test_ordering();
+    test_dropped_notices();
+    test_push_off();
+    return sim_test_failures;
+}
+
+/* [] END OF FILE */
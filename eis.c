@@ -0,0 +1,373 @@
+/*******************************************************************************
+* File Name: eis.c
+*
+* Description:
+*  Electrochemical impedance spectroscopy.  A small sine wave is put on top
+*  of a DC bias, 1 dac value each PWM_isr tick, and the TIA current is
+*  sampled in the same tick.  Each sample is multiplied by the sine and 
+*  cosine of the applied wave (I/Q lock-in) so only the magnitude and phase
+*  of each frequency is sent to the computer.
+*  The hardware is used through sequencer_hal.h and the demodulator
+*  functions do not use the hardware so they can be checked on a computer
+*  with made up signals
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include "eis.h"
+#include "DAC.h"
+#include "math.h"
+
+#define EIS_PHASE_MASK (EIS_POINTS_PER_PERIOD - 1)
+#define EIS_COSINE_OFFSET (EIS_POINTS_PER_PERIOD / 4)
+
+// one period of a sine wave with 14 fractional bits
+static const int16 eis_sine_q14[EIS_POINTS_PER_PERIOD] = {
+    0, 3196, 6270, 9102, 11585, 13623, 15137, 16069,
+    16384, 16069, 15137, 13623, 11585, 9102, 6270, 3196,
+    0, -3196, -6270, -9102, -11585, -13623, -15137, -16069,
+    -16384, -16069, -15137, -13623, -11585, -9102, -6270, -3196,
+};
+
+struct EISResult {
+    int64 in_phase;
+    int64 quadrature;
+    uint32 points;
+};
+
+static uint32 frequencies[EIS_MAX_FREQUENCIES];  // in 0.01 Hz
+static uint8 num_frequencies = 0;
+static struct EISResult results[EIS_MAX_FREQUENCIES];
+static uint8 results_done;  // written by the isr
+static uint8 results_sent;
+static union eis_usb_union eis_record;
+
+/* excitation */
+static int16 excitation[EIS_POINTS_PER_PERIOD];  // sine table scaled to the amplitude
+static uint16 bias_value;
+static uint16 amplitude_value;
+static uint16 measure_cycles;
+
+/* state of the frequency being measured */
+static uint8 running = false;
+static uint8 frequency_index;
+static uint8 phase_index;
+static uint16 cycle;
+
+/* lock-in accumulators */
+static int64 demod_in_phase;
+static int64 demod_quadrature;
+static uint32 demod_points;
+
+/***************************************
+* Forward function references
+***************************************/
+static void EIS_LoadFrequency(void);
+static void EIS_Convert(struct EISResult *result, uint32 *magnitude_q8, int16 *phase_centideg);
+
+
+/******************************************************************************
+* Function Name: EIS_Clear
+*******************************************************************************
+*
+* Summary:
+*  Remove all the frequencies from the list
+*
+*******************************************************************************/
+
+void EIS_Clear(void) {
+    if (!running) {
+        num_frequencies = 0;
+    }
+}
+
+/******************************************************************************
+* Function Name: EIS_AddFrequency
+*******************************************************************************
+*
+* Summary:
+*  Add a frequency to the end of the list to measure
+*
+* Parameters:
+*  uint32 frequency_centihz: frequency in 0.01 Hz
+*
+* Return:
+*  true if the frequency was added
+*
+*******************************************************************************/
+
+uint8 EIS_AddFrequency(uint32 frequency_centihz) {
+    if (running || (num_frequencies >= EIS_MAX_FREQUENCIES) || (frequency_centihz == 0)) {
+        return false;
+    }
+    frequencies[num_frequencies] = frequency_centihz;
+    num_frequencies++;
+    return true;
+}
+
+/******************************************************************************
+* Function Name: EIS_PeriodForFrequency
+*******************************************************************************
+*
+* Summary:
+*  Get the PWM_isr period closest to making the sine wave frequency
+*
+* Parameters:
+*  uint32 frequency_centihz: frequency in 0.01 Hz
+*
+* Return:
+*  uint16: value for PWM_isr_WritePeriod
+*
+*******************************************************************************/
+
+uint16 EIS_PeriodForFrequency(uint32 frequency_centihz) {
+    uint32 ticks_per_second_x100 = (uint32)PWM_CLOCK_HZ * 100 / EIS_POINTS_PER_PERIOD;
+    uint32 counts = (ticks_per_second_x100 + frequency_centihz/2) / frequency_centihz;
+    if (counts < 2) {
+        counts = 2;
+    }
+    if (counts > 65536) {
+        counts = 65536;
+    }
+    return counts - 1;
+}
+
+/******************************************************************************
+* Function Name: EIS_ShortestPeriod
+*******************************************************************************
+*
+* Summary:
+*  Get the PWM_isr period of the highest frequency in the list, the fastest
+*  tick the adc has to keep up with
+*
+* Return:
+*  uint16: smallest PWM_isr period, 0xFFFF if there are no frequencies
+*
+*******************************************************************************/
+
+uint16 EIS_ShortestPeriod(void) {
+    uint16 shortest = 0xFFFF;
+    for (uint8 i = 0; i < num_frequencies; i++) {
+        uint16 period = EIS_PeriodForFrequency(frequencies[i]);
+        if (period < shortest) {
+            shortest = period;
+        }
+    }
+    return shortest;
+}
+
+/******************************************************************************
+* Function Name: EIS_Start
+*******************************************************************************
+*
+* Summary:
+*  Make the excitation table and load the first frequency.  The caller has to
+*  enable the interrupt that calls EIS_Tick after this
+*
+* Parameters:
+*  uint16 bias: dac value of the DC potential
+*  uint16 amplitude: amplitude of the sine wave in dac counts
+*  uint16 cycles: number of sine wave periods to measure at each frequency
+*
+* Return:
+*  true if the settings are valid
+*
+*******************************************************************************/
+
+uint8 EIS_Start(uint16 bias, uint16 amplitude, uint16 cycles) {
+    if ((num_frequencies == 0) || (cycles == 0) || (amplitude == 0) || 
+        (amplitude > bias) || (bias + amplitude > DAC_MaxValue())) {
+        return false;
+    }
+    for (uint8 i = 0; i < EIS_POINTS_PER_PERIOD; i++) {
+        excitation[i] = ((int32)amplitude * eis_sine_q14[i]) >> EIS_SINE_SHIFT;
+    }
+    bias_value = bias;
+    amplitude_value = amplitude;
+    measure_cycles = cycles;
+    frequency_index = 0;
+    results_done = 0;
+    results_sent = 0;
+    EIS_LoadFrequency();
+    running = true;
+    return true;
+}
+
+/******************************************************************************
+* Function Name: EIS_Tick
+*******************************************************************************
+*
+* Summary:
+*  Run one PWM_isr tick.  Read the current for the dac value set on the last
+*  tick, add it to the lock-in and set the next point of the sine wave
+*
+*******************************************************************************/
+
+void EIS_Tick(void) {
+    if (!running) {
+        return;
+    }
+    int16 sample = SeqHAL_ReadADC();
+    if (cycle >= EIS_SETTLE_CYCLES) {
+        EIS_DemodAdd(sample, phase_index);  // the reading is for the dac value set on the last tick
+    }
+    phase_index = (phase_index + 1) & EIS_PHASE_MASK;
+    if (phase_index == 0) {
+        cycle++;
+        if (cycle >= EIS_SETTLE_CYCLES + measure_cycles) {
+            results[frequency_index].in_phase = demod_in_phase;
+            results[frequency_index].quadrature = demod_quadrature;
+            results[frequency_index].points = demod_points;
+            results_done++;
+            frequency_index++;
+            if (frequency_index >= num_frequencies) {
+                running = false;
+                SeqHAL_SetDAC(bias_value);
+                return;
+            }
+            EIS_LoadFrequency();
+        }
+    }
+    SeqHAL_SetDAC(bias_value + excitation[phase_index]);
+}
+
+void EIS_Stop(void) {
+    running = false;
+    results_done = 0;
+    results_sent = 0;
+}
+
+uint8 EIS_IsRunning(void) {
+    return running;
+}
+
+uint8 EIS_ResultReady(void) {
+    return results_sent < results_done;
+}
+
+/******************************************************************************
+* Function Name: EIS_NextResult
+*******************************************************************************
+*
+* Summary:
+*  Make the record of the next finished frequency, call from the main loop
+*  as it uses floating point math
+*
+* Return:
+*  uint8*: record to export, sizeof(struct EISRecord) bytes long
+*
+*******************************************************************************/
+
+uint8* EIS_NextResult(void) {
+    uint8 index = results_sent;
+    uint16 period = EIS_PeriodForFrequency(frequencies[index]);
+    
+    eis_record.record.tag[0] = 'E';
+    eis_record.record.tag[1] = 'Z';
+    eis_record.record.index = index;
+    eis_record.record.frequency_centihz = (uint32)PWM_CLOCK_HZ * 100 / 
+                                          ((uint32)EIS_POINTS_PER_PERIOD * (period + 1));
+    eis_record.record.amplitude = amplitude_value;
+    EIS_Convert(&results[index], &eis_record.record.magnitude_q8, &eis_record.record.phase_centideg);
+    results_sent++;
+    return eis_record.usb;
+}
+
+/******************************************************************************
+* Function Name: EIS_DemodReset
+*******************************************************************************
+*
+* Summary:
+*  Clear the lock-in accumulators
+*
+*******************************************************************************/
+
+void EIS_DemodReset(void) {
+    demod_in_phase = 0;
+    demod_quadrature = 0;
+    demod_points = 0;
+}
+
+/******************************************************************************
+* Function Name: EIS_DemodAdd
+*******************************************************************************
+*
+* Summary:
+*  Multiply a data point by the sine and cosine of the applied wave and add 
+*  it to the accumulators
+*
+* Parameters:
+*  int16 sample: adc reading
+*  uint8 phase_index: position in the sine wave of the dac value the reading is for
+*
+*******************************************************************************/
+
+void EIS_DemodAdd(int16 sample, uint8 phase_index) {
+    demod_in_phase += (int32)sample * eis_sine_q14[phase_index & EIS_PHASE_MASK];
+    demod_quadrature += (int32)sample * eis_sine_q14[(phase_index + EIS_COSINE_OFFSET) & EIS_PHASE_MASK];
+    demod_points++;
+}
+
+/******************************************************************************
+* Function Name: EIS_DemodResult
+*******************************************************************************
+*
+* Summary:
+*  Get the magnitude and phase of the data added since EIS_DemodReset
+*
+* Parameters:
+*  uint32 *magnitude_q8: amplitude of the sine wave in adc counts with 8 fractional bits
+*  int16 *phase_centideg: phase relative to the sine table in 0.01 degrees
+*
+*******************************************************************************/
+
+void EIS_DemodResult(uint32 *magnitude_q8, int16 *phase_centideg) {
+    struct EISResult result = {demod_in_phase, demod_quadrature, demod_points};
+    EIS_Convert(&result, magnitude_q8, phase_centideg);
+}
+
+/******************************************************************************
+* Function Name: EIS_LoadFrequency
+*******************************************************************************
+*
+* Summary:
+*  Set the PWM period for the frequency at frequency_index and restart the wave
+*
+*******************************************************************************/
+
+static void EIS_LoadFrequency(void) {
+    SeqHAL_SetPeriod(EIS_PeriodForFrequency(frequencies[frequency_index]));
+    phase_index = 0;
+    cycle = 0;
+    EIS_DemodReset();
+    SeqHAL_SetDAC(bias_value + excitation[0]);
+}
+
+/******************************************************************************
+* Function Name: EIS_Convert
+*******************************************************************************
+*
+* Summary:
+*  Change the in phase and quadrature sums into a magnitude and phase.
+*  For a reading of A*sin(wt + phase) the in phase sum is N*A/2*cos(phase)
+*  and the quadrature sum is N*A/2*sin(phase), both times 2**14
+*
+*******************************************************************************/
+
+static void EIS_Convert(struct EISResult *result, uint32 *magnitude_q8, int16 *phase_centideg) {
+    if (result->points == 0) {
+        *magnitude_q8 = 0;
+        *phase_centideg = 0;
+        return;
+    }
+    float32 in_phase = (float32)result->in_phase;
+    float32 quadrature = (float32)result->quadrature;
+    float32 magnitude = 2.0f * sqrtf(in_phase*in_phase + quadrature*quadrature) / 
+                        ((float32)result->points * (1 << EIS_SINE_SHIFT));
+    *magnitude_q8 = (uint32)(magnitude * 256.0f + 0.5f);
+    *phase_centideg = (int16)(atan2f(quadrature, in_phase) * 18000.0f / 3.14159265f);
+}
+
+/* [] END OF FILE */
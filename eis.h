@@ -0,0 +1,71 @@
+/*******************************************************************************
+* File Name: eis.h
+*
+* Description:
+*  This file contains the function prototypes and constants used for
+*  electrochemical impedance spectroscopy
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#if !defined(EIS_H)
+#define EIS_H
+
+#include "cytypes.h"
+#include "globals.h"
+#include "sequencer_hal.h"
+
+/**************************************
+*      Constants
+**************************************/
+
+#define EIS_MAX_FREQUENCIES 32
+#define EIS_POINTS_PER_PERIOD 32  // has to be a power of 2 and match eis_sine_q14
+#define EIS_SINE_SHIFT 14  // the sine table has 14 fractional bits
+#define EIS_SETTLE_CYCLES 2  // sine wave periods to wait after each frequency change before measuring
+
+
+/**************************************
+*      Structures
+**************************************/
+
+struct EISRecord {
+    char tag[2];  // "EZ"
+    uint16 index;  // which frequency in the list
+    uint32 frequency_centihz;  // frequency made by the PWM in 0.01 Hz
+    uint32 magnitude_q8;  // amplitude of the current sine wave in adc counts with 8 fractional bits
+    int16 phase_centideg;  // phase of the current relative to the applied voltage in 0.01 degrees
+    uint16 amplitude;  // amplitude of the applied voltage in dac counts
+};
+
+union eis_usb_union {
+    uint8 usb[sizeof(struct EISRecord)];
+    struct EISRecord record;
+};
+
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+void EIS_Clear(void);
+uint8 EIS_AddFrequency(uint32 frequency_centihz);
+uint8 EIS_Start(uint16 bias, uint16 amplitude, uint16 cycles);
+void EIS_Tick(void);
+void EIS_Stop(void);
+uint8 EIS_IsRunning(void);
+uint8 EIS_ResultReady(void);
+uint8* EIS_NextResult(void);
+uint16 EIS_PeriodForFrequency(uint32 frequency_centihz);
+uint16 EIS_ShortestPeriod(void);
+
+/* lock-in demodulator, does not use the hardware */
+void EIS_DemodReset(void);
+void EIS_DemodAdd(int16 sample, uint8 phase_index);
+void EIS_DemodResult(uint32 *magnitude_q8, int16 *phase_centideg);
+
+#endif
+
+/* [] END OF FILE */
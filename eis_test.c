@@ -0,0 +1,116 @@
+/*******************************************************************************
+* File Name: eis_test.c
+*
+* Description:
+*  Checks the EIS lock-in on a computer.  The demodulator is given made up
+*  signals with a known amplitude and phase, then the whole EIS run is done
+*  on the simulated hardware with a Randles cell of known impedance
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include <complex.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "DAC.h"
+#include "eis.h"
+#include "sequencer_hal_sim.h"
+#include "sim_test.h"
+
+#define TEST_BIAS 2048
+#define TEST_AMPLITUDE 10  // dac counts, 10 mV with the DVDAC
+#define TEST_CYCLES 4
+#define TEST_RU 1000.0
+#define TEST_RCT 10000.0
+#define TEST_CDL 1e-6
+
+static void test_synthetic(void) {
+    // amplitude, phase in degrees, dc offset and a 3rd harmonic the lock-in has to ignore
+    static const float64 signals[][4] = {
+        {1000, 28.65, 200, 0},
+        {1000, -90, -3000, 300},
+        {50, 135, 0, 20},
+        {12000, 0, 5000, 2000}
+    };
+    for (uint8 i = 0; i < sizeof(signals)/sizeof(signals[0]); i++) {
+        uint32 magnitude_q8;
+        int16 phase_centideg;
+        EIS_DemodReset();
+        for (uint16 k = 0; k < EIS_POINTS_PER_PERIOD*TEST_CYCLES; k++) {
+            float64 angle = 2*M_PI*k/EIS_POINTS_PER_PERIOD;
+            float64 sample = signals[i][0]*sin(angle + signals[i][1]*M_PI/180) + signals[i][2] +
+                             signals[i][3]*sin(3*angle);
+            EIS_DemodAdd((int16)lround(sample), k % EIS_POINTS_PER_PERIOD);
+        }
+        EIS_DemodResult(&magnitude_q8, &phase_centideg);
+        SIM_CHECK(fabs(magnitude_q8/256.0 - signals[i][0]) < 0.01*signals[i][0] + 0.5);
+        SIM_CHECK(abs(phase_centideg - (int16)lround(signals[i][1]*100)) < 20 + 3000/signals[i][0]);
+    }
+}
+
+/* current in A for 1 V of excitation read at the end of each tick.  The dac
+   holds each value for a tick so the double layer voltage after tick n is
+   Vc[n+1] = Vc[n]*d + V[n]*(1 - d)*Rct/(Ru + Rct) with d = exp(-T/((Ru || Rct)*Cdl)),
+   and the current read is (V[n] - Vc[n+1])/Ru */
+static double complex expected_admittance(float64 tick_seconds) {
+    float64 omega = 2*M_PI / (EIS_POINTS_PER_PERIOD*tick_seconds);
+    float64 decay = exp(-tick_seconds * (1/TEST_RU + 1/TEST_RCT) / TEST_CDL);
+    double complex rotate = cexp(I*omega*tick_seconds);
+    double complex interface = (1 - decay) * TEST_RCT / (TEST_RU + TEST_RCT) / (rotate - decay);
+    return (1 - interface*rotate) / TEST_RU;
+}
+
+static void test_randles_cell(void) {
+    static const uint32 frequencies_centihz[] = {200, 2000, 20000, 100000};
+    float64 tick_seconds[4];
+    
+    SimCell_Randles(&sim_cell, TEST_RU, TEST_RCT, TEST_CDL);
+    SimHAL_Reset();
+    EIS_Clear();
+    for (uint8 i = 0; i < 4; i++) {
+        SIM_CHECK(EIS_AddFrequency(frequencies_centihz[i]));
+        tick_seconds[i] = (float64)sim_clock_divider * (EIS_PeriodForFrequency(frequencies_centihz[i]) + 1) / 
+                          BCLK__BUS_CLK__HZ;
+    }
+    SIM_CHECK(!EIS_Start(TEST_BIAS, TEST_BIAS + 1, TEST_CYCLES));  // past the dac range
+    SIM_CHECK(EIS_Start(TEST_BIAS, TEST_AMPLITUDE, TEST_CYCLES));
+    while (EIS_IsRunning() && (sim_ticks < 100000)) {
+        SimHAL_Advance();
+        EIS_Tick();
+    }
+    SIM_CHECK(sim_dac_value == TEST_BIAS);
+    
+    for (uint8 i = 0; i < 4; i++) {
+        SIM_CHECK(EIS_ResultReady());
+        struct EISRecord *record = (struct EISRecord*)EIS_NextResult();
+        double complex current = TEST_AMPLITUDE * 1e-3 * expected_admittance(tick_seconds[i]) * 1e9;  // nA, 1 nA per count
+        float64 phase = carg(current) * 18000 / M_PI;
+        SIM_CHECK(record->index == i);
+        SIM_CHECK(fabs(record->magnitude_q8/256.0 - cabs(current)) < 0.01*cabs(current) + 1);
+        SIM_CHECK(fabs(record->phase_centideg - phase) < 50);
+    }
+    SIM_CHECK(!EIS_ResultReady());
+}
+
+static void test_vdac_range(void) {
+    EIS_Clear();
+    SIM_CHECK(EIS_AddFrequency(10000));
+    selected_voltage_source = VDAC_IS_VDAC;
+    SIM_CHECK(!EIS_Start(250, 10, 1));  // 260 wraps around in the 8-bit VDAC
+    SIM_CHECK(EIS_Start(240, 10, 1));
+    EIS_Stop();
+    selected_voltage_source = VDAC_IS_DVDAC;
+}
+
+int main(void) {
+    DAC_Start();
+    test_synthetic();
+    test_randles_cell();
+    test_vdac_range();
+    return sim_test_failures;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,293 @@
+/*******************************************************************************
+* File Name: electrode_scan.c
+*
+* Description:
+*  Time multiplexed scan of a list of electrode configurations.  On each
+*  isr_adcAmp tick the ADC sample is saved to the buffer of the channel that
+*  is connected, after a set number of samples the AMuxes and gain are
+*  switched to the next channel.  The first samples after a switch are thrown
+*  away while the TIA and delta sigma ADC settle.  Each channel is saved to
+*  its own ADC_array buffer and the computer is told when half of a buffer is
+*  full so it can read it with the ranged 'E' export while the other half fills
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include <project.h>
+#include <stdio.h>
+#include "string.h"
+
+#include "adc_profile.h"
+#include "data_export.h"
+#include "electrode_scan.h"
+#include "sequencer_hal.h"
+#include "usb_protocols.h"
+
+extern char usb_str[];
+void HardwareSleep(void);  // in main.c
+
+static struct ScanChannel scan_channels[SCAN_MAX_CHANNELS];
+static struct ScanChannel scan_home;  // settings the user had before the scan, put back when it ends
+static uint8 scan_length = 0;
+static volatile uint8 scan_running = false;
+
+static uint8 scan_current;  // channel that is connected
+static uint16 scan_blank_ticks;
+static uint16 scan_dwell_ticks;
+static uint16 scan_block_size;
+static uint16 scan_rounds;  // 0 runs until stopped
+static uint16 scan_round_count;
+static uint16 blank_count;  // samples left to throw away after the last switch
+static uint16 dwell_count;  // samples saved since the last switch
+static uint16 fill_index[SCAN_MAX_CHANNELS];  // where the next sample of each channel goes
+
+/***************************************
+* Forward function references
+***************************************/
+static void scan_connect(uint8 channel);
+static void scan_apply(struct ScanChannel *settings);
+static void scan_finish(void);
+static void scan_restore(void);
+
+
+/******************************************************************************
+* Function Name: Scan_Clear
+*******************************************************************************
+*
+* Summary:
+*  Remove all the channels from the scan list
+*
+*******************************************************************************/
+
+void Scan_Clear(void) {
+    scan_length = 0;
+}
+
+/******************************************************************************
+* Function Name: Scan_AddChannel
+*******************************************************************************
+*
+* Summary:
+*  Add an electrode configuration to the end of the scan list
+*
+* Parameters:
+*  struct ScanChannel *channel: AMux and gain settings to use for the channel
+*
+* Return:
+*  true (1) if the channel was added or false (0) if the list is full or the scan is running
+*
+*******************************************************************************/
+
+uint8 Scan_AddChannel(struct ScanChannel *channel) {
+    if ((scan_length >= SCAN_MAX_CHANNELS) || scan_running) {
+        return false;
+    }
+    scan_channels[scan_length] = *channel;
+    scan_length++;
+    return true;
+}
+
+/******************************************************************************
+* Function Name: Scan_Start
+*******************************************************************************
+*
+* Summary:
+*  Connect the first channel and get ready for the isr_adcAmp ticks, the
+*  caller has to wake up the hardware and enable the interrupt
+*
+* Parameters:
+*  struct ScanChannel *home: the AMux and gain settings to go back to after the scan
+*  uint16 blank_ticks: samples to throw away after switching channels
+*  uint16 dwell_ticks: samples to save from a channel before switching to the next
+*  uint16 block_size: data points of a channel in each block sent to the computer
+*  uint16 rounds: how many times to go through the channel list, 0 to run until Scan_Stop
+*
+* Return:
+*  true (1) if the scan started or false (0) if the settings can not be used
+*
+*******************************************************************************/
+
+uint8 Scan_Start(struct ScanChannel *home, uint16 blank_ticks, uint16 dwell_ticks, uint16 block_size, uint16 rounds) {
+    if ((scan_length == 0) || (dwell_ticks == 0) || (block_size == 0) || (block_size > SCAN_MAX_BLOCK)) {
+        return false;
+    }
+    if (scan_length > adc_ring_channels) {  // each channel has its own buffer and a saved blank keeps the last one
+        return false;
+    }
+    scan_home = *home;
+    SeqHAL_ForgetGain();  // the user may have changed the gain with 'A' since the last run
+    scan_blank_ticks = blank_ticks;
+    scan_dwell_ticks = dwell_ticks;
+    scan_block_size = block_size;
+    scan_rounds = rounds;
+    scan_round_count = 0;
+    for (uint8 i = 0; i < SCAN_MAX_CHANNELS; i++) {
+        fill_index[i] = 0;
+    }
+    scan_connect(0);
+    scan_running = true;
+    return true;
+}
+
+/******************************************************************************
+* Function Name: Scan_Tick
+*******************************************************************************
+*
+* Summary:
+*  Called every isr_adcAmp tick.  Save the sample to the connected channel,
+*  send a block when half a buffer is full and switch to the next channel when
+*  the dwell time is over.
+*  A block is sent as "L" + channel + | + offset + | + data points, the data
+*  can be read with EX|OOOO|LLLL
+*
+*******************************************************************************/
+
+void Scan_Tick(void) {
+    int16 sample = AdcProfile_GetResult();
+    if (!scan_running) {
+        return;
+    }
+    if (blank_count) {  // TIA and ADC are still settling from the switch
+        blank_count--;
+        return;
+    }
+    uint16 index = fill_index[scan_current];
+    ADC_array[scan_current].data[index] = sample;
+    index++;
+    if ((index == scan_block_size) || (index == 2*scan_block_size)) {
+        sprintf(usb_str, "L%d|%04d|%04d", scan_current, index - scan_block_size, scan_block_size);
+        Export_Notify((uint8*)usb_str, strlen(usb_str)+1);
+        if (index == 2*scan_block_size) {
+            index = 0;
+        }
+    }
+    fill_index[scan_current] = index;
+    
+    dwell_count++;
+    if (dwell_count < scan_dwell_ticks) {
+        return;
+    }
+    uint8 next = scan_current + 1;
+    if (next >= scan_length) {
+        next = 0;
+        scan_round_count++;
+        if (scan_rounds && (scan_round_count >= scan_rounds)) {
+            scan_finish();
+            return;
+        }
+    }
+    if (next != scan_current) {
+        scan_connect(next);
+    }
+    else {  // only 1 channel, no settling needed
+        dwell_count = 0;
+    }
+}
+
+/******************************************************************************
+* Function Name: Scan_Stop
+*******************************************************************************
+*
+* Summary:
+*  Stop the scan without telling the computer, used by the 'X' command
+*
+*******************************************************************************/
+
+void Scan_Stop(void) {
+    if (scan_running) {
+        scan_running = false;
+        scan_restore();
+    }
+}
+
+uint8 Scan_IsRunning(void) {
+    return scan_running;
+}
+
+/******************************************************************************
+* Function Name: scan_connect
+*******************************************************************************
+*
+* Summary:
+*  Set the AMuxes and gain for a channel and start the blanking time
+*
+* Parameters:
+*  uint8 channel: index in the scan list to connect
+*
+*******************************************************************************/
+
+static void scan_connect(uint8 channel) {
+    scan_apply(&scan_channels[channel]);
+    scan_current = channel;
+    blank_count = scan_blank_ticks;
+    dwell_count = 0;
+}
+
+/******************************************************************************
+* Function Name: scan_apply
+*******************************************************************************
+*
+* Summary:
+*  Set the AMuxes and gain
+*
+* Parameters:
+*  struct ScanChannel *settings: AMux and gain settings to use
+*
+*******************************************************************************/
+
+static void scan_apply(struct ScanChannel *settings) {
+    AMux_electrode_Select(settings->electrode_config);
+    AMux_TIA_input_Select(settings->tia_input);
+    if (settings->use_extra_resistor) {
+        AMux_TIA_resistor_bypass_Connect(0);
+    }
+    else {
+        AMux_TIA_resistor_bypass_Disconnect(0);
+    }
+    SeqHAL_SetGain(settings->tia_resistor, settings->adc_buffer);  // only writes the registers if the gain changed
+}
+
+/******************************************************************************
+* Function Name: scan_finish
+*******************************************************************************
+*
+* Summary:
+*  Send the partly filled blocks, stop the interrupt and tell the computer the scan is done
+*
+*******************************************************************************/
+
+static void scan_finish(void) {
+    scan_running = false;
+    isr_adcAmp_Disable();
+    HardwareSleep();
+    scan_restore();
+    for (uint8 i = 0; i < scan_length; i++) {
+        uint16 start = 0;
+        if (fill_index[i] >= scan_block_size) {  // the first half was sent when it filled
+            start = scan_block_size;
+        }
+        if (fill_index[i] > start) {
+            sprintf(usb_str, "L%d|%04d|%04d", i, start, fill_index[i] - start);
+            Export_Notify((uint8*)usb_str, strlen(usb_str)+1);
+        }
+    }
+    Export_Notify((uint8*)"LDone", 6);
+}
+
+/******************************************************************************
+* Function Name: scan_restore
+*******************************************************************************
+*
+* Summary:
+*  Put the AMuxes and gain back to the settings the user had before the scan
+*
+*******************************************************************************/
+
+static void scan_restore(void) {
+    scan_apply(&scan_home);
+    SeqHAL_ForgetGain();
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,53 @@
+/*******************************************************************************
+* File Name: electrode_scan.h
+*
+* Description:
+*  This file contains the function prototypes and constants used for
+*  the time multiplexed scan of several electrode / AMux configurations
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#if !defined(ELECTRODE_SCAN_H)
+#define ELECTRODE_SCAN_H
+
+#include "cytypes.h"
+#include "globals.h"
+
+/**************************************
+*      Constants
+**************************************/
+
+#define SCAN_MAX_CHANNELS ADC_CHANNELS  // each scan channel gets its own ADC_array buffer
+#define SCAN_MAX_BLOCK (MAX_LUT_SIZE / 2)  // each buffer is split in 2 halves, one fills while the other is exported
+
+
+/**************************************
+*      Structures
+**************************************/
+
+struct ScanChannel {
+    uint8 electrode_config;  // AMux_electrode channel, two_electrode_config_ch or three_electrode_config_ch
+    uint8 tia_input;  // AMux_TIA_input channel
+    uint8 use_extra_resistor;  // true to connect AMux_TIA_resistor_bypass
+    uint8 tia_resistor;  // index for TIA_SetResFB
+    uint8 adc_buffer;  // index for ADC_SigDel_SetBufferGain
+};
+
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+void Scan_Clear(void);
+uint8 Scan_AddChannel(struct ScanChannel *channel);
+uint8 Scan_Start(struct ScanChannel *home, uint16 blank_ticks, uint16 dwell_ticks, uint16 block_size, uint16 rounds);
+void Scan_Tick(void);
+void Scan_Stop(void);
+uint8 Scan_IsRunning(void);
+
+#endif
+
+/* [] END OF FILE */
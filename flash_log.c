@@ -0,0 +1,416 @@
+/*******************************************************************************
+* File Name: flash_log.c
+*
+* Description:
+*  Log structured writer that saves sequencer data blocks in the unused top
+*  of the internal flash, so a stored program can be run in the field and
+*  the data read back later with the 'UF' command.  The sequencer isr only
+*  queues the ADC_array channel of each finished block, the main loop copies
+*  the blocks into a RAM row and writes the flash a whole row at a time.
+*  Every row starts with a sequence number that follows on from the row
+*  before, so the end of the log is found again after a power cycle by
+*  looking for the first row that breaks the sequence.  Erasing the log
+*  only moves the starting sequence number on, the old rows are written
+*  over as the new log grows.
+*  The rows are written with the SPC while the program keeps running from
+*  the lower flash arrays, so the isrs are not held off during a write.
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include "flash_log.h"
+#include "command_queue.h"
+#include "helper_functions.h"
+#include "usb_protocols.h"
+
+/* the table of the data sections the start up code copies out of the flash, made by the
+   PSoC Creator linker script (cm3gcc.ld) for Cm3Start.c, and the end of the code before them */
+struct LinkerRegion {
+    uint32 init_addr;  // where the initial values are in the flash
+    uint32 data_addr;
+    uint32 init_size;
+    uint32 zero_size;
+};
+extern const struct LinkerRegion __cy_regions[];
+extern const char __cy_region_num;
+extern const char __exidx_end;
+
+static uint16 log_rows = LOG_ROWS;  // 0 if the program reaches into the log
+static uint16 log_sequence;  // sequence number of the first row of the log
+static uint16 rows_used;  // rows of the log already in flash
+static uint16 row_limit = LOG_ROWS;  // lowered if a row write fails so nothing is written after it
+static uint8 row_buffer[CY_FLASH_SIZEOF_ROW];  // next row to write
+static uint16 row_fill;  // bytes used in row_buffer, including the row header
+
+static volatile uint8 running = false;
+static volatile uint8 overrun;  // the sequencer was about to write over a block that was not logged yet
+static uint16 blocks_lost;  // blocks not logged because the log is full
+
+/* blocks waiting to be copied into the flash, the isr moves pending_in on and the main loop pending_out.
+   Both count to 2*LOG_PENDING_BLOCKS so a full queue is not mistaken for an empty one */
+static volatile struct {
+    uint8 channel;
+    uint8 step;
+    uint16 count;
+} pending[LOG_PENDING_BLOCKS];
+static volatile uint8 pending_in;
+static volatile uint8 pending_out;
+
+/***************************************
+* Forward function references
+***************************************/
+static struct LogRowHeader* FlashLog_Row(uint16 row);
+static uint32 FlashLog_ImageEnd(void);
+static uint32 FlashLog_Space(void);
+static void FlashLog_AppendRecord(uint8 tag, uint8 arg8, uint16 arg16);
+static void FlashLog_Append(const uint8 data[], uint16 length);
+static void FlashLog_WriteRow(void);
+
+/******************************************************************************
+* Function Name: FlashLog_Init
+*******************************************************************************
+*
+* Summary:
+*  Find the end of the log left in the flash, call once at power up.  The
+*  generated linker script does not keep the program out of the log rows, so
+*  the end of the program image is checked here and the log is turned off if
+*  the program has grown into it
+*
+* Return:
+*  true if the log is clear of the program
+*
+*******************************************************************************/
+
+uint8 FlashLog_Init(void) {
+    if (FlashLog_ImageEnd() > CY_FLASH_BASE + (uint32)LOG_FIRST_ROW*CY_FLASH_SIZEOF_ROW) {
+        log_rows = 0;
+        row_limit = 0;
+        rows_used = 0;
+        return false;
+    }
+    uint8 sequence_bytes[2];
+    helper_Read_EEPROM(sequence_bytes, FLASH_LOG_SEQUENCE_ADDRESS, 2);
+    log_sequence = sequence_bytes[0] | (sequence_bytes[1] << 8);
+    rows_used = 0;
+    while (rows_used < log_rows) {
+        struct LogRowHeader *row = FlashLog_Row(rows_used);
+        if ((row->magic != LOG_ROW_MAGIC) || (row->sequence != (uint16)(log_sequence + rows_used))) {
+            break;
+        }
+        rows_used++;
+    }
+    return true;
+}
+
+/******************************************************************************
+* Function Name: FlashLog_Erase
+*******************************************************************************
+*
+* Summary:
+*  Start a new empty log.  The starting sequence number is moved on and saved
+*  in the eeprom so none of the old rows follow on from the new first row
+*
+* Return:
+*  true if the log was erased, false if a run is being logged
+*
+*******************************************************************************/
+
+uint8 FlashLog_Erase(void) {
+    if (running) {
+        return false;
+    }
+    log_sequence++;
+    helper_Writebyte_EEPROM(log_sequence & 0xFF, FLASH_LOG_SEQUENCE_ADDRESS);
+    helper_Writebyte_EEPROM(log_sequence >> 8, FLASH_LOG_SEQUENCE_ADDRESS + 1);
+    rows_used = 0;
+    row_limit = log_rows;
+    return true;
+}
+
+/******************************************************************************
+* Function Name: FlashLog_Start
+*******************************************************************************
+*
+* Summary:
+*  Start logging the blocks of a sequencer run after what is already in the log.
+*  Call before the sequencer is started
+*
+* Parameters:
+*  uint8 steps: number of steps in the program, saved in the start record
+*  uint16 block_size: data points in a block, saved in the start record
+*
+* Return:
+*  true if the log has room for the run
+*
+*******************************************************************************/
+
+uint8 FlashLog_Start(uint8 steps, uint16 block_size) {
+    if (running) {
+        return false;
+    }
+    row_fill = sizeof(struct LogRowHeader);
+    if (FlashLog_Space() < 3*sizeof(struct LogRecordHeader) + 2*block_size) {  // room for at least 1 block
+        return false;
+    }
+    CySetTemp();  // the SPC needs the die temperature to set the flash write timing
+    pending_in = 0;
+    pending_out = 0;
+    overrun = false;
+    blocks_lost = 0;
+    FlashLog_AppendRecord(LOG_RECORD_START, steps, block_size);
+    running = true;
+    return true;
+}
+
+uint8 FlashLog_IsRunning(void) {
+    return running;
+}
+
+uint8 FlashLog_Overrun(void) {
+    return overrun;
+}
+
+/******************************************************************************
+* Function Name: FlashLog_BlockReady
+*******************************************************************************
+*
+* Summary:
+*  Queue a finished sequencer block to be written to the flash, called by the
+*  sequencer isr in place of telling the computer
+*
+* Parameters:
+*  uint8 channel: ADC_array channel the block is in
+*  uint8 step: sequencer step the block is from
+*  uint16 count: data points in the block
+*
+* Return:
+*  false if the main loop has fallen behind and the next block would write
+*  over one that is not logged yet, the caller has to stop the sequencer
+*
+*******************************************************************************/
+
+uint8 FlashLog_BlockReady(uint8 channel, uint8 step, uint16 count) {
+    if (FlashLog_Pending() >= adc_ring_channels - 1) {  // fewer when the blank takes a channel
+        overrun = true;
+        return false;
+    }
+    uint8 slot = pending_in % LOG_PENDING_BLOCKS;
+    pending[slot].channel = channel;
+    pending[slot].step = step;
+    pending[slot].count = count;
+    pending_in = (pending_in + 1) % (2*LOG_PENDING_BLOCKS);
+    return true;
+}
+
+uint8 FlashLog_Pending(void) {
+    return (pending_in + 2*LOG_PENDING_BLOCKS - pending_out) % (2*LOG_PENDING_BLOCKS);
+}
+
+/******************************************************************************
+* Function Name: FlashLog_Poll
+*******************************************************************************
+*
+* Summary:
+*  Copy the queued blocks into the flash, called from the main loop.  A block
+*  stays queued until all of it is copied so the sequencer does not reuse its
+*  ADC_array channel.  Room is always kept for the end record
+*
+*******************************************************************************/
+
+void FlashLog_Poll(void) {
+    while (pending_in != pending_out) {
+        uint8 slot = pending_out % LOG_PENDING_BLOCKS;
+        uint16 count = pending[slot].count;
+        if (FlashLog_Space() >= 2*sizeof(struct LogRecordHeader) + 2*count) {
+            FlashLog_AppendRecord(LOG_RECORD_BLOCK, pending[slot].step, count);
+            FlashLog_Append((uint8*)ADC_array[pending[slot].channel].data, 2*count);
+        }
+        else {
+            blocks_lost++;
+        }
+        pending_out = (pending_out + 1) % (2*LOG_PENDING_BLOCKS);
+    }
+}
+
+/******************************************************************************
+* Function Name: FlashLog_Finish
+*******************************************************************************
+*
+* Summary:
+*  Write the blocks still queued and the end record, then write the last
+*  row even if it is not full so the log is complete in the flash
+*
+* Parameters:
+*  uint8 reason: LOG_END_DONE or LOG_END_STOPPED, changed to LOG_END_OVERRUN
+*                or LOG_END_FULL if blocks were missed
+*
+*******************************************************************************/
+
+void FlashLog_Finish(uint8 reason) {
+    if (!running) {
+        return;
+    }
+    FlashLog_Poll();
+    running = false;
+    if (overrun) {
+        reason = LOG_END_OVERRUN;
+    }
+    else if (blocks_lost) {
+        reason = LOG_END_FULL;
+    }
+    if (FlashLog_Space() >= sizeof(struct LogRecordHeader)) {
+        FlashLog_AppendRecord(LOG_RECORD_END, reason, blocks_lost);
+    }
+    if ((row_fill > sizeof(struct LogRowHeader)) && (rows_used < row_limit)) {
+        FlashLog_WriteRow();
+    }
+}
+
+/******************************************************************************
+* Function Name: FlashLog_Dump
+*******************************************************************************
+*
+* Summary:
+*  Send the log to the computer, a LogDumpHeader and then the rows as they are
+*  in the flash.  The rows are exported straight from the flash in large
+*  pieces so the dump runs as fast as the IN endpoint is read
+*
+*******************************************************************************/
+
+void FlashLog_Dump(void) {
+    union {
+        uint8 usb[sizeof(struct LogDumpHeader)];
+        struct LogDumpHeader header;
+    } dump_header;
+
+    dump_header.header.tag[0] = 'F';
+    dump_header.header.tag[1] = 'L';
+    dump_header.header.rows = rows_used;
+    dump_header.header.row_size = CY_FLASH_SIZEOF_ROW;
+    dump_header.header.free_rows = row_limit - rows_used;
+    USB_Export_Data(dump_header.usb, sizeof(struct LogDumpHeader));
+
+    for (uint16 row = 0; row < rows_used; row += LOG_DUMP_ROWS) {
+        uint16 rows_to_send = rows_used - row;
+        if (rows_to_send > LOG_DUMP_ROWS) {
+            rows_to_send = LOG_DUMP_ROWS;
+        }
+        USB_Export_Data((uint8*)FlashLog_Row(row), rows_to_send*CY_FLASH_SIZEOF_ROW);
+        if (usb_abort) {
+            return;
+        }
+    }
+}
+
+/******************************************************************************
+* Function Name: FlashLog_Row
+*******************************************************************************
+*
+* Summary:
+*  Find where a row of the log is in the memory map of the flash
+*
+*******************************************************************************/
+
+static struct LogRowHeader* FlashLog_Row(uint16 row) {
+    return (struct LogRowHeader*)(CY_FLASH_BASE + (uint32)(LOG_FIRST_ROW + row)*CY_FLASH_SIZEOF_ROW);
+}
+
+/******************************************************************************
+* Function Name: FlashLog_Space
+*******************************************************************************
+*
+* Summary:
+*  Bytes that can still be added to the log
+*
+*******************************************************************************/
+
+/******************************************************************************
+* Function Name: FlashLog_ImageEnd
+*******************************************************************************
+*
+* Summary:
+*  Find the first flash address after the program, the code and read only data
+*  end at __exidx_end and the initial values of the data sections follow
+*
+*******************************************************************************/
+
+static uint32 FlashLog_ImageEnd(void) {
+    uint32 end = (uint32)&__exidx_end;
+    for (uint32 i = 0; i < (uint32)&__cy_region_num; i++) {
+        uint32 region_end = __cy_regions[i].init_addr + __cy_regions[i].init_size;
+        if (region_end > end) {
+            end = region_end;
+        }
+    }
+    return end;
+}
+
+static uint32 FlashLog_Space(void) {
+    if (rows_used >= row_limit) {
+        return 0;
+    }
+    return (uint32)(row_limit - rows_used)*LOG_ROW_PAYLOAD - (row_fill - sizeof(struct LogRowHeader));
+}
+
+static void FlashLog_AppendRecord(uint8 tag, uint8 arg8, uint16 arg16) {
+    struct LogRecordHeader record;
+    record.tag = tag;
+    record.arg8 = arg8;
+    record.arg16 = arg16;
+    FlashLog_Append((uint8*)&record, sizeof(record));
+}
+
+/******************************************************************************
+* Function Name: FlashLog_Append
+*******************************************************************************
+*
+* Summary:
+*  Add bytes to the row buffer, writing it to the flash each time it fills
+*
+*******************************************************************************/
+
+static void FlashLog_Append(const uint8 data[], uint16 length) {
+    for (uint16 i = 0; i < length; i++) {
+        if (rows_used >= row_limit) {  // a row write failed
+            return;
+        }
+        row_buffer[row_fill] = data[i];
+        row_fill++;
+        if (row_fill >= CY_FLASH_SIZEOF_ROW) {
+            FlashLog_WriteRow();
+        }
+    }
+}
+
+/******************************************************************************
+* Function Name: FlashLog_WriteRow
+*******************************************************************************
+*
+* Summary:
+*  Write the row buffer to the next row of the log, the unused end of the row
+*  is filled with LOG_RECORD_PAD.  If the write fails the log is ended at the
+*  row before it
+*
+*******************************************************************************/
+
+static void FlashLog_WriteRow(void) {
+    struct LogRowHeader *header = (struct LogRowHeader*)row_buffer;
+    uint16 flash_row = LOG_FIRST_ROW + rows_used;
+
+    header->magic = LOG_ROW_MAGIC;
+    header->sequence = log_sequence + rows_used;
+    for (uint16 i = row_fill; i < CY_FLASH_SIZEOF_ROW; i++) {
+        row_buffer[i] = LOG_RECORD_PAD;
+    }
+    if (CyWriteRowData(flash_row / LOG_ROWS_PER_ARRAY, flash_row % LOG_ROWS_PER_ARRAY, row_buffer) == CYRET_SUCCESS) {
+        rows_used++;
+    }
+    else {
+        row_limit = rows_used;
+    }
+    row_fill = sizeof(struct LogRowHeader);
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,88 @@
+/*******************************************************************************
+* File Name: flash_log.h
+*
+* Description:
+*  This file contains the function prototypes, record formats and constants
+*  used for logging sequencer data to the unused top of the internal flash
+*  so the device can run with no computer connected
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#if !defined(FLASH_LOG_H)
+#define FLASH_LOG_H
+
+#include <project.h>
+#include "globals.h"
+
+/**************************************
+*      Constants
+**************************************/
+
+#define LOG_FIRST_ROW 768  // the log uses the top 64 kB of the 256 kB flash, the program has to fit below this, see FlashLog_Init
+#define LOG_ROWS 256
+#define LOG_ROWS_PER_ARRAY (CY_FLASH_SIZEOF_ARRAY / CY_FLASH_SIZEOF_ROW)
+#define LOG_ROW_MAGIC 0x474C  // "LG" in flash
+#define LOG_ROW_PAYLOAD (CY_FLASH_SIZEOF_ROW - sizeof(struct LogRowHeader))
+#define LOG_PENDING_BLOCKS (ADC_CHANNELS - 1)  // adc_ring_channels - 1 are used, one more would let the sequencer write over the block being logged
+#define LOG_DUMP_ROWS 32  // rows sent with each USB_Export_Data call of a dump
+
+#if ((LOG_FIRST_ROW + LOG_ROWS) * CY_FLASH_SIZEOF_ROW > CY_FLASH_SIZE)
+#error "the flash log goes past the end of the flash"
+#endif
+
+// record tags, the records are packed end to end in the row payloads and can cross rows
+#define LOG_RECORD_PAD 0x00  // nothing more in this row
+#define LOG_RECORD_START 'S'  // a run started, arg8: program steps, arg16: block size
+#define LOG_RECORD_BLOCK 'B'  // arg8: sequencer step, arg16: data points, followed by the int16 data points
+#define LOG_RECORD_END 'E'  // the run ended, arg8: LOG_END_XXX, arg16: blocks that were not logged
+
+#define LOG_END_DONE 0  // the program ran to the end
+#define LOG_END_STOPPED 1  // stopped by the 'X' command
+#define LOG_END_OVERRUN 2  // the flash writes fell behind the sequencer so the run was stopped
+#define LOG_END_FULL 3  // the log ran out of rows, the blocks after that were not logged
+
+
+/**************************************
+*      Structures
+**************************************/
+
+struct LogRowHeader {  // start of every row written
+    uint16 magic;  // LOG_ROW_MAGIC
+    uint16 sequence;  // sequence number of the first row plus the row index, finds the end of the log
+};
+
+struct LogRecordHeader {
+    uint8 tag;  // LOG_RECORD_XXX
+    uint8 arg8;
+    uint16 arg16;
+};
+
+struct LogDumpHeader {  // sent by the 'UF' command before the rows
+    char tag[2];  // "FL"
+    uint16 rows;  // rows that follow, each CY_FLASH_SIZEOF_ROW bytes including the LogRowHeader
+    uint16 row_size;
+    uint16 free_rows;
+};
+
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+uint8 FlashLog_Init(void);
+uint8 FlashLog_Erase(void);
+uint8 FlashLog_Start(uint8 steps, uint16 block_size);
+uint8 FlashLog_IsRunning(void);
+uint8 FlashLog_BlockReady(uint8 channel, uint8 step, uint16 count);
+uint8 FlashLog_Pending(void);
+uint8 FlashLog_Overrun(void);
+void FlashLog_Poll(void);
+void FlashLog_Finish(uint8 reason);
+void FlashLog_Dump(void);
+
+#endif
+
+/* [] END OF FILE */
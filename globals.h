@@ -23,6 +23,15 @@
     
 #define VIRTUAL_GROUND              2048  // TODO: make variable
 
+// define how big to make the arrays for the lut for dac and how big
+// to make the adc data array 
+#define MAX_LUT_SIZE 5000
+#define ADC_CHANNELS 4
+#define ADC_DATA_DONE_CODE 0xC000  // put after the last data point to mark the data array is done
+#define FIRMWARE_VERSION 0x0005  // major version in the high byte and minor in the low byte, sent in the DeviceHeader
+
+#define PWM_CLOCK_HZ 2400000  // frequency of Clock_PWM, PWM_isr counts period+1 of these clocks each tick
+
 // Define the AMux channels
 #define two_electrode_config_ch     0
 #define three_electrode_config_ch   1 
@@ -39,6 +48,8 @@
 #define VDAC_IS_DVDAC 2
     
 #define VDAC_ADDRESS 0
+#define FLASH_LOG_SEQUENCE_ADDRESS 16  // 2 bytes, see flash_log.c
+#define SEQ_STORE_ROW 2  // the saved sequencer program starts at this eeprom row, see Sequencer_Save
     
     
 /**************************************
@@ -52,6 +63,14 @@
 /**************************************
 *        Global Variables
 **************************************/   
+
+union data_usb_union {
+    uint8 usb[2*MAX_LUT_SIZE];
+    int16 data[MAX_LUT_SIZE];
+    int32 data32[MAX_LUT_SIZE/2];  // for 32 bit work buffers, also keeps the channels word aligned
+};
+extern union data_usb_union ADC_array[ADC_CHANNELS];  // adc measurements, allocated in main.c
+extern uint8 adc_ring_channels;  // channels the block modes go around, the last one is kept while a blank is saved
     
 //uint16 dac_ground_value = VIRTUAL_GROUND;  // initialize it to be set for the DVDAC and a 1 mV per step
 uint16 dac_ground_value;    
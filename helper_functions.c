@@ -125,4 +125,142 @@ uint8 helper_Readbyte_EEPROM(uint16 address) {
     return hold;
 }
 
+/******************************************************************************
+* Function Name: helper_WriteRows_EEPROM
+*******************************************************************************
+*
+* Summary:
+*    Start the eeprom, update the temperature and write whole rows to it.
+*    Writing a row takes as long as writing a byte so this is used for
+*    anything longer than a few bytes
+*
+* Parameters:
+*     data: bytes to write, has to hold rows * CYDEV_EEPROM_ROW_SIZE bytes
+*     first_row: eeprom row to start writing at
+*     rows: number of rows to write
+*
+* Return:
+*     true if all the rows were written
+*
+*******************************************************************************/
+
+uint8 helper_WriteRows_EEPROM(const uint8 data[], uint8 first_row, uint8 rows) {
+    uint8 status = true;
+    EEPROM_Start();
+    CyDelayUs(10);
+    uint8 blank_hold2 = EEPROM_UpdateTemperature();
+    for (uint8 i = 0; i < rows; i++) {
+        if (EEPROM_Write(&data[i*CYDEV_EEPROM_ROW_SIZE], first_row + i) != CYRET_SUCCESS) {
+            status = false;
+            break;
+        }
+    }
+    EEPROM_Stop();
+    return status;
+}
+
+/******************************************************************************
+* Function Name: helper_Read_EEPROM
+*******************************************************************************
+*
+* Summary:
+*    Copy a range of bytes out of the eeprom
+*
+* Parameters:
+*     data: where to put the bytes
+*     address: the address to start reading from
+*     length: number of bytes to read
+*
+*******************************************************************************/
+
+void helper_Read_EEPROM(uint8 data[], uint16 address, uint16 length) {
+    EEPROM_Start();
+    CyDelayUs(10);
+    for (uint16 i = 0; i < length; i++) {
+        data[i] = EEPROM_ReadByte(address + i);
+    }
+    EEPROM_Stop();
+}
+
+/******************************************************************************
+* Function Name: helper_StartCycleCounter
+*******************************************************************************
+*
+* Summary:
+*    Enable the Cortex-M3 DWT cycle counter so events can be timestamped
+*    with bus clock resolution.  The counter wraps after 2**32 BUS_CLK cycles
+*
+*******************************************************************************/
+
+void helper_StartCycleCounter(void) {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+/******************************************************************************
+* Function Name: helper_ReadCycleCounter
+*******************************************************************************
+*
+* Summary:
+*    Read the current value of the DWT cycle counter
+*
+* Return:
+*     number of BUS_CLK cycles since helper_StartCycleCounter was called
+*
+*******************************************************************************/
+
+uint32 helper_ReadCycleCounter(void) {
+    return DWT->CYCCNT;
+}
+
+/******************************************************************************
+* Function Name: helper_CyclesToUs
+*******************************************************************************
+*
+* Summary:
+*    Convert a difference of cycle counter readings into microseconds
+*
+* Parameters:
+*     cycles: number of BUS_CLK cycles
+*
+* Return:
+*     time in microseconds
+*
+*******************************************************************************/
+
+uint32 helper_CyclesToUs(uint32 cycles) {
+    return cycles / BCLK__BUS_CLK__MHZ;
+}
+
+/******************************************************************************
+* Function Name: helper_CRC16
+*******************************************************************************
+*
+* Summary:
+*    Add bytes to a running CRC-16/CCITT (polynomial 0x1021, start with 0xFFFF).
+*    Uses a 16 entry table so it is fast enough to run in the USB interrupt
+*
+* Parameters:
+*     crc: CRC of the bytes before these
+*     data: bytes to add
+*     length: number of bytes to add
+*
+* Return:
+*     CRC including the new bytes
+*
+*******************************************************************************/
+
+uint16 helper_CRC16(uint16 crc, const uint8 data[], uint16 length) {
+    static const uint16 crc_table[16] = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+        0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+    };
+    for (uint16 i = 0; i < length; i++) {
+        crc = (crc << 4) ^ crc_table[(crc >> 12) ^ (data[i] >> 4)];
+        crc = (crc << 4) ^ crc_table[(crc >> 12) ^ (data[i] & 0x0F)];
+    }
+    return crc;
+}
+
 /* [] END OF FILE */
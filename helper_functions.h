@@ -17,6 +17,9 @@
 #include "globals.h"
 #include "DAC.h"
     
+#define HELPER_CRC16_START 0xFFFF
+
+
 /***************************************
 *        Variables
 ***************************************/     
@@ -32,6 +35,12 @@ uint8 helper_check_voltage_source(void);
 void helper_set_voltage_source(uint8 selected_voltage_source);
 void helper_Writebyte_EEPROM(uint8 data, uint16 address);
 uint8 helper_Readbyte_EEPROM(uint16 address);
+uint8 helper_WriteRows_EEPROM(const uint8 data[], uint8 first_row, uint8 rows);
+void helper_Read_EEPROM(uint8 data[], uint16 address, uint16 length);
+void helper_StartCycleCounter(void);
+uint32 helper_ReadCycleCounter(void);
+uint32 helper_CyclesToUs(uint32 cycles);
+uint16 helper_CRC16(uint16 crc, const uint8 data[], uint16 length);
 
 
 #endif
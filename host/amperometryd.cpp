@@ -0,0 +1,105 @@
+/*******************************************************************************
+* File Name: amperometryd.cpp
+*
+* Description:
+*  The daemon program, see daemon.h.  It starts the simulated devices, records
+*  their runs until the time is up or it gets SIGINT or SIGTERM, then reports
+*  the points per second of all the devices and how long the points took to
+*  get to the disk
+*
+*  amperometryd SIM_DEVICE [--devices N] [--workers N] [--seconds S]
+*               [--period-ns P] [--profile N] [--block N] [--push N]
+*               [--dir DIRECTORY] [--commit-ms N]
+*
+*  With no --seconds it runs until it is stopped, the load test of many
+*  devices is daemon_bench.cpp
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+
+#include "daemon.h"
+
+using namespace amperometry;
+
+static Daemon *running_daemon = nullptr;
+
+static void stop_handler(int) {
+    if (running_daemon) {
+        running_daemon->stop();
+    }
+}
+
+static void usage(const char *program) {
+    std::fprintf(stderr, "usage: %s SIM_DEVICE [--devices N] [--workers N] [--seconds S] [--period-ns P]"
+                 " [--profile N] [--block N] [--push N] [--dir DIRECTORY] [--commit-ms N]\n", program);
+}
+
+int main(int argc, char **argv) {
+    DaemonOptions options;
+    double seconds = 0;
+    for (int i = 1; i < argc; i++) {
+        bool has_value = (i + 1 < argc);
+        if ((std::strcmp(argv[i], "--devices") == 0) && has_value) {
+            options.devices = std::atoi(argv[++i]);
+        }
+        else if ((std::strcmp(argv[i], "--workers") == 0) && has_value) {
+            options.workers = std::atoi(argv[++i]);
+        }
+        else if ((std::strcmp(argv[i], "--seconds") == 0) && has_value) {
+            seconds = std::atof(argv[++i]);
+        }
+        else if ((std::strcmp(argv[i], "--period-ns") == 0) && has_value) {
+            options.sample_period_ns = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if ((std::strcmp(argv[i], "--profile") == 0) && has_value) {
+            options.adc_profile = std::atoi(argv[++i]);
+        }
+        else if ((std::strcmp(argv[i], "--block") == 0) && has_value) {
+            options.block_points = std::atoi(argv[++i]);
+        }
+        else if ((std::strcmp(argv[i], "--push") == 0) && has_value) {
+            options.push_points = std::atoi(argv[++i]);
+        }
+        else if ((std::strcmp(argv[i], "--dir") == 0) && has_value) {
+            options.directory = argv[++i];
+        }
+        else if ((std::strcmp(argv[i], "--commit-ms") == 0) && has_value) {
+            options.commit_interval_ms = std::atoi(argv[++i]);
+        }
+        else if ((argv[i][0] != '-') && options.device_program.empty()) {
+            options.device_program = argv[i];
+        }
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (options.device_program.empty()) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    DaemonStats stats;
+    try {
+        Daemon daemon(options);
+        running_daemon = &daemon;
+        std::signal(SIGINT, stop_handler);
+        std::signal(SIGTERM, stop_handler);
+        stats = daemon.run((seconds > 0) ? seconds : 1e9);
+        running_daemon = nullptr;
+    } catch (const std::exception &error) {
+        std::fprintf(stderr, "amperometryd: %s\n", error.what());
+        return 1;
+    }
+
+    std::fputs(describe_stats(options, stats).c_str(), stdout);
+    return 0;
+}
@@ -0,0 +1,117 @@
+/*******************************************************************************
+* File Name: analysis_bench.cpp
+*
+* Description:
+*  Speed of the analysis steps, scalar against vector, on traces of 1 thousand
+*  to 10 million points (e.g. a long amperometry run at a fast adc rate).
+*  Each step is timed a few times and the fastest is printed in millions of
+*  points a second.  With --quick only the small traces are run, that is what
+*  ctest does
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "baseline.h"
+#include "calibration.h"
+#include "export_parse.h"
+#include "peaks.h"
+#include "savitzky_golay.h"
+
+using namespace amperometry;
+
+static const size_t kPointsWanted = 20000000;  // points run through each step at each size
+
+// fastest time of the repeats in seconds
+static double time_step(size_t size, const std::function<void()> &step) {
+    size_t repeats = kPointsWanted / size;
+    if (repeats < 3) {
+        repeats = 3;
+    }
+    double fastest = 1e9;
+    for (size_t i = 0; i < repeats; i++) {
+        auto start = std::chrono::steady_clock::now();
+        step();
+        std::chrono::duration<double> taken = std::chrono::steady_clock::now() - start;
+        if (taken.count() < fastest) {
+            fastest = taken.count();
+        }
+    }
+    return fastest;
+}
+
+static void print_step(const char *name, size_t size, double scalar, double vector) {
+    std::printf("%10zu  %-16s %10.1f %10.1f %8.2fx\n", size, name,
+                size / scalar * 1e-6, size / vector * 1e-6, scalar / vector);
+}
+
+static bool bench_size(size_t size) {
+    // an exported channel, a peak on a sloped baseline with noise, in counts
+    std::mt19937 random(size);
+    std::normal_distribution<float> noise(0, 20);
+    std::vector<uint8_t> bytes(2*size + 2);
+    for (size_t i = 0; i < size; i++) {
+        double offset = ((double)i - size/2.0) / (size/50.0 + 1);
+        int16_t count = (int16_t)std::lround(-500 + 0.3*i*1000/size + 4000*std::exp(-offset*offset/2)
+                                             + noise(random));
+        std::memcpy(&bytes[2*i], &count, 2);
+    }
+    std::memcpy(&bytes[2*size], &kDoneCode, 2);
+    CountView counts = *parse_channel(bytes, false);
+    Calibration calibration{0.05, 12};
+    std::vector<float> current(size);
+    std::vector<float> smoothed(size);
+    std::vector<float> corrected(size);
+    SavitzkyGolay smooth(10, 2);
+    Baseline baseline = Baseline::fit(smoothed.data(), size, {{0, size/5}, {size - size/5, size}}, 1);
+    size_t found[2] = {0, 0};
+
+    double scalar = time_step(size, [&] { counts_to_nanoamps_scalar(counts, calibration, current.data()); });
+    double vector = time_step(size, [&] { counts_to_nanoamps(counts, calibration, current.data()); });
+    print_step("counts to nA", size, scalar, vector);
+
+    scalar = time_step(size, [&] { smooth.apply_scalar(current.data(), smoothed.data(), size); });
+    vector = time_step(size, [&] { smooth.apply(current.data(), smoothed.data(), size); });
+    print_step("smooth 21 point", size, scalar, vector);
+
+    baseline = Baseline::fit(smoothed.data(), size, {{0, size/5}, {size - size/5, size}}, 1);
+    scalar = time_step(size, [&] { baseline.subtract_scalar(smoothed.data(), corrected.data(), size); });
+    vector = time_step(size, [&] { baseline.subtract(smoothed.data(), corrected.data(), size); });
+    print_step("baseline", size, scalar, vector);
+
+    // the raw current has a local maximum at about every 3rd point, the smoothed one a lot less
+    PeakOptions options;
+    options.min_height = 50;
+    scalar = time_step(size, [&] { found[0] = find_peaks_scalar(corrected.data(), size, options).size(); });
+    vector = time_step(size, [&] { found[1] = find_peaks(corrected.data(), size, options).size(); });
+    print_step("peaks", size, scalar, vector);
+    if (found[0] != found[1]) {
+        std::printf("peak count does not match, %zu scalar %zu vector\n", found[0], found[1]);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    bool quick = (argc > 1) && (std::strcmp(argv[1], "--quick") == 0);
+    const size_t sizes[] = {1000, 10000, 100000, 1000000, 10000000};
+    std::printf("%10s  %-16s %10s %10s %9s\n", "points", "step", "scalar M/s", "vector M/s", "speedup");
+    for (size_t size : sizes) {
+        if (quick && (size > 10000)) {
+            break;
+        }
+        if (!bench_size(size)) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,328 @@
+/*******************************************************************************
+* File Name: analysis_test.cpp
+*
+* Description:
+*  Checks the export parsing and the analysis.  The vector versions have to
+*  give what the scalar ones do, and the scalar ones what the math says on
+*  traces made up with known peaks and baselines
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "baseline.h"
+#include "calibration.h"
+#include "export_parse.h"
+#include "host_test.h"
+#include "peaks.h"
+#include "savitzky_golay.h"
+
+using namespace amperometry;
+
+static void put_word(std::vector<uint8_t> &bytes, uint16_t word) {
+    bytes.push_back(word & 0xFF);
+    bytes.push_back(word >> 8);
+}
+
+static float largest_difference(const std::vector<float> &a, const std::vector<float> &b) {
+    float largest = 0;
+    for (size_t i = 0; i < a.size(); i++) {
+        largest = std::max(largest, std::fabs(a[i] - b[i]));
+    }
+    return largest;
+}
+
+static void test_parse_channel() {
+    std::vector<uint8_t> bytes;
+    for (int i = 0; i < 5; i++) {
+        put_word(bytes, (uint16_t)(i*100 - 200));
+    }
+    put_word(bytes, kDoneCode);
+    put_word(bytes, 0x1234);  // whatever was in the array after the channel
+    auto view = parse_channel(bytes, false);
+    HOST_CHECK(view && (view->size() == 5));
+    HOST_CHECK(view && ((*view)[0] == -200) && ((*view)[4] == 200));
+
+    // pairs, the done code is where the next dac value would be
+    bytes.clear();
+    for (int i = 0; i < 3; i++) {
+        put_word(bytes, (uint16_t)(1000 + i));
+        put_word(bytes, (uint16_t)(-i));
+    }
+    put_word(bytes, kDoneCode);
+    view = parse_channel(bytes, true);
+    HOST_CHECK(view && (view->size() == 3));
+    HOST_CHECK(view && (view->dac_value(2) == 1002) && (view->current(2) == -2));
+
+    // a current of 0xC000 in a pair is data, not the end
+    bytes.clear();
+    put_word(bytes, 10);
+    put_word(bytes, kDoneCode);
+    put_word(bytes, kDoneCode);
+    view = parse_channel(bytes, true);
+    HOST_CHECK(view && (view->size() == 1) && ((uint16_t)view->current(0) == kDoneCode));
+
+    bytes.resize(4);
+    HOST_CHECK(!parse_channel(bytes, true));
+}
+
+static void test_parse_export() {
+    std::vector<uint8_t> bytes = {'E', 'S'};
+    put_word(bytes, 3);
+    put_word(bytes, 0x5678);  // first_sequence 0x12345678
+    put_word(bytes, 0x1234);
+    put_word(bytes, 7);
+    put_word(bytes, 8);
+    HOST_CHECK(!parse_export(bytes));  // a point is missing
+    put_word(bytes, 9);
+    put_word(bytes, 99);  // the start of the next record
+    auto block = parse_export(bytes);
+    HOST_CHECK(block && (block->first_sequence == 0x12345678) && (block->points.size() == 3));
+    HOST_CHECK(block && (block->points[2] == 9) && (block->record_bytes == 14));
+    bytes[1] = 'X';
+    HOST_CHECK(!parse_export(bytes));
+}
+
+static void test_calibration() {
+    // made up points of a TIA with 50 nA each count and the zero at 12 counts,
+    // the first 2 IDAC values sink current
+    const double nanoamps_per_count = 50;
+    const int16_t zero = 12;
+    int16_t points[2*kCalibrationPoints] = {40, 20, 0, 20, 40};
+    for (int i = 0; i < kCalibrationPoints; i++) {
+        double nanoamps = points[i] * kIdacFemtoampsPerBit * 1e-6 * (i < 2 ? -1 : 1);
+        points[i + kCalibrationPoints] = (int16_t)std::lround(zero + nanoamps / nanoamps_per_count);
+    }
+    auto calibration = Calibration::from_points(points);
+    HOST_CHECK(calibration);
+    HOST_CHECK(calibration && std::fabs(calibration->nanoamps_per_count - nanoamps_per_count) < 1e-9);
+    HOST_CHECK(calibration && (calibration->zero_count == zero));
+
+    int16_t flat[2*kCalibrationPoints] = {40, 20, 0, 20, 40, 5, 5, 5, 5, 5};
+    HOST_CHECK(!Calibration::from_points(flat));
+
+    ExportFormat format = {};
+    HOST_CHECK(!Calibration::from_format(format));
+    format.calibrated = 1;
+    format.femtoamps_per_count = 50000;
+    format.zero_count = -3;
+    calibration = Calibration::from_format(format);
+    HOST_CHECK(calibration && (std::fabs(calibration->nanoamps(7) - 0.5) < 1e-12));
+
+    // the vector conversion is the scalar one for both layouts and a length that is not a multiple of 8
+    std::vector<uint8_t> bytes;
+    for (int i = 0; i < 2*37; i++) {
+        put_word(bytes, (uint16_t)(i*911 - 30000));
+    }
+    for (bool pairs : {false, true}) {
+        CountView counts(bytes.data(), pairs ? 37 : 74, pairs);
+        std::vector<float> vector(counts.size());
+        std::vector<float> scalar(counts.size());
+        counts_to_nanoamps(counts, *calibration, vector.data());
+        counts_to_nanoamps_scalar(counts, *calibration, scalar.data());
+        HOST_CHECK(largest_difference(vector, scalar) < 1e-3);
+        HOST_CHECK(scalar[5] == (float)calibration->nanoamps(counts[5]));
+    }
+}
+
+static void test_savitzky_golay() {
+    // the classic 5 point quadratic smoothing weights
+    SavitzkyGolay smooth(2, 2);
+    const float classic[5] = {-3, 12, 17, 12, -3};
+    for (int k = 0; k < 5; k++) {
+        HOST_CHECK(std::fabs(smooth.weights()[k] - classic[k] / 35) < 1e-6);
+    }
+
+    // a cubic goes through a cubic fit unchanged and its slope is exact
+    const size_t size = 203;
+    std::vector<float> cubic(size);
+    for (size_t i = 0; i < size; i++) {
+        double x = (i - 100.0) / 50.0;
+        cubic[i] = (float)(2 + x - 3*x*x + 0.5*x*x*x);
+    }
+    SavitzkyGolay fit(7, 3);
+    std::vector<float> vector(size);
+    std::vector<float> scalar(size);
+    fit.apply(cubic.data(), vector.data(), size);
+    fit.apply_scalar(cubic.data(), scalar.data(), size);
+    HOST_CHECK(largest_difference(vector, scalar) < 1e-5);
+    for (size_t i = 7; i + 7 < size; i++) {
+        HOST_CHECK(std::fabs(scalar[i] - cubic[i]) < 1e-4);
+    }
+    SavitzkyGolay slope(7, 3, 1, 0.02);  // 50 points for each unit of x
+    slope.apply(cubic.data(), vector.data(), size);
+    double x = (60 - 100.0) / 50.0;
+    HOST_CHECK(std::fabs(vector[60] - (1 - 6*x + 1.5*x*x)) < 1e-3);
+
+    // noise gets smaller
+    std::mt19937 random(1);
+    std::normal_distribution<float> noise(0, 1);
+    std::vector<float> noisy(size);
+    for (auto &value : noisy) {
+        value = noise(random);
+    }
+    SavitzkyGolay(10, 2).apply(noisy.data(), vector.data(), size);
+    double before = 0;
+    double after = 0;
+    for (size_t i = 0; i < size; i++) {
+        before += noisy[i] * noisy[i];
+        after += vector[i] * vector[i];
+    }
+    HOST_CHECK(after < before / 4);
+
+    bool thrown = false;
+    try {
+        SavitzkyGolay(2, 5);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    HOST_CHECK(thrown);
+    thrown = false;
+    try {
+        fit.apply(cubic.data(), vector.data(), 7);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    HOST_CHECK(thrown);
+}
+
+static std::vector<float> gaussian_on_slope(size_t size, size_t center, float height, float sigma,
+                                            double slope = -0.01) {
+    std::vector<float> trace(size);
+    for (size_t i = 0; i < size; i++) {
+        double offset = ((double)i - center) / sigma;
+        trace[i] = (float)(3.0 + slope*i + height * std::exp(-offset*offset/2));
+    }
+    return trace;
+}
+
+static void test_baseline() {
+    const size_t size = 1001;
+    std::vector<float> trace = gaussian_on_slope(size, 500, 5, 20);
+    Baseline baseline = Baseline::fit(trace.data(), size, {{0, 300}, {700, size}}, 1);
+    HOST_CHECK(std::fabs(baseline.value(0) - 3.0) < 1e-3);
+    HOST_CHECK(std::fabs(baseline.value(1000) - (3.0 - 10.0)) < 1e-3);
+    std::vector<float> vector(size);
+    std::vector<float> scalar(size);
+    baseline.subtract(trace.data(), vector.data(), size);
+    baseline.subtract_scalar(trace.data(), scalar.data(), size);
+    HOST_CHECK(largest_difference(vector, scalar) < 1e-4);
+    HOST_CHECK(std::fabs(scalar[500] - 5) < 1e-3);
+    HOST_CHECK(std::fabs(scalar[100]) < 1e-3);
+
+    // in place
+    baseline.subtract(trace.data(), trace.data(), size);
+    HOST_CHECK(largest_difference(trace, scalar) < 1e-4);
+
+    bool thrown = false;
+    try {
+        Baseline::fit(trace.data(), size, {{0, 1}}, 1);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    HOST_CHECK(thrown);
+}
+
+// the prominence the long way, out from the peak on each side until the trace is higher
+static float walked_prominence(const std::vector<float> &trace, size_t index, bool negative) {
+    float sign = negative ? -1 : 1;
+    float height = sign * trace[index];
+    float left = height;
+    for (size_t i = index; i-- > 0 && sign * trace[i] <= height; ) {
+        left = std::min(left, sign * trace[i]);
+    }
+    float right = height;
+    for (size_t i = index + 1; i < trace.size() && sign * trace[i] <= height; i++) {
+        right = std::min(right, sign * trace[i]);
+    }
+    return height - std::max(left, right);
+}
+
+static void test_peaks() {
+    const size_t size = 1000;
+    // on a flat baseline the width at half height of a gaussian is 2.355 sigma, the
+    // float rounding of the tails makes steps in the trace that are peaks with no height
+    std::vector<float> trace = gaussian_on_slope(size, 400, 5, 20, 0);
+    PeakOptions options;
+    options.min_prominence = 0.01f;
+    std::vector<Peak> peaks = find_peaks(trace.data(), size, options);
+    HOST_CHECK(peaks.size() == 1);
+    if (peaks.size() == 1) {
+        HOST_CHECK(peaks[0].index == 400);
+        HOST_CHECK(std::fabs(peaks[0].prominence - 5) < 1e-4);
+        HOST_CHECK(std::fabs(peaks[0].width - 2.3548f * 20) < 0.2);
+    }
+    // the slope moves the top a bit, the prominence is from the higher of the 2 bases
+    trace = gaussian_on_slope(size, 400, 5, 20);
+    peaks = find_peaks(trace.data(), size, options);
+    HOST_CHECK(peaks.size() == 1);
+    if (peaks.size() == 1) {
+        HOST_CHECK((peaks[0].index >= 395) && (peaks[0].index <= 400));
+        HOST_CHECK(peaks[0].right_base == size - 1);
+        HOST_CHECK(peaks[0].prominence == peaks[0].height - trace[peaks[0].left_base]);
+    }
+
+    // 2 peaks closer than the distance, only the higher one is kept
+    std::vector<float> two = gaussian_on_slope(size, 400, 5, 10);
+    std::vector<float> second = gaussian_on_slope(size, 460, 2, 10);
+    for (size_t i = 0; i < size; i++) {
+        two[i] += second[i] - (float)(3.0 - 0.01*i);
+    }
+    HOST_CHECK(find_peaks(two.data(), size, options).size() == 2);
+    options.min_distance = 100;
+    peaks = find_peaks(two.data(), size, options);
+    HOST_CHECK((peaks.size() == 1) && (peaks[0].index / 10 == 40));
+    options.min_distance = 1;
+    options.min_prominence = 3;  // the lower peak is on the side of the higher one
+    peaks = find_peaks(two.data(), size, options);
+    HOST_CHECK((peaks.size() == 1) && (peaks[0].index / 10 == 40));
+
+    // a dip
+    for (auto &value : trace) {
+        value = -value;
+    }
+    options.min_prominence = 0.01f;
+    options.negative = true;
+    peaks = find_peaks(trace.data(), size, options);
+    HOST_CHECK((peaks.size() == 1) && (peaks[0].height > 0));
+
+    // the vector search finds the same peaks on noise, which has a lot of them
+    std::mt19937 random(2);
+    std::normal_distribution<float> noise(0, 1);
+    std::vector<float> noisy(size + 5);
+    for (auto &value : noisy) {
+        value = noise(random);
+    }
+    for (bool negative : {false, true}) {
+        options = PeakOptions();
+        options.negative = negative;
+        options.min_height = 0.5f;
+        options.min_distance = 3;
+        std::vector<Peak> vector = find_peaks(noisy.data(), noisy.size(), options);
+        std::vector<Peak> scalar = find_peaks_scalar(noisy.data(), noisy.size(), options);
+        HOST_CHECK(vector.size() == scalar.size());
+        HOST_CHECK(vector.size() > 50);
+        for (size_t i = 0; i < std::min(vector.size(), scalar.size()); i++) {
+            HOST_CHECK(vector[i].index == scalar[i].index);
+            HOST_CHECK(vector[i].width == scalar[i].width);
+            HOST_CHECK(vector[i].prominence == walked_prominence(noisy, vector[i].index, negative));
+        }
+    }
+}
+
+int main() {
+    test_parse_channel();
+    test_parse_export();
+    test_calibration();
+    test_savitzky_golay();
+    test_baseline();
+    test_peaks();
+    return host_test_failures;
+}
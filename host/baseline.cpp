@@ -0,0 +1,121 @@
+/*******************************************************************************
+* File Name: baseline.cpp
+*
+* Description:
+*  Baseline fit and subtraction, see baseline.h
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include <cmath>
+#include <stdexcept>
+
+#include "baseline.h"
+#include "simd.h"
+
+namespace amperometry {
+
+Baseline Baseline::fit(const float *trace, size_t size, const std::vector<IndexRange> &ranges, int order) {
+    if ((order < 0) || (order > 3)) {
+        throw std::invalid_argument("baseline order has to be 0 to 3");
+    }
+    int terms = order + 1;
+    Baseline baseline;
+    baseline.center_ = (size - 1) / 2.0;
+    baseline.scale_ = (size > 1) ? (size - 1) / 2.0 : 1.0;
+    // normal equations in the scaled index, the sums are in double so long traces stay exact enough
+    double normal[4][5] = {};
+    size_t used = 0;
+    for (const IndexRange &range : ranges) {
+        if ((range.first > range.end) || (range.end > size)) {
+            throw std::invalid_argument("baseline range is outside of the trace");
+        }
+        for (size_t i = range.first; i < range.end; i++) {
+            double x = (i - baseline.center_) / baseline.scale_;
+            double power[7] = {1};
+            for (int j = 1; j < 2*terms - 1; j++) {
+                power[j] = power[j - 1] * x;
+            }
+            for (int row = 0; row < terms; row++) {
+                for (int col = 0; col < terms; col++) {
+                    normal[row][col] += power[row + col];
+                }
+                normal[row][terms] += power[row] * trace[i];
+            }
+            used++;
+        }
+    }
+    if (used < (size_t)terms) {
+        throw std::invalid_argument("too few baseline points for the order");
+    }
+    for (int col = 0; col < terms; col++) {
+        int pivot = col;
+        for (int row = col + 1; row < terms; row++) {
+            if (std::fabs(normal[row][col]) > std::fabs(normal[pivot][col])) {
+                pivot = row;
+            }
+        }
+        for (int j = 0; j <= terms; j++) {
+            std::swap(normal[col][j], normal[pivot][j]);
+        }
+        if (normal[col][col] == 0) {
+            throw std::invalid_argument("baseline points do not fix the polynomial");
+        }
+        for (int row = 0; row < terms; row++) {
+            if (row == col) {
+                continue;
+            }
+            double factor = normal[row][col] / normal[col][col];
+            for (int j = 0; j <= terms; j++) {
+                normal[row][j] -= factor * normal[col][j];
+            }
+        }
+    }
+    baseline.coefficients_.resize(terms);
+    for (int row = 0; row < terms; row++) {
+        baseline.coefficients_[row] = normal[row][terms] / normal[row][row];
+    }
+    return baseline;
+}
+
+double Baseline::value(size_t index) const {
+    double x = (index - center_) / scale_;
+    double sum = 0;
+    for (size_t j = coefficients_.size(); j-- > 0; ) {
+        sum = sum * x + coefficients_[j];
+    }
+    return sum;
+}
+
+__attribute__((optimize("no-tree-vectorize")))
+void Baseline::subtract_scalar(const float *in, float *out, size_t size) const {
+    for (size_t i = 0; i < size; i++) {
+        out[i] = in[i] - (float)value(i);
+    }
+}
+
+void Baseline::subtract(const float *in, float *out, size_t size) const {
+    // Horner in float on 8 indexes at a time, the scaled index is -1 to 1 so float is close enough
+    float coefficients[4] = {};
+    for (size_t j = 0; j < coefficients_.size(); j++) {
+        coefficients[j] = (float)coefficients_[j];
+    }
+    const int top = (int)coefficients_.size() - 1;
+    const float step = (float)(1.0 / scale_);
+    size_t i = 0;
+    for (; i + simd::kLanes <= size; i += simd::kLanes) {
+        simd::Floats x = (simd::iota(0) + (float)((double)i - center_)) * step;
+        simd::Floats sum = simd::splat(coefficients[top]);
+        for (int j = top - 1; j >= 0; j--) {
+            sum = sum * x + coefficients[j];
+        }
+        simd::store(out + i, simd::load(in + i) - sum);
+    }
+    for (; i < size; i++) {
+        out[i] = in[i] - (float)value(i);
+    }
+}
+
+}  // namespace amperometry
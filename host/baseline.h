@@ -0,0 +1,47 @@
+/*******************************************************************************
+* File Name: baseline.h
+*
+* Description:
+*  Baseline subtraction.  A polynomial is fitted by least squares to the
+*  parts of the trace that only have background current (i.e. before and
+*  after a peak) and taken off the whole trace
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace amperometry {
+
+struct IndexRange {
+    size_t first;
+    size_t end;  // one past the last point
+};
+
+class Baseline {
+public:
+    // fit a polynomial of order 0 to 3 to the points in the ranges, throws if there are too few points
+    static Baseline fit(const float *trace, size_t size, const std::vector<IndexRange> &ranges, int order);
+
+    double value(size_t index) const;
+    const std::vector<double>& coefficients() const { return coefficients_; }
+
+    // out[i] = in[i] - value(i), in and out can be the same
+    void subtract(const float *in, float *out, size_t size) const;
+    void subtract_scalar(const float *in, float *out, size_t size) const;
+
+private:
+    Baseline() = default;
+
+    // the polynomial is in (index - center) / scale so the powers stay small for long traces
+    double center_ = 0;
+    double scale_ = 1;
+    std::vector<double> coefficients_;
+};
+
+}  // namespace amperometry
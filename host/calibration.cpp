@@ -0,0 +1,78 @@
+/*******************************************************************************
+* File Name: calibration.cpp
+*
+* Description:
+*  Calibration fit and the count to current conversion, see calibration.h
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include "calibration.h"
+#include "simd.h"
+
+namespace amperometry {
+
+std::optional<Calibration> Calibration::from_points(const int16_t points[2*kCalibrationPoints]) {
+    double current[kCalibrationPoints];
+    double mean_count = 0;
+    double mean_current = 0;
+    for (int i = 0; i < kCalibrationPoints; i++) {
+        current[i] = kIdacFemtoampsPerBit * points[i];
+        if (i < 2) {  // the first 2 points sink current
+            current[i] = -current[i];
+        }
+        mean_count += points[i + kCalibrationPoints];
+        mean_current += current[i];
+    }
+    mean_count /= kCalibrationPoints;
+    mean_current /= kCalibrationPoints;
+    double covariance = 0;
+    double variance = 0;
+    for (int i = 0; i < kCalibrationPoints; i++) {
+        double count_offset = points[i + kCalibrationPoints] - mean_count;
+        covariance += count_offset * (current[i] - mean_current);
+        variance += count_offset * count_offset;
+    }
+    if (variance == 0) {
+        return std::nullopt;
+    }
+    Calibration calibration;
+    calibration.nanoamps_per_count = covariance / variance * 1e-6;
+    calibration.zero_count = points[2 + kCalibrationPoints];  // the reading with the IDAC at 0
+    return calibration;
+}
+
+std::optional<Calibration> Calibration::from_format(const ExportFormat &format) {
+    if (!format.calibrated || (format.femtoamps_per_count == 0)) {
+        return std::nullopt;
+    }
+    Calibration calibration;
+    calibration.nanoamps_per_count = format.femtoamps_per_count * 1e-6;
+    calibration.zero_count = format.zero_count;
+    return calibration;
+}
+
+__attribute__((optimize("no-tree-vectorize")))
+void counts_to_nanoamps_scalar(const CountView &counts, const Calibration &calibration, float *out) {
+    for (size_t i = 0; i < counts.size(); i++) {
+        out[i] = (float)calibration.nanoamps(counts[i]);
+    }
+}
+
+void counts_to_nanoamps(const CountView &counts, const Calibration &calibration, float *out) {
+    const float scale = (float)calibration.nanoamps_per_count;
+    const simd::Floats offset = simd::splat((float)calibration.zero_count);
+    const uint8_t *bytes = counts.bytes();
+    size_t i = 0;
+    for (; i + simd::kLanes <= counts.size(); i += simd::kLanes) {
+        simd::Floats value = simd::load_counts(bytes + i*counts.stride(), counts.pairs());
+        simd::store(out + i, (value - offset) * scale);
+    }
+    for (; i < counts.size(); i++) {
+        out[i] = (float)calibration.nanoamps(counts[i]);
+    }
+}
+
+}  // namespace amperometry
@@ -0,0 +1,40 @@
+/*******************************************************************************
+* File Name: calibration.h
+*
+* Description:
+*  Change adc counts into current.  The fit is the same least squares line
+*  through the 5 calibration points as calibrate_GetFit in the firmware, so a
+*  recording of calibrate_array gives the fit the ExportFormat would have
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+#include "device_records.h"
+#include "export_parse.h"
+
+namespace amperometry {
+
+struct Calibration {
+    double nanoamps_per_count = 0;
+    double zero_count = 0;
+
+    double nanoamps(int16_t count) const { return nanoamps_per_count * (count - zero_count); }
+
+    // calibrate_array as the 'C' command sends it, nullopt if the adc did not see the IDAC
+    static std::optional<Calibration> from_points(const int16_t points[2*kCalibrationPoints]);
+    // the fit the firmware made, nullopt if the format says the calibration is not for the gain used
+    static std::optional<Calibration> from_format(const ExportFormat &format);
+};
+
+// out gets counts.size() currents in nA
+void counts_to_nanoamps(const CountView &counts, const Calibration &calibration, float *out);
+void counts_to_nanoamps_scalar(const CountView &counts, const Calibration &calibration, float *out);
+
+}  // namespace amperometry
@@ -0,0 +1,85 @@
+/*******************************************************************************
+* File Name: crc32c.cpp
+*
+* Description:
+*  CRC-32C, see crc32c.h
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include <cstring>
+
+#include "crc32c.h"
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+namespace amperometry {
+
+namespace {
+
+const uint32_t kPolynomial = 0x82F63B78;  // reflected Castagnoli
+
+struct Table {
+    uint32_t entries[256];
+
+    Table() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc >> 1) ^ ((crc & 1) ? kPolynomial : 0);
+            }
+            entries[i] = crc;
+        }
+    }
+};
+
+const Table table;
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+uint32_t crc32c_instruction(const uint8_t *bytes, size_t size, uint32_t crc) {
+    uint64_t crc64 = ~crc;
+    for (; size >= 8; bytes += 8, size -= 8) {
+        uint64_t word;
+        std::memcpy(&word, bytes, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    uint32_t crc32 = (uint32_t)crc64;
+    for (; size > 0; bytes++, size--) {
+        crc32 = _mm_crc32_u8(crc32, *bytes);
+    }
+    return ~crc32;
+}
+
+// this runs with the static constructors, which can be before the compiler's own cpu check
+const bool has_instruction = [] {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2") != 0;
+}();
+#endif
+
+}  // namespace
+
+uint32_t crc32c_scalar(const void *data, size_t size, uint32_t crc) {
+    const uint8_t *bytes = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc = (crc >> 8) ^ table.entries[(crc ^ bytes[i]) & 0xFF];
+    }
+    return ~crc;
+}
+
+uint32_t crc32c(const void *data, size_t size, uint32_t crc) {
+#if defined(__x86_64__)
+    if (has_instruction) {
+        return crc32c_instruction(static_cast<const uint8_t*>(data), size, crc);
+    }
+#endif
+    return crc32c_scalar(data, size, crc);
+}
+
+}  // namespace amperometry
@@ -0,0 +1,25 @@
+/*******************************************************************************
+* File Name: crc32c.h
+*
+* Description:
+*  CRC-32C (Castagnoli) of the recording blocks and index entries.  The x86
+*  crc32 instruction is used when the processor has it, which checks the
+*  data about as fast as it can be written to a disk
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace amperometry {
+
+// crc of size bytes carried on from crc, start with 0
+uint32_t crc32c(const void *data, size_t size, uint32_t crc = 0);
+uint32_t crc32c_scalar(const void *data, size_t size, uint32_t crc = 0);
+
+}  // namespace amperometry
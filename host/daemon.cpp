@@ -0,0 +1,659 @@
+/*******************************************************************************
+* File Name: daemon.cpp
+*
+* Description:
+*  The event loop, workers and sink of the daemon, see daemon.h
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include "daemon.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <optional>
+#include <semaphore>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "calibration.h"
+#include "device_stream.h"
+#include "recording.h"
+#include "spsc_queue.h"
+
+namespace amperometry {
+
+namespace {
+
+constexpr size_t kChunkBytes = 16384;  // most read from a device at once
+constexpr int kReadsEachTurn = 4;  // then the other devices get a turn
+constexpr uint64_t kWakeTag = UINT64_MAX - 1;  // epoll data of the eventfds, the devices are their index
+constexpr uint64_t kStopTag = UINT64_MAX;
+constexpr int64_t kStopWaitNs = 2000000000;  // for the devices to send the rest and close after 'X'
+
+struct Chunk {
+    size_t size;
+    uint8_t bytes[kChunkBytes];
+};
+
+struct SinkItem {
+    int device;
+    bool header;  // start the device's recording, else append the points
+    RecordingHeader recording_header;
+    int64_t time_ns;  // of the first point, from the start of the run
+    int64_t taken_ns;  // CLOCK_MONOTONIC when the first point was taken
+    uint32_t points;
+    bool pairs;
+    uint8_t tia_resistor;
+    uint8_t adc_buffer;
+    std::vector<uint8_t> bytes;
+};
+
+int64_t clock_ns(clockid_t clock) {
+    struct timespec now;
+    clock_gettime(clock, &now);
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+[[noreturn]] void throw_errno(const std::string &what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+// a command in a 64 byte packet like the OUT endpoint takes
+void send_command(int fd, const std::string &command) {
+    uint8_t packet[kUsbPacketSize] = {};
+    std::memcpy(packet, command.data(), std::min(command.size(), sizeof(packet)));
+    size_t sent = 0;
+    while (sent < sizeof(packet)) {
+        ssize_t result = send(fd, packet + sent, sizeof(packet) - sent, MSG_NOSIGNAL);
+        if (result >= 0) {
+            sent += result;
+        }
+        else if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+            struct pollfd output = {fd, POLLOUT, 0};
+            poll(&output, 1, 100);
+        }
+        else if (errno != EINTR) {
+            throw_errno("sending " + command);
+        }
+    }
+}
+
+void write_eventfd(int fd) {
+    uint64_t one = 1;
+    ssize_t result = write(fd, &one, sizeof(one));
+    (void)result;  // a full counter is still a wake up
+}
+
+}  // namespace
+
+std::string describe_stats(const DaemonOptions &options, const DaemonStats &stats) {
+    char text[1024];
+    int size = std::snprintf(text, sizeof(text),
+        "devices  %d at %.1f kHz for %.2f s\n"
+        "points   %llu of %llu expected: %.3f M samples/s, %llu lost, %llu device errors, %llu bad bytes\n"
+        "disk     %.1f MB in %llu group commits, %llu reads paused, mean %.1f nA\n"
+        "latency  %.0f us p50, %.0f us p99, %.0f us p99.9, %.0f us max (%s)\n",
+        options.devices, 1e6 / options.sample_period_ns, stats.seconds,
+        (unsigned long long)stats.points, (unsigned long long)stats.expected_points,
+        (stats.seconds > 0) ? stats.points / stats.seconds / 1e6 : 0.0, (unsigned long long)stats.lost_points,
+        (unsigned long long)stats.device_errors, (unsigned long long)stats.bad_bytes,
+        stats.bytes_written / 1e6, (unsigned long long)stats.commits, (unsigned long long)stats.pauses,
+        stats.mean_nanoamps, stats.latency_p50_us, stats.latency_p99_us, stats.latency_p999_us,
+        stats.latency_max_us, options.directory.empty() ? "taken to the sink" : "taken to committed");
+    std::string description(text, std::min<size_t>(size, sizeof(text) - 1));
+    if (!stats.first_error.empty()) {
+        description += "error    " + stats.first_error + "\n";
+    }
+    return description;
+}
+
+struct Daemon::Device {
+    explicit Device(size_t queue_chunks) : queue(queue_chunks) {}
+
+    int index = 0;
+    pid_t pid = -1;
+    int fd = -1;
+    SpscQueue<Chunk> queue;  // event loop to worker
+    std::atomic<bool> paused{false};  // not read until the worker makes room
+    std::atomic<bool> closed{false};  // the device closed its end, nothing more goes in the queue
+    int64_t fire_ns = 0;  // CLOCK_MONOTONIC when 'M' was sent
+    int64_t fire_realtime_ns = 0;
+    int64_t stop_ns = 0;  // when 'X' was sent
+
+    // used by the worker only
+    DeviceStream stream;
+    std::optional<DeviceHeader> header;
+    std::optional<ExportFormat> format;
+    std::optional<Calibration> calibration;
+    std::vector<SinkItem> early;  // points that came before the header
+    uint64_t next_sequence = 0;
+};
+
+struct Daemon::Worker {
+    std::thread thread;
+    std::counting_semaphore<> ready{0};  // a chunk was queued or a device closed
+    std::vector<Device*> devices;
+    std::vector<float> nanoamps;
+    uint64_t points = 0;
+    uint64_t lost_points = 0;
+    uint64_t device_errors = 0;
+    double nanoamp_sum = 0;
+    std::string first_error;
+};
+
+struct Daemon::Sink {
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::vector<SinkItem> items;
+    bool done = false;  // the workers have finished, nothing more comes
+
+    std::vector<std::optional<RecordingWriter>> writers;
+    std::vector<double> latencies_us;
+    uint64_t bytes_written = 0;
+    uint64_t commits = 0;
+    std::string first_error;
+
+    void push(SinkItem &&item, size_t limit) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_full.wait(lock, [&] { return items.size() < limit; });
+        items.push_back(std::move(item));
+        not_empty.notify_one();
+    }
+};
+
+Daemon::Daemon(const DaemonOptions &options) : options_(options), sink_(std::make_unique<Sink>()) {
+    if ((options_.devices <= 0) || (options_.block_points == 0) || (options_.push_points == 0) ||
+        (options_.sample_period_ns == 0)) {
+        throw std::invalid_argument("the daemon needs devices, a block size, a push size and a sample period");
+    }
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    stop_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if ((epoll_fd_ < 0) || (wake_fd_ < 0) || (stop_fd_ < 0)) {
+        throw_errno("making the event loop");
+    }
+    for (int i = 0; i < options_.devices; i++) {
+        auto device = std::make_unique<Device>(options_.queue_chunks);
+        device->index = i;
+        int ends[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, ends) < 0) {
+            throw_errno("making the socket of a device");
+        }
+        // the device end is left open through the exec, it is the board's USB
+        std::string fd_arg = std::to_string(ends[1]);
+        std::string board_arg = std::to_string(i);
+        pid_t pid = fork();
+        if (pid < 0) {
+            close(ends[0]);
+            close(ends[1]);
+            throw_errno("starting " + options_.device_program);
+        }
+        if (pid == 0) {
+            fcntl(ends[1], F_SETFD, 0);
+            execl(options_.device_program.c_str(), options_.device_program.c_str(), fd_arg.c_str(),
+                  board_arg.c_str(), (char*)nullptr);
+            _exit(127);
+        }
+        close(ends[1]);
+        device->pid = pid;
+        device->fd = ends[0];
+        fcntl(device->fd, F_SETFL, fcntl(device->fd, F_GETFL) | O_NONBLOCK);
+        devices_.push_back(std::move(device));
+    }
+
+    int workers = options_.workers;
+    if (workers <= 0) {
+        workers = std::max(1u, std::thread::hardware_concurrency());
+    }
+    workers = std::min(workers, options_.devices);
+    for (int i = 0; i < workers; i++) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+    for (auto &device : devices_) {
+        workers_[device->index % workers]->devices.push_back(device.get());
+    }
+    sink_->writers.resize(devices_.size());
+}
+
+Daemon::~Daemon() {
+    for (auto &device : devices_) {
+        device->closed.store(true);  // so the workers finish if run did not
+        if (device->fd >= 0) {
+            close(device->fd);  // a device that is still running exits when it sees the socket close
+        }
+        if (device->pid > 0) {
+            waitpid(device->pid, nullptr, 0);
+        }
+    }
+    for (auto &worker : workers_) {
+        if (worker->thread.joinable()) {
+            worker->ready.release();
+            worker->thread.join();
+        }
+    }
+    if (sink_->thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(sink_->mutex);
+            sink_->done = true;
+        }
+        sink_->not_empty.notify_one();
+        sink_->thread.join();
+    }
+    for (int fd : {epoll_fd_, wake_fd_, stop_fd_}) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+void Daemon::stop() {
+    write_eventfd(stop_fd_);
+}
+
+DaemonStats Daemon::run(double seconds) {
+    sink_->thread = std::thread([this] { sink_loop(); });
+    for (auto &worker : workers_) {
+        worker->thread = std::thread([this, &worker] { worker_loop(*worker); });
+    }
+
+    char command[32];
+    for (auto &device : devices_) {
+        if (options_.adc_profile) {
+            std::snprintf(command, sizeof(command), "AP|%u", options_.adc_profile);
+            send_command(device->fd, command);
+        }
+        std::snprintf(command, sizeof(command), "HP|%010u", options_.sample_period_ns);
+        send_command(device->fd, command);
+        std::snprintf(command, sizeof(command), "UP|%04u", options_.push_points);
+        send_command(device->fd, command);
+    }
+    // the runs start as close together as they can, the header comes after so it has the sample period
+    std::snprintf(command, sizeof(command), "M|%04u|%04u", options_.dac_value, options_.block_points);
+    start_ns_ = clock_ns(CLOCK_MONOTONIC);
+    for (auto &device : devices_) {
+        device->fire_ns = clock_ns(CLOCK_MONOTONIC);
+        device->fire_realtime_ns = clock_ns(CLOCK_REALTIME);
+        send_command(device->fd, command);
+        send_command(device->fd, "UH");
+    }
+
+    event_loop(seconds);
+
+    for (auto &worker : workers_) {
+        worker->ready.release();
+        worker->thread.join();
+    }
+    {
+        std::lock_guard<std::mutex> lock(sink_->mutex);
+        sink_->done = true;
+    }
+    sink_->not_empty.notify_one();
+    sink_->thread.join();
+
+    DaemonStats stats;
+    int64_t last_stop = start_ns_;
+    for (auto &device : devices_) {
+        last_stop = std::max(last_stop, device->stop_ns);
+        stats.expected_points += (device->stop_ns - device->fire_ns) / options_.sample_period_ns;
+        stats.bad_bytes += device->stream.bad_bytes();
+    }
+    stats.seconds = (last_stop - start_ns_) * 1e-9;
+    for (auto &worker : workers_) {
+        stats.points += worker->points;
+        stats.lost_points += worker->lost_points;
+        stats.device_errors += worker->device_errors;
+        stats.mean_nanoamps += worker->nanoamp_sum;
+        if (stats.first_error.empty()) {
+            stats.first_error = worker->first_error;
+        }
+    }
+    if (stats.points) {
+        stats.mean_nanoamps /= stats.points;
+    }
+    if (stats.first_error.empty()) {
+        stats.first_error = sink_->first_error;
+    }
+    stats.pauses = pauses_;
+    stats.bytes_written = sink_->bytes_written;
+    stats.commits = sink_->commits;
+    std::vector<double> &latencies = sink_->latencies_us;
+    if (!latencies.empty()) {
+        std::sort(latencies.begin(), latencies.end());
+        stats.latency_p50_us = latencies[latencies.size() / 2];
+        stats.latency_p99_us = latencies[latencies.size() * 99 / 100];
+        stats.latency_p999_us = latencies[latencies.size() * 999 / 1000];
+        stats.latency_max_us = latencies.back();
+    }
+    return stats;
+}
+
+void Daemon::event_loop(double seconds) {
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    for (auto &device : devices_) {
+        event.data.u64 = device->index;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, device->fd, &event) < 0) {
+            throw_errno("adding a device to the event loop");
+        }
+    }
+    event.data.u64 = kWakeTag;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &event);
+    event.data.u64 = kStopTag;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, stop_fd_, &event);
+
+    int64_t deadline = start_ns_ + (int64_t)(seconds * 1e9);
+    bool stopping = false;
+    size_t open_devices = devices_.size();
+    struct epoll_event events[64];
+    while (open_devices) {
+        int64_t now = clock_ns(CLOCK_MONOTONIC);
+        if (!stopping && (now >= deadline)) {
+            stop_devices();
+            stopping = true;
+            deadline = now + kStopWaitNs;
+        }
+        else if (stopping && (now >= deadline)) {  // a device that does not close is cut off
+            break;
+        }
+        int timeout_ms = (int)std::min<int64_t>((deadline - now) / 1000000 + 1, 1000);
+        int ready = epoll_wait(epoll_fd_, events, 64, timeout_ms);
+        if ((ready < 0) && (errno != EINTR)) {
+            throw_errno("waiting for the devices");
+        }
+        for (int i = 0; i < ready; i++) {
+            uint64_t tag = events[i].data.u64;
+            if ((tag == kWakeTag) || (tag == kStopTag)) {
+                uint64_t count;
+                ssize_t result = read((tag == kWakeTag) ? wake_fd_ : stop_fd_, &count, sizeof(count));
+                (void)result;
+                if (tag == kWakeTag) {
+                    resume_devices();
+                }
+                else if (!stopping) {
+                    stop_devices();
+                    stopping = true;
+                    deadline = clock_ns(CLOCK_MONOTONIC) + kStopWaitNs;
+                }
+                continue;
+            }
+            Device &device = *devices_[tag];
+            read_device(device);
+            if (device.closed.load()) {
+                open_devices--;
+            }
+        }
+    }
+    for (auto &device : devices_) {
+        if (!device->closed.load()) {
+            epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, device->fd, nullptr);
+            device->closed.store(true);
+            workers_[device->index % workers_.size()]->ready.release();
+        }
+    }
+}
+
+void Daemon::read_device(Device &device) {
+    Worker &worker = *workers_[device.index % workers_.size()];
+    for (int turn = 0; turn < kReadsEachTurn; turn++) {
+        Chunk *chunk = device.queue.back();
+        if (!chunk) {  // the worker is behind, leave the data in the socket until it makes room
+            struct epoll_event event = {};
+            event.data.u64 = device.index;
+            epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, device.fd, &event);
+            device.paused.store(true);
+            pauses_++;
+            if (!device.queue.full()) {  // the worker made room before it could see the pause
+                resume_devices();
+            }
+            return;
+        }
+        ssize_t got = read(device.fd, chunk->bytes, kChunkBytes);
+        if (got > 0) {
+            chunk->size = got;
+            device.queue.push();
+            worker.ready.release();
+            if ((size_t)got < kChunkBytes) {
+                return;
+            }
+            continue;
+        }
+        if ((got < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+            return;
+        }
+        if ((got < 0) && (errno == EINTR)) {
+            continue;
+        }
+        // the device closed its end (or the socket broke), the worker finishes what is queued
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, device.fd, nullptr);
+        device.closed.store(true);
+        worker.ready.release();
+        return;
+    }
+}
+
+void Daemon::resume_devices() {
+    resume_pending_.store(false);
+    for (auto &device : devices_) {
+        if (device->paused.load() && !device->queue.full() && !device->closed.load()) {
+            device->paused.store(false);
+            struct epoll_event event = {};
+            event.events = EPOLLIN;
+            event.data.u64 = device->index;
+            epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, device->fd, &event);
+        }
+    }
+}
+
+void Daemon::stop_devices() {
+    // 'X' stops the run, the device pushes the rest of its data then sees the socket close and exits
+    for (auto &device : devices_) {
+        if (device->closed.load()) {
+            continue;
+        }
+        device->stop_ns = clock_ns(CLOCK_MONOTONIC);
+        try {
+            send_command(device->fd, "X");
+        } catch (const std::system_error&) {
+            // the device has gone, the read sees it
+        }
+        shutdown(device->fd, SHUT_WR);
+    }
+}
+
+void Daemon::worker_loop(Worker &worker) {
+    for (;;) {
+        worker.ready.acquire();
+        bool finished = true;
+        for (Device *device : worker.devices) {
+            bool closed = device->closed.load();  // before the queue, so every chunk pushed before it is seen
+            while (Chunk *chunk = device->queue.front()) {
+                device->stream.append(std::span<const uint8_t>(chunk->bytes, chunk->size));
+                device->queue.pop();
+                if (device->paused.load() && !resume_pending_.exchange(true)) {
+                    write_eventfd(wake_fd_);
+                }
+
+                DeviceRecord record;
+                while (device->stream.next(record)) {
+                    if (record.kind == RecordKind::kPoints) {
+                        const ExportBlock &block = record.export_block;
+                        uint32_t period = device->header ? device->header->sample_period_ns
+                                                         : options_.sample_period_ns;
+                        uint64_t first = block.first_sequence;
+                        CountView points = block.points;
+                        if (first + points.size() <= device->next_sequence) {  // sent again, already have it
+                            continue;
+                        }
+                        if (first < device->next_sequence) {
+                            points = points.subview(device->next_sequence - first, first + points.size() - device->next_sequence);
+                            first = device->next_sequence;
+                        }
+                        worker.lost_points += first - device->next_sequence;  // the ring went around before it was pushed
+                        device->next_sequence = first + points.size();
+                        worker.points += points.size();
+                        if (device->calibration) {
+                            worker.nanoamps.resize(std::max(worker.nanoamps.size(), points.size()));
+                            counts_to_nanoamps(points, *device->calibration, worker.nanoamps.data());
+                            for (size_t i = 0; i < points.size(); i++) {
+                                worker.nanoamp_sum += worker.nanoamps[i];
+                            }
+                        }
+                        SinkItem item{};
+                        item.device = device->index;
+                        item.time_ns = (int64_t)first * period;
+                        item.taken_ns = device->fire_ns + item.time_ns;
+                        item.points = points.size();
+                        item.pairs = points.pairs();
+                        item.bytes.assign(points.bytes(), points.bytes() + points.size() * points.stride());
+                        if (!device->header || !device->format) {
+                            device->early.push_back(std::move(item));
+                        }
+                        else {
+                            item.tia_resistor = device->header->tia_resistor;
+                            item.adc_buffer = device->header->adc_buffer;
+                            sink_->push(std::move(item), options_.sink_items);
+                        }
+                    }
+                    else if ((record.kind == RecordKind::kDeviceHeader) || (record.kind == RecordKind::kExportFormat)) {
+                        bool had_both = device->header && device->format;
+                        if (record.kind == RecordKind::kDeviceHeader) {
+                            device->header = record.device_header;
+                        }
+                        else {
+                            device->format = record.export_format;
+                            device->calibration = Calibration::from_format(record.export_format);
+                        }
+                        if (!had_both && device->header && device->format) {  // the recording can start
+                            SinkItem item{};
+                            item.device = device->index;
+                            item.header = true;
+                            item.recording_header = make_recording_header(*device->header, *device->format,
+                                                                          device->fire_realtime_ns);
+                            sink_->push(std::move(item), options_.sink_items);
+                            for (SinkItem &early : device->early) {  // taken with the period asked for, put right now
+                                uint64_t sequence = early.time_ns / options_.sample_period_ns;
+                                early.time_ns = (int64_t)sequence * device->header->sample_period_ns;
+                                early.taken_ns = device->fire_ns + early.time_ns;
+                                early.tia_resistor = device->header->tia_resistor;
+                                early.adc_buffer = device->header->adc_buffer;
+                                sink_->push(std::move(early), options_.sink_items);
+                            }
+                            device->early.clear();
+                        }
+                    }
+                    else if ((record.kind == RecordKind::kMessage) && record.text.starts_with("Error")) {
+                        worker.device_errors++;
+                        if (worker.first_error.empty()) {
+                            worker.first_error = "device " + std::to_string(device->index) + ": " +
+                                                 std::string(record.text);
+                        }
+                    }
+                }
+            }
+            finished = finished && closed && !device->queue.front();
+        }
+        if (finished) {
+            return;
+        }
+    }
+}
+
+void Daemon::sink_loop() {
+    Sink &sink = *sink_;
+    const auto interval = std::chrono::milliseconds(options_.commit_interval_ms);
+    auto next_commit = std::chrono::steady_clock::now() + interval;
+    std::vector<SinkItem> batch;
+    std::vector<int64_t> uncommitted;  // taken_ns of the pushes appended since the last commit
+    for (;;) {
+        bool done;
+        {
+            std::unique_lock<std::mutex> lock(sink.mutex);
+            sink.not_empty.wait_until(lock, next_commit, [&] { return !sink.items.empty() || sink.done; });
+            batch.swap(sink.items);
+            done = sink.done;
+        }
+        sink.not_full.notify_all();
+
+        for (SinkItem &item : batch) {
+            std::optional<RecordingWriter> &writer = sink.writers[item.device];
+            try {
+                if (item.header) {
+                    if (!options_.directory.empty()) {
+                        char name[64];
+                        std::snprintf(name, sizeof(name), "/%08x%08x_%lld.amprec", item.recording_header.unique_id[0],
+                                      item.recording_header.unique_id[1],
+                                      (long long)(item.recording_header.start_time_ns / 1000000000));
+                        writer = RecordingWriter::create(options_.directory + name, item.recording_header);
+                    }
+                    continue;
+                }
+                if (writer) {
+                    writer->append(item.time_ns, CountView(item.bytes.data(), item.points, item.pairs),
+                                   item.tia_resistor, item.adc_buffer);
+                    uncommitted.push_back(item.taken_ns);
+                }
+                else {
+                    sink.latencies_us.push_back((clock_ns(CLOCK_MONOTONIC) - item.taken_ns) * 1e-3);
+                }
+            } catch (const std::exception &error) {  // the device is not recorded from here on
+                if (sink.first_error.empty()) {
+                    sink.first_error = "recording device " + std::to_string(item.device) + ": " + error.what();
+                }
+                writer.reset();
+            }
+        }
+        batch.clear();
+
+        if (done || (std::chrono::steady_clock::now() >= next_commit)) {  // 1 sync of all of the recordings
+            for (std::optional<RecordingWriter> &writer : sink.writers) {
+                if (writer) {
+                    try {
+                        writer->commit();
+                    } catch (const std::exception &error) {
+                        if (sink.first_error.empty()) {
+                            sink.first_error = std::string("committing: ") + error.what();
+                        }
+                        writer.reset();
+                    }
+                }
+            }
+            int64_t committed = clock_ns(CLOCK_MONOTONIC);
+            for (int64_t taken : uncommitted) {
+                sink.latencies_us.push_back((committed - taken) * 1e-3);
+            }
+            uncommitted.clear();
+            sink.commits++;
+            next_commit = std::chrono::steady_clock::now() + interval;
+        }
+        if (done) {
+            break;
+        }
+    }
+    for (std::optional<RecordingWriter> &writer : sink.writers) {
+        if (writer) {
+            sink.bytes_written += writer->bytes();
+        }
+    }
+}
+
+}  // namespace amperometry
@@ -0,0 +1,117 @@
+/*******************************************************************************
+* File Name: daemon.h
+*
+* Description:
+*  The computer side of many devices running amperometry at once.  Each
+*  device pushes its data ('UP' command) and the daemon gets it onto the disk:
+*
+*  event loop   1 thread waits on all of the devices with epoll and reads
+*               what they send into a bounded queue for each device.  When a
+*               queue is full the device is not read until a worker has made
+*               room, so a slow disk holds up the device (whose ring then
+*               writes over the oldest block, which shows as lost points)
+*               instead of the daemon's memory growing
+*  workers      a pool of threads, each with its own devices, split the bytes
+*               into records, check no points are missing and change the
+*               counts into current with the device's calibration
+*  sink         1 thread owns the recordings (recording.h), it appends the
+*               blocks as they come and commits them all together every
+*               commit interval so the disk syncs do not grow with the devices
+*
+*  The devices are sim_device programs (sim/sim_device.c) on the other end of
+*  a socket, a board on the USB would be read the same way
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace amperometry {
+
+struct DaemonOptions {
+    std::string device_program;  // the sim_device program
+    int devices = 32;
+    int workers = 0;  // 0 for 1 for each cpu
+    uint32_t sample_period_ns = 100000;  // 'HP' command
+    uint8_t adc_profile = 0;  // 'AP' command, ADC_PROFILE_FAST to go over 12.5 kHz
+    uint16_t dac_value = 2100;
+    uint16_t block_points = 1000;  // 'M' command, points in each ADC_array block
+    uint16_t push_points = 100;  // 'UP' command
+    size_t queue_chunks = 64;  // reads that can wait for a worker, for each device
+    size_t sink_items = 4096;  // pushes that can wait for the sink, for all the devices
+    std::string directory;  // where the recordings go, empty to not record
+    uint32_t commit_interval_ms = 100;
+};
+
+struct DaemonStats {
+    double seconds = 0;  // from the first 'M' to the last 'X'
+    uint64_t points = 0;  // received from all the devices
+    uint64_t expected_points = 0;  // the devices should have taken in the time
+    uint64_t lost_points = 0;  // missing from the sequence numbers
+    uint64_t device_errors = 0;  // "Error ..." messages
+    uint64_t bad_bytes = 0;  // that were not in a record
+    uint64_t pauses = 0;  // times a device was not read because its queue was full
+    uint64_t bytes_written = 0;  // to the recordings
+    uint64_t commits = 0;
+    double mean_nanoamps = 0;  // of all the points
+    /* from when the first point of a push was taken until it was committed
+       (or handed to the sink if nothing is recorded), in us */
+    double latency_p50_us = 0;
+    double latency_p99_us = 0;
+    double latency_p999_us = 0;
+    double latency_max_us = 0;
+    std::string first_error;
+};
+
+// the stats as lines of text
+std::string describe_stats(const DaemonOptions &options, const DaemonStats &stats);
+
+class Daemon {
+public:
+    // starts the device programs, throws std::system_error if it can not
+    explicit Daemon(const DaemonOptions &options);
+    Daemon(const Daemon&) = delete;
+    Daemon& operator=(const Daemon&) = delete;
+    ~Daemon();
+
+    /* starts the runs and does the event loop on this thread for the seconds
+       or until stop, then stops the devices and returns after everything they
+       sent is committed */
+    DaemonStats run(double seconds);
+    // can be called from a signal handler
+    void stop();
+
+private:
+    struct Device;
+    struct Worker;
+    struct Sink;
+
+    void event_loop(double seconds);
+    void read_device(Device &device);
+    void resume_devices();
+    void stop_devices();
+    void worker_loop(Worker &worker);
+    void sink_loop();
+
+    DaemonOptions options_;
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;  // eventfd, a worker made room in a full queue
+    int stop_fd_ = -1;  // eventfd, stop was called
+    std::vector<std::unique_ptr<Device>> devices_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::unique_ptr<Sink> sink_;
+    std::atomic<bool> resume_pending_{false};  // a worker has written wake_fd_ and the loop has not looked yet
+    uint64_t pauses_ = 0;
+    int64_t start_ns_ = 0;  // CLOCK_MONOTONIC when the first 'M' was sent
+};
+
+}  // namespace amperometry
@@ -0,0 +1,95 @@
+/*******************************************************************************
+* File Name: daemon_bench.cpp
+*
+* Description:
+*  Load test of the daemon with many simulated devices pushing at once.  It
+*  reports the samples per second of all the devices together and the tail
+*  of the time from a point being taken to it being committed to the disk,
+*  and fails if a point was lost or the devices could not keep up
+*
+*  daemon_bench SIM_DEVICE [--devices N] [--seconds S] [--period-ns P]
+*               [--workers N] [--dir DIRECTORY] [--keep] [--quick]
+*
+*  The default is 64 devices at 10 kHz for 10 s, --quick (what ctest runs)
+*  is 32 devices for 3 s.  The recordings go in a new directory in the
+*  directory it is run in and are removed after unless --keep
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <string>
+
+#include <unistd.h>
+
+#include "daemon.h"
+
+using namespace amperometry;
+
+int main(int argc, char **argv) {
+    DaemonOptions options;
+    options.devices = 64;
+    double seconds = 10;
+    std::string directory = ".";
+    bool keep = false;
+    for (int i = 1; i < argc; i++) {
+        bool has_value = (i + 1 < argc);
+        if ((std::strcmp(argv[i], "--devices") == 0) && has_value) {
+            options.devices = std::atoi(argv[++i]);
+        }
+        else if ((std::strcmp(argv[i], "--seconds") == 0) && has_value) {
+            seconds = std::atof(argv[++i]);
+        }
+        else if ((std::strcmp(argv[i], "--period-ns") == 0) && has_value) {
+            options.sample_period_ns = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if ((std::strcmp(argv[i], "--workers") == 0) && has_value) {
+            options.workers = std::atoi(argv[++i]);
+        }
+        else if ((std::strcmp(argv[i], "--dir") == 0) && has_value) {
+            directory = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--keep") == 0) {
+            keep = true;
+        }
+        else if (std::strcmp(argv[i], "--quick") == 0) {
+            options.devices = 32;
+            seconds = 3;
+        }
+        else if ((argv[i][0] != '-') && options.device_program.empty()) {
+            options.device_program = argv[i];
+        }
+        else {
+            options.device_program.clear();
+            break;
+        }
+    }
+    if (options.device_program.empty()) {
+        std::fprintf(stderr, "usage: %s SIM_DEVICE [--devices N] [--seconds S] [--period-ns P] [--workers N]"
+                     " [--dir DIRECTORY] [--keep] [--quick]\n", argv[0]);
+        return 2;
+    }
+    options.directory = directory + "/daemon_bench_" + std::to_string(getpid());
+    std::filesystem::create_directories(options.directory);
+
+    DaemonStats stats;
+    try {
+        Daemon daemon(options);
+        stats = daemon.run(seconds);
+    } catch (const std::exception &error) {
+        std::fprintf(stderr, "daemon_bench: %s\n", error.what());
+        return 1;
+    }
+    std::fputs(describe_stats(options, stats).c_str(), stdout);
+    if (!keep) {
+        std::filesystem::remove_all(options.directory);
+    }
+    bool kept_up = stats.points >= stats.expected_points * 95 / 100;
+    return (!stats.lost_points && !stats.device_errors && stats.first_error.empty() && kept_up) ? 0 : 1;
+}
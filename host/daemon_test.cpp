@@ -0,0 +1,213 @@
+/*******************************************************************************
+* File Name: daemon_test.cpp
+*
+* Description:
+*  Checks the parts of the daemon: the records are found in the bytes a device
+*  sends however they are split up, the queue hands everything over in order
+*  between 2 threads, and a few simulated devices are recorded with every
+*  point they took
+*
+*  daemon_test SIM_DEVICE
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "daemon.h"
+#include "device_stream.h"
+#include "host_test.h"
+#include "recording.h"
+#include "spsc_queue.h"
+
+using namespace amperometry;
+
+static void add_bytes(std::vector<uint8_t> &stream, const void *bytes, size_t size) {
+    const uint8_t *start = static_cast<const uint8_t*>(bytes);
+    stream.insert(stream.end(), start, start + size);
+}
+
+// what a device sends while it pushes: replies, the headers, exports and the isr messages
+static std::vector<uint8_t> test_stream() {
+    std::vector<uint8_t> stream;
+    add_bytes(stream, "UP|0100", 8);
+    DeviceHeader device{};
+    std::memcpy(device.tag, "DH", 2);
+    device.sample_period_ns = 100000;
+    add_bytes(stream, &device, sizeof(device));
+    ExportFormat format{};
+    std::memcpy(format.tag, "XF", 2);
+    format.zero_count = 7;
+    add_bytes(stream, &format, sizeof(format));
+    for (uint32_t push = 0; push < 3; push++) {
+        ExportHeader header{{'E', 'S'}, 100, push * 100};
+        add_bytes(stream, &header, sizeof(header));
+        for (int16_t i = 0; i < 100; i++) {
+            int16_t count = (int16_t)(push * 100 + i);
+            add_bytes(stream, &count, sizeof(count));
+        }
+        add_bytes(stream, "Done0", 6);
+    }
+    uint8_t stats[kBlockStatsBytes] = {'B', 'S'};
+    add_bytes(stream, stats, sizeof(stats));
+    add_bytes(stream, "Error ADC Rate", 15);
+    return stream;
+}
+
+struct Seen {
+    int points = 0;
+    int messages = 0;
+    int headers = 0;
+    int block_stats = 0;
+    bool in_order = true;
+    std::string last_message;
+};
+
+static void read_records(DeviceStream &stream, Seen &seen) {
+    DeviceRecord record;
+    while (stream.next(record)) {
+        if (record.kind == RecordKind::kPoints) {
+            for (size_t i = 0; i < record.export_block.points.size(); i++) {
+                seen.in_order = seen.in_order && (record.export_block.points[i] == seen.points);
+                seen.points++;
+            }
+        }
+        else if (record.kind == RecordKind::kMessage) {
+            seen.messages++;
+            seen.last_message = std::string(record.text);
+        }
+        else if (record.kind == RecordKind::kDeviceHeader) {
+            seen.headers += (record.device_header.sample_period_ns == 100000);
+        }
+        else if (record.kind == RecordKind::kExportFormat) {
+            seen.headers += (record.export_format.zero_count == 7);
+        }
+        else {
+            seen.block_stats++;
+        }
+    }
+}
+
+static void test_stream_pieces() {
+    std::vector<uint8_t> bytes = test_stream();
+    for (size_t piece : {(size_t)1, (size_t)3, (size_t)64, bytes.size()}) {
+        DeviceStream stream;
+        Seen seen;
+        for (size_t start = 0; start < bytes.size(); start += piece) {
+            stream.append(std::span<const uint8_t>(bytes.data() + start, std::min(piece, bytes.size() - start)));
+            read_records(stream, seen);
+        }
+        HOST_CHECK(seen.points == 300);
+        HOST_CHECK(seen.in_order);
+        HOST_CHECK(seen.messages == 5);
+        HOST_CHECK(seen.headers == 2);
+        HOST_CHECK(seen.block_stats == 1);
+        HOST_CHECK(seen.last_message == "Error ADC Rate");
+        HOST_CHECK(stream.buffered() == 0);
+        HOST_CHECK(stream.bad_bytes() == 0);
+    }
+
+    // bytes that are not a record are skipped up to the next one
+    DeviceStream stream;
+    Seen seen;
+    std::vector<uint8_t> junk = {0x01, 0xFF, 0x00, 0x80};
+    stream.append(junk);
+    stream.append(bytes);
+    read_records(stream, seen);
+    HOST_CHECK(seen.points == 300);
+    HOST_CHECK(stream.bad_bytes() == junk.size());
+}
+
+static void test_queue() {
+    SpscQueue<uint64_t> queue(5);
+    HOST_CHECK(queue.capacity() == 8);
+    const uint64_t items = 1000000;
+    std::thread producer([&] {
+        for (uint64_t i = 0; i < items; i++) {
+            uint64_t *slot;
+            while (!(slot = queue.back())) {
+                std::this_thread::yield();
+            }
+            *slot = i;
+            queue.push();
+        }
+    });
+    bool in_order = true;
+    for (uint64_t i = 0; i < items; i++) {
+        uint64_t *slot;
+        while (!(slot = queue.front())) {
+            std::this_thread::yield();
+        }
+        in_order = in_order && (*slot == i);
+        queue.pop();
+    }
+    producer.join();
+    HOST_CHECK(in_order);
+    HOST_CHECK(queue.size() == 0);
+}
+
+static void test_daemon(const char *program) {
+    DaemonOptions options;
+    options.device_program = program;
+    options.devices = 3;
+    options.workers = 2;
+    options.queue_chunks = 2;  // small so the reads have to wait for the workers
+    options.block_points = 500;
+    options.push_points = 50;
+    options.directory = (std::filesystem::temp_directory_path() / ("daemon_test_" + std::to_string(getpid())));
+    std::filesystem::create_directories(options.directory);
+    DaemonStats stats;
+    {
+        Daemon daemon(options);
+        stats = daemon.run(0.5);
+    }
+    HOST_CHECK(stats.lost_points == 0);
+    HOST_CHECK(stats.device_errors == 0);
+    HOST_CHECK(stats.bad_bytes == 0);
+    HOST_CHECK(stats.first_error.empty());
+    HOST_CHECK(stats.points >= stats.expected_points * 9 / 10);
+    HOST_CHECK(stats.latency_max_us > 0);
+    // the cell of sim_device.c has about 52 mV across 100k, 500 nA
+    HOST_CHECK((stats.mean_nanoamps > 400) && (stats.mean_nanoamps < 600));
+
+    // every point that came is in the recordings, in order
+    uint64_t recorded = 0;
+    int recordings = 0;
+    for (const auto &entry : std::filesystem::directory_iterator(options.directory)) {
+        if (entry.path().extension() != ".amprec") {
+            continue;
+        }
+        RecordingReader reader(entry.path());
+        recordings++;
+        HOST_CHECK(reader.header().sample_period_ns == options.sample_period_ns);
+        HOST_CHECK(reader.header().calibrated);
+        for (size_t block = 0; block < reader.blocks(); block++) {
+            HOST_CHECK(reader.entry(block).time_ns == (int64_t)(reader.entry(block).first_point *
+                                                                 options.sample_period_ns));
+            recorded += reader.entry(block).points;
+        }
+    }
+    HOST_CHECK(recordings == options.devices);
+    HOST_CHECK(recorded == stats.points);
+    std::filesystem::remove_all(options.directory);
+}
+
+int main(int argc, char **argv) {
+    test_stream_pieces();
+    test_queue();
+    if (argc > 1) {
+        test_daemon(argv[1]);
+    }
+    else {
+        std::printf("no sim_device given, the daemon is not run\n");
+    }
+    return host_test_failures;
+}
@@ -0,0 +1,98 @@
+/*******************************************************************************
+* File Name: device_records.h
+*
+* Description:
+*  The binary records the firmware sends, laid out the same as in
+*  data_export.h, calibrate.h and trace.h.  The PSoC is little endian with
+*  the same alignment rules as the computers this is built on, the
+*  static_asserts catch a layout that does not match
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+
+namespace amperometry {
+
+constexpr uint16_t kDoneCode = 0xC000;  // ADC_DATA_DONE_CODE, ends a channel sent with 'E' or 'F'
+constexpr int kCalibrationPoints = 5;  // Number_calibration_points
+constexpr double kIdacFemtoampsPerBit = 125000000.0;  // CALIBRATE_IDAC_FA_PER_BIT
+constexpr int kAdcChannels = 4;  // ADC_CHANNELS
+constexpr int kUsbPacketSize = 64;  // MAX_BUFFER_SIZE
+
+constexpr uint8_t kVdacIsVdac = 1;  // VDAC_IS_VDAC, dac_source of the DeviceHeader
+constexpr uint8_t kVdacIsDvdac = 2;  // VDAC_IS_DVDAC
+
+struct ExportHeader {  // "ES" or "EP" then count data points
+    char tag[2];
+    uint16_t count;
+    uint32_t first_sequence;
+};
+
+struct ExportFormat {  // "XF", sent by 'UK' and after the DeviceHeader
+    char tag[2];
+    uint16_t done_code;
+    uint8_t pairs;
+    uint8_t tia_resistor;
+    uint8_t adc_buffer;
+    uint8_t calibrated;
+    int16_t calibration[2*kCalibrationPoints];  // calibrate_array, 5 IDAC values then 5 adc readings
+    int32_t femtoamps_per_count;
+    int16_t zero_count;
+    uint8_t adc_profile;
+    uint8_t sample_bits;
+};
+
+struct DeviceHeader {  // "DH", sent by 'UH'
+    char tag[2];
+    uint16_t firmware_version;
+    uint32_t unique_id[2];
+    uint8_t dac_source;
+    uint8_t tia_resistor;
+    uint8_t adc_buffer;
+    uint8_t reserved;
+    uint32_t sample_period_ns;
+};
+
+struct BlockInfo {  // 1 for each ADC_array channel, sent by 'UM'
+    uint32_t block_number;
+    uint32_t first_sequence;
+    uint32_t sample_period_ns;
+    uint16_t count;
+    uint8_t tia_resistor;
+    uint8_t adc_buffer;
+};
+
+constexpr double kBusClockHz = 24000000.0;  // BCLK__BUS_CLK__HZ, the trace times count its cycles
+
+struct TraceHeader {  // "TR", sent by 'UT' before the events
+    char tag[2];
+    uint16_t count;
+    uint32_t now;  // cycle counter when the dump started
+    uint32_t lost;
+};
+
+struct TraceEvent {
+    uint32_t time;  // cycle counter, wraps about every 179 seconds
+    uint8_t event;  // TRACE_XXX
+    uint8_t arg8;
+    uint16_t arg16;
+};
+
+static_assert(sizeof(ExportHeader) == 8, "ExportHeader does not match data_export.h");
+static_assert(sizeof(ExportFormat) == 36, "ExportFormat does not match data_export.h");
+static_assert(sizeof(DeviceHeader) == 20, "DeviceHeader does not match data_export.h");
+static_assert(sizeof(BlockInfo) == 16, "BlockInfo does not match data_export.h");
+static_assert(sizeof(TraceHeader) == 12, "TraceHeader does not match trace.h");
+static_assert(sizeof(TraceEvent) == 8, "TraceEvent does not match trace.h");
+
+inline bool has_tag(const void *record, char first, char second) {
+    const char *tag = static_cast<const char*>(record);
+    return (tag[0] == first) && (tag[1] == second);
+}
+
+}  // namespace amperometry
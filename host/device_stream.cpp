@@ -0,0 +1,95 @@
+/*******************************************************************************
+* File Name: device_stream.cpp
+*
+* Description:
+*  Split what a device sends into its records, see device_stream.h
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include "device_stream.h"
+
+namespace amperometry {
+
+void DeviceStream::append(std::span<const uint8_t> bytes) {
+    if (start_ == data_.size()) {
+        data_.clear();
+        start_ = 0;
+    }
+    else if (start_ > data_.size() / 2) {  // move the part record down instead of growing
+        data_.erase(data_.begin(), data_.begin() + start_);
+        start_ = 0;
+    }
+    data_.insert(data_.end(), bytes.begin(), bytes.end());
+}
+
+bool DeviceStream::next(DeviceRecord &record) {
+    while (start_ < data_.size()) {
+        std::span<const uint8_t> rest(data_.data() + start_, data_.size() - start_);
+        if (rest.size() < 2) {
+            return false;
+        }
+        size_t record_bytes = 0;
+        if (has_tag(rest.data(), 'E', 'S') || has_tag(rest.data(), 'E', 'P')) {
+            if (rest.size() < sizeof(ExportHeader)) {
+                return false;
+            }
+            std::optional<ExportBlock> block = parse_export(rest);
+            if (!block) {
+                return false;
+            }
+            record.kind = RecordKind::kPoints;
+            record.export_block = *block;
+            record_bytes = block->record_bytes;
+        }
+        else if (has_tag(rest.data(), 'D', 'H') || has_tag(rest.data(), 'X', 'F') ||
+                 has_tag(rest.data(), 'B', 'S')) {
+            if (rest[0] == 'D') {
+                record.kind = RecordKind::kDeviceHeader;
+                record_bytes = sizeof(DeviceHeader);
+            }
+            else if (rest[0] == 'X') {
+                record.kind = RecordKind::kExportFormat;
+                record_bytes = sizeof(ExportFormat);
+            }
+            else {
+                record.kind = RecordKind::kBlockStats;
+                record_bytes = kBlockStatsBytes;
+            }
+            if (rest.size() < record_bytes) {
+                return false;
+            }
+            if (record.kind == RecordKind::kDeviceHeader) {
+                std::memcpy(&record.device_header, rest.data(), sizeof(DeviceHeader));
+            }
+            else if (record.kind == RecordKind::kExportFormat) {
+                std::memcpy(&record.export_format, rest.data(), sizeof(ExportFormat));
+            }
+        }
+        else {  // a message, printable up to the 0
+            size_t end = 0;
+            while ((end < rest.size()) && (end < kMaxMessageBytes) && (rest[end] >= ' ') && (rest[end] < 0x7F)) {
+                end++;
+            }
+            if ((end == rest.size()) && (end < kMaxMessageBytes)) {
+                return false;
+            }
+            if ((end == 0) || (end == kMaxMessageBytes) || (rest[end] != 0)) {  // not a record, look again from the next byte
+                start_++;
+                bad_bytes_++;
+                continue;
+            }
+            record.kind = RecordKind::kMessage;
+            record.text = std::string_view((const char*)rest.data(), end);
+            record_bytes = end + 1;
+        }
+        record.bytes = rest.subspan(0, record_bytes);
+        start_ += record_bytes;
+        return true;
+    }
+    return false;
+}
+
+}  // namespace amperometry
@@ -0,0 +1,66 @@
+/*******************************************************************************
+* File Name: device_stream.h
+*
+* Description:
+*  Split what a device sends into its records.  USB_Export_Data sends in 64
+*  byte packets with nothing to mark where a record ends, so the records are
+*  told apart by their first 2 bytes: the binary records that can come while
+*  the data is pushed (ES/EP, DH, XF and BS) have a fixed or given size, and
+*  anything else is a message ended by a 0.  The bytes can be given in any
+*  pieces, a record split between them is kept until the rest comes
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "device_records.h"
+#include "export_parse.h"
+
+namespace amperometry {
+
+constexpr size_t kBlockStatsBytes = 24;  // sizeof(struct BlockStatsRecord), "BS"
+constexpr size_t kMaxMessageBytes = 256;  // a message longer than this is not one, the stream is lost
+
+enum class RecordKind {
+    kPoints,  // export has the points of an ES or EP
+    kDeviceHeader,
+    kExportFormat,
+    kBlockStats,  // bytes has the record
+    kMessage,  // text has the message without the 0
+};
+
+struct DeviceRecord {
+    RecordKind kind;
+    ExportBlock export_block;
+    DeviceHeader device_header;
+    ExportFormat export_format;
+    std::span<const uint8_t> bytes;  // all of the record
+    std::string_view text;
+};
+
+class DeviceStream {
+public:
+    void append(std::span<const uint8_t> bytes);
+    /* the next whole record, false if the rest has not come yet.  The views in
+       it are good until the next call to append */
+    bool next(DeviceRecord &record);
+
+    size_t buffered() const { return data_.size() - start_; }
+    uint64_t bad_bytes() const { return bad_bytes_; }  // skipped to find the next record
+
+private:
+    std::vector<uint8_t> data_;
+    size_t start_ = 0;  // the first byte not read yet
+    uint64_t bad_bytes_ = 0;
+};
+
+}  // namespace amperometry
@@ -0,0 +1,54 @@
+/*******************************************************************************
+* File Name: export_parse.cpp
+*
+* Description:
+*  Find the data points in the exports, see export_parse.h
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include "export_parse.h"
+
+namespace amperometry {
+
+std::optional<CountView> parse_channel(std::span<const uint8_t> bytes, bool pairs) {
+    // the firmware writes the done code where the next data point would start, so
+    // with pairs it is in the dac value word and a current can not be taken for it
+    size_t stride = pairs ? 4 : 2;
+    for (size_t offset = 0; offset + 2 <= bytes.size(); offset += stride) {
+        uint16_t word;
+        std::memcpy(&word, bytes.data() + offset, sizeof(word));
+        if (word == kDoneCode) {
+            return CountView(bytes.data(), offset / stride, pairs);
+        }
+    }
+    return std::nullopt;
+}
+
+size_t export_data_bytes(const ExportHeader &header) {
+    return (size_t)header.count * (header.tag[1] == 'P' ? 4 : 2);
+}
+
+std::optional<ExportBlock> parse_export(std::span<const uint8_t> bytes) {
+    ExportHeader header;
+    if (bytes.size() < sizeof(header)) {
+        return std::nullopt;
+    }
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (!has_tag(&header, 'E', 'S') && !has_tag(&header, 'E', 'P')) {
+        return std::nullopt;
+    }
+    size_t data_bytes = export_data_bytes(header);
+    if (bytes.size() < sizeof(header) + data_bytes) {
+        return std::nullopt;
+    }
+    ExportBlock block;
+    block.first_sequence = header.first_sequence;
+    block.points = CountView(bytes.data() + sizeof(header), header.count, header.tag[1] == 'P');
+    block.record_bytes = sizeof(header) + data_bytes;
+    return block;
+}
+
+}  // namespace amperometry
@@ -0,0 +1,76 @@
+/*******************************************************************************
+* File Name: export_parse.h
+*
+* Description:
+*  Read the data the firmware exports without copying it.  A channel sent
+*  with 'E' or 'F' is int16 values ended by the done code, a push or 'ES'
+*  export is an ExportHeader then its data points.  The views point into the
+*  bytes read from the USB, which have to outlive them
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+
+#include "device_records.h"
+
+namespace amperometry {
+
+/* The currents of a trace in the bytes they came in.  With pairs each data
+   point is the dac value on the electrode then the current */
+class CountView {
+public:
+    CountView() = default;
+    CountView(const uint8_t *bytes, size_t points, bool pairs)
+        : bytes_(bytes), points_(points), pairs_(pairs) {}
+
+    size_t size() const { return points_; }
+    bool empty() const { return points_ == 0; }
+    bool pairs() const { return pairs_; }
+    const uint8_t* bytes() const { return bytes_; }
+
+    int16_t current(size_t index) const { return word(pairs_ ? 2*index + 1 : index); }
+    int16_t dac_value(size_t index) const { return pairs_ ? word(2*index) : 0; }
+    int16_t operator[](size_t index) const { return current(index); }
+
+    CountView subview(size_t first, size_t points) const {
+        return CountView(bytes_ + first*stride(), points, pairs_);
+    }
+    size_t stride() const { return pairs_ ? 4 : 2; }  // bytes in each data point
+
+private:
+    int16_t word(size_t index) const {
+        int16_t value;
+        std::memcpy(&value, bytes_ + 2*index, sizeof(value));
+        return value;
+    }
+
+    const uint8_t *bytes_ = nullptr;
+    size_t points_ = 0;
+    bool pairs_ = false;
+};
+
+struct ExportBlock {
+    uint32_t first_sequence;  // sequence number of the first data point
+    CountView points;
+    size_t record_bytes;  // header and data, where the next record starts
+};
+
+// a channel sent with 'E' or 'F', nullopt if the done code is not in the bytes
+std::optional<CountView> parse_channel(std::span<const uint8_t> bytes, bool pairs);
+
+// an ExportHeader and its data points, nullopt if the bytes do not start with one or it is not all there
+std::optional<ExportBlock> parse_export(std::span<const uint8_t> bytes);
+
+// bytes an ExportHeader says follow it
+size_t export_data_bytes(const ExportHeader &header);
+
+}  // namespace amperometry
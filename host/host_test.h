@@ -0,0 +1,24 @@
+/*******************************************************************************
+* File Name: host_test.h
+*
+* Description:
+*  Check macro for the tests of the computer side code, the same as
+*  sim_test.h for the firmware tests
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#pragma once
+
+#include <cstdio>
+
+static int host_test_failures = 0;
+
+#define HOST_CHECK(condition) do {                                              \
+    if (!(condition)) {                                                         \
+        std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        host_test_failures++;                                                   \
+    }                                                                           \
+} while (0)
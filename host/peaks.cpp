@@ -0,0 +1,251 @@
+/*******************************************************************************
+* File Name: peaks.cpp
+*
+* Description:
+*  Peak finding, see peaks.h.  Only the search for the local maxima and the
+*  lowest points between them go through the whole trace, so those are the
+*  parts done 8 points at a time
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include <algorithm>
+
+#include "peaks.h"
+#include "simd.h"
+
+namespace amperometry {
+
+namespace {
+
+struct Trace {
+    const float *data;
+    float sign;
+
+    float operator[](size_t index) const { return sign * data[index]; }
+};
+
+struct Lowest {
+    float value;
+    size_t index;
+};
+
+typedef Lowest (*LowestFunction)(const Trace &trace, size_t first, size_t last);
+
+bool is_candidate(const Trace &trace, size_t i, float min_height) {
+    return (trace[i] > trace[i - 1]) && (trace[i] >= trace[i + 1]) && (trace[i] >= min_height);
+}
+
+// lowest point from first to last, the first one of them if there is a tie
+__attribute__((optimize("no-tree-vectorize")))
+Lowest lowest_scalar(const Trace &trace, size_t first, size_t last) {
+    Lowest lowest{trace[first], first};
+    for (size_t i = first + 1; i <= last; i++) {
+        if (trace[i] < lowest.value) {
+            lowest = Lowest{trace[i], i};
+        }
+    }
+    return lowest;
+}
+
+Lowest lowest_vector(const Trace &trace, size_t first, size_t last) {
+    size_t end = last + 1;
+    if (end - first < 2*simd::kLanes) {
+        return lowest_scalar(trace, first, last);
+    }
+    // the lowest value 8 points at a time, then where it is first
+    const simd::Floats sign = simd::splat(trace.sign);
+    simd::Floats lowest = sign * simd::load(trace.data + first);
+    size_t i = first + simd::kLanes;
+    for (; i + simd::kLanes <= end; i += simd::kLanes) {
+        simd::Floats value = sign * simd::load(trace.data + i);
+        lowest = (value < lowest) ? value : lowest;
+    }
+    float value = lowest[0];
+    for (int lane = 1; lane < simd::kLanes; lane++) {
+        value = std::min(value, lowest[lane]);
+    }
+    for (; i < end; i++) {
+        value = std::min(value, trace[i]);
+    }
+    const simd::Floats wanted = simd::splat(value);
+    for (i = first; i + simd::kLanes <= end; i += simd::kLanes) {
+        if (simd::any(sign * simd::load(trace.data + i) == wanted)) {
+            break;
+        }
+    }
+    while (trace[i] != value) {
+        i++;
+    }
+    return Lowest{value, i};
+}
+
+/* The base on one side of a peak is the lowest point before the trace gets
+   higher than the peak.  The first point higher than it is on the slope up
+   to the closest higher candidate, so only the lowest points between the
+   candidates are needed, and a stack of the candidates that are not yet
+   passed by a higher one gives each base with 1 pass over the candidates.
+   gaps[j] is the lowest point between candidate j - 1 and j, gaps[0] from
+   the start of the trace, bases get the base of each candidate on the side
+   the gaps are on */
+void side_bases(const Trace &trace, const std::vector<size_t> &candidates, const std::vector<Lowest> &gaps,
+                std::vector<Lowest> &bases, bool forward) {
+    struct Open {
+        float height;
+        Lowest lowest;  // from the candidate before it on the stack to it
+    };
+    std::vector<Open> stack;
+    size_t count = candidates.size();
+    for (size_t n = 0; n < count; n++) {
+        size_t j = forward ? n : count - 1 - n;
+        float height = trace[candidates[j]];
+        Lowest lowest = gaps[n];
+        while (!stack.empty() && (stack.back().height <= height)) {
+            if (stack.back().lowest.value < lowest.value) {
+                lowest = stack.back().lowest;
+            }
+            stack.pop_back();
+        }
+        bases[j] = lowest;
+        stack.push_back(Open{height, lowest});
+    }
+}
+
+std::vector<Peak> measure(const Trace &trace, size_t size, const std::vector<size_t> &candidates,
+                          LowestFunction find_lowest) {
+    size_t count = candidates.size();
+    std::vector<Peak> peaks(count);
+    if (count == 0) {
+        return peaks;
+    }
+    // gaps going forward, the one after the last candidate is for going back
+    std::vector<Lowest> gaps(count + 1);
+    gaps[0] = find_lowest(trace, 0, candidates[0]);
+    for (size_t j = 1; j < count; j++) {
+        gaps[j] = find_lowest(trace, candidates[j - 1], candidates[j]);
+    }
+    gaps[count] = find_lowest(trace, candidates[count - 1], size - 1);
+    std::vector<Lowest> left(count);
+    std::vector<Lowest> right(count);
+    side_bases(trace, candidates, gaps, left, true);
+    std::reverse(gaps.begin(), gaps.end());
+    side_bases(trace, candidates, gaps, right, false);
+
+    for (size_t j = 0; j < count; j++) {
+        Peak &peak = peaks[j];
+        size_t index = candidates[j];
+        peak.index = index;
+        peak.height = trace[index];
+        peak.left_base = left[j].index;
+        peak.right_base = right[j].index;
+        peak.prominence = peak.height - std::max(left[j].value, right[j].value);
+        if (peak.prominence == 0) {  // flat on one side, no half height to measure at
+            peak.width = 0;
+            continue;
+        }
+        // the trace gets to half height before the bases, it is between 2 points so interpolate
+        float half = peak.height - peak.prominence / 2;
+        float left_side = (float)peak.left_base;
+        for (size_t i = index; i > peak.left_base; i--) {
+            if (trace[i - 1] <= half) {
+                left_side = (float)(i - 1) + (half - trace[i - 1]) / (trace[i] - trace[i - 1]);
+                break;
+            }
+        }
+        float right_side = (float)peak.right_base;
+        for (size_t i = index; i < peak.right_base; i++) {
+            if (trace[i + 1] <= half) {
+                right_side = (float)(i + 1) - (half - trace[i + 1]) / (trace[i] - trace[i + 1]);
+                break;
+            }
+        }
+        peak.width = right_side - left_side;
+    }
+    return peaks;
+}
+
+std::vector<Peak> select(const Trace &trace, size_t size, const std::vector<size_t> &candidates,
+                         const PeakOptions &options, LowestFunction find_lowest) {
+    std::vector<Peak> peaks;
+    for (const Peak &peak : measure(trace, size, candidates, find_lowest)) {
+        if (peak.prominence >= options.min_prominence) {
+            peaks.push_back(peak);
+        }
+    }
+    if (options.min_distance <= 1) {
+        return peaks;
+    }
+    // highest first, each peak takes out the lower ones too close to it
+    std::vector<size_t> order(peaks.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&](size_t a, size_t b) { return peaks[a].height > peaks[b].height; });
+    std::vector<bool> keep(peaks.size(), true);
+    for (size_t i : order) {
+        if (!keep[i]) {
+            continue;
+        }
+        for (size_t j = i; j-- > 0 && peaks[i].index - peaks[j].index < options.min_distance; ) {
+            keep[j] = false;
+        }
+        for (size_t j = i + 1; j < peaks.size() && peaks[j].index - peaks[i].index < options.min_distance; j++) {
+            keep[j] = false;
+        }
+    }
+    std::vector<Peak> kept;
+    for (size_t i = 0; i < peaks.size(); i++) {
+        if (keep[i]) {
+            kept.push_back(peaks[i]);
+        }
+    }
+    return kept;
+}
+
+}  // namespace
+
+__attribute__((optimize("no-tree-vectorize")))
+std::vector<Peak> find_peaks_scalar(const float *data, size_t size, const PeakOptions &options) {
+    Trace trace{data, options.negative ? -1.0f : 1.0f};
+    std::vector<size_t> candidates;
+    for (size_t i = 1; i + 1 < size; i++) {
+        if (is_candidate(trace, i, options.min_height)) {
+            candidates.push_back(i);
+        }
+    }
+    return select(trace, size, candidates, options, lowest_scalar);
+}
+
+std::vector<Peak> find_peaks(const float *data, size_t size, const PeakOptions &options) {
+    Trace trace{data, options.negative ? -1.0f : 1.0f};
+    std::vector<size_t> candidates;
+    const simd::Floats sign = simd::splat(trace.sign);
+    const simd::Floats min_height = simd::splat(options.min_height);
+    size_t i = 1;
+    // most blocks of 8 have no peak, only the ones that do are looked at point by point
+    for (; i + simd::kLanes + 1 <= size; i += simd::kLanes) {
+        simd::Floats before = sign * simd::load(data + i - 1);
+        simd::Floats middle = sign * simd::load(data + i);
+        simd::Floats after = sign * simd::load(data + i + 1);
+        simd::Ints found = (middle > before) & (middle >= after) & (middle >= min_height);
+        if (!simd::any(found)) {
+            continue;
+        }
+        for (int lane = 0; lane < simd::kLanes; lane++) {
+            if (found[lane]) {
+                candidates.push_back(i + lane);
+            }
+        }
+    }
+    for (; i + 1 < size; i++) {
+        if (is_candidate(trace, i, options.min_height)) {
+            candidates.push_back(i);
+        }
+    }
+    return select(trace, size, candidates, options, lowest_vector);
+}
+
+}  // namespace amperometry
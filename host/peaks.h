@@ -0,0 +1,44 @@
+/*******************************************************************************
+* File Name: peaks.h
+*
+* Description:
+*  Find the peaks of a trace (i.e. the oxidation peaks of a cyclic voltammetry
+*  or the spikes of an amperometry run).  A peak is a point higher than the
+*  one before it and at least as high as the one after it, then it is kept
+*  if it stands out enough from the trace around it
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+namespace amperometry {
+
+struct PeakOptions {
+    float min_height = -std::numeric_limits<float>::infinity();
+    float min_prominence = 0;
+    size_t min_distance = 1;  // points between kept peaks, the higher peak is kept
+    bool negative = false;  // find the dips instead, e.g. reduction peaks, the heights are then negative of the trace
+};
+
+struct Peak {
+    size_t index;
+    float height;
+    // height above the higher of the lowest points on each side before the trace gets higher than the peak
+    float prominence;
+    size_t left_base;
+    size_t right_base;
+    float width;  // in points, at half of the prominence, interpolated between the points
+};
+
+// peaks in order of index
+std::vector<Peak> find_peaks(const float *trace, size_t size, const PeakOptions &options = PeakOptions());
+std::vector<Peak> find_peaks_scalar(const float *trace, size_t size, const PeakOptions &options = PeakOptions());
+
+}  // namespace amperometry
@@ -0,0 +1,518 @@
+/*******************************************************************************
+* File Name: recording.cpp
+*
+* Description:
+*  Writing and reading the recordings, see recording.h
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "crc32c.h"
+#include "recording.h"
+
+namespace amperometry {
+
+namespace {
+
+const char kRecordingMagic[8] = {'A', 'M', 'P', 'R', 'E', 'C', 0, 1};
+const char kIndexMagic[8] = {'A', 'M', 'P', 'I', 'D', 'X', 0, 1};
+const char kBlockMagic[4] = {'B', 'L', 'K', '1'};
+const size_t kFlushBytes = 1 << 20;  // of blocks put together before a write
+
+[[noreturn]] void fail(const std::string &what, const std::string &path) {
+    throw std::system_error(errno, std::generic_category(), what + " " + path);
+}
+
+// bytes of a block in the data file, kept a multiple of 8 so the headers are aligned in the map
+uint64_t block_bytes(uint32_t points, bool pairs) {
+    uint64_t bytes = sizeof(BlockHeader) + (uint64_t)points * (pairs ? 4 : 2);
+    return (bytes + 7) & ~(uint64_t)7;
+}
+
+template <typename Record>
+uint32_t record_crc(const Record &record) {
+    return crc32c(&record, offsetof(Record, crc));
+}
+
+uint32_t block_crc(const BlockHeader &block, const uint8_t *data, size_t data_bytes) {
+    return crc32c(&block, offsetof(BlockHeader, crc), crc32c(data, data_bytes));
+}
+
+bool header_good(const RecordingHeader &header) {
+    return (std::memcmp(header.magic, kRecordingMagic, sizeof(kRecordingMagic)) == 0) &&
+           (header.crc == record_crc(header));
+}
+
+bool index_header_good(const IndexHeader &header) {
+    return (std::memcmp(header.magic, kIndexMagic, sizeof(kIndexMagic)) == 0) &&
+           (header.entry_bytes == sizeof(IndexEntry)) && (header.crc == record_crc(header));
+}
+
+// an entry is good if it is for the block that follows the one before it
+bool entry_good(const IndexEntry &entry, const IndexEntry *before, bool pairs, uint64_t data_size) {
+    uint64_t offset = before ? before->offset + block_bytes(before->points, pairs) : kRecordingHeaderBytes;
+    uint64_t first_point = before ? before->first_point + before->points : 0;
+    return (entry.crc == record_crc(entry)) && (entry.offset == offset) && (entry.first_point == first_point) &&
+           (!before || (entry.time_ns >= before->time_ns)) &&
+           (entry.offset + block_bytes(entry.points, pairs) <= data_size);
+}
+
+IndexEntry entry_for(const BlockHeader &block, uint64_t offset) {
+    IndexEntry entry{};
+    entry.time_ns = block.time_ns;
+    entry.offset = offset;
+    entry.first_point = block.first_point;
+    entry.points = block.points;
+    entry.tia_resistor = block.tia_resistor;
+    entry.adc_buffer = block.adc_buffer;
+    entry.block_crc = block.crc;
+    entry.crc = record_crc(entry);
+    return entry;
+}
+
+void write_all(int fd, const void *data, size_t size, uint64_t offset, const std::string &path) {
+    const uint8_t *bytes = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        ssize_t written = pwrite(fd, bytes, size, offset);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fail("write", path);
+        }
+        bytes += written;
+        size -= written;
+        offset += written;
+    }
+}
+
+bool read_all(int fd, void *data, size_t size, uint64_t offset) {
+    uint8_t *bytes = static_cast<uint8_t*>(data);
+    while (size > 0) {
+        ssize_t got = pread(fd, bytes, size, offset);
+        if ((got < 0) && (errno == EINTR)) {
+            continue;
+        }
+        if (got <= 0) {
+            return false;
+        }
+        bytes += got;
+        size -= got;
+        offset += got;
+    }
+    return true;
+}
+
+void sync(int fd, const std::string &path) {
+    if (fdatasync(fd) != 0) {
+        fail("sync", path);
+    }
+}
+
+// a new file is only there after a crash if the directory it is in was synced too
+void sync_directory(const std::string &path) {
+    size_t slash = path.rfind('/');
+    std::string directory = (slash == std::string::npos) ? "." : path.substr(0, slash + 1);
+    int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        fail("open", directory);
+    }
+    int result = fsync(fd);
+    ::close(fd);
+    if (result != 0) {
+        fail("sync", directory);
+    }
+}
+
+uint64_t file_size(int fd, const std::string &path) {
+    struct stat status;
+    if (fstat(fd, &status) != 0) {
+        fail("stat", path);
+    }
+    return status.st_size;
+}
+
+}  // namespace
+
+RecordingHeader make_recording_header(const DeviceHeader &device, const ExportFormat &format, int64_t start_time_ns) {
+    RecordingHeader header{};
+    std::memcpy(header.magic, kRecordingMagic, sizeof(kRecordingMagic));
+    header.unique_id[0] = device.unique_id[0];
+    header.unique_id[1] = device.unique_id[1];
+    header.firmware_version = device.firmware_version;
+    header.dac_source = device.dac_source;
+    header.pairs = format.pairs;
+    header.sample_period_ns = device.sample_period_ns;
+    header.tia_resistor = device.tia_resistor;
+    header.adc_buffer = device.adc_buffer;
+    header.calibrated = format.calibrated;
+    header.adc_profile = format.adc_profile;
+    std::memcpy(header.calibration, format.calibration, sizeof(header.calibration));
+    header.femtoamps_per_count = format.femtoamps_per_count;
+    header.zero_count = format.zero_count;
+    header.start_time_ns = start_time_ns;
+    return header;
+}
+
+std::string index_path(const std::string &path) {
+    return path + ".index";
+}
+
+RecordingWriter RecordingWriter::create(const std::string &path, const RecordingHeader &header,
+                                        size_t commit_bytes) {
+    RecordingWriter writer;
+    writer.path_ = path;
+    writer.commit_bytes_ = commit_bytes;
+    writer.header_ = header;
+    std::memcpy(writer.header_.magic, kRecordingMagic, sizeof(kRecordingMagic));
+    writer.header_.crc = record_crc(writer.header_);
+
+    writer.data_fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (writer.data_fd_ < 0) {
+        fail("create", path);
+    }
+    writer.index_fd_ = ::open(index_path(path).c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (writer.index_fd_ < 0) {
+        fail("create", index_path(path));
+    }
+    std::vector<uint8_t> first(kRecordingHeaderBytes, 0);
+    std::memcpy(first.data(), &writer.header_, sizeof(writer.header_));
+    write_all(writer.data_fd_, first.data(), first.size(), 0, path);
+    IndexHeader index{};
+    std::memcpy(index.magic, kIndexMagic, sizeof(kIndexMagic));
+    index.entry_bytes = sizeof(IndexEntry);
+    index.crc = record_crc(index);
+    write_all(writer.index_fd_, &index, sizeof(index), 0, index_path(path));
+    sync(writer.data_fd_, path);
+    sync(writer.index_fd_, index_path(path));
+    sync_directory(path);
+    writer.data_end_ = kRecordingHeaderBytes;
+    return writer;
+}
+
+RecordingWriter RecordingWriter::open(const std::string &path, size_t commit_bytes) {
+    RecordingWriter writer;
+    writer.path_ = path;
+    writer.commit_bytes_ = commit_bytes;
+    writer.data_fd_ = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+    if (writer.data_fd_ < 0) {
+        fail("open", path);
+    }
+    writer.index_fd_ = ::open(index_path(path).c_str(), O_RDWR | O_CLOEXEC);
+    if (writer.index_fd_ < 0) {
+        fail("open", index_path(path));
+    }
+    IndexHeader index;
+    if (!read_all(writer.data_fd_, &writer.header_, sizeof(writer.header_), 0) || !header_good(writer.header_) ||
+        !read_all(writer.index_fd_, &index, sizeof(index), 0) || !index_header_good(index)) {
+        throw std::runtime_error("not a recording: " + path);
+    }
+    bool pairs = writer.header_.pairs;
+    uint64_t data_size = file_size(writer.data_fd_, path);
+
+    // the entries that point at whole blocks, anything after a bad one is from a crash
+    uint64_t index_size = file_size(writer.index_fd_, index_path(path));
+    std::vector<IndexEntry> entries((index_size - sizeof(IndexHeader)) / sizeof(IndexEntry));
+    read_all(writer.index_fd_, entries.data(), entries.size() * sizeof(IndexEntry), sizeof(IndexHeader));
+    size_t good = 0;
+    while ((good < entries.size()) && entry_good(entries[good], good ? &entries[good - 1] : nullptr, pairs, data_size)) {
+        good++;
+    }
+    entries.resize(good);
+
+    // blocks that got to the disk after the last entry, up to the first one that is not all there
+    uint64_t offset = good ? entries.back().offset + block_bytes(entries.back().points, pairs) : kRecordingHeaderBytes;
+    uint64_t next_point = good ? entries.back().first_point + entries.back().points : 0;
+    int64_t last_time = good ? entries.back().time_ns : INT64_MIN;
+    std::vector<uint8_t> data;
+    BlockHeader block;
+    while (read_all(writer.data_fd_, &block, sizeof(block), offset) &&
+           (std::memcmp(block.magic, kBlockMagic, sizeof(kBlockMagic)) == 0) &&
+           (block.first_point == next_point) && (block.time_ns >= last_time) &&
+           (offset + block_bytes(block.points, pairs) <= data_size)) {
+        data.resize((size_t)block.points * (pairs ? 4 : 2));
+        if (!read_all(writer.data_fd_, data.data(), data.size(), offset + sizeof(block)) ||
+            (block_crc(block, data.data(), data.size()) != block.crc)) {
+            break;
+        }
+        writer.pending_index_.push_back(entry_for(block, offset));
+        offset += block_bytes(block.points, pairs);
+        next_point += block.points;
+        last_time = block.time_ns;
+    }
+
+    if (ftruncate(writer.data_fd_, offset) != 0) {
+        fail("truncate", path);
+    }
+    if (ftruncate(writer.index_fd_, sizeof(IndexHeader) + good * sizeof(IndexEntry)) != 0) {
+        fail("truncate", index_path(path));
+    }
+    sync(writer.data_fd_, path);
+    sync(writer.index_fd_, index_path(path));
+    writer.data_end_ = offset;
+    writer.next_point_ = next_point;
+    writer.last_time_ns_ = last_time;
+    writer.blocks_ = good + writer.pending_index_.size();
+    writer.commit();
+    return writer;
+}
+
+RecordingWriter::RecordingWriter(RecordingWriter &&other) noexcept {
+    *this = std::move(other);
+}
+
+RecordingWriter& RecordingWriter::operator=(RecordingWriter &&other) noexcept {
+    if (this != &other) {
+        close();
+        path_ = std::move(other.path_);
+        data_fd_ = std::exchange(other.data_fd_, -1);
+        index_fd_ = std::exchange(other.index_fd_, -1);
+        header_ = other.header_;
+        commit_bytes_ = other.commit_bytes_;
+        data_end_ = other.data_end_;
+        next_point_ = other.next_point_;
+        blocks_ = other.blocks_;
+        last_time_ns_ = other.last_time_ns_;
+        uncommitted_bytes_ = other.uncommitted_bytes_;
+        pending_data_ = std::move(other.pending_data_);
+        pending_index_ = std::move(other.pending_index_);
+    }
+    return *this;
+}
+
+RecordingWriter::~RecordingWriter() {
+    close();
+}
+
+void RecordingWriter::close() {
+    if (data_fd_ >= 0) {
+        try {
+            commit();
+        } catch (const std::exception&) {
+            // nothing to tell from a destructor, the reopen cuts off what did not make it
+        }
+        ::close(data_fd_);
+        ::close(index_fd_);
+        data_fd_ = -1;
+        index_fd_ = -1;
+    }
+}
+
+void RecordingWriter::append(int64_t time_ns, const CountView &points, uint8_t tia_resistor, uint8_t adc_buffer) {
+    if (points.pairs() != (header_.pairs != 0)) {
+        throw std::invalid_argument("points are not laid out like the recording");
+    }
+    if (time_ns < last_time_ns_) {
+        throw std::invalid_argument("block is before the last one");
+    }
+    if (points.empty()) {
+        return;
+    }
+    BlockHeader block{};
+    std::memcpy(block.magic, kBlockMagic, sizeof(kBlockMagic));
+    block.points = points.size();
+    block.first_point = next_point_;
+    block.time_ns = time_ns;
+    block.tia_resistor = tia_resistor;
+    block.adc_buffer = adc_buffer;
+    size_t data_bytes = points.size() * points.stride();
+    block.crc = block_crc(block, points.bytes(), data_bytes);
+
+    uint64_t bytes = block_bytes(block.points, header_.pairs);
+    pending_index_.push_back(entry_for(block, data_end_ + pending_data_.size()));
+    size_t at = pending_data_.size();
+    pending_data_.resize(at + bytes, 0);
+    std::memcpy(&pending_data_[at], &block, sizeof(block));
+    std::memcpy(&pending_data_[at + sizeof(block)], points.bytes(), data_bytes);
+
+    next_point_ += block.points;
+    last_time_ns_ = time_ns;
+    blocks_++;
+    uncommitted_bytes_ += bytes;
+    if (uncommitted_bytes_ >= commit_bytes_) {
+        commit();
+    }
+    else if (pending_data_.size() >= kFlushBytes) {
+        flush_data();
+    }
+}
+
+void RecordingWriter::flush_data() {
+    if (pending_data_.empty()) {
+        return;
+    }
+    write_all(data_fd_, pending_data_.data(), pending_data_.size(), data_end_, path_);
+    data_end_ += pending_data_.size();
+    pending_data_.clear();
+}
+
+void RecordingWriter::commit() {
+    flush_data();
+    if (pending_index_.empty()) {
+        return;
+    }
+    // the blocks have to be on the disk before the entries that point at them
+    sync(data_fd_, path_);
+    uint64_t committed = blocks_ - pending_index_.size();
+    write_all(index_fd_, pending_index_.data(), pending_index_.size() * sizeof(IndexEntry),
+              sizeof(IndexHeader) + committed * sizeof(IndexEntry), index_path(path_));
+    sync(index_fd_, index_path(path_));
+    pending_index_.clear();
+    uncommitted_bytes_ = 0;
+}
+
+RecordingReader::RecordingReader(const std::string &path) {
+    std::string paths[2] = {path, index_path(path)};
+    const uint8_t **maps[2] = {&data_, &index_};
+    size_t *sizes[2] = {&data_size_, &index_size_};
+    for (int i = 0; i < 2; i++) {
+        int fd = ::open(paths[i].c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            fail("open", paths[i]);
+        }
+        *sizes[i] = file_size(fd, paths[i]);
+        if (*sizes[i] > 0) {
+            void *map = mmap(nullptr, *sizes[i], PROT_READ, MAP_SHARED, fd, 0);
+            if (map == MAP_FAILED) {
+                ::close(fd);
+                fail("map", paths[i]);
+            }
+            *maps[i] = static_cast<const uint8_t*>(map);
+        }
+        ::close(fd);  // the map keeps the file
+    }
+    IndexHeader index{};
+    if (data_size_ >= sizeof(header_)) {
+        std::memcpy(&header_, data_, sizeof(header_));
+    }
+    if (index_size_ >= sizeof(index)) {
+        std::memcpy(&index, index_, sizeof(index));
+    }
+    if (!header_good(header_) || !index_header_good(index)) {
+        unmap();
+        throw std::runtime_error("not a recording: " + path);
+    }
+    entries_ = reinterpret_cast<const IndexEntry*>(index_ + sizeof(IndexHeader));
+    size_t count = (index_size_ - sizeof(IndexHeader)) / sizeof(IndexEntry);
+    while ((blocks_ < count) &&
+           entry_good(entries_[blocks_], blocks_ ? &entries_[blocks_ - 1] : nullptr, header_.pairs, data_size_)) {
+        blocks_++;
+    }
+}
+
+RecordingReader::RecordingReader(RecordingReader &&other) noexcept
+    : header_(other.header_),
+      data_(std::exchange(other.data_, nullptr)),
+      data_size_(std::exchange(other.data_size_, 0)),
+      index_(std::exchange(other.index_, nullptr)),
+      index_size_(std::exchange(other.index_size_, 0)),
+      entries_(std::exchange(other.entries_, nullptr)),
+      blocks_(std::exchange(other.blocks_, 0)) {}
+
+RecordingReader::~RecordingReader() {
+    unmap();
+}
+
+void RecordingReader::unmap() {
+    if (data_) {
+        munmap(const_cast<uint8_t*>(data_), data_size_);
+        data_ = nullptr;
+    }
+    if (index_) {
+        munmap(const_cast<uint8_t*>(index_), index_size_);
+        index_ = nullptr;
+    }
+}
+
+CountView RecordingReader::points(size_t block) const {
+    return CountView(data_ + entries_[block].offset + sizeof(BlockHeader), entries_[block].points, header_.pairs);
+}
+
+bool RecordingReader::check_block(size_t block) const {
+    BlockHeader header;
+    std::memcpy(&header, data_ + entries_[block].offset, sizeof(header));
+    CountView view = points(block);
+    return (header.crc == entries_[block].block_crc) &&
+           (block_crc(header, view.bytes(), view.size() * view.stride()) == header.crc);
+}
+
+size_t RecordingReader::find_block(int64_t time_ns) const {
+    if ((blocks_ == 0) || (time_ns <= entries_[0].time_ns)) {
+        return 0;
+    }
+    size_t last = blocks_ - 1;
+    if (time_ns >= entries_[last].time_ns) {
+        return last;
+    }
+    // entries_[0] is before the time and entries_[last] after it, guess from where it is between them
+    double fraction = (double)(time_ns - entries_[0].time_ns) / (double)(entries_[last].time_ns - entries_[0].time_ns);
+    size_t guess = std::min((size_t)(fraction * last), last - 1);
+    for (int step = 0; step < 4; step++) {
+        if (entries_[guess].time_ns > time_ns) {
+            guess--;
+        }
+        else if (entries_[guess + 1].time_ns <= time_ns) {
+            guess++;
+        }
+        else {
+            return guess;
+        }
+    }
+    // the blocks are not evenly spread out here (e.g. the run was stopped for a while)
+    const IndexEntry *after = std::upper_bound(entries_, entries_ + blocks_, time_ns,
+        [](int64_t time, const IndexEntry &entry) { return time < entry.time_ns; });
+    return (after - entries_) - 1;
+}
+
+std::vector<TimedPoints> RecordingReader::range(int64_t start_ns, int64_t end_ns) const {
+    std::vector<TimedPoints> parts;
+    if ((blocks_ == 0) || (end_ns <= start_ns)) {
+        return parts;
+    }
+    const int64_t period = header_.sample_period_ns;
+    // points of a block taken before a time, the point times are time_ns + n * period
+    auto points_before = [period](const IndexEntry &entry, int64_t time_ns) -> uint64_t {
+        if (time_ns <= entry.time_ns) {
+            return 0;
+        }
+        if (period == 0) {
+            return entry.points;
+        }
+        uint64_t points = (time_ns - entry.time_ns + period - 1) / period;
+        return std::min<uint64_t>(points, entry.points);
+    };
+    for (size_t block = find_block(start_ns); (block < blocks_) && (entries_[block].time_ns < end_ns); block++) {
+        const IndexEntry &entry = entries_[block];
+        uint64_t first = points_before(entry, start_ns);
+        uint64_t end = points_before(entry, end_ns);
+        if (first < end) {
+            parts.push_back(TimedPoints{entry.time_ns + (int64_t)first * period, entry.first_point + first,
+                                        points(block).subview(first, end - first),
+                                        entry.tia_resistor, entry.adc_buffer});
+        }
+    }
+    if (!parts.empty()) {
+        // the pages of a range are read in 1 go instead of a page fault at a time
+        const uint8_t *first = parts.front().points.bytes();
+        const uint8_t *end = parts.back().points.bytes() + parts.back().points.size() * parts.back().points.stride();
+        uintptr_t page = (uintptr_t)first & ~(uintptr_t)(sysconf(_SC_PAGESIZE) - 1);
+        madvise((void*)page, end - (const uint8_t*)page, MADV_WILLNEED);
+    }
+    return parts;
+}
+
+}  // namespace amperometry
@@ -0,0 +1,188 @@
+/*******************************************************************************
+* File Name: recording.h
+*
+* Description:
+*  Recordings of long runs on the computer's disk.  A recording is 2 files
+*  that are only ever appended to:
+*
+*  name         the RecordingHeader in the first 4096 bytes, then the blocks
+*               of data points, each a BlockHeader then the points as the
+*               device sent them (int16 counts, or dac value and count pairs)
+*  name.index   an IndexHeader then 1 IndexEntry for each block, so a time
+*               is found without reading the blocks
+*
+*  The writer makes the blocks durable (fdatasync) before it writes their
+*  index entries, and every header and entry has a CRC, so after a crash
+*  the index is a good prefix of the blocks.  Opening the recording again
+*  to write checks the end of both files, indexes the blocks that made it to
+*  the disk but not into the index, and cuts off anything half written.
+*
+*  The reader maps both files into memory, the points are read straight out
+*  of the page cache with a CountView and a time is found with a guess from
+*  the first and last block times, which is right first time for blocks of
+*  the same length
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "device_records.h"
+#include "export_parse.h"
+
+namespace amperometry {
+
+constexpr size_t kRecordingHeaderBytes = 4096;
+
+struct RecordingHeader {  // the start of the data file, the rest of the 4096 bytes are 0
+    char magic[8];  // "AMPREC" then the format version
+    uint32_t unique_id[2];  // of the device, from the DeviceHeader
+    uint16_t firmware_version;
+    uint8_t dac_source;  // kVdacIsVdac or kVdacIsDvdac
+    uint8_t pairs;  // the blocks have a dac value with each count
+    uint32_t sample_period_ns;
+    uint8_t tia_resistor;  // gain at the start, each block has the gain it was taken with
+    uint8_t adc_buffer;
+    uint8_t calibrated;  // the calibration is for this gain
+    uint8_t adc_profile;
+    int16_t calibration[2*kCalibrationPoints];  // calibrate_array
+    int32_t femtoamps_per_count;  // the firmware's fit of the calibration
+    int16_t zero_count;
+    uint16_t reserved;
+    int64_t start_time_ns;  // computer time (e.g. unix time) of time 0 of the blocks
+    uint32_t crc;  // of the bytes before it
+    uint32_t reserved2;
+};
+
+struct BlockHeader {  // before the data points of each block in the data file
+    char magic[4];  // "BLK1"
+    uint32_t points;
+    uint64_t first_point;  // number of the first data point since the recording started
+    int64_t time_ns;  // of the first data point, from start_time_ns
+    uint8_t tia_resistor;  // gain the block was taken with
+    uint8_t adc_buffer;
+    uint16_t reserved;
+    uint32_t crc;  // of the data points then the bytes of this header before it
+};
+
+struct IndexHeader {  // the start of the index file
+    char magic[8];  // "AMPIDX" then the format version
+    uint32_t entry_bytes;  // sizeof(IndexEntry)
+    uint32_t crc;
+};
+
+struct IndexEntry {
+    int64_t time_ns;
+    uint64_t offset;  // of the BlockHeader in the data file
+    uint64_t first_point;
+    uint32_t points;
+    uint8_t tia_resistor;
+    uint8_t adc_buffer;
+    uint16_t reserved;
+    uint32_t block_crc;  // the crc in the BlockHeader
+    uint32_t crc;  // of the bytes of this entry before it
+};
+
+static_assert(sizeof(RecordingHeader) == 72, "RecordingHeader has padding");
+static_assert(sizeof(BlockHeader) == 32, "BlockHeader has padding");
+static_assert(sizeof(IndexHeader) == 16, "IndexHeader has padding");
+static_assert(sizeof(IndexEntry) == 40, "IndexEntry has padding");
+
+// the header of a recording of what the 'UH' command sent
+RecordingHeader make_recording_header(const DeviceHeader &device, const ExportFormat &format, int64_t start_time_ns);
+
+std::string index_path(const std::string &path);
+
+class RecordingWriter {
+public:
+    /* commit_bytes: append commits by itself after this much data, a crash
+       loses at most this much (and the blocks of the data not yet committed) */
+    static RecordingWriter create(const std::string &path, const RecordingHeader &header,
+                                  size_t commit_bytes = 64 << 20);
+    // carry on a recording, after a crash too
+    static RecordingWriter open(const std::string &path, size_t commit_bytes = 64 << 20);
+
+    RecordingWriter(RecordingWriter &&other) noexcept;
+    RecordingWriter& operator=(RecordingWriter &&other) noexcept;
+    RecordingWriter(const RecordingWriter&) = delete;
+    RecordingWriter& operator=(const RecordingWriter&) = delete;
+    ~RecordingWriter();  // commits, call commit first to see an error
+
+    /* add a block of points taken from time_ns on, which can not be before the
+       last block.  The points have to be pairs if the recording is */
+    void append(int64_t time_ns, const CountView &points, uint8_t tia_resistor, uint8_t adc_buffer);
+    // everything appended is on the disk when this returns
+    void commit();
+
+    const RecordingHeader& header() const { return header_; }
+    uint64_t points() const { return next_point_; }
+    uint64_t blocks() const { return blocks_; }
+    uint64_t bytes() const { return data_end_ + pending_data_.size(); }  // of the data file
+
+private:
+    RecordingWriter() = default;
+    void flush_data();
+    void close();
+
+    std::string path_;
+    int data_fd_ = -1;
+    int index_fd_ = -1;
+    RecordingHeader header_{};
+    size_t commit_bytes_ = 0;
+    uint64_t data_end_ = 0;  // written to the data file, not all synced
+    uint64_t next_point_ = 0;
+    uint64_t blocks_ = 0;
+    int64_t last_time_ns_ = INT64_MIN;
+    uint64_t uncommitted_bytes_ = 0;
+    std::vector<uint8_t> pending_data_;  // not written yet
+    std::vector<IndexEntry> pending_index_;  // of blocks not synced yet
+};
+
+struct TimedPoints {  // a part of a block
+    int64_t time_ns;  // of the first point
+    uint64_t first_point;
+    CountView points;
+    uint8_t tia_resistor;
+    uint8_t adc_buffer;
+};
+
+class RecordingReader {
+public:
+    // maps the committed part of the recording, what is appended after that is not seen
+    explicit RecordingReader(const std::string &path);
+    RecordingReader(RecordingReader &&other) noexcept;
+    RecordingReader(const RecordingReader&) = delete;
+    RecordingReader& operator=(const RecordingReader&) = delete;
+    ~RecordingReader();
+
+    const RecordingHeader& header() const { return header_; }
+    size_t blocks() const { return blocks_; }
+    const IndexEntry& entry(size_t block) const { return entries_[block]; }
+    CountView points(size_t block) const;
+    bool check_block(size_t block) const;  // the crc of the data, reads all of it
+
+    // the last block that starts at or before time_ns, 0 if it is before them all
+    size_t find_block(int64_t time_ns) const;
+    // points from start_ns up to but not including end_ns, in the order they were taken
+    std::vector<TimedPoints> range(int64_t start_ns, int64_t end_ns) const;
+
+private:
+    void unmap();
+
+    RecordingHeader header_{};
+    const uint8_t *data_ = nullptr;
+    size_t data_size_ = 0;
+    const uint8_t *index_ = nullptr;
+    size_t index_size_ = 0;
+    const IndexEntry *entries_ = nullptr;
+    size_t blocks_ = 0;
+};
+
+}  // namespace amperometry
@@ -0,0 +1,153 @@
+/*******************************************************************************
+* File Name: recording_bench.cpp
+*
+* Description:
+*  Speed of the recordings on a multi-GB file.  A recording of a 1 MHz adc
+*  is written in blocks of 4096 points (the commits included), then random
+*  times are found and random 10 ms ranges read back through the map.
+*
+*  recording_bench [--gigabytes N] [--dir DIRECTORY] [--keep] [--quick]
+*
+*  The default is 4 GB in the directory it is run in, --quick (what ctest
+*  runs) writes 32 MB.  Reads of a file smaller than the free memory come
+*  from the page cache, so the query times are those of a warm file
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "recording.h"
+
+using namespace amperometry;
+
+static const uint32_t kPeriod = 1000;  // ns
+static const size_t kBlockPoints = 4096;
+static const int kFinds = 1000000;
+static const int kRanges = 20000;
+static const int64_t kRangeNs = 10000000;  // 10 ms
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv) {
+    double gigabytes = 4;
+    std::string directory = ".";
+    bool keep = false;
+    for (int i = 1; i < argc; i++) {
+        if ((std::strcmp(argv[i], "--gigabytes") == 0) && (i + 1 < argc)) {
+            gigabytes = std::atof(argv[++i]);
+        }
+        else if ((std::strcmp(argv[i], "--dir") == 0) && (i + 1 < argc)) {
+            directory = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--keep") == 0) {
+            keep = true;
+        }
+        else if (std::strcmp(argv[i], "--quick") == 0) {
+            gigabytes = 1.0 / 32;
+        }
+        else {
+            std::fprintf(stderr, "usage: %s [--gigabytes N] [--dir DIRECTORY] [--keep] [--quick]\n", argv[0]);
+            return 2;
+        }
+    }
+    std::string path = directory + "/recording_bench_" + std::to_string(getpid()) + ".amprec";
+    size_t blocks = (size_t)(gigabytes * (1 << 30) / (kBlockPoints * 2));
+
+    // the ingest, a slow drift with the block number in it so the data is not all the same
+    DeviceHeader device{};
+    device.sample_period_ns = kPeriod;
+    ExportFormat format{};
+    std::vector<int16_t> counts(kBlockPoints);
+    auto start = std::chrono::steady_clock::now();
+    uint64_t bytes;
+    {
+        RecordingWriter writer = RecordingWriter::create(path, make_recording_header(device, format, 0));
+        for (size_t block = 0; block < blocks; block++) {
+            for (size_t i = 0; i < kBlockPoints; i++) {
+                counts[i] = (int16_t)(block + i);
+            }
+            writer.append((int64_t)block * kBlockPoints * kPeriod,
+                          CountView((const uint8_t*)counts.data(), kBlockPoints, false), 3, 0);
+        }
+        writer.commit();
+        bytes = writer.bytes();
+    }
+    double taken = seconds_since(start);
+    std::printf("ingest   %zu blocks %.2f GB in %.2f s: %.0f MB/s, %.1f M points/s\n", blocks, bytes / 1e9,
+                taken, bytes / taken / 1e6, blocks * kBlockPoints / taken / 1e6);
+
+    start = std::chrono::steady_clock::now();
+    RecordingReader reader(path);
+    std::printf("open     %.3f ms for %zu index entries\n", seconds_since(start) * 1e3, reader.blocks());
+    if (reader.blocks() != blocks) {
+        std::printf("read %zu blocks of %zu\n", reader.blocks(), blocks);
+        return 1;
+    }
+
+    // times anywhere in the recording, the block has to be the one the time is in
+    const int64_t length_ns = (int64_t)blocks * kBlockPoints * kPeriod;
+    std::mt19937_64 random(1);
+    std::uniform_int_distribution<int64_t> anywhere(0, length_ns - 1);
+    std::vector<int64_t> times(kFinds);
+    for (auto &time : times) {
+        time = anywhere(random);
+    }
+    size_t wrong = 0;
+    start = std::chrono::steady_clock::now();
+    for (int64_t time : times) {
+        size_t block = reader.find_block(time);
+        wrong += (size_t)(block != (size_t)(time / (kBlockPoints * kPeriod)));
+    }
+    taken = seconds_since(start);
+    std::printf("find     %d times: %.1f ns each\n", kFinds, taken / kFinds * 1e9);
+
+    // 10 ms ranges, each point is read so the pages are touched
+    std::uniform_int_distribution<int64_t> range_start(0, length_ns - kRangeNs);
+    std::vector<double> latencies;
+    int64_t sum = 0;
+    size_t points = 0;
+    for (int i = 0; i < kRanges; i++) {
+        int64_t first = range_start(random);
+        auto query = std::chrono::steady_clock::now();
+        for (const TimedPoints &part : reader.range(first, first + kRangeNs)) {
+            for (size_t j = 0; j < part.points.size(); j++) {
+                sum += part.points[j];
+            }
+            points += part.points.size();
+        }
+        latencies.push_back(seconds_since(query));
+    }
+    std::sort(latencies.begin(), latencies.end());
+    double total = 0;
+    for (double latency : latencies) {
+        total += latency;
+    }
+    std::printf("range    %d of 10 ms (%zu points each): %.1f us mean, %.1f us p50, %.1f us p99, %.1f us max,"
+                " %.0f M points/s\n", kRanges, points / kRanges, total / kRanges * 1e6,
+                latencies[kRanges / 2] * 1e6, latencies[kRanges * 99 / 100] * 1e6, latencies.back() * 1e6,
+                points / total / 1e6);
+    if (points != (size_t)kRanges * (kRangeNs / kPeriod)) {
+        std::printf("ranges gave %zu points, sum %lld\n", points, (long long)sum);
+        wrong++;
+    }
+    if (!keep) {
+        std::filesystem::remove(path);
+        std::filesystem::remove(index_path(path));
+    }
+    return wrong ? 1 : 0;
+}
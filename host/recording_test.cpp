@@ -0,0 +1,245 @@
+/*******************************************************************************
+* File Name: recording_test.cpp
+*
+* Description:
+*  Checks the recordings: what is written is read back, times are found in
+*  evenly and unevenly spaced blocks, and a writer that dies part way leaves
+*  a recording that opens with everything that made it to the disk
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "crc32c.h"
+#include "host_test.h"
+#include "recording.h"
+
+using namespace amperometry;
+
+static const uint32_t kPeriod = 1000;  // ns, a 1 MHz adc
+
+static std::string test_path(const char *name) {
+    std::filesystem::path path = std::filesystem::temp_directory_path() /
+                                 ("recording_test_" + std::to_string(getpid()) + "_" + name);
+    std::filesystem::remove(path);
+    std::filesystem::remove(index_path(path));
+    return path;
+}
+
+static void remove_recording(const std::string &path) {
+    std::filesystem::remove(path);
+    std::filesystem::remove(index_path(path));
+}
+
+static RecordingHeader test_header(bool pairs) {
+    DeviceHeader device{};
+    device.firmware_version = 7;
+    device.unique_id[0] = 0x12345678;
+    device.unique_id[1] = 0x9ABCDEF0;
+    device.dac_source = kVdacIsDvdac;
+    device.tia_resistor = 3;
+    device.sample_period_ns = kPeriod;
+    ExportFormat format{};
+    format.pairs = pairs;
+    format.calibrated = 1;
+    format.femtoamps_per_count = 50000;
+    format.zero_count = -4;
+    for (int i = 0; i < 2*kCalibrationPoints; i++) {
+        format.calibration[i] = i * 11;
+    }
+    return make_recording_header(device, format, 1700000000000000000LL);
+}
+
+// counts that tell where they came from, point n of the recording is n * 3 (as int16)
+static std::vector<int16_t> block_counts(uint64_t first_point, size_t points, bool pairs) {
+    std::vector<int16_t> counts;
+    for (size_t i = 0; i < points; i++) {
+        if (pairs) {
+            counts.push_back((int16_t)(first_point + i));
+        }
+        counts.push_back((int16_t)((first_point + i) * 3));
+    }
+    return counts;
+}
+
+static void append_block(RecordingWriter &writer, int64_t time_ns, size_t points, bool pairs) {
+    std::vector<int16_t> counts = block_counts(writer.points(), points, pairs);
+    writer.append(time_ns, CountView((const uint8_t*)counts.data(), points, pairs), 3, 0);
+}
+
+static void test_crc() {
+    const char *check = "123456789";
+    HOST_CHECK(crc32c(check, 9) == 0xE3069283);
+    HOST_CHECK(crc32c_scalar(check, 9) == 0xE3069283);
+    std::vector<uint8_t> bytes(1001);
+    for (size_t i = 0; i < bytes.size(); i++) {
+        bytes[i] = (uint8_t)(i * 7 + 1);
+    }
+    HOST_CHECK(crc32c(bytes.data(), bytes.size()) == crc32c_scalar(bytes.data(), bytes.size()));
+    HOST_CHECK(crc32c(bytes.data() + 100, 901, crc32c(bytes.data(), 100)) == crc32c(bytes.data(), 1001));
+}
+
+static void test_write_read(bool pairs) {
+    std::string path = test_path(pairs ? "pairs" : "counts");
+    const size_t points = 1000;
+    {
+        RecordingWriter writer = RecordingWriter::create(path, test_header(pairs), 4096);
+        for (int block = 0; block < 50; block++) {
+            append_block(writer, block * (int64_t)points * kPeriod, points, pairs);
+        }
+        HOST_CHECK(writer.points() == 50 * points);
+    }
+    RecordingReader reader(path);
+    HOST_CHECK(reader.blocks() == 50);
+    HOST_CHECK(reader.header().unique_id[1] == 0x9ABCDEF0);
+    HOST_CHECK((reader.header().pairs != 0) == pairs);
+    HOST_CHECK(reader.header().calibration[9] == 99);
+    HOST_CHECK(reader.header().zero_count == -4);
+    bool same = true;
+    for (size_t block = 0; block < reader.blocks(); block++) {
+        CountView view = reader.points(block);
+        HOST_CHECK(reader.check_block(block));
+        for (size_t i = 0; i < view.size(); i++) {
+            same = same && (view[i] == (int16_t)((block * points + i) * 3));
+        }
+    }
+    HOST_CHECK(same);
+
+    HOST_CHECK(reader.find_block(-5) == 0);
+    HOST_CHECK(reader.find_block(0) == 0);
+    HOST_CHECK(reader.find_block(points * kPeriod - 1) == 0);
+    HOST_CHECK(reader.find_block(points * kPeriod) == 1);
+    HOST_CHECK(reader.find_block(1000000000) == 49);
+
+    // 2.5 blocks from the middle of block 3, the start is rounded up to the next point
+    int64_t start = 3500 * (int64_t)kPeriod - 10;
+    std::vector<TimedPoints> parts = reader.range(start, start + 2500 * (int64_t)kPeriod);
+    HOST_CHECK(parts.size() == 3);
+    if (parts.size() == 3) {
+        HOST_CHECK((parts[0].first_point == 3500) && (parts[0].time_ns == 3500 * (int64_t)kPeriod));
+        HOST_CHECK((parts[0].points.size() == 500) && (parts[0].points[0] == (int16_t)(3500 * 3)));
+        HOST_CHECK(parts[1].points.size() == 1000);
+        HOST_CHECK((parts[2].first_point == 5000) && (parts[2].points.size() == 1000));
+        HOST_CHECK(!pairs || (parts[2].points.dac_value(1) == 5001));
+    }
+    HOST_CHECK(reader.range(start, start).empty());
+    HOST_CHECK(reader.range(-100, 1).size() == 1);
+
+    bool thrown = false;
+    try {
+        RecordingWriter writer = RecordingWriter::open(path);
+        append_block(writer, 0, 10, pairs);  // before the last block
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    HOST_CHECK(thrown);
+    remove_recording(path);
+}
+
+static void test_uneven_blocks() {
+    // blocks of different lengths with gaps, the guess is wrong and the search has to find them
+    std::string path = test_path("uneven");
+    std::vector<int64_t> times;
+    {
+        RecordingWriter writer = RecordingWriter::create(path, test_header(false));
+        int64_t time = 0;
+        for (int block = 0; block < 300; block++) {
+            size_t points = 1 + (block * 37) % 200;
+            times.push_back(time);
+            append_block(writer, time, points, false);
+            time += points * kPeriod + ((block % 50 == 0) ? 10000000 : 0);
+        }
+    }
+    RecordingReader reader(path);
+    HOST_CHECK(reader.blocks() == times.size());
+    bool found = true;
+    for (int64_t time = -1000; time < times.back() + 500000; time += 7919) {
+        size_t expected = 0;
+        while ((expected + 1 < times.size()) && (times[expected + 1] <= time)) {
+            expected++;
+        }
+        found = found && (reader.find_block(time) == expected);
+    }
+    HOST_CHECK(found);
+    remove_recording(path);
+}
+
+static void test_crash() {
+    std::string path = test_path("crash");
+    // a writer that commits 20 blocks, writes 10 more and dies before it syncs them
+    pid_t child = fork();
+    if (child == 0) {
+        RecordingWriter writer = RecordingWriter::create(path, test_header(false), 1 << 30);
+        for (int block = 0; block < 20; block++) {
+            append_block(writer, block * 100 * (int64_t)kPeriod, 100, false);
+        }
+        writer.commit();
+        for (int block = 20; block < 30; block++) {
+            append_block(writer, block * 100 * (int64_t)kPeriod, 100, false);
+        }
+        std::vector<int16_t> big(600000);  // over the write size so it gets to the file
+        writer.append(30 * 100 * (int64_t)kPeriod, CountView((const uint8_t*)big.data(), big.size(), false), 3, 0);
+        _exit(0);
+    }
+    int status;
+    waitpid(child, &status, 0);
+    HOST_CHECK(WIFEXITED(status));
+    {
+        RecordingReader reader(path);
+        HOST_CHECK(reader.blocks() == 20);
+    }
+
+    // the last block is cut short like a write that did not finish, and the index has half an entry
+    uint64_t data_size = std::filesystem::file_size(path);
+    std::filesystem::resize_file(path, data_size - 100);
+    {
+        int fd = ::open(index_path(path).c_str(), O_WRONLY | O_APPEND);
+        IndexEntry half{};
+        HOST_CHECK(write(fd, &half, sizeof(half) / 2) == sizeof(half) / 2);
+        ::close(fd);
+    }
+    {
+        RecordingWriter writer = RecordingWriter::open(path);
+        HOST_CHECK(writer.blocks() == 30);
+        HOST_CHECK(writer.points() == 3000);
+        append_block(writer, 40 * 100 * (int64_t)kPeriod, 100, false);
+    }
+    RecordingReader reader(path);
+    HOST_CHECK(reader.blocks() == 31);
+    bool good = true;
+    for (size_t block = 0; block < reader.blocks(); block++) {
+        good = good && reader.check_block(block);
+    }
+    HOST_CHECK(good);
+    HOST_CHECK(reader.entry(30).first_point == 3000);
+    HOST_CHECK(reader.points(30)[99] == (int16_t)(3099 * 3));
+    HOST_CHECK(reader.find_block(35 * 100 * (int64_t)kPeriod) == 29);
+    remove_recording(path);
+
+    bool thrown = false;
+    try {
+        RecordingReader missing(path);
+    } catch (const std::system_error&) {
+        thrown = true;
+    }
+    HOST_CHECK(thrown);
+}
+
+int main() {
+    test_crc();
+    test_write_read(false);
+    test_write_read(true);
+    test_uneven_blocks();
+    test_crash();
+    return host_test_failures;
+}
@@ -0,0 +1,138 @@
+/*******************************************************************************
+* File Name: savitzky_golay.cpp
+*
+* Description:
+*  Savitzky-Golay weights and the filter, see savitzky_golay.h
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include <cmath>
+#include <stdexcept>
+
+#include "savitzky_golay.h"
+#include "simd.h"
+
+namespace amperometry {
+
+SavitzkyGolay::SavitzkyGolay(int half_window, int order, int derivative, double spacing)
+    : half_window_(half_window) {
+    int terms = order + 1;
+    if ((half_window < 1) || (order < 0) || (terms > 2*half_window + 1) || (derivative < 0) ||
+        (derivative > order) || (spacing <= 0)) {
+        throw std::invalid_argument("Savitzky-Golay window, order and derivative do not fit together");
+    }
+    // normal equations of the fit, (A^T A) c = A^T y with A[k][j] = k^j
+    std::vector<double> normal(terms * terms, 0.0);
+    for (int k = -half_window; k <= half_window; k++) {
+        for (int row = 0; row < terms; row++) {
+            for (int col = 0; col < terms; col++) {
+                normal[row*terms + col] += std::pow(k, row + col);
+            }
+        }
+    }
+    // solve for the row of the inverse that gives the wanted coefficient, Gauss-Jordan on a small matrix
+    std::vector<double> unit(terms, 0.0);
+    unit[derivative] = 1.0;
+    for (int col = 0; col < terms; col++) {
+        int pivot = col;
+        for (int row = col + 1; row < terms; row++) {
+            if (std::fabs(normal[row*terms + col]) > std::fabs(normal[pivot*terms + col])) {
+                pivot = row;
+            }
+        }
+        for (int j = 0; j < terms; j++) {
+            std::swap(normal[col*terms + j], normal[pivot*terms + j]);
+        }
+        std::swap(unit[col], unit[pivot]);
+        for (int row = 0; row < terms; row++) {
+            if (row == col) {
+                continue;
+            }
+            double factor = normal[row*terms + col] / normal[col*terms + col];
+            for (int j = 0; j < terms; j++) {
+                normal[row*terms + j] -= factor * normal[col*terms + j];
+            }
+            unit[row] -= factor * unit[col];
+        }
+    }
+    std::vector<double> solution(terms);
+    for (int row = 0; row < terms; row++) {
+        solution[row] = unit[row] / normal[row*terms + row];
+    }
+    // A^T A is symmetric so the solution is row 'derivative' of its inverse, times A^T gives the weights
+    double factorial = 1;
+    for (int i = 2; i <= derivative; i++) {
+        factorial *= i;
+    }
+    double scale = factorial / std::pow(spacing, derivative);
+    weights_.resize(2*half_window + 1);
+    for (int k = -half_window; k <= half_window; k++) {
+        double weight = 0;
+        for (int j = 0; j < terms; j++) {
+            weight += solution[j] * std::pow(k, j);
+        }
+        weights_[k + half_window] = (float)(weight * scale);
+    }
+}
+
+float SavitzkyGolay::edge_point(const float *in, size_t size, size_t index) const {
+    float sum = 0;
+    for (int k = -half_window_; k <= half_window_; k++) {
+        long j = (long)index + k;
+        if (j < 0) {  // mirror the trace at the ends
+            j = -j;
+        }
+        else if (j >= (long)size) {
+            j = 2*((long)size - 1) - j;
+        }
+        sum += weights_[k + half_window_] * in[j];
+    }
+    return sum;
+}
+
+__attribute__((optimize("no-tree-vectorize")))
+void SavitzkyGolay::apply_scalar(const float *in, float *out, size_t size) const {
+    size_t m = half_window_;
+    if (size <= m) {
+        throw std::invalid_argument("trace is shorter than the Savitzky-Golay half window");
+    }
+    for (size_t i = 0; i < size; i++) {
+        if ((i < m) || (i + m >= size)) {
+            out[i] = edge_point(in, size, i);
+            continue;
+        }
+        float sum = 0;
+        for (int k = -half_window_; k <= half_window_; k++) {
+            sum += weights_[k + half_window_] * in[i + k];
+        }
+        out[i] = sum;
+    }
+}
+
+void SavitzkyGolay::apply(const float *in, float *out, size_t size) const {
+    size_t m = half_window_;
+    if (size <= m) {
+        throw std::invalid_argument("trace is shorter than the Savitzky-Golay half window");
+    }
+    for (size_t i = 0; i < m; i++) {
+        out[i] = edge_point(in, size, i);
+    }
+    size_t i = m;
+    // 8 outputs at a time, each weight times the input shifted by its offset
+    for (; i + m + simd::kLanes <= size; i += simd::kLanes) {
+        simd::Floats sum = simd::splat(0);
+        const float *window = in + i - m;
+        for (size_t k = 0; k < weights_.size(); k++) {
+            sum += weights_[k] * simd::load(window + k);
+        }
+        simd::store(out + i, sum);
+    }
+    for (; i < size; i++) {
+        out[i] = edge_point(in, size, i);
+    }
+}
+
+}  // namespace amperometry
@@ -0,0 +1,44 @@
+/*******************************************************************************
+* File Name: savitzky_golay.h
+*
+* Description:
+*  Savitzky-Golay smoothing and derivatives.  Each output point is the value
+*  (or slope) at the middle of a polynomial fitted to the points around it by
+*  least squares, which comes down to a fixed set of weights.  The trace is
+*  mirrored at the ends so the output is as long as the input
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace amperometry {
+
+class SavitzkyGolay {
+public:
+    /* half_window: points on each side of the middle, the window is 2*half_window + 1
+       order: order of the polynomial, less than the window
+       derivative: 0 to smooth, 1 for the slope, 2 for the curvature
+       spacing: time (or potential) between the points, the derivatives are per unit of it */
+    SavitzkyGolay(int half_window, int order, int derivative = 0, double spacing = 1.0);
+
+    int half_window() const { return half_window_; }
+    const std::vector<float>& weights() const { return weights_; }
+
+    // out gets size points, in and out can not overlap, size has to be more than half_window
+    void apply(const float *in, float *out, size_t size) const;
+    void apply_scalar(const float *in, float *out, size_t size) const;
+
+private:
+    float edge_point(const float *in, size_t size, size_t index) const;
+
+    int half_window_;
+    std::vector<float> weights_;
+};
+
+}  // namespace amperometry
@@ -0,0 +1,70 @@
+/*******************************************************************************
+* File Name: simd.h
+*
+* Description:
+*  Vector types for the analysis code.  The GCC / Clang vector extensions are
+*  used so the same code becomes SSE, AVX or NEON for whatever the compiler
+*  targets, build with HOST_NATIVE on to use all of the computer's registers.
+*  Loads and stores go through memcpy so the data does not have to be aligned
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace amperometry {
+namespace simd {
+
+constexpr int kLanes = 8;
+
+typedef float Floats __attribute__((vector_size(kLanes * sizeof(float))));
+typedef int32_t Ints __attribute__((vector_size(kLanes * sizeof(int32_t))));
+typedef int16_t Shorts __attribute__((vector_size(kLanes * sizeof(int16_t))));
+typedef int16_t ShortPairs __attribute__((vector_size(2 * kLanes * sizeof(int16_t))));
+
+inline Floats load(const float *data) {
+    Floats value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+inline void store(float *data, Floats value) {
+    std::memcpy(data, &value, sizeof(value));
+}
+
+inline Floats splat(float value) {
+    return Floats{} + value;
+}
+
+inline Floats iota(float first) {
+    return Floats{0, 1, 2, 3, 4, 5, 6, 7} + first;
+}
+
+// 8 little endian int16 counts, every other one if pairs so the dac values are skipped
+inline Floats load_counts(const uint8_t *bytes, bool pairs) {
+    if (pairs) {
+        ShortPairs both;
+        std::memcpy(&both, bytes, sizeof(both));
+        Shorts currents = __builtin_shufflevector(both, both, 1, 3, 5, 7, 9, 11, 13, 15);
+        return __builtin_convertvector(currents, Floats);
+    }
+    Shorts counts;
+    std::memcpy(&counts, bytes, sizeof(counts));
+    return __builtin_convertvector(counts, Floats);
+}
+
+inline bool any(Ints mask) {
+    Ints folded = mask;
+    for (int i = 1; i < kLanes; i++) {
+        folded[0] |= mask[i];
+    }
+    return folded[0] != 0;
+}
+
+}  // namespace simd
+}  // namespace amperometry
@@ -0,0 +1,84 @@
+/*******************************************************************************
+* File Name: spsc_queue.h
+*
+* Description:
+*  A bounded queue between 1 producer thread and 1 consumer thread.  The
+*  slots are made once and filled in place, the producer writes into back()
+*  then push() hands it over, the consumer reads front() then pop() gives the
+*  slot back, so nothing is copied or allocated while it runs
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <stdexcept>
+
+namespace amperometry {
+
+template <typename T>
+class SpscQueue {
+public:
+    // capacity is rounded up to a power of 2
+    explicit SpscQueue(size_t capacity) {
+        if (capacity == 0) {
+            throw std::invalid_argument("SpscQueue needs at least 1 slot");
+        }
+        size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        mask_ = size - 1;
+        slots_ = std::make_unique<T[]>(size);
+    }
+
+    size_t capacity() const { return mask_ + 1; }
+
+    // producer: the slot to fill, nullptr if the queue is full
+    T* back() {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_cache_ > mask_) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (tail - head_cache_ > mask_) {
+                return nullptr;
+            }
+        }
+        return &slots_[tail & mask_];
+    }
+    void push() { tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    // consumer: the oldest slot, nullptr if the queue is empty
+    T* front() {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_cache_) {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if (head == tail_cache_) {
+                return nullptr;
+            }
+        }
+        return &slots_[head & mask_];
+    }
+    void pop() { head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    // either thread, the other can change it right after
+    size_t size() const { return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire); }
+    bool full() const { return size() > mask_; }
+
+private:
+    static constexpr size_t kCacheLine = 64;
+
+    std::unique_ptr<T[]> slots_;
+    size_t mask_ = 0;
+    alignas(kCacheLine) std::atomic<size_t> head_{0};  // next slot to read, moved by the consumer
+    size_t tail_cache_ = 0;  // the consumer's last look at tail_
+    alignas(kCacheLine) std::atomic<size_t> tail_{0};  // next slot to fill, moved by the producer
+    size_t head_cache_ = 0;  // the producer's last look at head_
+};
+
+}  // namespace amperometry
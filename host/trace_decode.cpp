@@ -0,0 +1,165 @@
+/*******************************************************************************
+* File Name: trace_decode.cpp
+*
+* Description:
+*  Read the 'UT' event trace into a timeline, see trace_decode.h
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include "trace_decode.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace amperometry {
+
+static double cycles_to_us(uint32_t cycles) {
+    return cycles * 1e6 / kBusClockHz;
+}
+
+std::optional<Timeline> decode_trace(std::span<const uint8_t> bytes) {
+    TraceHeader header;
+    if (bytes.size() < sizeof(header)) {
+        return std::nullopt;
+    }
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (!has_tag(&header, 'T', 'R') || (bytes.size() < sizeof(header) + header.count * sizeof(TraceEvent))) {
+        return std::nullopt;
+    }
+    Timeline timeline{};
+    timeline.lost = header.lost;
+    std::vector<size_t> exports;  // the exports going, innermost last
+    double time_us = 0;
+    for (uint16_t i = 0; i < header.count; i++) {
+        TimelineEvent item{};
+        std::memcpy(&item.event, bytes.data() + sizeof(header) + i*sizeof(TraceEvent), sizeof(TraceEvent));
+        if (i > 0) {  // the unsigned difference is right across the counter wrapping
+            time_us += cycles_to_us(item.event.time - timeline.events.back().event.time);
+        }
+        item.time_us = time_us;
+        item.before_dump_us = cycles_to_us(header.now - item.event.time);
+
+        switch (item.event.event) {
+            case kTraceExportStart:
+                exports.push_back(timeline.events.size());
+                break;
+            case kTraceExportNested:
+                timeline.nested_exports++;
+                break;
+            case kTraceExportEnd:
+            case kTraceExportAbort:
+                if (!exports.empty()) {
+                    item.export_us = time_us - timeline.events[exports.back()].time_us;
+                    timeline.longest_export_us = std::max(timeline.longest_export_us, item.export_us);
+                    exports.pop_back();
+                }
+                break;
+            default:
+                break;
+        }
+        timeline.events.push_back(item);
+    }
+    timeline.unfinished_exports = exports.size();
+    return timeline;
+}
+
+static std::string letter(uint8_t value) {
+    char text[8];
+    if ((value >= ' ') && (value < 0x7F)) {
+        std::snprintf(text, sizeof(text), "'%c'", value);
+    }
+    else {
+        std::snprintf(text, sizeof(text), "0x%02X", value);
+    }
+    return text;
+}
+
+static const char* isr_name(uint8_t isr) {
+    switch (isr) {
+        case 'd': return "dac";  // TRACE_ISR_DAC
+        case 'a': return "adc";  // TRACE_ISR_ADC
+        case 't': return "tick";  // TRACE_ISR_TICK
+        default: return "unknown";
+    }
+}
+
+std::string describe_event(const TraceEvent &event) {
+    char text[96];
+    switch (event.event) {
+        case kTraceCommand:
+            std::snprintf(text, sizeof(text), "command %s %s", letter(event.arg8).c_str(),
+                          letter(event.arg16 & 0xFF).c_str());
+            break;
+        case kTraceIsrEnable:
+        case kTraceIsrDisable:
+            std::snprintf(text, sizeof(text), "isr %s %s", isr_name(event.arg8),
+                          (event.event == kTraceIsrEnable) ? "enabled" : "disabled");
+            if ((event.arg8 == 't') && (event.arg16 == 1)) {
+                std::strcat(text, " (amperometry)");
+            }
+            else if (event.arg8 == 't') {
+                std::strcat(text, " (other tick mode)");
+            }
+            break;
+        case kTraceBufferFull:
+            std::snprintf(text, sizeof(text), "buffer %u full, %u points", event.arg8, event.arg16);
+            break;
+        case kTraceExportStart:
+            std::snprintf(text, sizeof(text), "export start %s, %u bytes", letter(event.arg8).c_str(), event.arg16);
+            break;
+        case kTraceExportEnd:
+            std::snprintf(text, sizeof(text), "export end %s, %u us waiting on the IN endpoint%s",
+                          letter(event.arg8).c_str(), event.arg16, (event.arg16 == 0xFFFF) ? " or more" : "");
+            break;
+        case kTraceExportNested:
+            std::snprintf(text, sizeof(text), "NESTED export %s, %u bytes inside another",
+                          letter(event.arg8).c_str(), event.arg16);
+            break;
+        case kTraceExportAbort:
+            std::snprintf(text, sizeof(text), "export aborted %s, %u bytes not sent", letter(event.arg8).c_str(),
+                          event.arg16);
+            break;
+        case kTraceQueueDrop:
+            std::snprintf(text, sizeof(text), "command queue full, %s dropped", letter(event.arg8).c_str());
+            break;
+        case kTraceUrgentStop:
+            std::snprintf(text, sizeof(text), "stop seen in the OUT endpoint isr");
+            break;
+        case kTraceRunDone:
+            std::snprintf(text, sizeof(text), "run %s done, %u points", letter(event.arg8).c_str(), event.arg16);
+            break;
+        default:
+            std::snprintf(text, sizeof(text), "event %u arg8 %u arg16 %u", event.event, event.arg8, event.arg16);
+            break;
+    }
+    return text;
+}
+
+std::string format_timeline(const Timeline &timeline) {
+    std::string lines;
+    char line[192];
+    std::snprintf(line, sizeof(line), "%zu events, %u lost before them, %zu nested exports, %zu unfinished,"
+                  " longest export %.1f us\n", timeline.events.size(), timeline.lost, timeline.nested_exports,
+                  timeline.unfinished_exports, timeline.longest_export_us);
+    lines += line;
+    lines += "      time us      step us   before dump us  event\n";
+    for (size_t i = 0; i < timeline.events.size(); i++) {
+        const TimelineEvent &item = timeline.events[i];
+        double step_us = (i > 0) ? item.time_us - timeline.events[i - 1].time_us : 0;
+        int size = std::snprintf(line, sizeof(line), "%13.2f %12.2f %16.2f  %s", item.time_us, step_us,
+                                 item.before_dump_us, describe_event(item.event).c_str());
+        lines.append(line, std::min<size_t>(size, sizeof(line) - 1));
+        if (item.export_us > 0) {
+            std::snprintf(line, sizeof(line), " (took %.2f us)", item.export_us);
+            lines += line;
+        }
+        lines += "\n";
+    }
+    return lines;
+}
+
+}  // namespace amperometry
@@ -0,0 +1,67 @@
+/*******************************************************************************
+* File Name: trace_decode.h
+*
+* Description:
+*  Read the event trace the 'UT' command dumps (trace.h in the firmware) into
+*  a timeline.  The event times are the 32 bit bus clock cycle counter, each
+*  event is timed from the one before it so the counter wrapping around does
+*  not matter as long as no 2 events are more than 179 s apart.  The exports
+*  are paired up so the time each took and the ones started inside another
+*  (which mix their bytes on the USB) stand out
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "device_records.h"
+
+namespace amperometry {
+
+// TRACE_XXX event codes of trace.h
+enum TraceCode : uint8_t {
+    kTraceCommand = 1,
+    kTraceIsrEnable = 2,
+    kTraceIsrDisable = 3,
+    kTraceBufferFull = 4,
+    kTraceExportStart = 5,
+    kTraceExportEnd = 6,
+    kTraceExportNested = 7,
+    kTraceExportAbort = 8,
+    kTraceQueueDrop = 9,
+    kTraceUrgentStop = 10,
+    kTraceRunDone = 11,
+};
+
+struct TimelineEvent {
+    TraceEvent event;
+    double time_us;  // from the oldest event in the dump
+    double before_dump_us;  // how long before the dump started
+    double export_us;  // for an export end, from its start, else 0
+};
+
+struct Timeline {
+    uint32_t lost;  // events written over before the dump
+    std::vector<TimelineEvent> events;  // oldest first
+    size_t nested_exports;
+    size_t unfinished_exports;  // started with no end in the dump
+    double longest_export_us;
+};
+
+// a dump as 'UT' sends it, nullopt if the bytes do not start with a whole one
+std::optional<Timeline> decode_trace(std::span<const uint8_t> bytes);
+// what happened, e.g. "command 'M' 0x7C" or "isr tick enabled (amperometry)"
+std::string describe_event(const TraceEvent &event);
+// a line for each event: time, time since the one before, what happened
+std::string format_timeline(const Timeline &timeline);
+
+}  // namespace amperometry
@@ -0,0 +1,90 @@
+/*******************************************************************************
+* File Name: trace_decode_test.cpp
+*
+* Description:
+*  Checks the event trace timeline: times across the cycle counter wrapping,
+*  the exports paired up with one nested inside another, and dumps that are
+*  cut short
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "host_test.h"
+#include "trace_decode.h"
+
+using namespace amperometry;
+
+static const uint32_t kCyclesPerUs = 24;
+
+static std::vector<uint8_t> dump(const std::vector<TraceEvent> &events, uint32_t now, uint32_t lost) {
+    TraceHeader header{{'T', 'R'}, (uint16_t)events.size(), now, lost};
+    std::vector<uint8_t> bytes(sizeof(header) + events.size() * sizeof(TraceEvent));
+    std::memcpy(bytes.data(), &header, sizeof(header));
+    std::memcpy(bytes.data() + sizeof(header), events.data(), events.size() * sizeof(TraceEvent));
+    return bytes;
+}
+
+static bool near(double value, double expected) {
+    return std::fabs(value - expected) < 0.01;
+}
+
+static void test_timeline() {
+    // a command 10 us before the counter wraps, then an export with a Done from the isr inside it
+    uint32_t start = 0xFFFFFFFF - 10 * kCyclesPerUs + 1;
+    std::vector<TraceEvent> events = {
+        {start, kTraceCommand, 'M', '|'},
+        {start + 20 * kCyclesPerUs, kTraceIsrEnable, 't', 1},
+        {start + 50 * kCyclesPerUs, kTraceExportStart, 'E', 208},
+        {start + 60 * kCyclesPerUs, kTraceBufferFull, 2, 1000},
+        {start + 61 * kCyclesPerUs, kTraceExportNested, 'D', 6},
+        {start + 61 * kCyclesPerUs, kTraceExportStart, 'D', 6},
+        {start + 65 * kCyclesPerUs, kTraceExportEnd, 'D', 3},
+        {start + 150 * kCyclesPerUs, kTraceExportEnd, 'E', 80},
+        {start + 151 * kCyclesPerUs, kTraceExportStart, 'E', 16},
+    };
+    std::optional<Timeline> timeline = decode_trace(dump(events, start + 200 * kCyclesPerUs, 3));
+    HOST_CHECK(timeline.has_value());
+    if (!timeline) {
+        return;
+    }
+    HOST_CHECK(timeline->lost == 3);
+    HOST_CHECK(timeline->events.size() == events.size());
+    HOST_CHECK(near(timeline->events[1].time_us, 20));  // across the wrap
+    HOST_CHECK(near(timeline->events[8].time_us, 151));
+    HOST_CHECK(near(timeline->events[0].before_dump_us, 200));
+    HOST_CHECK(near(timeline->events[6].export_us, 4));  // the nested one ends first
+    HOST_CHECK(near(timeline->events[7].export_us, 100));
+    HOST_CHECK(near(timeline->longest_export_us, 100));
+    HOST_CHECK(timeline->nested_exports == 1);
+    HOST_CHECK(timeline->unfinished_exports == 1);
+
+    HOST_CHECK(describe_event(events[0]) == "command 'M' '|'");
+    HOST_CHECK(describe_event(events[1]) == "isr tick enabled (amperometry)");
+    HOST_CHECK(describe_event(events[3]) == "buffer 2 full, 1000 points");
+    std::string text = format_timeline(*timeline);
+    HOST_CHECK(text.find("NESTED export 'D'") != std::string::npos);
+    HOST_CHECK(text.find("(took 100.00 us)") != std::string::npos);
+}
+
+static void test_short_dumps() {
+    std::vector<TraceEvent> events = {{100, kTraceUrgentStop, 0, 0}, {200, kTraceRunDone, 'R', 10}};
+    std::vector<uint8_t> bytes = dump(events, 300, 0);
+    HOST_CHECK(!decode_trace(std::span<const uint8_t>(bytes.data(), bytes.size() - 1)));
+    HOST_CHECK(!decode_trace(std::span<const uint8_t>(bytes.data(), 5)));
+    bytes[0] = 'X';
+    HOST_CHECK(!decode_trace(bytes));
+    std::optional<Timeline> empty = decode_trace(dump({}, 0, 0));
+    HOST_CHECK(empty && empty->events.empty());
+}
+
+int main() {
+    test_timeline();
+    test_short_dumps();
+    return host_test_failures;
+}
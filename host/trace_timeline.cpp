@@ -0,0 +1,50 @@
+/*******************************************************************************
+* File Name: trace_timeline.cpp
+*
+* Description:
+*  Print the timeline of an event trace saved from the 'UT' command, the
+*  bytes as the device sent them from the TraceHeader on
+*
+*  trace_timeline [FILE]
+*
+*  With no file the dump is read from stdin
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include <cstdio>
+#include <vector>
+
+#include "trace_decode.h"
+
+using namespace amperometry;
+
+int main(int argc, char **argv) {
+    if (argc > 2) {
+        std::fprintf(stderr, "usage: %s [FILE]\n", argv[0]);
+        return 2;
+    }
+    std::FILE *input = (argc == 2) ? std::fopen(argv[1], "rb") : stdin;
+    if (!input) {
+        std::perror(argv[1]);
+        return 1;
+    }
+    std::vector<uint8_t> bytes;
+    uint8_t buffer[4096];
+    size_t got;
+    while ((got = std::fread(buffer, 1, sizeof(buffer), input)) > 0) {
+        bytes.insert(bytes.end(), buffer, buffer + got);
+    }
+    if (input != stdin) {
+        std::fclose(input);
+    }
+    std::optional<Timeline> timeline = decode_trace(bytes);
+    if (!timeline) {
+        std::fprintf(stderr, "not a whole trace dump, it starts with a \"TR\" TraceHeader\n");
+        return 1;
+    }
+    std::fputs(format_timeline(*timeline).c_str(), stdout);
+    return 0;
+}
@@ -0,0 +1,157 @@
+/*******************************************************************************
+* File Name: ir_compensation.c
+*
+* Description:
+*  Positive feedback iR drop compensation.  Each dac value is moved by the
+*  last measured current times the resistance between the SC block and the 
+*  electrode, so there is 1 data point of delay in the loop.  The correction
+*  is limited in size and in how much it can change each data point to keep
+*  the loop stable.  IR_Correct does not use the hardware so it can be run 
+*  on a computer against a model of a cell
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include "ir_compensation.h"
+#include "calibrate.h"
+#include "DAC.h"
+
+uint8 ir_enabled = false;
+int16 ir_last_current = 0;
+
+static int32 gain_q16;  // dac counts per adc count with 16 fractional bits
+static int16 zero_count;  // adc reading with no current
+static int32 correction_limit;
+static int32 step_limit;
+static int32 correction;  // correction put on the last dac value
+
+
+/******************************************************************************
+* Function Name: IR_Configure
+*******************************************************************************
+*
+* Summary:
+*  Turn on the compensation for a resistance using the last calibration 
+*  (calibrate_array) to change adc counts into current
+*
+* Parameters:
+*  int32 resistance_ohms: resistance to compensate, the sign sets the direction of the correction
+*  uint16 max_correction: largest correction allowed in dac counts
+*  uint16 max_step: largest change in the correction between 2 data points in dac counts
+*
+* Return:
+*  true if the compensation was turned on, false if there is no calibration or the gain is too large
+*
+*******************************************************************************/
+
+uint8 IR_Configure(int32 resistance_ohms, uint16 max_correction, uint16 max_step) {
+    // the highest sink and source calibration points give the adc counts per IDAC bit
+    int32 idac_span = calibrate_array.data[0] + calibrate_array.data[4];
+    int32 count_span = calibrate_array.data[9] - calibrate_array.data[5];
+    if ((idac_span == 0) || (count_span == 0) || (dac_ground_value == 0)) {
+        return false;
+    }
+    // mV per dac count, 1 for the DVDAC and 16 for the VDAC
+    float32 mv_per_dac_count = (float32)VIRTUAL_GROUND / dac_ground_value;
+    float32 na_per_count = (float32)IR_IDAC_NA_PER_BIT * idac_span / count_span;
+    // nA * ohms = nV so divide by 1e6 to get mV
+    float32 dac_per_count = na_per_count * resistance_ohms / (1000000.0f * mv_per_dac_count);
+    float32 gain = dac_per_count * 65536.0f;
+    if ((gain > IR_MAX_GAIN_Q16) || (gain < -IR_MAX_GAIN_Q16)) {
+        return false;
+    }
+    IR_SetGain((int32)gain, calibrate_array.data[7], max_correction, max_step);
+    return true;
+}
+
+/******************************************************************************
+* Function Name: IR_SetGain
+*******************************************************************************
+*
+* Summary:
+*  Turn on the compensation with a known gain
+*
+* Parameters:
+*  int32 _gain_q16: dac counts per adc count with 16 fractional bits
+*  int16 zero_current_count: adc reading with no current
+*  uint16 max_correction: largest correction allowed in dac counts
+*  uint16 max_step: largest change in the correction between 2 data points in dac counts
+*
+*******************************************************************************/
+
+void IR_SetGain(int32 _gain_q16, int16 zero_current_count, uint16 max_correction, uint16 max_step) {
+    gain_q16 = _gain_q16;
+    zero_count = zero_current_count;
+    correction_limit = max_correction;
+    step_limit = max_step;
+    IR_Reset();
+    ir_enabled = true;
+}
+
+void IR_Disable(void) {
+    ir_enabled = false;
+    correction = 0;
+}
+
+/******************************************************************************
+* Function Name: IR_Reset
+*******************************************************************************
+*
+* Summary:
+*  Start a run with no correction, call before the adc isr is enabled so the
+*  first dac value does not get the correction or current left by the last run
+*
+*******************************************************************************/
+
+void IR_Reset(void) {
+    correction = 0;
+    ir_last_current = zero_count;
+}
+
+/******************************************************************************
+* Function Name: IR_Correct
+*******************************************************************************
+*
+* Summary:
+*  Add the iR drop of the last measured current to a dac value, the result is
+*  kept in the range of the selected dac so the 8-bit VDAC does not wrap
+*
+* Parameters:
+*  uint16 dac_value: dac value of the waveform
+*  int16 current: last adc reading
+*
+* Return:
+*  uint16: dac value to use
+*
+*******************************************************************************/
+
+uint16 IR_Correct(uint16 dac_value, int16 current) {
+    int32 target = ((int64)(current - zero_count) * gain_q16) / 65536;
+    
+    if (target > correction + step_limit) {
+        target = correction + step_limit;
+    }
+    else if (target < correction - step_limit) {
+        target = correction - step_limit;
+    }
+    if (target > correction_limit) {
+        target = correction_limit;
+    }
+    else if (target < -correction_limit) {
+        target = -correction_limit;
+    }
+    correction = target;
+    
+    int32 value = (int32)dac_value + correction;
+    if (value < 0) {
+        value = 0;
+    }
+    else if (value > DAC_MaxValue()) {
+        value = DAC_MaxValue();
+    }
+    return value;
+}
+
+/* [] END OF FILE */
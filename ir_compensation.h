@@ -0,0 +1,47 @@
+/*******************************************************************************
+* File Name: ir_compensation.h
+*
+* Description:
+*  This file contains the function prototypes and constants used for
+*  the positive feedback iR drop compensation
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#if !defined(IR_COMPENSATION_H)
+#define IR_COMPENSATION_H
+
+#include "cytypes.h"
+#include "globals.h"
+
+/**************************************
+*      Constants
+**************************************/
+
+#define IR_IDAC_NA_PER_BIT 125  // calibration IDAC is 1/8 uA per bit
+#define IR_MAX_GAIN_Q16 (1L << 20)  // 16 dac counts per adc count, larger gains are not stable
+
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+uint8 IR_Configure(int32 resistance_ohms, uint16 max_correction, uint16 max_step);
+void IR_SetGain(int32 gain_q16, int16 zero_current_count, uint16 max_correction, uint16 max_step);
+void IR_Disable(void);
+void IR_Reset(void);
+uint16 IR_Correct(uint16 dac_value, int16 current);
+
+
+/***************************************
+* Global variables external identifier
+***************************************/
+
+extern uint8 ir_enabled;
+extern int16 ir_last_current;  // latest adc reading, set by the adc isr
+
+#endif
+
+/* [] END OF FILE */
@@ -0,0 +1,107 @@
+/*******************************************************************************
+* File Name: ir_compensation_test.c
+*
+* Description:
+*  Checks the iR drop compensation on a computer.  IR_Correct drives a
+*  simulated Randles cell the way the dac isr does, 1 data point behind the
+*  current, and the potential on the electrode is compared with the waveform
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include <math.h>
+
+#include "DAC.h"
+#include "ir_compensation.h"
+#include "sim_cell.h"
+#include "sim_test.h"
+
+#define TEST_RU 1000.0
+#define TEST_RCT 10000.0
+#define TEST_CDL 1e-6
+#define TEST_NA_PER_COUNT 10.0
+#define TEST_TICK_SECONDS 1e-3
+#define TEST_STEP 200  // dac counts above ground, 200 mV with the DVDAC
+#define TEST_TICKS 200
+
+/* hold a potential step on the cell and return the error on the electrode at
+   the end, the largest change of the dac in the last 20 ticks is put in wobble */
+static float64 run_step(uint8 compensate, uint16 *wobble) {
+    struct SimCell cell;
+    SimCell_Randles(&cell, TEST_RU, TEST_RCT, TEST_CDL);
+    cell.na_per_adc_count = TEST_NA_PER_COUNT;
+    uint16 target = cell.dac_ground + TEST_STEP;
+    uint16 dac_value = target;
+    uint16 low = 0xFFFF, high = 0;
+
+    IR_Reset();
+    for (int tick = 0; tick < TEST_TICKS; tick++) {
+        if (compensate) {
+            dac_value = IR_Correct(target, ir_last_current);
+        }
+        SimCell_Advance(&cell, dac_value, TEST_TICK_SECONDS);
+        ir_last_current = SimCell_Reading(&cell);
+        if (tick >= TEST_TICKS - 20) {
+            low = (dac_value < low) ? dac_value : low;
+            high = (dac_value > high) ? dac_value : high;
+        }
+    }
+    *wobble = high - low;
+    return fabs(SimCell_ElectrodeMv(&cell, dac_value) - TEST_STEP);
+}
+
+static void test_step_on_cell(void) {
+    // 90% of Ru, dac counts per adc count is nA per count * ohms / 1e6 at 1 mV per count
+    int32 gain_q16 = (int32)(0.9 * TEST_NA_PER_COUNT * TEST_RU / 1e6 * 65536);
+    uint16 wobble;
+
+    IR_SetGain(gain_q16, 0, 100, 10);
+    float64 plain_error = run_step(false, &wobble);
+    float64 compensated_error = run_step(true, &wobble);
+    // the cell leaves Ru / (Ru + Rct) of the step on Ru, 18 mV
+    SIM_CHECK(fabs(plain_error - TEST_STEP * TEST_RU / (TEST_RU + TEST_RCT)) < 0.5);
+    // 10% of the drop is left, with up to 1 mV from rounding the dac
+    SIM_CHECK(compensated_error < 0.1 * plain_error + 1);
+    SIM_CHECK(wobble <= 1);
+}
+
+static void test_limits(void) {
+    IR_SetGain(65536, 0, 50, 5);  // 1 dac count per adc count
+    SIM_CHECK(IR_Correct(1000, 100) == 1005);  // the step limit
+    SIM_CHECK(IR_Correct(1000, 100) == 1010);
+    IR_Reset();
+    SIM_CHECK(IR_Correct(1000, 0) == 1000);
+    for (int i = 0; i < 20; i++) {
+        IR_Correct(1000, 100);
+    }
+    SIM_CHECK(IR_Correct(1000, 100) == 1050);  // the correction limit
+
+    // a new run starts with no correction and no current left over
+    IR_Reset();
+    SIM_CHECK(IR_Correct(1000, ir_last_current) == 1000);
+
+    // the 8-bit VDAC would wrap above 255, the DVDAC goes to 4095
+    selected_voltage_source = VDAC_IS_VDAC;
+    IR_Reset();
+    for (int i = 0; i < 20; i++) {
+        IR_Correct(250, 100);
+    }
+    SIM_CHECK(IR_Correct(250, 100) == DAC_VDAC_MAX);
+    selected_voltage_source = VDAC_IS_DVDAC;
+    SIM_CHECK(IR_Correct(4090, 100) == DAC_DVDAC_MAX);
+    SIM_CHECK(IR_Correct(250, 100) == 300);
+    IR_SetGain(65536, 0, 50, 100);
+    SIM_CHECK(IR_Correct(20, -100) == 0);
+}
+
+int main(void) {
+    DAC_Start();
+    selected_voltage_source = VDAC_IS_DVDAC;
+    test_step_on_cell();
+    test_limits();
+    return sim_test_failures;
+}
+
+/* [] END OF FILE */
@@ -13,32 +13,53 @@
 #include <project.h>
 #include "stdio.h"
 #include "stdlib.h"
+#include "string.h"
 // local files
 #include "calibrate.h"
 #include "DAC.h"
 #include "globals.h"
 #include "helper_functions.h"
 #include "lut_protocols.h"
+#include "sequencer.h"
+#include "asv.h"
+#include "cv_features.h"
+#include "block_stats.h"
+#include "eis.h"
+#include "ir_compensation.h"
+#include "ocp.h"
+#include "data_export.h"
+#include "command_queue.h"
+#include "electrode_scan.h"
+#include "sample_clock.h"
+#include "waveform_upload.h"
+#include "mains_filter.h"
+#include "cv_average.h"
+#include "blank_subtract.h"
+#include "trace.h"
+#include "flash_log.h"
+#include "adaptive_cv.h"
+#include "adc_profile.h"
+#include "amperometry.h"
 #include "USB_protocols.h"
 
-// define how big to make the arrays for the lut for dac and how big
-// to make the adc data array 
-#define MAX_LUT_SIZE 5000
-#define ADC_CHANNELS 4
-
 #define Work_electrode_resistance 1400  // ohms, estimate of resistance from SC block to the working electrode pin
 
+// states of the pre-armed experiment start
+#define ARM_IDLE 0
+#define ARM_CV 1
+#define ARM_AMP 2
+#define ARM_BLOCK_STATS 3
+
+#define USB_WAIT_US 2000000  // time a computer has at power up to configure the usb before the device runs on its own
+
 struct TIAMux {
     uint8 use_extra_resistor;
     uint8 user_channel;
 };
 struct TIAMux tia_mux = {.use_extra_resistor = false, .user_channel = 0};
 
-union data_usb_union {
-    uint8 usb[2*MAX_LUT_SIZE];
-    int16 data[MAX_LUT_SIZE];
-};
 union data_usb_union ADC_array[ADC_CHANNELS];  // allocate space to put adc measurements
+uint8 adc_ring_channels = ADC_CHANNELS;  // blank_subtract.c takes BLANK_CHANNEL out of the ring when it saves a blank
 
 union small_data_usb_union {
     uint8 usb[64];
@@ -63,15 +84,23 @@ uint8 AMux_channel_select = 0;  // Let the user choose to use the two electrode
 uint16 timer_period;
 uint16 waveform_lut[MAX_LUT_SIZE];  // look up table for waveform values to put into msb DAC
 uint16 lut_index = 0;  // look up table index
-uint8 adc_recording_channel = 0;
 uint16 lut_value;  // value need to load DAC
 uint16 lut_length = 3000;  // how long the look up table is,initialize large so when starting isr the ending doesn't get triggered
 uint16 lut_hold = 0;
-uint8 adc_hold;
-uint8 counter = 0;
 uint16 buffer_size_bytes;
 uint16 buffer_size_data_pts = 4000;  // prevent the isr from firing
 uint16 dac_value_hold = 0;
+uint16 dac_applied = 0;  // dac value on the electrode, after the iR correction if it is on
+
+/* Variables for arming an experiment and measuring the time to the first sample */
+uint8 arm_state = ARM_IDLE;
+uint8 first_sample_pending = false;
+uint8 experiment_fired = false;  // a run has been started with FireExperiment, so 'PL' has times to report
+uint32 arm_timestamp;  // cycle counter values, see helper_ReadCycleCounter
+uint32 fire_timestamp;
+uint32 first_sample_timestamp;
+
+uint8 sw3_released = true;  // SW3 has to be let go between runs of the saved program
 
 
 /* function prototypes */
@@ -79,47 +108,118 @@ void HardwareSetup(void);
 void HardwareStart(void);
 void HardwareSleep(void);
 void HardwareWakeup(void);
+uint8 AdcRateAllowed(uint32 tick_ns);
+uint8 ArmCyclicVoltammetry(void);
+uint8 ArmAmperometry(uint16 dac_value, uint16 buffer_pts);
+void FireExperiment(void);
+void StartSequencer(uint16 block_size);
+void StartEIS(uint16 bias, uint16 amplitude, uint16 cycles);
+void StartScan(uint16 blank_ticks, uint16 dwell_ticks, uint16 block_size, uint16 rounds);
+void EnableTickInterrupt(cyisraddress tick_isr);
+void StartStoredProgram(uint8 power_up);
+void StartAdaptive(struct AdaptiveSettings *settings);
 uint16 Convert2Dec(uint8 array[], uint8 len);
+uint32 Convert2Dec32(uint8 array[], uint8 len);
 
 CY_ISR(dacInterrupt)
 {
     
-    DAC_SetValue(lut_value);
+    dac_applied = lut_value;
+    if (ir_enabled) {  // move the dac by the iR drop of the last current measured
+        dac_applied = IR_Correct(lut_value, ir_last_current);
+    }
+    DAC_SetValue(dac_applied);
     lut_index++;
     dac_value_hold = lut_value;
     if (lut_index >= lut_length) { // all the data points have been given
+        if (cv_average_cycles && CVAverage_EndCycle()) {  // play the look up table again with the same timing
+            lut_index = 0;
+            lut_value = waveform_lut[0];
+            return;
+        }
         isr_adc_Disable();
         isr_dac_Disable();
+        TRACE(TRACE_RUN_DONE, 'R', lut_index);
         //LCD_Position(1,0);
         //sprintf(LCD_str, "e2:%d|%d", lut_index, lut_length);
         //LCD_PrintString(LCD_str);
-        ADC_array[0].data[lut_index] = 0xC000;  // mark that the data array is done
+        ADC_array[0].data[lut_index] = ADC_DATA_DONE_CODE;  // mark that the data array is done
         HardwareSleep();
         lut_index = 0; 
-        USB_Export_Data((uint8*)"Done", 5); // calls a function in an isr but only after the current isr has been disabled
+        if (!cv_average_cycles) {  // an averaged run is finished by the main loop
+            Blank_EndRun(lut_length);  // saves the run if it was a blank capture
+            if (cv_features_mode != CV_FEATURES_ONLY) {
+                Export_Notify((uint8*)"Done", 5); // calls a function in an isr but only after the current isr has been disabled
+            }
+            if (cv_features_mode != CV_FEATURES_OFF) {
+                CVFeatures_EndCycle();  // the main loop will send the feature record
+            }
+        }
 
     }
     lut_value = waveform_lut[lut_index];
 }
 CY_ISR(adcInterrupt){
+    if (first_sample_pending) {
+        first_sample_timestamp = helper_ReadCycleCounter();
+        first_sample_pending = false;
+    }
     //ADC_array[0].data[lut_index] = ADC_SigDel_GetResult16(); 
     //ADC_array[0].data[lut_index] = lut_value;
-    ADC_array[0].data[lut_index] = dac_value_hold;
+    int16 current = AdcProfile_GetResult();
+    ir_last_current = current;  // for the iR compensation of the next dac value
+    current = Blank_Process(lut_index, current);  // background subtraction if it is on for this run
+    export_sequence = lut_index + 1;
+    if (cv_average_cycles) {  // the features are found from the average at the end
+        ADC_array[0].data[lut_index] = current;
+        CVAverage_AddSample(lut_index, current);
+    }
+    else if (cv_features_mode != CV_FEATURES_OFF) {  // the features need the current
+        ADC_array[0].data[lut_index] = current;
+        CVFeatures_AddSample(lut_index, dac_value_hold, current);
+    }
+    else if (blank_state != BLANK_IDLE) {  // the blank is made from and subtracted from the currents
+        ADC_array[0].data[lut_index] = current;
+    }
+    else {
+        ADC_array[0].data[lut_index] = dac_value_hold;
+    }
 }
 
 CY_ISR(adcAmpInterrupt){
-    ADC_array[adc_recording_channel].data[lut_index] = ADC_SigDel_GetResult16(); 
-    lut_index++;  
-    if (lut_index >= buffer_size_data_pts) {
-        ADC_array[adc_recording_channel].data[lut_index] = 0xC000;
-        counter += 1;
-        lut_index = 0;
-        adc_hold = adc_recording_channel;
-        adc_recording_channel = (adc_recording_channel + 1) % ADC_CHANNELS;
-        
-        sprintf(usb_str, "Done%d", adc_hold);  // tell the user the data is ready to pick up and which channel its on
-        USB_Export_Data((uint8*)usb_str, 6);  // use the 'F' command to retreive the data
+    if (first_sample_pending) {
+        first_sample_timestamp = helper_ReadCycleCounter();
+        first_sample_pending = false;
+    }
+    Amp_Sample();  // shared with the simulated board, see amperometry.c
+}
+
+CY_ISR(blockStatsInterrupt){
+    if (first_sample_pending) {
+        first_sample_timestamp = helper_ReadCycleCounter();
+        first_sample_pending = false;
     }
+    BlockStats_AddSample(AdcProfile_GetResult());
+}
+
+CY_ISR(sequencerInterrupt){
+    Sequencer_Tick();
+}
+
+CY_ISR(eisInterrupt){
+    EIS_Tick();
+}
+
+CY_ISR(ocpInterrupt){
+    OCP_Tick();
+}
+
+CY_ISR(scanInterrupt){
+    Scan_Tick();
+}
+
+CY_ISR(adaptiveInterrupt){
+    Adaptive_Tick();
 }
 
 int main()
@@ -131,65 +231,174 @@ int main()
     
     USBFS_Start(0, USBFS_DWR_VDDD_OPERATION);  // initialize the USB
     HardwareSetup();
-    while(!USBFS_bGetConfiguration());  //Wait till it the usb gets its configuration from the PC ??
+    helper_StartCycleCounter();
+    if (!FlashLog_Init()) {  // the program has grown into the top of the flash, LOG_FIRST_ROW has to move up
+        LCD_Position(1,0);
+        LCD_PrintString("No flash log");
+    }
+    uint32 usb_wait_start = helper_ReadCycleCounter();
+    while(!USBFS_bGetConfiguration() && (helper_CyclesToUs(helper_ReadCycleCounter() - usb_wait_start) < USB_WAIT_US));
     
     isr_dac_StartEx(dacInterrupt);
     isr_dac_Disable();  // disable interrupt until a voltage signal needs to be given
     isr_adc_StartEx(adcInterrupt);
     isr_adc_Disable();
     
-    USBFS_EnableOutEP(OUT_ENDPOINT);  // changed
+    USB_StartOut();  // changed
     isr_adcAmp_StartEx(adcAmpInterrupt);
     isr_adcAmp_Disable();
     
     LCD_Position(0,0);
     LCD_PrintString("amp build4b||");
     helper_Writebyte_EEPROM(0, VDAC_ADDRESS);
+    if (!USBFS_GetConfiguration()) {  // no computer, run the saved program if it is set to start at power up
+        StartStoredProgram(true);
+    }
     
     for(;;) {
         
-        if(USBFS_IsConfigurationChanged()) {  // if the configuration is changed reenable the OUT ENDPOINT
-            while(!USBFS_GetConfiguration()) {  // wait for the configuration with windows / controller is updated
+        if(USBFS_IsConfigurationChanged() && USBFS_GetConfiguration()) {  // a computer configured the usb, reenable the OUT ENDPOINT
+            USB_StartOut();  // reenable OUT ENDPOINT
+        }
+        if ((arm_state != ARM_IDLE) && (SW3_Read() == 0)) {  // hardware trigger, SW3 pulls the pin low
+            FireExperiment();
+        }
+        else if ((SW3_Read() == 0) && sw3_released && !USBFS_GetConfiguration()) {  // no computer, SW3 runs the saved program
+            sw3_released = false;
+            StartStoredProgram(false);
+        }
+        if (SW3_Read()) {
+            sw3_released = true;
+        }
+        if (FlashLog_IsRunning()) {  // copy the finished blocks of a logged run into the flash
+            FlashLog_Poll();
+            if (FlashLog_Overrun() && Sequencer_IsRunning()) {  // the sequencer isr stopped itself
+                Sequencer_Stop();
+                SeqHAL_Finished();
             }
-            USBFS_EnableOutEP(OUT_ENDPOINT);  // reenable OUT ENDPOINT
+            if (!Sequencer_IsRunning()) {
+                FlashLog_Finish(LOG_END_DONE);
+                LCD_Position(0,0);
+                LCD_PrintString("Log saved       ");
+            }
+        }
+        if (CVAverage_Ready()) {  // all the cycles of an averaged cyclic voltammetry run are done
+            uint16 record_size;
+            uint8 *average_record = CVAverage_Finish(&record_size);  // puts the average in ADC_array[0]
+            Blank_EndRun(lut_length);  // an averaged blank is saved if it was a blank capture
+            if (cv_features_mode != CV_FEATURES_OFF) {  // find the peaks of the averaged cycle
+                for (uint16 i = 1; i < lut_length; i++) {
+                    CVFeatures_AddSample(i, waveform_lut[i-1], ADC_array[0].data[i]);
+                }
+                CVFeatures_EndCycle();
+            }
+            if (cv_features_mode != CV_FEATURES_ONLY) {
+                USB_Export_Data((uint8*)"Done", 5);
+            }
+            if (average_record) {
+                USB_Export_Data(average_record, record_size);
+            }
+        }
+        Export_Push(!(isr_adc_GetState() || isr_adcAmp_GetState()));  // send the new data if the 'UP' command turned pushing on
+        if (CVFeatures_Ready()) {  // a cyclic voltammetry run is done, send the peaks found
+            USB_Export_Data(CVFeatures_Finish(), sizeof(struct CVFeatureRecord));
         }
+        uint8 gate = OCP_GateReady();
+        if (gate != OCP_GATE_NONE) {  // the open circuit potential is stable, start the next experiment
+            isr_adcAmp_Disable();
+            if (gate == OCP_GATE_CV) {
+                if (ArmCyclicVoltammetry()) {
+                    FireExperiment();
+                }
+                else {
+                    HardwareSleep();  // the ocp run left the hardware on
+                }
+            }
+            else {
+                StartSequencer(buffer_size_data_pts);
+            }
+        }
+        if (EIS_ResultReady()) {  // an impedance frequency is done
+            USB_Export_Data(EIS_NextResult(), sizeof(struct EISRecord));
+            if (!EIS_IsRunning() && !EIS_ResultReady()) {  // that was the last frequency
+                isr_adcAmp_Disable();
+                HardwareSleep();
+                USB_Export_Data((uint8*)"ZDone", 6);
+            }
+        }
+        if (Upload_Poll()) {  // the computer stopped sending waveform data
+            USB_Export_Data((uint8*)"Error Upload", 13);
+        }
+        if (calibrate_Poll()) {  // a calibration started with 'B' finished
+            LCD_Position(0,0);
+            LCD_PrintString("Done cal");
+        }
+        CommandQueue_Poll();
         if (Input_Flag == false) {  // make sure any input has already been dealt with
-            Input_Flag = USB_CheckInput(OUT_Data_Buffer);  // check if there is a response from the computer
+            Input_Flag = CommandQueue_Pop(OUT_Data_Buffer);  // check if the OUT endpoint isr queued a command from the computer
         }
         
         if (Input_Flag == true) {
+            TRACE(TRACE_COMMAND, OUT_Data_Buffer[0], OUT_Data_Buffer[1]);
             switch (OUT_Data_Buffer[0]) { 
                 
             case 'F': ; // User wants to export streaming data
-                LCD_Position(1,0);
-                LCD_PrintString(";lll");
-                
+                // FX exports the block in channel X, FX|OOOO|LLLL exports LLLL data points starting at OOOO
                 uint8 user_ch1 = OUT_Data_Buffer[1]-'0';
                 LCD_Position(1,0);
                 sprintf(LCD_str, "get:%d | ", user_ch1);
                 LCD_PrintString(LCD_str);
-                USB_Export_Data(&ADC_array[user_ch1].usb[0], buffer_size_bytes); 
+                if (OUT_Data_Buffer[2] == '|') {
+                    if (!Export_Range(user_ch1, Convert2Dec(&OUT_Data_Buffer[3], 4), Convert2Dec(&OUT_Data_Buffer[8], 4))) {
+                        USB_Export_Data((uint8*)"Error Exporting", 16);
+                    }
+                }
+                else if ((user_ch1 < ADC_CHANNELS) && (buffer_size_bytes <= 2*MAX_LUT_SIZE)) {  // check for buffer overflow
+                    USB_Export_Data(&ADC_array[user_ch1].usb[0], buffer_size_bytes); 
+                }
+                else {
+                    USB_Export_Data((uint8*)"Error Exporting", 16);
+                }
                 break;
                 
             case 'E': ; // User wants to export the data, the user can choose what ADC array to export
+                // EX exports channel X of the last cyclic voltammetry run, EX|OOOO|LLLL exports LLLL data points
+                // starting at OOOO and ES|NNNNNNNNNN exports the data saved since sequence number NNNNNNNNNN
                 uint8 user_ch = OUT_Data_Buffer[1]-'0';
-                if (user_ch <= ADC_CHANNELS) { // check for buffer overflow
-                    // 2*(lut_length+2) because the data is 2 times as long as it has to 
-                    // be sent as 8-bits and the data is 16 bit, +1 is for the 0xC000 finished signal
-                    //LCD_Position(1,0);
-                    //sprintf(LCD_str, "Edf:%d", 2*(lut_length+2));
-                    //LCD_PrintString(LCD_str);
-                    USB_Export_Data(&ADC_array[user_ch].usb[0], 2*(lut_length+1));  
-                    
+                if (OUT_Data_Buffer[1] == 'S') {
+                    Export_Since(Convert2Dec32(&OUT_Data_Buffer[3], 10));
                 }
-                else {
+                else if (OUT_Data_Buffer[2] == '|') {
+                    if (!Export_Range(user_ch, Convert2Dec(&OUT_Data_Buffer[3], 4), Convert2Dec(&OUT_Data_Buffer[8], 4))) {
+                        USB_Export_Data((uint8*)"Error Exporting", 16);
+                    }
+                }
+                // 2*(lut_length+1) because the data is 2 times as long as it has to 
+                // be sent as 8-bits and the data is 16 bit, +1 is for the 0xC000 finished signal
+                else if (!Export_Range(user_ch, 0, lut_length + 1)) {
                     USB_Export_Data((uint8*)"Error Exporting", 16);
                 }
                 break;
-            case 'B': ; // calibrate the TIA / ADC current measuring circuit
-                calibrate_TIA(TIA_resistor_value, ADC_buffer_index);
-                LCD_Position(0,0);
-                LCD_PrintString("Done cal");
+            case 'B': ; // calibrate the TIA / ADC current measuring circuit, finished by calibrate_Poll in the main loop
+                // blank (background) commands for cyclic voltammetry: BC saves the next run as the blank,
+                // BS|SSSSS subtracts SSSSS/16384 times the blank from the next runs with the same waveform and gain,
+                // BO turns the subtraction off and BK sends back BK|KKKKK the key of the saved blank, 0 if none
+                if (OUT_Data_Buffer[1] == 'C') {
+                    Blank_Capture();
+                }
+                else if (OUT_Data_Buffer[1] == 'S') {
+                    Blank_Enable(Convert2Dec(&OUT_Data_Buffer[3], 5));
+                }
+                else if (OUT_Data_Buffer[1] == 'O') {
+                    Blank_Disable();
+                }
+                else if (OUT_Data_Buffer[1] == 'K') {
+                    sprintf(usb_str, "BK|%05u", Blank_Key());
+                    USB_Export_Data((uint8*)usb_str, strlen(usb_str)+1);
+                }
+                else {
+                    calibrate_TIA(TIA_resistor_value, ADC_buffer_index);
+                }
                 break;
             case 'C': ;  // change the compare value of the PWM to start the adc isr
                 uint16 CMP = Convert2Dec(&OUT_Data_Buffer[2], 5);
@@ -202,6 +411,15 @@ int main()
                 // input is AX|Y|Z|W: where X is the TIA resistor value, Y is the adc buffer gain setting
                 // Z is T or F for if an external resistor is to be used and the AMux_working_electrode should be set according
                 // W is 0 or 1 for which user resistor should be selected by AMux_working_electrode
+                // AP|N selects ADC profile N, see adc_profile.h, and sends back AP|N|name|bits|rate
+                if (OUT_Data_Buffer[1] == 'P') {
+                    if (isr_adc_GetState() || isr_adcAmp_GetState() || (arm_state != ARM_IDLE)) {
+                        USB_Export_Data((uint8*)"Error ADC Profile", 18);
+                        break;
+                    }
+                    Amp_SelectProfile(OUT_Data_Buffer[3]-'0', ADC_buffer_index);
+                    break;
+                }
                 TIA_resistor_value = OUT_Data_Buffer[1]-'0';
                 TIA_SetResFB(TIA_resistor_value);  // see TIA.h for how the values work, basically 0 - 20k, 1 -30k, etc.
                 ADC_buffer_index = OUT_Data_Buffer[3]-'0';
@@ -213,6 +431,7 @@ int main()
                     AMux_TIA_resistor_bypass_Connect(0);
                 }
                 else {
+                    tia_mux.use_extra_resistor = false;
                     AMux_TIA_resistor_bypass_Disconnect(0);
                 }
                 break;
@@ -231,26 +450,42 @@ int main()
                 }
                 break;
             case 'R': ;  // Start a cyclic voltammetry experiment
+                // RA|NN|V plays the look up table NN times and saves the average, V is T to also send
+                // the variance of each cycle
+                // RD|SSSS|EEEE|MM|TTTTT|LLLLL|BBBB runs an adaptive step scan from SSSS to EEEE and back with steps
+                // of 1 to MM dac counts, TTTTT PWM periods for each dac count, the step is halved when the current of a
+                // step changes more than LLLLL adc counts.  BBBB dac value / current pairs are put in each block
+                if (OUT_Data_Buffer[1] == 'D') {
+                    struct AdaptiveSettings adaptive_settings;
+                    adaptive_settings.start_value = Convert2Dec(&OUT_Data_Buffer[3], 4);
+                    adaptive_settings.vertex_value = Convert2Dec(&OUT_Data_Buffer[8], 4);
+                    adaptive_settings.max_step = Convert2Dec(&OUT_Data_Buffer[13], 2);
+                    adaptive_settings.ticks_per_count = Convert2Dec(&OUT_Data_Buffer[16], 5);
+                    adaptive_settings.change_limit = Convert2Dec(&OUT_Data_Buffer[22], 5);
+                    adaptive_settings.block_size = Convert2Dec(&OUT_Data_Buffer[28], 4);
+                    StartAdaptive(&adaptive_settings);
+                    break;
+                }
                 if (!isr_dac_GetState()){  // enable the dac isr if it isnt already enabled
                     if (isr_adcAmp_GetState()) {  // User has started cyclic voltammetry while amp is already running so disable amperometry
                         isr_adcAmp_Disable();
                     }
-                    LCD_Position(0,0);
-                    LCD_PrintString("Cyclic volt running");
-                    lut_index = 0;
-                    lut_value = waveform_lut[0];
-                    HardwareWakeup();  // start the hardware
-                    DAC_SetValue(lut_value);  // TODO:  Fix this is a mess
-                    //lut_index = 1;
-                    //lut_value = waveform_lut[1];
-                    CyDelay(1);  // let the electrode voltage settle
-                    ADC_SigDel_StartConvert();  // start the converstion process of the delta sigma adc so it will be ready to read when needed
-                    CyDelay(5);
-                    PWM_isr_WriteCounter(100);  // set the pwm timer so that it will trigger adc isr first
-                    
-                    ADC_array[0].data[lut_index] = ADC_SigDel_GetResult16();  // Hack, get first adc reading, timing element doesn't reverse for some reason
-                    isr_dac_Enable();  // enable the interrupts to start the dac
-                    isr_adc_Enable();  // and the adc
+                    if (!ArmCyclicVoltammetry()) {  // the error was sent
+                        break;
+                    }
+                    if (OUT_Data_Buffer[1] == 'A') {
+                        if (!CVAverage_Start(Convert2Dec(&OUT_Data_Buffer[3], 2), (OUT_Data_Buffer[6] == 'T'),
+                                             lut_length, ADC_array[0].data[0])) {
+                            arm_state = ARM_IDLE;
+                            HardwareSleep();
+                            USB_Export_Data((uint8*)"Error Average", 14);
+                            break;
+                        }
+                    }
+                    else {
+                        CVAverage_Stop();
+                    }
+                    FireExperiment();
                 }
                 else {
                     USB_Export_Data((uint8*)"Error1", 7);
@@ -260,6 +495,19 @@ int main()
                 isr_dac_Disable();
                 isr_adc_Disable();
                 isr_adcAmp_Disable();
+                TRACE(TRACE_ISR_DISABLE, TRACE_ISR_DAC, 0);
+                arm_state = ARM_IDLE;
+                Sequencer_Stop();
+                FlashLog_Finish(LOG_END_STOPPED);
+                EIS_Stop();
+                OCP_Stop();
+                Scan_Stop();
+                Adaptive_Stop();
+                Upload_Cancel();
+                CVAverage_Stop();
+                Blank_Stop();
+                calibrate_Abort();
+                usb_abort = false;  // the OUT endpoint isr set this when the command came in
                 LCD_Position(0,0);
                 LCD_PrintString("not recording");
                 lut_index = 0;  
@@ -269,18 +517,46 @@ int main()
                 isr_adcAmp_Disable();
                 isr_adc_Disable();
                 isr_dac_Disable();
+                arm_state = ARM_IDLE;
                 USB_Export_Data((uint8*)"USB Test - v04", 15);
                 //LCD_Position(0,0);
                 //LCD_PrintString("Got I");
                 // TODO:  Put in a software reset incase something goes wrong the program can reattach
                 break;
             case 'L': ; // User wants to change the electrode configuration
-                AMux_channel_select = Convert2Dec(&OUT_Data_Buffer[2], 1) - 2; // user sends 2 or 3 for the # electrode 
-                //config, map this to 0 or 1 for the channel the AMux should select
-                AMux_electrode_Select(AMux_channel_select);
+                // LC clears the scan list, LA|E|I|X|R|B adds a channel to the scan list, E is 2 or 3 for the
+                // electrode configuration, I the AMux_TIA_input channel, X is T or F to use the extra resistor,
+                // R the TIA resistor and B the adc buffer gain
+                // LS|BBBB|DDDDD|SSSS|NNNNN scans the list, BBBB samples are thrown away after each switch, DDDDD
+                // samples saved from each channel before switching, SSSS the block size and NNNNN the number of
+                // times to go through the list, 0 to scan until 'X'
+                if (OUT_Data_Buffer[1] == 'C') {
+                    Scan_Clear();
+                }
+                else if (OUT_Data_Buffer[1] == 'A') {
+                    struct ScanChannel scan_channel;
+                    scan_channel.electrode_config = OUT_Data_Buffer[3]-'2';
+                    scan_channel.tia_input = OUT_Data_Buffer[5]-'0';
+                    scan_channel.use_extra_resistor = (OUT_Data_Buffer[7] == 'T');
+                    scan_channel.tia_resistor = OUT_Data_Buffer[9]-'0';
+                    scan_channel.adc_buffer = OUT_Data_Buffer[11]-'0';
+                    if (!Scan_AddChannel(&scan_channel)) {
+                        USB_Export_Data((uint8*)"Error Channel", 14);
+                    }
+                }
+                else if (OUT_Data_Buffer[1] == 'S') {
+                    StartScan(Convert2Dec(&OUT_Data_Buffer[3], 4), Convert2Dec(&OUT_Data_Buffer[8], 5), 
+                              Convert2Dec(&OUT_Data_Buffer[14], 4), Convert2Dec(&OUT_Data_Buffer[19], 5));
+                }
+                else {
+                    AMux_channel_select = Convert2Dec(&OUT_Data_Buffer[2], 1) - 2; // user sends 2 or 3 for the # electrode 
+                    //config, map this to 0 or 1 for the channel the AMux should select
+                    AMux_electrode_Select(AMux_channel_select);
+                }
                 break;
             case 'T': ; //Set the PWM timer period
                 PWM_isr_Wakeup();
+                SampleClock_Default();  // the period is for the 2.4 MHz Clock_PWM
                 timer_period = Convert2Dec(&OUT_Data_Buffer[2], 5);
                 PWM_isr_WriteCompare(timer_period / 2);  // not used in amperometry run so just set in the middle
                 PWM_isr_WritePeriod(timer_period);
@@ -293,6 +569,7 @@ int main()
                 break;
             case 'Q': ;  // Hack to let the device to run a chronoamperometry experiment, not working properly yet
                 PWM_isr_Wakeup();
+                SampleClock_Default();  // the period is for the 2.4 MHz Clock_PWM
                 uint16 baseline = Convert2Dec(&OUT_Data_Buffer[2], 4);
                 uint16 pulse = Convert2Dec(&OUT_Data_Buffer[7], 4);
                 timer_period = Convert2Dec(&OUT_Data_Buffer[12], 5);
@@ -307,6 +584,7 @@ int main()
                 break;
             case 'S': ; // make a look up table (lut) for a cyclic voltammetry experiment
                 PWM_isr_Wakeup();
+                SampleClock_Default();  // the period is for the 2.4 MHz Clock_PWM
                 uint16 low_amplitude = Convert2Dec(&OUT_Data_Buffer[2], 4);
                 uint16 high_amplitude = Convert2Dec(&OUT_Data_Buffer[7], 4);
                 timer_period = Convert2Dec(&OUT_Data_Buffer[12], 5);
@@ -317,39 +595,334 @@ int main()
                 lut_value = waveform_lut[0];  // Initialize for the start of the experiment
                 PWM_isr_Sleep();
                 break; 
+            case 'J': ; // sequencer, run a program of steps with no computer involvement between the steps
+                // JC clears the program
+                // JA|M|R|B|C|SSSS|EEEE|PPPPP|LLLLLLL adds a step, M is the mode (see SEQ_MODE_XXX),
+                // R is the TIA resistor, B is the adc buffer gain, C is the route (see SEQ_ROUTE_XXX), 
+                // SSSS and EEEE are the start and end dac values, PPPPP is the PWM period and
+                // LLLLLLL is how many PWM periods to hold for hold or amperometry steps, an optional |AAAA on
+                // the end is the square wave pulse amplitude in dac counts
+                // JR|XXXX runs the program, XXXX is the data points in a block before it is exported with 'F'
+                // JS|XXXX|A saves the program in the eeprom to run with no computer connected, XXXX is the
+                // block size and A is 1 to run it at power up or 0 to only run it with SW3, the data is logged to flash
+                if (OUT_Data_Buffer[1] == 'C') {
+                    if (!Sequencer_Clear()) {
+                        USB_Export_Data((uint8*)"Error Running", 14);
+                    }
+                }
+                else if (OUT_Data_Buffer[1] == 'A') {
+                    struct SequenceStep step;
+                    step.mode = OUT_Data_Buffer[3]-'0';
+                    step.tia_resistor = OUT_Data_Buffer[5]-'0';
+                    step.adc_buffer = OUT_Data_Buffer[7]-'0';
+                    step.route = OUT_Data_Buffer[9]-'0';
+                    step.start_value = Convert2Dec(&OUT_Data_Buffer[11], 4);
+                    step.end_value = Convert2Dec(&OUT_Data_Buffer[16], 4);
+                    step.timer_period = Convert2Dec(&OUT_Data_Buffer[21], 5);
+                    step.length = Convert2Dec32(&OUT_Data_Buffer[27], 7);
+                    step.pulse_amplitude = 0;
+                    if (OUT_Data_Buffer[34] == '|') {
+                        step.pulse_amplitude = Convert2Dec(&OUT_Data_Buffer[35], 4);
+                    }
+                    if (!Sequencer_AddStep(&step)) {
+                        USB_Export_Data((uint8*)"Error Step", 11);
+                    }
+                }
+                else if (OUT_Data_Buffer[1] == 'R') {
+                    StartSequencer(Convert2Dec(&OUT_Data_Buffer[3], 4));
+                }
+                else if (OUT_Data_Buffer[1] == 'S') {
+                    if (Sequencer_Save(Convert2Dec(&OUT_Data_Buffer[3], 4), (OUT_Data_Buffer[8] == '1'))) {
+                        USB_Export_Data((uint8*)"JS", 3);
+                    }
+                    else {
+                        USB_Export_Data((uint8*)"Error Save", 11);
+                    }
+                }
+                break;
+            case 'K': ; // run an anodic stripping voltammetry experiment
+                // K|DDDD|TTTTTTT|QQQQQQQ|SSSS|EEEE|W|AAAA|PPPPP|XXXX, DDDD is the deposition dac value, TTTTTTT
+                // the deposition time in ms, QQQQQQQ the quiet time in ms, SSSS and EEEE the stripping start and 
+                // end dac values, W is L for a linear sweep or S for a square wave sweep, AAAA the square 
+                // wave amplitude, PPPPP the PWM period of the stripping sweep and XXXX the block size
+                // The current TIA and adc buffer gain settings are used
+                struct ASVSettings asv_settings;
+                asv_settings.deposition_value = Convert2Dec(&OUT_Data_Buffer[2], 4);
+                asv_settings.deposition_time = Convert2Dec32(&OUT_Data_Buffer[7], 7);
+                asv_settings.quiet_time = Convert2Dec32(&OUT_Data_Buffer[15], 7);
+                asv_settings.start_value = Convert2Dec(&OUT_Data_Buffer[23], 4);
+                asv_settings.end_value = Convert2Dec(&OUT_Data_Buffer[28], 4);
+                asv_settings.sweep_type = OUT_Data_Buffer[33];
+                asv_settings.pulse_amplitude = Convert2Dec(&OUT_Data_Buffer[35], 4);
+                asv_settings.timer_period = Convert2Dec(&OUT_Data_Buffer[40], 5);
+                asv_settings.tia_resistor = TIA_resistor_value;
+                asv_settings.adc_buffer = ADC_buffer_index;
+                if (ASV_Load(&asv_settings)) {
+                    StartSequencer(Convert2Dec(&OUT_Data_Buffer[46], 4));
+                }
+                else {
+                    USB_Export_Data((uint8*)"Error ASV", 10);
+                }
+                break;
+            case 'O': ; // cyclic voltammetry feature extraction, OX where X is 0 for off, 1 to only send the
+                // peak features at the end of a run and 2 to send the features and let the raw data be exported
+                CVFeatures_SetMode(OUT_Data_Buffer[1]-'0');
+                break;
+            case 'W': ; // run amperometry that only sends the statistics of each window of data points
+                // W|DDDD|NNNNN|VVVVVVVVV|R, DDDD is the dac value, NNNNN the data points in a window,
+                // VVVVVVVVV the variance threshold in adc counts squared and R is T to keep the raw 
+                // data of windows over the threshold to export with 'F'
+                uint16 window_size = Convert2Dec(&OUT_Data_Buffer[7], 5);
+                if (BlockStats_Start(window_size, Convert2Dec32(&OUT_Data_Buffer[13], 9), OUT_Data_Buffer[23] == 'T')) {
+                    if (ArmAmperometry(Convert2Dec(&OUT_Data_Buffer[2], 4), window_size)) {
+                        arm_state = ARM_BLOCK_STATS;
+                        FireExperiment();
+                    }
+                }
+                else {
+                    USB_Export_Data((uint8*)"Error Window", 13);
+                }
+                break;
+            case 'Z': ; // electrochemical impedance spectroscopy
+                // ZC clears the frequency list
+                // ZA|FFFFFFF adds a frequency in 0.01 Hz
+                // ZR|BBBB|AAAA|CCCC runs the list, BBBB is the bias dac value, AAAA the sine wave amplitude 
+                // in dac counts and CCCC the number of sine wave periods to measure at each frequency
+                if (OUT_Data_Buffer[1] == 'C') {
+                    EIS_Clear();
+                }
+                else if (OUT_Data_Buffer[1] == 'A') {
+                    if (!EIS_AddFrequency(Convert2Dec32(&OUT_Data_Buffer[3], 7))) {
+                        USB_Export_Data((uint8*)"Error Frequency", 16);
+                    }
+                }
+                else if (OUT_Data_Buffer[1] == 'R') {
+                    StartEIS(Convert2Dec(&OUT_Data_Buffer[3], 4), Convert2Dec(&OUT_Data_Buffer[8], 4),
+                             Convert2Dec(&OUT_Data_Buffer[13], 4));
+                }
+                break;
+            case 'Y': ; // iR drop compensation, Y0 turns it off
+                // Y|SRRRRR|CCCC|LLL turns it on, S is + or - for the direction of the correction, RRRRR the
+                // resistance in ohms, CCCC the largest correction and LLL the largest change in the correction
+                // each data point, both in dac counts.  Uses the last 'B' calibration to convert the current
+                if (OUT_Data_Buffer[1] == '0') {
+                    IR_Disable();
+                }
+                else {
+                    int32 resistance = Convert2Dec(&OUT_Data_Buffer[3], 5);
+                    if (OUT_Data_Buffer[2] == '-') {
+                        resistance = -resistance;
+                    }
+                    if (!IR_Configure(resistance, Convert2Dec(&OUT_Data_Buffer[9], 4), Convert2Dec(&OUT_Data_Buffer[14], 3))) {
+                        USB_Export_Data((uint8*)"Error iR", 9);
+                    }
+                }
+                break;
+            case 'N': ; // open circuit potential, found as the dac value with no current
+                // N|S|DDD|XXXX|YYYYYYY|G|BBBB, S is + if raising the dac raises the adc reading or - if it
+                // lowers it, DDD the adc deadband around zero current, XXXX the largest change in mV in a
+                // window that is called stable, YYYYYYY the window in ms, G is 0 to keep running, 
+                // R to start a cyclic voltammetry run or J to run the sequencer program when stable
+                // and BBBB the data points in each block exported with 'F'
+                if (isr_dac_GetState() || isr_adcAmp_GetState()) {
+                    USB_Export_Data((uint8*)"Error1", 7);
+                    break;
+                }
+                struct OCPSettings ocp_settings;
+                ocp_settings.polarity = (OUT_Data_Buffer[2] == '-') ? -1 : 1;
+                ocp_settings.zero_current_count = calibrate_array.data[7];  // adc reading with the calibration IDAC at 0
+                ocp_settings.deadband = Convert2Dec(&OUT_Data_Buffer[4], 3);
+                // the ocp works in dac counts and PWM_isr ticks, so the dac and clock being used set the scale
+                ocp_settings.stable_range = ((uint32)Convert2Dec(&OUT_Data_Buffer[8], 4) * dac_ground_value) / VIRTUAL_GROUND;
+                ocp_settings.stable_window = ((uint64)Convert2Dec32(&OUT_Data_Buffer[13], 7) * 1000000) / SampleClock_TickNs();
+                ocp_settings.gate = OUT_Data_Buffer[21];
+                ocp_settings.block_size = Convert2Dec(&OUT_Data_Buffer[23], 4);
+                if (!AdcRateAllowed(SampleClock_TickNs())) {
+                    break;
+                }
+                HardwareWakeup();
+                if (OCP_Start(&ocp_settings)) {
+                    buffer_size_data_pts = ocp_settings.block_size;
+                    buffer_size_bytes = 2*(buffer_size_data_pts + 1);
+                    Export_Reset(EXPORT_RING, buffer_size_data_pts);
+                    LCD_Position(0,0);
+                    LCD_PrintString("OCP running");
+                    EnableTickInterrupt(ocpInterrupt);
+                }
+                else {
+                    HardwareSleep();
+                    USB_Export_Data((uint8*)"Error OCP", 10);
+                }
+                break;
             case 'D': ; // set the dac value
                 uint16 dac_value1 = Convert2Dec(&OUT_Data_Buffer[2], 4);
                 DAC_SetValue(dac_value1);
                 break;
                 
             case 'M': ; // run an amperometric experiment
-                LCD_Position(0,0);
-                LCD_PrintString("Ampmtry running");
-                HardwareWakeup();
-                if (!isr_adcAmp_GetState()) {  // enable isr if it is not already
-                    if (isr_dac_GetState()) {  // User selected to run amperometry but a CV is still running 
-                        isr_dac_Disable();
-                        isr_adc_Disable();
+                // MF|FF|CC averages each data point over CC cycles of FF (50 or 60) Hz mains, MF|00|00 turns it off
+                // sends back MF|FF|CC|RRRRRRRRRR with the PWM_isr rate in mHz, the rate is set when the run is armed
+                // and the clock is put back when the filter is turned off
+                if (OUT_Data_Buffer[1] == 'F') {
+                    if (isr_adcAmp_GetState() || (arm_state != ARM_IDLE)) {  // the tick of a run can not change under it
+                        USB_Export_Data((uint8*)"Error1", 7);
+                    }
+                    else if (Mains_Configure(Convert2Dec(&OUT_Data_Buffer[3], 2), Convert2Dec(&OUT_Data_Buffer[6], 2))) {
+                        sprintf(usb_str, "MF|%02d|%02d|%010lu", Convert2Dec(&OUT_Data_Buffer[3], 2), mains_cycles, 
+                                (unsigned long)Mains_SampleRate());
+                        USB_Export_Data((uint8*)usb_str, strlen(usb_str)+1);
                     }
+                    else {
+                        USB_Export_Data((uint8*)"MF|00|00", 9);
+                    }
+                    break;
                 }
                 uint16 dac_value = Convert2Dec(&OUT_Data_Buffer[2], 4);  // get the voltage the user wants and set the dac
-                lut_index = 0;
-                DAC_SetValue(dac_value);
-                
-                ADC_SigDel_StartConvert();
-                CyDelay(5);
-                
-                buffer_size_data_pts = Convert2Dec(&OUT_Data_Buffer[7], 4);  // how many data points to collect in each adc channel before exporting the data
-                buffer_size_bytes = 2*(buffer_size_data_pts + 1); // add 1 bit for the termination code and double size for bytes from uint16 data
-                adc_recording_channel = 0;
-                 
-                CyDelay(10);
-                isr_adcAmp_Enable();
+                uint16 buffer_pts = Convert2Dec(&OUT_Data_Buffer[7], 4);  // how many data points to collect in each adc channel before exporting the data
+                if (ArmAmperometry(dac_value, buffer_pts)) {
+                    FireExperiment();
+                }
+                break;
+            case 'P': ; // arm an experiment so it can be started with the 'G' command or SW3 with no settling delay
+                // PR arms a cyclic voltammetry run with the current look up table
+                // PM|XXXX|YYYY arms amperometry with the same parameters as the 'M' command
+                // PL reports the arm to first sample and fire to first sample times in microseconds,
+                // "Error No Sample" if no run has been fired or its first sample has not been taken yet
+                if (OUT_Data_Buffer[1] == 'R') {
+                    if (!isr_dac_GetState()) {
+                        ArmCyclicVoltammetry();
+                    }
+                    else {
+                        USB_Export_Data((uint8*)"Error1", 7);
+                    }
+                }
+                else if (OUT_Data_Buffer[1] == 'M') {
+                    ArmAmperometry(Convert2Dec(&OUT_Data_Buffer[3], 4), Convert2Dec(&OUT_Data_Buffer[8], 4));
+                }
+                else if (OUT_Data_Buffer[1] == 'L') {
+                    if (!experiment_fired || first_sample_pending) {  // the first sample has not been timed yet
+                        USB_Export_Data((uint8*)"Error No Sample", 16);
+                        break;
+                    }
+                    sprintf(usb_str, "L%lu|%lu", helper_CyclesToUs(first_sample_timestamp - arm_timestamp),
+                            helper_CyclesToUs(first_sample_timestamp - fire_timestamp));
+                    USB_Export_Data((uint8*)usb_str, strlen(usb_str)+1);
+                }
+                break;
+            case 'U': ; // utility commands
+                // UB|NNNN starts a binary upload of NNNN dac values into the look up table, after the device
+                // answers UB|NNNN the computer sends the values as little endian uint16 in as many packets as needed
+                // UC|CCCCC uses the uploaded waveform if CCCCC matches the CRC-16/CCITT of the bytes, play it with 'R'
+                if (OUT_Data_Buffer[1] == 'B') {
+                    uint16 upload_points = Convert2Dec(&OUT_Data_Buffer[3], 4);
+                    if (Upload_Begin(upload_points)) {
+                        sprintf(usb_str, "UB|%04u", upload_points);
+                        USB_Export_Data((uint8*)usb_str, strlen(usb_str)+1);
+                    }
+                    else {
+                        USB_Export_Data((uint8*)"Error Upload", 13);
+                    }
+                }
+                else if (OUT_Data_Buffer[1] == 'C') {
+                    uint16 upload_bytes = Upload_BytesReceived();
+                    uint16 upload_crc = Upload_CRC();
+                    uint8 upload_result = Upload_Commit(Convert2Dec(&OUT_Data_Buffer[3], 5));
+                    if (upload_result == UPLOAD_COMMITTED) {
+                        sprintf(usb_str, "UC|%04u|%05u", lut_length, upload_crc);
+                    }
+                    else if (upload_result == UPLOAD_BAD_VALUE) {
+                        sprintf(usb_str, "Error DAC Value");
+                    }
+                    else {
+                        sprintf(usb_str, "Error CRC|%05u|%05u", upload_bytes, upload_crc);
+                    }
+                    USB_Export_Data((uint8*)usb_str, strlen(usb_str)+1);
+                }
+                else if (OUT_Data_Buffer[1] == 'T') {  // UT dumps the event trace, UTC also clears it after the dump
+                    #if TRACE_ENABLED
+                    Trace_Dump(OUT_Data_Buffer[2] == 'C');
+                    #else
+                    USB_Export_Data((uint8*)"Error Trace", 12);
+                    #endif
+                }
+                else if (OUT_Data_Buffer[1] == 'D') {  // UD reports the USB_Export_Data counters, UDC also clears them
+                    // sends UD|M|BBBBBBBBBB|PPPPPPPPPP|CCCCCCCCCC|WWWWWWWWWW, M is M for manual or D for DMA endpoint
+                    // management, then the bytes, packets and the cpu and waiting time in microseconds
+                    struct USBExportStats export_counters;
+                    USB_GetExportStats(&export_counters, (OUT_Data_Buffer[2] == 'C'));
+                    sprintf(usb_str, "UD|%c|%010lu|%010lu|%010lu|%010lu", USBFS_EP_MANAGEMENT_DMA_AUTO ? 'D' : 'M',
+                            (unsigned long)export_counters.bytes, (unsigned long)export_counters.packets,
+                            (unsigned long)helper_CyclesToUs(export_counters.cpu_cycles),
+                            (unsigned long)helper_CyclesToUs(export_counters.wait_cycles));
+                    USB_Export_Data((uint8*)usb_str, strlen(usb_str)+1);
+                }
+                else if (OUT_Data_Buffer[1] == 'F') {  // UF sends the flash log, see FlashLog_Dump, UFE erases it
+                    if (OUT_Data_Buffer[2] != 'E') {
+                        FlashLog_Dump();
+                    }
+                    else if (FlashLog_Erase()) {
+                        USB_Export_Data((uint8*)"UFE", 4);
+                    }
+                    else {
+                        USB_Export_Data((uint8*)"Error Log", 10);
+                    }
+                }
+                else if (OUT_Data_Buffer[1] == 'K') {  // UK sends the binary ExportFormat, see data_export.h
+                    Export_Format(Export_Pairs(), TIA_resistor_value, ADC_buffer_index);
+                }
+                else if (OUT_Data_Buffer[1] == 'P') {  // UP|NNNN pushes the data with the same ExportHeader as the 'ES'
+                    // command every NNNN data points and at the end of the run, so the computer does not have to
+                    // send 'F' or 'ES' after each "Done" string.  UP|0000 turns pushing off.  While pushing the
+                    // messages from the isrs ("Done", "J", "L", "RD", "OCP" and the block stats) are sent by the
+                    // main loop after the data saved before them, so they never land inside a pushed block
+                    uint16 push_points = Convert2Dec(&OUT_Data_Buffer[3], 4);
+                    Export_SetPush(push_points);
+                    sprintf(usb_str, "UP|%04d", push_points);
+                    USB_Export_Data((uint8*)usb_str, strlen(usb_str)+1);
+                }
+                else if (OUT_Data_Buffer[1] == 'H') {  // UH sends the binary DeviceHeader then the ExportFormat,
+                    // the start of a recording on the computer, see data_export.h
+                    Export_DeviceHeader(TIA_resistor_value, ADC_buffer_index);
+                }
+                else if (OUT_Data_Buffer[1] == 'M') {  // UM sends the BlockInfo of each ADC_array channel so the
+                    // computer knows when the data points of a block were taken and with what gain
+                    Export_BlockInfo();
+                }
+                else if (OUT_Data_Buffer[1] == 'Q') {  // report the command queue counters
+                    struct CommandQueueStats queue_stats;
+                    CommandQueue_GetStats(&queue_stats);
+                    sprintf(usb_str, "UQ|%d|%d|%d|%lu", queue_stats.depth, queue_stats.high_water,
+                            queue_stats.drops, (unsigned long)queue_stats.received);
+                    USB_Export_Data((uint8*)usb_str, strlen(usb_str)+1);
+                }
+                break;
+            case 'H': ; // set the sample clock over a wide range by changing the Clock_PWM divider with the PWM period
+                // HR|RRRRRRRRRR sets the rate in mHz and HP|PPPPPPPPPP sets the period in ns
+                // sends back H|DDDDD|PPPPP|RRRRRRRRRR, the divider, PWM period and the rate made in mHz
+                Amp_SetClock(OUT_Data_Buffer[1], Convert2Dec32(&OUT_Data_Buffer[3], 10));
+                break;
+            case 'G': ; // fire an experiment that was armed with the 'P' command
+                if (arm_state != ARM_IDLE) {
+                    FireExperiment();
+                }
+                else {
+                    USB_Export_Data((uint8*)"Error2", 7);
+                }
                 break;
             }  // end of switch statment
             OUT_Data_Buffer[0] = '0';  // clear data buffer cause it has been processed
             Input_Flag = false;  // turn off input flag because it has been processed
         }
+        if ((isr_adc_GetState() || isr_adcAmp_GetState()) && (arm_state == ARM_IDLE) && SampleClock_IdleAllowed()) {
+            // slow sampling, sleep the CPU until the next tick or USB interrupt.  Interrupts are masked
+            // so one that comes in after the check still wakes the CPU up from the WFI
+            CyGlobalIntDisable;
+            CommandQueue_Poll();  // with DMA a packet that came in since the top of the loop is only queued here
+            if (CommandQueue_IsEmpty() && !CVFeatures_Ready() && !CVAverage_Ready() && !EIS_ResultReady() && !FlashLog_Pending() && !Export_PushReady()) {
+                CY_PM_WFI;
+            }
+            CyGlobalIntEnable;
+        }
     }  // end of for loop in main
     
 }  // end of main
@@ -397,6 +970,239 @@ void HardwareWakeup(void){  // wakeup all the components that have to be on for
     
 }
 
+uint8 AdcRateAllowed(uint32 tick_ns) {  // check the adc profile converts at least as fast as a tick and tell the computer if not
+    if (!AdcProfile_TickAllowed(tick_ns)) {
+        USB_Export_Data((uint8*)"Error ADC Rate", 15);
+        return false;
+    }
+    return true;
+}
+
+uint8 ArmCyclicVoltammetry(void) {  // wake and settle the hardware for a CV run so it can be started with no delay
+    if (lut_length == 0) {  // an upload was started and not committed, the table is part old and part new
+        USB_Export_Data((uint8*)"Error LUT", 10);
+        return false;
+    }
+    if (!AdcRateAllowed(SampleClock_TickNs())) {
+        return false;
+    }
+    if (Blank_Arm(lut_length, timer_period, TIA_resistor_value, ADC_buffer_index) == BLANK_ERROR) {
+        USB_Export_Data((uint8*)"Error Blank", 12);  // subtracting is on but there is no blank for this run
+        return false;
+    }
+    if (isr_adcAmp_GetState()) {  // User has started cyclic voltammetry while amp is already running so disable amperometry
+        isr_adcAmp_Disable();
+    }
+    LCD_Position(0,0);
+    LCD_PrintString("Cyclic volt armed");
+    lut_index = 0;
+    lut_value = waveform_lut[0];
+    CVFeatures_Reset();
+    Export_Reset(EXPORT_LINEAR, 0);
+    HardwareWakeup();  // start the hardware
+    DAC_SetValue(lut_value);  // preload the first dac value
+    dac_applied = lut_value;
+    CyDelay(1);  // let the electrode voltage settle
+    ADC_SigDel_StartConvert();  // start the converstion process of the delta sigma adc so it will be ready to read when needed
+    CyDelay(5);
+    ADC_array[0].data[lut_index] = AdcProfile_GetResult();  // Hack, get first adc reading, timing element doesn't reverse for some reason
+    ADC_array[0].data[lut_index] = Blank_Process(lut_index, ADC_array[0].data[lut_index]);
+    arm_state = ARM_CV;
+    arm_timestamp = helper_ReadCycleCounter();
+    return true;
+}
+
+uint8 ArmAmperometry(uint16 dac_value, uint16 buffer_pts) {  // wake and settle the hardware for an amperometry run
+    if (!Amp_BufferAllowed(buffer_pts)) {
+        return false;
+    }
+    Mains_Reset();  // sets the PWM_isr period if the mains filter is on so do it before the hardware wakes up
+    if (!AdcRateAllowed(SampleClock_TickNs())) {  // with the mains filter period
+        return false;
+    }
+    LCD_Position(0,0);
+    LCD_PrintString("Ampmtry armed");
+    HardwareWakeup();
+    if (!isr_adcAmp_GetState()) {  // enable isr if it is not already
+        if (isr_dac_GetState()) {  // User selected to run amperometry but a CV is still running 
+            isr_dac_Disable();
+            isr_adc_Disable();
+        }
+    }
+    Amp_Setup(dac_value, buffer_pts, TIA_resistor_value, ADC_buffer_index);  // sets the dac, the iR compensation corrects from this value
+    dac_value_hold = dac_value;
+    dac_applied = dac_value;
+    
+    ADC_SigDel_StartConvert();
+    CyDelay(5);
+    
+    buffer_size_data_pts = buffer_pts;
+    buffer_size_bytes = 2*(buffer_size_data_pts + 1); // add 1 bit for the termination code and double size for bytes from uint16 data
+     
+    CyDelay(10);
+    arm_state = ARM_AMP;
+    arm_timestamp = helper_ReadCycleCounter();
+    return true;
+}
+
+void FireExperiment(void) {  // start an armed experiment, the first sample is taken within one PWM_isr period
+    fire_timestamp = helper_ReadCycleCounter();
+    first_sample_pending = true;
+    experiment_fired = true;
+    Export_SetSamplePeriod(SampleClock_TickNs());  // 1 data point each tick, the mains filter changes this below
+    IR_Reset();  // no correction is carried over from the last run
+    // nothing slow between setting the pwm counter and enabling the isrs, the LCD writes take
+    // longer than the 100 counts so they are done after or the first tick would be missed
+    PWM_isr_WriteCounter(100);  // set the pwm timer so that it will trigger adc isr first
+    if (arm_state == ARM_CV) {
+        isr_dac_ClearPending();  // the pwm has been running while armed, clear old interrupts
+        isr_adc_ClearPending();
+        isr_dac_Enable();  // enable the interrupts to start the dac
+        isr_adc_Enable();  // and the adc
+        TRACE(TRACE_ISR_ENABLE, TRACE_ISR_DAC, 0);
+        LCD_Position(0,0);
+        LCD_PrintString("Cyclic volt running");
+    }
+    else if (arm_state == ARM_AMP) {
+        if (mains_cycles) {  // a data point is the average of whole mains cycles
+            Export_SetSamplePeriod(SampleClock_TickNs() * MAINS_SAMPLES_PER_CYCLE * mains_cycles);
+        }
+        isr_adcAmp_SetVector(adcAmpInterrupt);  // the sequencer and other modes share this interrupt
+        isr_adcAmp_ClearPending();
+        isr_adcAmp_Enable();
+        TRACE(TRACE_ISR_ENABLE, TRACE_ISR_TICK, 1);
+        LCD_Position(0,0);
+        LCD_PrintString("Ampmtry running");
+    }
+    else if (arm_state == ARM_BLOCK_STATS) {
+        isr_adcAmp_SetVector(blockStatsInterrupt);
+        isr_adcAmp_ClearPending();
+        isr_adcAmp_Enable();
+        LCD_Position(0,0);
+        LCD_PrintString("Amp stats running");
+    }
+    arm_state = ARM_IDLE;
+}
+
+void StartSequencer(uint16 block_size) {  // run the program loaded into the sequencer
+    if (isr_dac_GetState() || isr_adcAmp_GetState() || Sequencer_IsRunning()) {
+        USB_Export_Data((uint8*)"Error1", 7);
+        return;
+    }
+    SampleClock_Default();  // the periods are worked out for the 2.4 MHz Clock_PWM
+    if (!AdcRateAllowed(SampleClock_PeriodNs(Sequencer_ShortestPeriod()))) {  // every step has to get a new conversion each tick
+        return;
+    }
+    HardwareWakeup();
+    if (!Sequencer_Start(block_size)) {  // sets the dac, gain and period for the first step
+        HardwareSleep();
+        USB_Export_Data((uint8*)"Error Program", 14);
+        return;
+    }
+    LCD_Position(0,0);
+    LCD_PrintString("Sequence running");
+    buffer_size_bytes = 2*(block_size + 1);  // so the 'F' command will export a full block
+    EnableTickInterrupt(sequencerInterrupt);
+}
+
+void StartStoredProgram(uint8 power_up) {  // run the program saved with 'JS' and log the data to flash
+    uint16 block_size;
+    uint8 autostart;
+    if (isr_dac_GetState() || isr_adcAmp_GetState() || Sequencer_IsRunning()) {
+        return;
+    }
+    if (!Sequencer_Load(&block_size, &autostart) || (power_up && !autostart)) {
+        return;
+    }
+    if (!FlashLog_Start(Sequencer_GetLength(), block_size)) {
+        LCD_Position(0,0);
+        LCD_PrintString("Log full        ");
+        return;
+    }
+    StartSequencer(block_size);
+    if (!Sequencer_IsRunning()) {
+        FlashLog_Finish(LOG_END_STOPPED);
+    }
+}
+
+void StartEIS(uint16 bias, uint16 amplitude, uint16 cycles) {  // run the impedance frequency list
+    if (isr_dac_GetState() || isr_adcAmp_GetState() || EIS_IsRunning()) {
+        USB_Export_Data((uint8*)"Error1", 7);
+        return;
+    }
+    SampleClock_Default();  // the periods are worked out for the 2.4 MHz Clock_PWM
+    if (!AdcRateAllowed(SampleClock_PeriodNs(EIS_ShortestPeriod()))) {  // the highest frequency has the fastest tick
+        return;
+    }
+    HardwareWakeup();
+    if (!EIS_Start(bias, amplitude, cycles)) {  // sets the dac and period for the first frequency
+        HardwareSleep();
+        USB_Export_Data((uint8*)"Error EIS", 10);
+        return;
+    }
+    LCD_Position(0,0);
+    LCD_PrintString("EIS running");
+    EnableTickInterrupt(eisInterrupt);
+}
+
+void StartScan(uint16 blank_ticks, uint16 dwell_ticks, uint16 block_size, uint16 rounds) {  // run the electrode scan list
+    if (isr_dac_GetState() || isr_adcAmp_GetState() || Scan_IsRunning()) {
+        USB_Export_Data((uint8*)"Error1", 7);
+        return;
+    }
+    struct ScanChannel home;  // the settings to go back to when the scan is done
+    home.electrode_config = AMux_channel_select;
+    home.tia_input = AMux_TIA_working_electrode_ch;
+    home.use_extra_resistor = tia_mux.use_extra_resistor;
+    home.tia_resistor = TIA_resistor_value;
+    home.adc_buffer = ADC_buffer_index;
+    if (!AdcRateAllowed(SampleClock_TickNs())) {
+        return;
+    }
+    HardwareWakeup();
+    if (!Scan_Start(&home, blank_ticks, dwell_ticks, block_size, rounds)) {  // connects the first channel
+        HardwareSleep();
+        USB_Export_Data((uint8*)"Error Scan", 11);
+        return;
+    }
+    LCD_Position(0,0);
+    LCD_PrintString("Scan running");
+    EnableTickInterrupt(scanInterrupt);
+}
+
+void StartAdaptive(struct AdaptiveSettings *settings) {  // run an adaptive step cyclic voltammetry scan
+    if (isr_dac_GetState() || isr_adcAmp_GetState() || Adaptive_IsRunning()) {
+        USB_Export_Data((uint8*)"Error1", 7);
+        return;
+    }
+    if (!AdcRateAllowed(SampleClock_PeriodNs(timer_period))) {  // the period set with the 'T' command is the tick
+        return;
+    }
+    HardwareWakeup();
+    PWM_isr_WritePeriod(timer_period);
+    if (!Adaptive_Start(settings)) {  // sets the dac to the start value
+        HardwareSleep();
+        USB_Export_Data((uint8*)"Error Adaptive", 15);
+        return;
+    }
+    Export_Reset(EXPORT_RING, settings->block_size);
+    Export_SetPairs();
+    buffer_size_bytes = 2*(2*settings->block_size + 1);  // so the 'F' command will export a full block
+    LCD_Position(0,0);
+    LCD_PrintString("Adaptive running");
+    EnableTickInterrupt(adaptiveInterrupt);
+}
+
+void EnableTickInterrupt(cyisraddress tick_isr) {  // start a mode that runs from the isr_adcAmp tick
+    ADC_SigDel_StartConvert();
+    CyDelay(5);
+    PWM_isr_WriteCounter(100);  // start the first tick right away
+    isr_adcAmp_SetVector(tick_isr);
+    isr_adcAmp_ClearPending();
+    isr_adcAmp_Enable();
+    TRACE(TRACE_ISR_ENABLE, TRACE_ISR_TICK, 2);
+}
+
 void HardwareSleep(void){  // put to sleep all the components that have to be on for a reading
     ADC_SigDel_Sleep();
     DAC_Sleep();
@@ -415,4 +1221,12 @@ uint16 Convert2Dec(uint8 array[], uint8 len){
     return num;
 }
 
+uint32 Convert2Dec32(uint8 array[], uint8 len){  // same as Convert2Dec for numbers that do not fit in 16 bits
+    uint32 num = 0;
+    for (int i = 0; i < len; i++){
+        num = num * 10 + (array[i] - '0');
+    }
+    return num;
+}
+
 /* [] END OF FILE */
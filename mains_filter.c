@@ -0,0 +1,168 @@
+/*******************************************************************************
+* File Name: mains_filter.c
+*
+* Description:
+*  Reject 50 / 60 Hz pickup in amperometry.  The PWM_isr tick is set to
+*  exactly MAINS_SAMPLES_PER_CYCLE ticks per mains cycle and each data point
+*  saved is the average of the adc samples over a whole number of mains
+*  cycles.  A boxcar average over whole cycles has a zero at the mains
+*  frequency and all its harmonics, so the pickup cancels without the
+*  computer having to read and average the extra samples.  The clock is only
+*  changed when amperometry is armed, and the divider and period from before
+*  are put back when the filter is turned off
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include <project.h>
+
+#include "mains_filter.h"
+#include "sample_clock.h"
+
+extern uint16 timer_period;  // in main.c
+
+uint8 mains_cycles = 0;
+
+static uint8 mains_frequency;
+static uint16 samples_per_point;
+static uint16 sample_count;
+static int32 sample_sum;
+static struct SampleClockSetting mains_clock;
+static uint8 clock_changed = false;  // the mains tick was loaded, saved_period is the period from before
+static uint16 saved_period;
+
+/***************************************
+* Forward function references
+***************************************/
+static void mains_restore_clock(void);
+
+
+/******************************************************************************
+* Function Name: Mains_Configure
+*******************************************************************************
+*
+* Summary:
+*  Turn the mains filter on or off for the next amperometry runs.  The tick
+*  for the filter is only worked out here, it is loaded by Mains_Reset.
+*  Turning the filter off puts the clock back if a filtered run changed it
+*
+* Parameters:
+*  uint8 mains_hz: 50 or 60, any other value turns the filter off
+*  uint8 cycles: mains cycles to average for each data point, 0 turns the filter off
+*
+* Return:
+*  true (1) if the filter is on
+*
+*******************************************************************************/
+
+uint8 Mains_Configure(uint8 mains_hz, uint8 cycles) {
+    if (((mains_hz != 50) && (mains_hz != 60)) || (cycles == 0) || (cycles > MAINS_MAX_CYCLES)) {
+        mains_cycles = 0;
+        mains_restore_clock();
+        return false;
+    }
+    uint32 rate_millihz = (uint32)mains_hz * MAINS_SAMPLES_PER_CYCLE * 1000;
+    SampleClock_Find(((uint64)SAMPLE_CLOCK_SOURCE_HZ*1000 + rate_millihz/2) / rate_millihz, &mains_clock);
+    mains_frequency = mains_hz;
+    mains_cycles = cycles;
+    samples_per_point = (uint16)cycles * MAINS_SAMPLES_PER_CYCLE;
+    return true;
+}
+
+/******************************************************************************
+* Function Name: Mains_SampleRate
+*******************************************************************************
+*
+* Summary:
+*  Get the PWM_isr tick rate that the filter will use, call after Mains_Configure
+*
+* Return:
+*  tick rate in mHz
+*
+*******************************************************************************/
+
+uint32 Mains_SampleRate(void) {
+    return mains_clock.rate_millihz;
+}
+
+/******************************************************************************
+* Function Name: Mains_Reset
+*******************************************************************************
+*
+* Summary:
+*  Set the PWM_isr tick for the mains frequency and clear the average, called
+*  when amperometry is armed.  Has to be called before the PWM is woken up
+*
+*******************************************************************************/
+
+void Mains_Reset(void) {
+    sample_count = 0;
+    sample_sum = 0;
+    if (mains_cycles) {
+        if (!clock_changed) {
+            saved_period = timer_period;
+            clock_changed = true;
+        }
+        SampleClock_SetRate((uint32)mains_frequency * MAINS_SAMPLES_PER_CYCLE * 1000, &mains_clock);
+    }
+}
+
+/******************************************************************************
+* Function Name: Mains_AddSample
+*******************************************************************************
+*
+* Summary:
+*  Add an adc sample to the average, called from the amperometry isr
+*
+* Parameters:
+*  int16 sample: adc count
+*  int16 *average: where to put the average when the last sample of the mains cycles is added
+*
+* Return:
+*  true (1) if a new average was put in average
+*
+*******************************************************************************/
+
+uint8 Mains_AddSample(int16 sample, int16 *average) {
+    sample_sum += sample;
+    sample_count++;
+    if (sample_count < samples_per_point) {
+        return false;
+    }
+    if (sample_sum >= 0) {  // round to the nearest count
+        *average = (sample_sum + samples_per_point/2) / samples_per_point;
+    }
+    else {
+        *average = (sample_sum - samples_per_point/2) / samples_per_point;
+    }
+    sample_count = 0;
+    sample_sum = 0;
+    return true;
+}
+
+/******************************************************************************
+* Function Name: mains_restore_clock
+*******************************************************************************
+*
+* Summary:
+*  Put the Clock_PWM divider back to the default and PWM_isr back to the period
+*  it had before a filtered run loaded the mains tick
+*
+*******************************************************************************/
+
+static void mains_restore_clock(void) {
+    if (!clock_changed) {
+        return;
+    }
+    clock_changed = false;
+    SampleClock_Default();
+    timer_period = saved_period;
+    PWM_isr_Wakeup();
+    PWM_isr_WriteCompare(timer_period / 2);
+    PWM_isr_WritePeriod(timer_period);
+    PWM_isr_Sleep();
+}
+
+/* [] END OF FILE */
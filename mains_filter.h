@@ -0,0 +1,44 @@
+/*******************************************************************************
+* File Name: mains_filter.h
+*
+* Description:
+*  This file contains the function prototypes and constants used for
+*  averaging amperometry samples over whole mains cycles
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#if !defined(MAINS_FILTER_H)
+#define MAINS_FILTER_H
+
+#include "cytypes.h"
+
+/**************************************
+*      Constants
+**************************************/
+
+#define MAINS_SAMPLES_PER_CYCLE 32  // adc samples in each mains cycle
+#define MAINS_MAX_CYCLES 50  // 1 second at 50 Hz
+
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+uint8 Mains_Configure(uint8 mains_hz, uint8 cycles);
+uint32 Mains_SampleRate(void);
+void Mains_Reset(void);
+uint8 Mains_AddSample(int16 sample, int16 *average);
+
+
+/***************************************
+* Global variables external identifier
+***************************************/
+
+extern uint8 mains_cycles;  // mains cycles in each reported data point, 0 when the filter is off
+
+#endif
+
+/* [] END OF FILE */
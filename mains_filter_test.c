@@ -0,0 +1,112 @@
+/*******************************************************************************
+* File Name: mains_filter_test.c
+*
+* Description:
+*  Checks the mains filter on a computer.  The tick is set for 50 and 60 Hz
+*  with the simulated PWM and made up samples with mains pickup and its
+*  harmonics are averaged, only the signal under the pickup should be left
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <project.h>
+#include "mains_filter.h"
+#include "sample_clock.h"
+#include "sim_test.h"
+
+#define TEST_SIGNAL -100  // adc counts under the pickup
+#define TEST_PICKUP 800  // adc counts of mains pickup
+#define TEST_HARMONIC 200  // of the 3rd harmonic
+#define TEST_POINTS 6
+
+uint16 timer_period;  // in main.c
+
+/* run the filter on pickup at a mains frequency, the tick is the one the
+   simulated PWM was set to so any error in the rate shows up in the average,
+   returns the largest error of the averages */
+static int32 run_filter(float64 mains_hz, uint8 cycles, uint8 *points) {
+    float64 tick_seconds = SampleClock_TickNs() * 1e-9;
+    uint16 samples = (uint16)cycles * MAINS_SAMPLES_PER_CYCLE;
+    int32 worst = 0;
+    int16 average;
+
+    *points = 0;
+    Mains_Reset();
+    for (uint32 n = 0; n < (uint32)samples * TEST_POINTS; n++) {
+        float64 t = n * tick_seconds;
+        float64 value = TEST_SIGNAL + TEST_PICKUP * sin(2*M_PI*mains_hz*t + 0.3)
+                        + TEST_HARMONIC * sin(2*M_PI*3*mains_hz*t + 1.1);
+        if (Mains_AddSample((int16)lround(value), &average)) {
+            (*points)++;
+            if (abs(average - TEST_SIGNAL) > worst) {
+                worst = abs(average - TEST_SIGNAL);
+            }
+        }
+    }
+    return worst;
+}
+
+static void test_mains(uint8 mains_hz) {
+    for (uint8 cycles = 1; cycles <= 4; cycles++) {
+        uint8 points;
+        SIM_CHECK(Mains_Configure(mains_hz, cycles));
+        Mains_Reset();
+        // the tick has to be exactly 32 per mains cycle, 24 MHz divides into both rates
+        SIM_CHECK(Mains_SampleRate() == (uint32)mains_hz * MAINS_SAMPLES_PER_CYCLE * 1000);
+        SIM_CHECK((uint32)sim_clock_divider * (sim_pwm_period + 1) ==
+                  BCLK__BUS_CLK__HZ / ((uint32)mains_hz * MAINS_SAMPLES_PER_CYCLE));
+        int32 worst = run_filter(mains_hz, cycles, &points);
+        SIM_CHECK(points == TEST_POINTS);
+        SIM_CHECK(worst <= 1);  // rounding of the samples and the average
+    }
+    // the mains is only held to about 1%, a 2 cycle average still takes out most of the pickup
+    Mains_Configure(mains_hz, 2);
+    uint8 points;
+    int32 off_frequency = run_filter(mains_hz * 1.01, 2, &points);
+    SIM_CHECK(off_frequency < TEST_PICKUP / 20);
+}
+
+/* the tick is only loaded when a run is armed and put back when the filter is turned off */
+static void test_clock(void) {
+    uint16 default_period = PWM_CLOCK_HZ / 1000 - 1;
+    Mains_Configure(0, 0);
+    SampleClock_Default();
+    timer_period = default_period;
+    PWM_isr_WritePeriod(timer_period);
+    SIM_CHECK(Mains_Configure(50, 2));
+    SIM_CHECK(Mains_SampleRate() == 50 * MAINS_SAMPLES_PER_CYCLE * 1000);
+    SIM_CHECK(sim_clock_divider == SAMPLE_CLOCK_DEFAULT_DIVIDER);
+    SIM_CHECK(sim_pwm_period == default_period);
+    Mains_Reset();
+    SIM_CHECK(sim_clock_divider * (sim_pwm_period + 1) == BCLK__BUS_CLK__HZ / (50 * MAINS_SAMPLES_PER_CYCLE));
+    SIM_CHECK(Mains_Configure(60, 2));  // changed between runs, the period from before the first is kept
+    Mains_Reset();
+    SIM_CHECK(!Mains_Configure(0, 0));
+    SIM_CHECK(sim_clock_divider == SAMPLE_CLOCK_DEFAULT_DIVIDER);
+    SIM_CHECK(sim_pwm_period == default_period);
+    SIM_CHECK(timer_period == default_period);
+}
+
+static void test_configure(void) {
+    SIM_CHECK(!Mains_Configure(55, 2));
+    SIM_CHECK(mains_cycles == 0);
+    SIM_CHECK(!Mains_Configure(50, 0));
+    SIM_CHECK(!Mains_Configure(60, MAINS_MAX_CYCLES + 1));
+    SIM_CHECK(Mains_Configure(60, MAINS_MAX_CYCLES));
+    SIM_CHECK(mains_cycles == MAINS_MAX_CYCLES);
+}
+
+int main(void) {
+    test_mains(50);
+    test_mains(60);
+    test_clock();
+    test_configure();
+    return sim_test_failures;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,179 @@
+/*******************************************************************************
+* File Name: ocp.c
+*
+* Description:
+*  Open circuit potential monitor.  The board has no path from the reference
+*  or working electrode to an ADC so the open circuit potential is found as
+*  the zero current potential: each tick the dac is moved 1 count towards the
+*  potential where the TIA reads no current, so the cell is at its open circuit
+*  potential with only the current of the 1 count steps.  The dac values are
+*  streamed in blocks like amperometry data.  When the dac stays inside a range
+*  for a full window the potential is called stable, which can be used to 
+*  start the next experiment
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include "ocp.h"
+#include "stdio.h"
+#include "string.h"
+#include "usb_protocols.h"
+#include "data_export.h"
+
+extern char usb_str[];
+
+static struct OCPSettings ocp;
+static uint8 running = false;
+static uint8 gate_ready = false;
+static uint16 dac_value;
+
+/* stability window */
+static uint32 window_ticks;
+static uint16 window_min;
+static uint16 window_max;
+
+/* data block being filled */
+static uint8 block_channel;
+static uint16 block_index;
+
+/***************************************
+* Forward function references
+***************************************/
+static void OCP_ClearWindow(void);
+
+
+/******************************************************************************
+* Function Name: OCP_Start
+*******************************************************************************
+*
+* Summary:
+*  Start tracking the open circuit potential from the virtual ground.  The
+*  caller has to enable the interrupt that calls OCP_Tick after this
+*
+* Parameters:
+*  struct OCPSettings *settings: how to track and when to call it stable
+*
+* Return:
+*  true if the settings are valid
+*
+*******************************************************************************/
+
+uint8 OCP_Start(struct OCPSettings *settings) {
+    if ((settings->block_size == 0) || (settings->block_size >= MAX_LUT_SIZE) || (settings->stable_window == 0)) {
+        return false;
+    }
+    if ((settings->gate != OCP_GATE_NONE) && (settings->gate != OCP_GATE_CV) && (settings->gate != OCP_GATE_SEQUENCE)) {
+        return false;
+    }
+    ocp = *settings;
+    dac_value = dac_ground_value;
+    SeqHAL_SetDAC(dac_value);
+    block_channel = 0;
+    block_index = 0;
+    gate_ready = false;
+    OCP_ClearWindow();
+    running = true;
+    return true;
+}
+
+/******************************************************************************
+* Function Name: OCP_Tick
+*******************************************************************************
+*
+* Summary:
+*  Move the dac towards zero current, save the dac value and check if the
+*  potential is stable
+*
+*******************************************************************************/
+
+void OCP_Tick(void) {
+    if (!running) {
+        return;
+    }
+    int32 error = (int32)SeqHAL_ReadADC() - ocp.zero_current_count;  // a reading and zero at opposite ends of the adc overflow an int16
+    if (error > 32767) {
+        error = 32767;
+    }
+    else if (error < -32768) {
+        error = -32768;
+    }
+    if (error > (int32)ocp.deadband) {
+        dac_value -= ocp.polarity;
+    }
+    else if (error < -(int32)ocp.deadband) {
+        dac_value += ocp.polarity;
+    }
+    if (dac_value > SeqHAL_MaxDAC()) {  // also catches going below 0
+        dac_value = (ocp.polarity*error > 0) ? 0 : SeqHAL_MaxDAC();
+    }
+    SeqHAL_SetDAC(dac_value);
+    
+    ADC_array[block_channel].data[block_index] = dac_value;
+    export_sequence++;
+    block_index++;
+    if (block_index >= ocp.block_size) {
+        ADC_array[block_channel].data[block_index] = ADC_DATA_DONE_CODE;
+        sprintf(usb_str, "Done%d", block_channel);  // same as amperometry so it is read with 'F'
+        Export_Notify((uint8*)usb_str, 6);
+        block_channel = (block_channel + 1) % adc_ring_channels;
+        block_index = 0;
+    }
+    
+    if (dac_value < window_min) {
+        window_min = dac_value;
+    }
+    if (dac_value > window_max) {
+        window_max = dac_value;
+    }
+    window_ticks++;
+    if (window_ticks >= ocp.stable_window) {
+        if (window_max - window_min <= ocp.stable_range) {
+            sprintf(usb_str, "OCPS%04d", dac_value);  // tell the computer the potential is stable
+            Export_Notify((uint8*)usb_str, 9);
+            if (ocp.gate != OCP_GATE_NONE) {
+                running = false;
+                gate_ready = true;  // the main loop starts the next experiment
+            }
+        }
+        OCP_ClearWindow();
+    }
+}
+
+void OCP_Stop(void) {
+    running = false;
+    gate_ready = false;
+}
+
+uint8 OCP_IsRunning(void) {
+    return running;
+}
+
+/******************************************************************************
+* Function Name: OCP_GateReady
+*******************************************************************************
+*
+* Summary:
+*  Check if the potential became stable and the next experiment should start
+*
+* Return:
+*  the gate setting (OCP_GATE_CV or OCP_GATE_SEQUENCE) once, then OCP_GATE_NONE
+*
+*******************************************************************************/
+
+uint8 OCP_GateReady(void) {
+    if (!gate_ready) {
+        return OCP_GATE_NONE;
+    }
+    gate_ready = false;
+    return ocp.gate;
+}
+
+static void OCP_ClearWindow(void) {
+    window_ticks = 0;
+    window_min = SeqHAL_MaxDAC();
+    window_max = 0;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,57 @@
+/*******************************************************************************
+* File Name: ocp.h
+*
+* Description:
+*  This file contains the function prototypes and constants used for
+*  the open circuit potential monitor
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#if !defined(OCP_H)
+#define OCP_H
+
+#include "cytypes.h"
+#include "globals.h"
+#include "sequencer_hal.h"
+
+/**************************************
+*      Constants
+**************************************/
+
+// what to start when the potential is stable
+#define OCP_GATE_NONE '0'
+#define OCP_GATE_CV 'R'
+#define OCP_GATE_SEQUENCE 'J'
+
+
+/**************************************
+*      Structures
+**************************************/
+
+struct OCPSettings {
+    int8 polarity;  // 1 if raising the dac raises the adc reading, -1 if it lowers it
+    int16 zero_current_count;  // adc reading with no current
+    uint16 deadband;  // adc counts around zero current where the dac is not changed
+    uint16 stable_range;  // largest change in the dac value over a window to call the potential stable
+    uint32 stable_window;  // ticks in a window
+    uint16 block_size;  // data points in each block sent to the computer
+    uint8 gate;  // OCP_GATE_XXX
+};
+
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+uint8 OCP_Start(struct OCPSettings *settings);
+void OCP_Tick(void);
+void OCP_Stop(void);
+uint8 OCP_IsRunning(void);
+uint8 OCP_GateReady(void);
+
+#endif
+
+/* [] END OF FILE */
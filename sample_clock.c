@@ -0,0 +1,247 @@
+/*******************************************************************************
+* File Name: sample_clock.c
+*
+* Description:
+*  Sets the PWM_isr tick rate over a wide range.  The PWM_isr period is only
+*  16 bits so with the 2.4 MHz Clock_PWM the slowest tick is about 37 Hz.
+*  The Clock_PWM divider is changed with the period so rates from below
+*  0.01 Hz to well over 10 kHz can be made.  The divider and period pair with
+*  the smallest error from the requested rate is used and the rate actually
+*  made is reported back to the computer.
+*  The rest of the firmware (sequencer, EIS, ASV) works out periods for the
+*  default 2.4 MHz clock so they call SampleClock_Default before running
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include <project.h>
+
+#include "sample_clock.h"
+
+extern uint16 timer_period;  // in main.c
+
+static uint16 divider_set = SAMPLE_CLOCK_DEFAULT_DIVIDER;
+
+/***************************************
+* Forward function references
+***************************************/
+static uint8 sample_clock_apply(uint64 source_clocks, struct SampleClockSetting *setting);
+
+
+/******************************************************************************
+* Function Name: SampleClock_Find
+*******************************************************************************
+*
+* Summary:
+*  Find the Clock_PWM divider and PWM_isr period that make a tick closest to
+*  the number of master clocks asked for.  Every divider that can reach the
+*  tick is tried, the search stops early if an exact match is found and on a
+*  tie the smallest divider is kept so the PWM compare has the finest steps
+*
+* Parameters:
+*  uint64 source_clocks: length of the tick in master clocks
+*  struct SampleClockSetting *setting: where to put the divider, period and rate made
+*
+* Return:
+*  true (1) if the tick can be made or false (0) if it is too long or too short
+*
+*******************************************************************************/
+
+uint8 SampleClock_Find(uint64 source_clocks, struct SampleClockSetting *setting) {
+    if ((source_clocks < (uint64)SAMPLE_CLOCK_MIN_DIVIDER*SAMPLE_CLOCK_MIN_COUNTS) || 
+        (source_clocks > (uint64)SAMPLE_CLOCK_MAX_DIVIDER*SAMPLE_CLOCK_MAX_COUNTS)) {
+        return false;
+    }
+    uint32 clocks = source_clocks;  // fits after the range check
+    uint32 first_divider = (clocks + SAMPLE_CLOCK_MAX_COUNTS - 1) / SAMPLE_CLOCK_MAX_COUNTS;
+    if (first_divider < SAMPLE_CLOCK_MIN_DIVIDER) {
+        first_divider = SAMPLE_CLOCK_MIN_DIVIDER;
+    }
+    uint32 last_divider = clocks / SAMPLE_CLOCK_MIN_COUNTS;
+    if (last_divider > SAMPLE_CLOCK_MAX_DIVIDER) {
+        last_divider = SAMPLE_CLOCK_MAX_DIVIDER;
+    }
+    uint32 best_error = 0xFFFFFFFF;
+    uint32 best_divider = first_divider;
+    uint32 best_counts = SAMPLE_CLOCK_MAX_COUNTS;
+    for (uint32 divider = first_divider; divider <= last_divider; divider++) {
+        uint32 counts = (clocks + divider/2) / divider;
+        if (counts > SAMPLE_CLOCK_MAX_COUNTS) {
+            counts = SAMPLE_CLOCK_MAX_COUNTS;
+        }
+        if (counts < SAMPLE_CLOCK_MIN_COUNTS) {
+            counts = SAMPLE_CLOCK_MIN_COUNTS;
+        }
+        uint32 made = divider * counts;
+        uint32 error = (made > clocks) ? made - clocks : clocks - made;
+        if (error < best_error) {
+            best_error = error;
+            best_divider = divider;
+            best_counts = counts;
+            if (error == 0) {
+                break;
+            }
+        }
+    }
+    setting->divider = best_divider;
+    setting->period = best_counts - 1;
+    uint64 made = (uint64)best_divider * best_counts;
+    setting->rate_millihz = ((uint64)SAMPLE_CLOCK_SOURCE_HZ*1000 + made/2) / made;
+    return true;
+}
+
+/******************************************************************************
+* Function Name: SampleClock_SetRate
+*******************************************************************************
+*
+* Summary:
+*  Set the PWM_isr tick to a rate
+*
+* Parameters:
+*  uint32 rate_millihz: tick rate in mHz, 10 is 0.01 Hz
+*  struct SampleClockSetting *setting: where to put the divider, period and rate made
+*
+* Return:
+*  true (1) if the rate was set or false (0) if it can not be made
+*
+*******************************************************************************/
+
+uint8 SampleClock_SetRate(uint32 rate_millihz, struct SampleClockSetting *setting) {
+    if (rate_millihz == 0) {
+        return false;
+    }
+    uint64 source_clocks = ((uint64)SAMPLE_CLOCK_SOURCE_HZ*1000 + rate_millihz/2) / rate_millihz;
+    return sample_clock_apply(source_clocks, setting);
+}
+
+/******************************************************************************
+* Function Name: SampleClock_SetPeriodNs
+*******************************************************************************
+*
+* Summary:
+*  Set the PWM_isr tick to a period
+*
+* Parameters:
+*  uint32 period_ns: time between ticks in ns
+*  struct SampleClockSetting *setting: where to put the divider, period and rate made
+*
+* Return:
+*  true (1) if the period was set or false (0) if it can not be made
+*
+*******************************************************************************/
+
+uint8 SampleClock_SetPeriodNs(uint32 period_ns, struct SampleClockSetting *setting) {
+    uint64 source_clocks = ((uint64)period_ns * BCLK__BUS_CLK__MHZ + 500) / 1000;
+    return sample_clock_apply(source_clocks, setting);
+}
+
+/******************************************************************************
+* Function Name: SampleClock_Default
+*******************************************************************************
+*
+* Summary:
+*  Put the Clock_PWM divider back to the 2.4 MHz clock the PWM periods sent by
+*  the 'T', 'S' and 'Q' commands and worked out by the other modes are made for
+*
+*******************************************************************************/
+
+void SampleClock_Default(void) {
+    if (divider_set != SAMPLE_CLOCK_DEFAULT_DIVIDER) {
+        Clock_PWM_SetDividerValue(SAMPLE_CLOCK_DEFAULT_DIVIDER);
+        divider_set = SAMPLE_CLOCK_DEFAULT_DIVIDER;
+    }
+}
+
+uint16 SampleClock_Divider(void) {
+    return divider_set;
+}
+
+/******************************************************************************
+* Function Name: SampleClock_IdleAllowed
+*******************************************************************************
+*
+* Summary:
+*  Check if the ticks are far enough apart that the main loop can sleep the
+*  CPU until the next interrupt
+*
+* Return:
+*  true (1) if the time between ticks is longer than SAMPLE_CLOCK_IDLE_US
+*
+*******************************************************************************/
+
+uint8 SampleClock_IdleAllowed(void) {
+    uint64 tick_clocks = (uint64)divider_set * (timer_period + 1);
+    return (tick_clocks > (uint64)SAMPLE_CLOCK_IDLE_US * BCLK__BUS_CLK__MHZ);
+}
+
+/******************************************************************************
+* Function Name: SampleClock_TickNs
+*******************************************************************************
+*
+* Summary:
+*  Work out the PWM_isr tick from the Clock_PWM divider and the period that is
+*  loaded, so the modes that set the period themselves are reported right
+*
+* Return:
+*  time between ticks in ns
+*
+*******************************************************************************/
+
+uint32 SampleClock_TickNs(void) {
+    return SampleClock_PeriodNs(PWM_isr_ReadPeriod());
+}
+
+/******************************************************************************
+* Function Name: SampleClock_PeriodNs
+*******************************************************************************
+*
+* Summary:
+*  Work out the tick a PWM_isr period will make with the Clock_PWM divider
+*  that is set, for the modes that change the period as they run
+*
+* Parameters:
+*  uint16 period: PWM_isr period register value
+*
+* Return:
+*  time between ticks in ns
+*
+*******************************************************************************/
+
+uint32 SampleClock_PeriodNs(uint16 period) {
+    uint64 tick_clocks = (uint64)divider_set * ((uint32)period + 1);
+    return (tick_clocks * 1000000000 + SAMPLE_CLOCK_SOURCE_HZ/2) / SAMPLE_CLOCK_SOURCE_HZ;
+}
+
+/******************************************************************************
+* Function Name: sample_clock_apply
+*******************************************************************************
+*
+* Summary:
+*  Find the setting for a tick and load it into Clock_PWM and PWM_isr
+*
+* Parameters:
+*  uint64 source_clocks: length of the tick in master clocks
+*  struct SampleClockSetting *setting: where to put the divider, period and rate made
+*
+* Return:
+*  true (1) if the tick was set or false (0) if it can not be made
+*
+*******************************************************************************/
+
+static uint8 sample_clock_apply(uint64 source_clocks, struct SampleClockSetting *setting) {
+    if (!SampleClock_Find(source_clocks, setting)) {
+        return false;
+    }
+    Clock_PWM_SetDividerValue(setting->divider);
+    divider_set = setting->divider;
+    timer_period = setting->period;
+    PWM_isr_Wakeup();
+    PWM_isr_WriteCompare(timer_period / 2);
+    PWM_isr_WritePeriod(timer_period);
+    PWM_isr_Sleep();
+    return true;
+}
+
+/* [] END OF FILE */
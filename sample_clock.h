@@ -0,0 +1,58 @@
+/*******************************************************************************
+* File Name: sample_clock.h
+*
+* Description:
+*  This file contains the function prototypes and constants used for
+*  setting the PWM_isr tick rate with the Clock_PWM divider and PWM period
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#if !defined(SAMPLE_CLOCK_H)
+#define SAMPLE_CLOCK_H
+
+#include "cytypes.h"
+#include "globals.h"
+
+/**************************************
+*      Constants
+**************************************/
+
+#define SAMPLE_CLOCK_SOURCE_HZ BCLK__BUS_CLK__HZ  // Clock_PWM is divided down from the master clock
+#define SAMPLE_CLOCK_DEFAULT_DIVIDER (SAMPLE_CLOCK_SOURCE_HZ / PWM_CLOCK_HZ)  // divider the rest of the firmware assumes
+#define SAMPLE_CLOCK_MIN_DIVIDER 2
+#define SAMPLE_CLOCK_MAX_DIVIDER 65535
+#define SAMPLE_CLOCK_MIN_COUNTS 2  // PWM_isr counts period + 1 clocks
+#define SAMPLE_CLOCK_MAX_COUNTS 65536
+#define SAMPLE_CLOCK_IDLE_US 2000  // let the CPU sleep between ticks when they are further apart than this
+
+
+/**************************************
+*      Structures
+**************************************/
+
+struct SampleClockSetting {
+    uint16 divider;  // Clock_PWM divider
+    uint16 period;  // PWM_isr period register, the tick is period + 1 Clock_PWM clocks
+    uint32 rate_millihz;  // tick rate that is made by the divider and period
+};
+
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+uint8 SampleClock_Find(uint64 source_clocks, struct SampleClockSetting *setting);
+uint8 SampleClock_SetRate(uint32 rate_millihz, struct SampleClockSetting *setting);
+uint8 SampleClock_SetPeriodNs(uint32 period_ns, struct SampleClockSetting *setting);
+void SampleClock_Default(void);
+uint16 SampleClock_Divider(void);
+uint8 SampleClock_IdleAllowed(void);
+uint32 SampleClock_TickNs(void);
+uint32 SampleClock_PeriodNs(uint16 period);
+
+#endif
+
+/* [] END OF FILE */
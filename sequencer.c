@@ -0,0 +1,450 @@
+/*******************************************************************************
+* File Name: sequencer.c
+*
+* Description:
+*  On-device experiment sequencer.  A program of steps (conditioning
+*  potentials, deposition holds, quiet times, sweeps) is uploaded once and
+*  then run back to back from the PWM_isr tick so the time between steps
+*  is set by the hardware and not the USB polling of the computer.
+*  All hardware calls go through sequencer_hal.h
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include "sequencer.h"
+#include "string.h"
+
+static struct SequenceStep program[SEQ_MAX_STEPS];
+static uint8 program_length = 0;
+static uint8 running = false;
+
+/* state of the step being run */
+static uint8 step_index;
+static uint32 step_tick;
+static uint32 step_ticks_total;
+
+/* state of the data block being filled */
+static uint8 block_channel;
+static uint16 block_index;
+static uint16 block_size;
+static int16 forward_sample;  // square wave forward pulse reading, saved until the reverse pulse is read
+
+/***************************************
+* Forward function references
+***************************************/
+static void Sequencer_LoadStep(void);
+static void Sequencer_Record(int16 sample);
+static void Sequencer_FlushBlock(void);
+static uint16 Sequencer_Checksum(const uint8 data[], uint16 length);
+
+
+/******************************************************************************
+* Function Name: Sequencer_Clear
+*******************************************************************************
+*
+* Summary:
+*  Remove all the steps from the program
+*
+* Return:
+*  true if the program was cleared, false if it is running
+*
+*******************************************************************************/
+
+uint8 Sequencer_Clear(void) {
+    if (running) {
+        return false;
+    }
+    program_length = 0;
+    return true;
+}
+
+/******************************************************************************
+* Function Name: Sequencer_AddStep
+*******************************************************************************
+*
+* Summary:
+*  Copy a step to the end of the program.  The dac values of the step,
+*  including the square wave pulses, have to be inside the dac range so
+*  Sequencer_StepValue can not go below 0 or past the largest value
+*
+* Parameters:
+*  struct SequenceStep *step: step to add
+*
+* Return:
+*  true if the step was added, false if the program is full or the step is not valid
+*
+*******************************************************************************/
+
+uint8 Sequencer_AddStep(struct SequenceStep *step) {
+    if (running || (program_length >= SEQ_MAX_STEPS) || (step->mode >= SEQ_NUM_MODES)) {
+        return false;
+    }
+    if (Sequencer_StepLength(step) == 0) {
+        return false;
+    }
+    uint16 low = step->start_value;
+    uint16 high = step->start_value;
+    uint16 pulse = 0;
+    if ((step->mode == SEQ_MODE_RAMP) || (step->mode == SEQ_MODE_CV) || (step->mode == SEQ_MODE_SWV)) {
+        if (step->end_value < low) {
+            low = step->end_value;
+        }
+        else {
+            high = step->end_value;
+        }
+    }
+    if (step->mode == SEQ_MODE_SWV) {
+        pulse = step->pulse_amplitude;
+    }
+    if ((low < pulse) || ((uint32)high + pulse > SeqHAL_MaxDAC())) {
+        return false;
+    }
+    program[program_length] = *step;
+    program_length++;
+    return true;
+}
+
+uint8 Sequencer_GetLength(void) {
+    return program_length;
+}
+
+uint8 Sequencer_IsRunning(void) {
+    return running;
+}
+
+/******************************************************************************
+* Function Name: Sequencer_Start
+*******************************************************************************
+*
+* Summary:
+*  Load the first step of the program into the hardware.  The caller has to
+*  enable the interrupt that calls Sequencer_Tick after this
+*
+* Parameters:
+*  uint16 _block_size: number of data points to put in an ADC_array channel
+*                      before telling the computer it can be read
+*
+* Return:
+*  true if the program is started, false if there is no program or the block size is too big
+*
+*******************************************************************************/
+
+uint8 Sequencer_Start(uint16 _block_size) {
+    if ((program_length == 0) || (_block_size == 0) || (_block_size >= MAX_LUT_SIZE)) {
+        return false;
+    }
+    block_size = _block_size;
+    block_channel = 0;
+    block_index = 0;
+    step_index = 0;
+    Sequencer_LoadStep();
+    running = true;
+    return true;
+}
+
+/******************************************************************************
+* Function Name: Sequencer_Tick
+*******************************************************************************
+*
+* Summary:
+*  Run one PWM_isr period of the program.  Save the adc reading for the dac
+*  value set on the last tick and set the next dac value, or go to the next
+*  step in the same tick so there is no gap between the steps
+*
+*******************************************************************************/
+
+void Sequencer_Tick(void) {
+    if (!running) {
+        return;
+    }
+    struct SequenceStep *step = &program[step_index];
+    if (step->route == SEQ_ROUTE_STREAM) {
+        if (step->mode != SEQ_MODE_SWV) {
+            Sequencer_Record(SeqHAL_ReadADC());
+        }
+        else if (step_tick & 1) {  // end of the reverse pulse, save the difference current
+            Sequencer_Record(forward_sample - SeqHAL_ReadADC());
+        }
+        else {
+            forward_sample = SeqHAL_ReadADC();
+        }
+    }
+    step_tick++;
+    if (step_tick < step_ticks_total) {
+        SeqHAL_SetDAC(Sequencer_StepValue(step, step_tick));
+        return;
+    }
+    Sequencer_FlushBlock();  // a data block only has data from 1 step
+    step_index++;
+    if (step_index >= program_length) {
+        running = false;
+        SeqHAL_Finished();
+        return;
+    }
+    Sequencer_LoadStep();
+}
+
+/******************************************************************************
+* Function Name: Sequencer_Stop
+*******************************************************************************
+*
+* Summary:
+*  Stop the program, the data that is already recorded is kept
+*
+*******************************************************************************/
+
+void Sequencer_Stop(void) {
+    running = false;
+}
+
+/******************************************************************************
+* Function Name: Sequencer_Save
+*******************************************************************************
+*
+* Summary:
+*  Save the program in the eeprom so it can be run later with no computer
+*  connected.  The steps are written before the header so a save that is cut
+*  off leaves a header that does not match the steps
+*
+* Parameters:
+*  uint16 block_size: data points in a block when the saved program is run
+*  uint8 autostart: true to run the program at power up if no computer is connected
+*
+* Return:
+*  true if the program was saved
+*
+*******************************************************************************/
+
+uint8 Sequencer_Save(uint16 block_size, uint8 autostart) {
+    if (running || (program_length == 0) || (block_size == 0) || (block_size >= MAX_LUT_SIZE)) {
+        return false;
+    }
+    struct SequenceStoreHeader header;
+    uint16 steps_size = program_length * sizeof(struct SequenceStep);
+    memset(&header, 0, sizeof(header));
+    header.tag[0] = SEQ_STORE_TAG0;
+    header.tag[1] = SEQ_STORE_TAG1;
+    header.length = program_length;
+    header.autostart = autostart;
+    header.block_size = block_size;
+    header.checksum = Sequencer_Checksum((uint8*)program, steps_size);
+    if (!SeqHAL_WriteStore((uint8*)program, SEQ_STORE_HEADER_SIZE, steps_size)) {
+        return false;
+    }
+    return SeqHAL_WriteStore((uint8*)&header, 0, sizeof(header));
+}
+
+/******************************************************************************
+* Function Name: Sequencer_Load
+*******************************************************************************
+*
+* Summary:
+*  Replace the program with the one saved by Sequencer_Save
+*
+* Parameters:
+*  uint16 *block_size: where to put the saved block size
+*  uint8 *autostart: where to put the saved autostart setting
+*
+* Return:
+*  true if a saved program was loaded, the program is empty if the saved one is not valid
+*
+*******************************************************************************/
+
+uint8 Sequencer_Load(uint16 *block_size, uint8 *autostart) {
+    if (running) {
+        return false;
+    }
+    struct SequenceStoreHeader header;
+    SeqHAL_ReadStore((uint8*)&header, 0, sizeof(header));
+    program_length = 0;
+    if ((header.tag[0] != SEQ_STORE_TAG0) || (header.tag[1] != SEQ_STORE_TAG1) ||
+        (header.length == 0) || (header.length > SEQ_MAX_STEPS)) {
+        return false;
+    }
+    uint16 steps_size = header.length * sizeof(struct SequenceStep);
+    SeqHAL_ReadStore((uint8*)program, SEQ_STORE_HEADER_SIZE, steps_size);
+    if (Sequencer_Checksum((uint8*)program, steps_size) != header.checksum) {
+        return false;
+    }
+    program_length = header.length;
+    *block_size = header.block_size;
+    *autostart = header.autostart;
+    return true;
+}
+
+/******************************************************************************
+* Function Name: Sequencer_StepLength
+*******************************************************************************
+*
+* Summary:
+*  Calculate how many PWM_isr ticks a step takes
+*
+* Parameters:
+*  struct SequenceStep *step: step to check
+*
+* Return:
+*  uint32: number of ticks
+*
+*******************************************************************************/
+
+uint32 Sequencer_StepLength(struct SequenceStep *step) {
+    uint16 span;
+    if (step->start_value > step->end_value) {
+        span = step->start_value - step->end_value;
+    }
+    else {
+        span = step->end_value - step->start_value;
+    }
+    switch (step->mode) {
+    case SEQ_MODE_RAMP:
+        return (uint32)span + 1;
+    case SEQ_MODE_CV:
+        return 2*(uint32)span + 1;
+    case SEQ_MODE_SWV:
+        return 2*((uint32)span + 1);  // a forward and reverse pulse for each stair
+    default:
+        return step->length;
+    }
+}
+
+/******************************************************************************
+* Function Name: Sequencer_ShortestPeriod
+*******************************************************************************
+*
+* Summary:
+*  Find the fastest tick of the program so it can be checked against the adc
+*
+* Return:
+*  uint16: smallest PWM_isr period of the steps, 0xFFFF if there are no steps
+*
+*******************************************************************************/
+
+uint16 Sequencer_ShortestPeriod(void) {
+    uint16 shortest = 0xFFFF;
+    for (uint8 i = 0; i < program_length; i++) {
+        if (program[i].timer_period < shortest) {
+            shortest = program[i].timer_period;
+        }
+    }
+    return shortest;
+}
+
+/******************************************************************************
+* Function Name: Sequencer_StepValue
+*******************************************************************************
+*
+* Summary:
+*  Calculate the dac value a step uses at a tick, sweeps are calculated
+*  instead of using waveform_lut so the look up table is free for other uses
+*
+* Parameters:
+*  struct SequenceStep *step: step being run
+*  uint32 tick: number of ticks since the step started
+*
+* Return:
+*  uint16: value to put in the dac
+*
+*******************************************************************************/
+
+uint16 Sequencer_StepValue(struct SequenceStep *step, uint32 tick) {
+    uint32 span = Sequencer_StepLength(step) / 2;  // only used for the triangle wave
+    int16 pulse = 0;
+    switch (step->mode) {
+    case SEQ_MODE_RAMP:
+        break;
+    case SEQ_MODE_CV:
+        if (tick > span) {  // on the way back to the start value
+            tick = 2*span - tick;
+        }
+        break;
+    case SEQ_MODE_SWV:
+        pulse = (tick & 1) ? -step->pulse_amplitude : step->pulse_amplitude;  // even ticks are the forward pulse
+        tick = tick / 2;
+        break;
+    default:
+        return step->start_value;
+    }
+    if (step->start_value < step->end_value) {
+        return step->start_value + tick + pulse;
+    }
+    return step->start_value - tick - pulse;
+}
+
+/******************************************************************************
+* Function Name: Sequencer_LoadStep
+*******************************************************************************
+*
+* Summary:
+*  Set the hardware for the step at step_index and reset the tick counter
+*
+*******************************************************************************/
+
+static void Sequencer_LoadStep(void) {
+    struct SequenceStep *step = &program[step_index];
+    step_tick = 0;
+    step_ticks_total = Sequencer_StepLength(step);
+    SeqHAL_SetGain(step->tia_resistor, step->adc_buffer);
+    SeqHAL_SetPeriod(step->timer_period);
+    SeqHAL_SetDAC(Sequencer_StepValue(step, 0));
+}
+
+/******************************************************************************
+* Function Name: Sequencer_Record
+*******************************************************************************
+*
+* Summary:
+*  Save a data point in the current block and send the block when it is full
+*
+* Parameters:
+*  int16 sample: adc reading to save
+*
+*******************************************************************************/
+
+static void Sequencer_Record(int16 sample) {
+    ADC_array[block_channel].data[block_index] = sample;
+    block_index++;
+    if (block_index >= block_size) {
+        Sequencer_FlushBlock();
+    }
+}
+
+/******************************************************************************
+* Function Name: Sequencer_FlushBlock
+*******************************************************************************
+*
+* Summary:
+*  Mark the end of the current block, tell the computer which channel and step
+*  it is from and move to the next ADC_array channel
+*
+*******************************************************************************/
+
+static void Sequencer_FlushBlock(void) {
+    if (block_index == 0) {
+        return;
+    }
+    ADC_array[block_channel].data[block_index] = ADC_DATA_DONE_CODE;
+    SeqHAL_BlockReady(block_channel, step_index, block_index);
+    block_channel = (block_channel + 1) % adc_ring_channels;
+    block_index = 0;
+}
+
+/******************************************************************************
+* Function Name: Sequencer_Checksum
+*******************************************************************************
+*
+* Summary:
+*  Add up bytes to check a saved program was read back the way it was written
+*
+*******************************************************************************/
+
+static uint16 Sequencer_Checksum(const uint8 data[], uint16 length) {
+    uint16 sum = 0;
+    for (uint16 i = 0; i < length; i++) {
+        sum += data[i];
+    }
+    return sum;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,90 @@
+/*******************************************************************************
+* File Name: sequencer.h
+*
+* Description:
+*  This file contains the function prototypes and constants used for
+*  the on-device experiment sequencer that runs a program of steps
+*  back to back without the computer in between the steps
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#if !defined(SEQUENCER_H)
+#define SEQUENCER_H
+
+#include "cytypes.h"
+#include "globals.h"
+#include "sequencer_hal.h"
+
+/**************************************
+*      Constants
+**************************************/
+
+#define SEQ_MAX_STEPS 16
+
+// step modes
+#define SEQ_MODE_HOLD 0  // hold the start value, use for conditioning, deposition and quiet times
+#define SEQ_MODE_AMP 1  // hold the start value and record the current
+#define SEQ_MODE_RAMP 2  // linear sweep from the start to end value, 1 dac step per tick
+#define SEQ_MODE_CV 3  // triangle sweep from the start to end value and back to the start value
+#define SEQ_MODE_SWV 4  // square wave staircase from the start to end value, records forward - reverse current
+#define SEQ_NUM_MODES 5
+
+// saved program, see Sequencer_Save
+#define SEQ_STORE_TAG0 'S'
+#define SEQ_STORE_TAG1 'Q'
+#define SEQ_STORE_HEADER_SIZE 16  // one eeprom row, the steps start on the next row
+
+// where the data of a step is sent
+#define SEQ_ROUTE_NONE 0  // data is not saved
+#define SEQ_ROUTE_STREAM 1  // data is put in the ADC_array channels and the computer is told when a block is ready
+
+    
+/**************************************
+*      Structures
+**************************************/
+
+struct SequenceStep {
+    uint8 mode;  // SEQ_MODE_XXX
+    uint8 tia_resistor;  // index for TIA_SetResFB
+    uint8 adc_buffer;  // index for ADC_SigDel_SetBufferGain
+    uint8 route;  // SEQ_ROUTE_XXX
+    uint16 start_value;  // dac value at the start of the step
+    uint16 end_value;  // dac value at the end of a sweep, not used for hold or amperometry steps
+    uint16 timer_period;  // PWM_isr period used for the step
+    uint16 pulse_amplitude;  // dac counts above and below the staircase for square wave steps
+    uint32 length;  // number of PWM_isr ticks for hold or amperometry steps, sweeps calculate their own length
+};
+
+struct SequenceStoreHeader {
+    uint8 tag[2];  // SEQ_STORE_TAG0 and SEQ_STORE_TAG1 if a program is saved
+    uint8 length;  // number of steps saved
+    uint8 autostart;  // true to run the program at power up when no computer is connected
+    uint16 block_size;  // data points in a block
+    uint16 checksum;  // sum of the bytes of the saved steps
+    uint8 reserved[8];
+};
+
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+uint8 Sequencer_Clear(void);
+uint8 Sequencer_AddStep(struct SequenceStep *step);
+uint8 Sequencer_GetLength(void);
+uint8 Sequencer_IsRunning(void);
+uint8 Sequencer_Start(uint16 block_size);
+void Sequencer_Tick(void);
+void Sequencer_Stop(void);
+uint32 Sequencer_StepLength(struct SequenceStep *step);
+uint16 Sequencer_ShortestPeriod(void);
+uint16 Sequencer_StepValue(struct SequenceStep *step, uint32 tick);
+uint8 Sequencer_Save(uint16 block_size, uint8 autostart);
+uint8 Sequencer_Load(uint16 *block_size, uint8 *autostart);
+
+#endif
+
+/* [] END OF FILE */
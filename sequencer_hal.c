@@ -0,0 +1,169 @@
+/*******************************************************************************
+* File Name: sequencer_hal.c
+*
+* Description:
+*  PSoC hardware calls used by the sequencer, see sequencer_hal.h
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include <project.h>
+#include "stdio.h"
+#include "string.h"
+
+#include "adc_profile.h"
+#include "DAC.h"
+#include "data_export.h"
+#include "flash_log.h"
+#include "globals.h"
+#include "helper_functions.h"
+#include "sequencer_hal.h"
+#include "usb_protocols.h"
+
+extern char usb_str[];
+void HardwareSleep(void);  // in main.c
+
+static uint8 tia_resistor_set = 0xFF;  // last gain settings so the registers are only written when they change
+static uint8 adc_buffer_set = 0xFF;
+
+
+void SeqHAL_SetDAC(uint16 value) {
+    DAC_SetValue(value);
+}
+
+uint16 SeqHAL_MaxDAC(void) {
+    return DAC_MaxValue();
+}
+
+int16 SeqHAL_ReadADC(void) {
+    return AdcProfile_GetResult();
+}
+
+/******************************************************************************
+* Function Name: SeqHAL_SetGain
+*******************************************************************************
+*
+* Summary:
+*  Set the TIA resistor and ADC buffer gain for a step
+*
+* Parameters:
+*  uint8 tia_resistor: index for TIA_SetResFB
+*  uint8 adc_buffer: index for ADC_SigDel_SetBufferGain
+*
+*******************************************************************************/
+
+void SeqHAL_SetGain(uint8 tia_resistor, uint8 adc_buffer) {
+    if (tia_resistor != tia_resistor_set) {
+        TIA_SetResFB(tia_resistor);
+        tia_resistor_set = tia_resistor;
+    }
+    if (adc_buffer != adc_buffer_set) {
+        ADC_SigDel_SetBufferGain(adc_buffer);
+        adc_buffer_set = adc_buffer;
+    }
+}
+
+/******************************************************************************
+* Function Name: SeqHAL_ForgetGain
+*******************************************************************************
+*
+* Summary:
+*  Make the next SeqHAL_SetGain write the registers, used after the gain was
+*  set some other way e.g. the user's 'A' command
+*
+*******************************************************************************/
+
+void SeqHAL_ForgetGain(void) {
+    tia_resistor_set = 0xFF;
+    adc_buffer_set = 0xFF;
+}
+
+/******************************************************************************
+* Function Name: SeqHAL_SetPeriod
+*******************************************************************************
+*
+* Summary:
+*  Set the PWM_isr period for a step, the new period is loaded by the PWM
+*  at the end of the current period so the step change stays on a tick
+*
+* Parameters:
+*  uint16 timer_period: period to put in PWM_isr
+*
+*******************************************************************************/
+
+void SeqHAL_SetPeriod(uint16 timer_period) {
+    PWM_isr_WriteCompare(timer_period / 2);
+    PWM_isr_WritePeriod(timer_period);
+}
+
+/******************************************************************************
+* Function Name: SeqHAL_BlockReady
+*******************************************************************************
+*
+* Summary:
+*  Tell the computer a block of data is ready to be read with the 'F' command.
+*  Sends "J" + channel + | + step + | + number of data points in the block.
+*  When the run is logged to flash the block is queued for the flash instead,
+*  and the sequencer is stopped if the flash writes have fallen behind
+*
+*******************************************************************************/
+
+void SeqHAL_BlockReady(uint8 channel, uint8 step, uint16 count) {
+    if (FlashLog_IsRunning()) {
+        if (!FlashLog_BlockReady(channel, step, count)) {
+            isr_adcAmp_Disable();  // the main loop finishes the run
+        }
+        return;
+    }
+    sprintf(usb_str, "J%d|%02d|%04d", channel, step, count);
+    Export_Notify((uint8*)usb_str, strlen(usb_str)+1);
+}
+
+/******************************************************************************
+* Function Name: SeqHAL_Finished
+*******************************************************************************
+*
+* Summary:
+*  Stop the interrupt running the sequencer, put the hardware to sleep and
+*  tell the computer the program is done
+*
+*******************************************************************************/
+
+void SeqHAL_Finished(void) {
+    isr_adcAmp_Disable();
+    HardwareSleep();
+    SeqHAL_ForgetGain();  // the user can change the gain between runs with the 'A' command
+    Export_Notify((uint8*)"JDone", 6);
+}
+
+/******************************************************************************
+* Function Name: SeqHAL_WriteStore
+*******************************************************************************
+*
+* Summary:
+*  Save part of a program in the eeprom, starting at row SEQ_STORE_ROW
+*
+* Parameters:
+*  const uint8 data[]: bytes to save
+*  uint16 offset: where to put them from the start of the store, has to be a
+*                 multiple of CYDEV_EEPROM_ROW_SIZE
+*  uint16 length: number of bytes, rounded up to whole rows so data has to be
+*                 that long
+*
+* Return:
+*  true if the eeprom was written
+*
+*******************************************************************************/
+
+uint8 SeqHAL_WriteStore(const uint8 data[], uint16 offset, uint16 length) {
+    uint8 rows = (length + CYDEV_EEPROM_ROW_SIZE - 1) / CYDEV_EEPROM_ROW_SIZE;
+    return helper_WriteRows_EEPROM(data, SEQ_STORE_ROW + offset/CYDEV_EEPROM_ROW_SIZE, rows);
+}
+
+void SeqHAL_ReadStore(uint8 data[], uint16 offset, uint16 length) {
+    helper_Read_EEPROM(data, SEQ_STORE_ROW*CYDEV_EEPROM_ROW_SIZE + offset, length);
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,37 @@
+/*******************************************************************************
+* File Name: sequencer_hal.h
+*
+* Description:
+*  Hardware calls the sequencer needs.  sequencer.c only calls the hardware
+*  through these functions so it can be linked against sequencer_hal.c on the
+*  device or a simulated version of these functions on a computer
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#if !defined(SEQUENCER_HAL_H)
+#define SEQUENCER_HAL_H
+
+#include "cytypes.h"
+
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+void SeqHAL_SetDAC(uint16 value);
+uint16 SeqHAL_MaxDAC(void);
+int16 SeqHAL_ReadADC(void);
+void SeqHAL_SetGain(uint8 tia_resistor, uint8 adc_buffer);
+void SeqHAL_ForgetGain(void);
+void SeqHAL_SetPeriod(uint16 timer_period);
+void SeqHAL_BlockReady(uint8 channel, uint8 step, uint16 count);
+void SeqHAL_Finished(void);
+uint8 SeqHAL_WriteStore(const uint8 data[], uint16 offset, uint16 length);
+void SeqHAL_ReadStore(uint8 data[], uint16 offset, uint16 length);
+
+#endif
+
+/* [] END OF FILE */
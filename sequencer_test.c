@@ -0,0 +1,174 @@
+/*******************************************************************************
+* File Name: sequencer_test.c
+*
+* Description:
+*  Runs the sequencer on a computer against the simulated hardware in sim/.
+*  Checks the steps run back to back, the blocks are tagged with the step
+*  they came from, steps outside the dac range are refused and a saved
+*  program loads back the same
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include "string.h"
+
+#include "DAC.h"
+#include "sequencer.h"
+#include "sequencer_hal_sim.h"
+#include "sim_test.h"
+
+#define TEST_BLOCK_SIZE 5
+#define TEST_OHMS 100000.0  // 10 nA per mV so 10 adc counts per dac count
+#define TEST_COUNTS_PER_DAC 10
+#define TEST_PULSE 25
+
+static struct SequenceStep make_step(uint8 mode, uint16 start, uint16 end, uint32 length) {
+    struct SequenceStep step;
+    memset(&step, 0, sizeof(step));
+    step.mode = mode;
+    step.tia_resistor = 1;
+    step.adc_buffer = 0;
+    step.route = (mode == SEQ_MODE_HOLD) ? SEQ_ROUTE_NONE : SEQ_ROUTE_STREAM;
+    step.start_value = start;
+    step.end_value = end;
+    step.timer_period = 2399;  // 1 ms ticks
+    step.length = length;
+    return step;
+}
+
+static void load_program(void) {
+    struct SequenceStep step;
+    SIM_CHECK(Sequencer_Clear());
+    step = make_step(SEQ_MODE_HOLD, 2048, 0, 5);
+    SIM_CHECK(Sequencer_AddStep(&step));
+    step = make_step(SEQ_MODE_AMP, 2148, 0, 12);
+    step.timer_period = 4799;  // the period changes with the step
+    SIM_CHECK(Sequencer_AddStep(&step));
+    step = make_step(SEQ_MODE_RAMP, 2000, 2010, 0);
+    SIM_CHECK(Sequencer_AddStep(&step));
+    step = make_step(SEQ_MODE_SWV, 2100, 2103, 0);
+    step.pulse_amplitude = TEST_PULSE;
+    SIM_CHECK(Sequencer_AddStep(&step));
+}
+
+static void test_step_limits(void) {
+    struct SequenceStep step;
+    selected_voltage_source = VDAC_IS_DVDAC;
+    SIM_CHECK(Sequencer_Clear());
+    step = make_step(SEQ_MODE_SWV, 20, 100, 0);
+    step.pulse_amplitude = 21;  // the first reverse pulse would go below 0
+    SIM_CHECK(!Sequencer_AddStep(&step));
+    step.pulse_amplitude = 20;
+    SIM_CHECK(Sequencer_AddStep(&step));
+    step = make_step(SEQ_MODE_RAMP, 4000, 4096, 0);
+    SIM_CHECK(!Sequencer_AddStep(&step));
+    step = make_step(SEQ_MODE_SWV, 4000, 4090, 0);
+    step.pulse_amplitude = 6;
+    SIM_CHECK(!Sequencer_AddStep(&step));
+    step = make_step(SEQ_MODE_HOLD, 100, 9999, 10);  // the end value is not used by a hold
+    SIM_CHECK(Sequencer_AddStep(&step));
+    
+    selected_voltage_source = VDAC_IS_VDAC;  // the 8-bit VDAC stops at 255
+    step = make_step(SEQ_MODE_AMP, 256, 0, 10);
+    SIM_CHECK(!Sequencer_AddStep(&step));
+    step = make_step(SEQ_MODE_CV, 100, 255, 0);
+    SIM_CHECK(Sequencer_AddStep(&step));
+    selected_voltage_source = VDAC_IS_DVDAC;
+}
+
+static void test_run(void) {
+    uint32 expected_ticks = 5 + 12 + 11 + 2*4;
+    uint16 dac_history[64];
+    
+    load_program();
+    SimHAL_Reset();
+    SimCell_Resistor(&sim_cell, TEST_OHMS);
+    SIM_CHECK(Sequencer_Start(TEST_BLOCK_SIZE));
+    SIM_CHECK(!Sequencer_Clear());  // the program can't change under the isr
+    struct SequenceStep step = make_step(SEQ_MODE_HOLD, 2048, 0, 5);
+    SIM_CHECK(!Sequencer_AddStep(&step));
+    SIM_CHECK(Sequencer_GetLength() == 4);
+    SIM_CHECK(Sequencer_ShortestPeriod() == 2399);  // the fastest tick is checked against the adc
+    
+    while (Sequencer_IsRunning() && (sim_ticks < 1000)) {
+        if (sim_ticks < 64) {
+            dac_history[sim_ticks] = sim_dac_value;
+        }
+        SimHAL_Advance();
+        Sequencer_Tick();
+    }
+    SIM_CHECK(sim_finished);
+    SIM_CHECK(sim_ticks == expected_ticks);  // no gaps between the steps
+    SIM_CHECK(dac_history[4] == 2048);
+    SIM_CHECK(dac_history[5] == 2148);  // the amperometry step starts on the tick after the hold ends
+    SIM_CHECK(dac_history[17] == 2000);
+    SIM_CHECK(dac_history[27] == 2010);
+    SIM_CHECK(dac_history[28] == 2100 + TEST_PULSE);
+    SIM_CHECK(dac_history[29] == 2100 - TEST_PULSE);
+    SIM_CHECK(dac_history[35] == 2103 - TEST_PULSE);
+    
+    // 12 amperometry points, 11 ramp points and 4 square wave differences
+    static const uint8 steps[] = {1, 1, 1, 2, 2, 2, 3};
+    static const uint16 counts[] = {5, 5, 2, 5, 5, 1, 4};
+    SIM_CHECK(sim_block_count == sizeof(steps));
+    for (uint8 i = 0; (i < sim_block_count) && (i < sizeof(steps)); i++) {
+        SIM_CHECK(sim_blocks[i].step == steps[i]);
+        SIM_CHECK(sim_blocks[i].count == counts[i]);
+        SIM_CHECK(sim_blocks[i].channel == i % ADC_CHANNELS);
+    }
+    for (uint8 i = 0; i < 5; i++) {
+        SIM_CHECK(sim_blocks[0].data[i] == 100*TEST_COUNTS_PER_DAC);
+        SIM_CHECK(sim_blocks[3].data[i] == (2000 + i - 2048)*TEST_COUNTS_PER_DAC);
+    }
+    for (uint8 i = 0; i < 4; i++) {
+        SIM_CHECK(sim_blocks[6].data[i] == 2*TEST_PULSE*TEST_COUNTS_PER_DAC);
+    }
+    SIM_CHECK(sim_pwm_period == 2399);
+}
+
+static void test_blank_kept(void) {
+    adc_ring_channels = ADC_CHANNELS - 1;  // what blank_subtract.c does when it saves a blank
+    load_program();
+    SimHAL_Reset();
+    SimCell_Resistor(&sim_cell, TEST_OHMS);
+    SIM_CHECK(Sequencer_Start(TEST_BLOCK_SIZE));
+    while (Sequencer_IsRunning() && (sim_ticks < 1000)) {
+        SimHAL_Advance();
+        Sequencer_Tick();
+    }
+    SIM_CHECK(sim_block_count == 7);
+    for (uint8 i = 0; i < sim_block_count; i++) {
+        SIM_CHECK(sim_blocks[i].channel == i % (ADC_CHANNELS - 1));
+    }
+    adc_ring_channels = ADC_CHANNELS;
+}
+
+static void test_save_load(void) {
+    uint16 block_size = 0;
+    uint8 autostart = false;
+    
+    load_program();
+    SIM_CHECK(Sequencer_Save(TEST_BLOCK_SIZE, true));
+    SIM_CHECK(Sequencer_Clear());
+    SIM_CHECK(Sequencer_Load(&block_size, &autostart));
+    SIM_CHECK(Sequencer_GetLength() == 4);
+    SIM_CHECK(block_size == TEST_BLOCK_SIZE);
+    SIM_CHECK(autostart);
+    
+    sim_store[SEQ_STORE_HEADER_SIZE + 5] ^= 0x01;  // a changed step fails the checksum
+    SIM_CHECK(!Sequencer_Load(&block_size, &autostart));
+    SIM_CHECK(Sequencer_GetLength() == 0);
+}
+
+int main(void) {
+    DAC_Start();
+    test_step_limits();
+    test_run();
+    test_blank_kept();
+    test_save_load();
+    return sim_test_failures;
+}
+
+/* [] END OF FILE */
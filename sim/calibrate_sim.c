@@ -0,0 +1,23 @@
+/*******************************************************************************
+* File Name: calibrate_sim.c
+*
+* Description:
+*  calibrate_GetFit for the simulated boards, the fit is set by the test or
+*  the simulated board from the model of the cell instead of being measured
+*  with the IDAC
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include "calibrate_sim.h"
+
+struct CalibrationFit sim_calibration_fit;
+
+
+void calibrate_GetFit(struct CalibrationFit *fit) {
+    *fit = sim_calibration_fit;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,21 @@
+/*******************************************************************************
+* File Name: calibrate_sim.h
+*
+* Description:
+*  The calibration fit of the simulated boards, see calibrate_sim.c
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#if !defined(CALIBRATE_SIM_H)
+#define CALIBRATE_SIM_H
+
+#include "calibrate.h"
+
+extern struct CalibrationFit sim_calibration_fit;  // what calibrate_GetFit gives
+
+#endif
+
+/* [] END OF FILE */
@@ -0,0 +1,40 @@
+/*******************************************************************************
+* File Name: cytypes.h
+*
+* Description:
+*  PSoC Creator types for building the hardware free firmware modules on a
+*  computer, the sizes match the ARM Cortex-M3 of the PSoC 5LP
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#if !defined(CY_TYPES_H)
+#define CY_TYPES_H
+
+#include <stdint.h>
+
+typedef uint8_t uint8;
+typedef uint16_t uint16;
+typedef uint32_t uint32;
+typedef uint64_t uint64;
+typedef int8_t int8;
+typedef int16_t int16;
+typedef int32_t int32;
+typedef int64_t int64;
+typedef float float32;
+typedef double float64;
+typedef void (*cyisraddress)(void);
+
+#define CY_ISR(FuncName) void FuncName(void)
+#define CY_ISR_PROTO(FuncName) void FuncName(void)
+#define CYRET_SUCCESS 0x00u
+#define CYRET_BAD_PARAM 0x01u
+
+#define BCLK__BUS_CLK__HZ 24000000u
+#define BCLK__BUS_CLK__MHZ 24u
+
+#endif
+
+/* [] END OF FILE */
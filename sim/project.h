@@ -0,0 +1,78 @@
+/*******************************************************************************
+* File Name: project.h
+*
+* Description:
+*  The component calls the hardware free firmware modules make, for building
+*  them on a computer.  psoc_sim.c saves the values written so the tests can
+*  check them
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#if !defined(SIM_PROJECT_H)
+#define SIM_PROJECT_H
+
+#include "cytypes.h"
+
+void PWM_isr_WriteCompare(uint16 compare);
+void PWM_isr_WritePeriod(uint16 period);
+uint16 PWM_isr_ReadPeriod(void);
+void PWM_isr_Sleep(void);
+void PWM_isr_Wakeup(void);
+void Clock_PWM_SetDividerValue(uint16 divider);
+
+void DVDAC_Start(void);
+void DVDAC_Sleep(void);
+void DVDAC_Wakeup(void);
+void DVDAC_SetValue(uint16 value);
+void VDAC_source_Start(void);
+void VDAC_source_Sleep(void);
+void VDAC_source_Wakeup(void);
+void VDAC_source_SetValue(uint8 value);
+void AMux_V_source_Select(uint8 channel);
+void LCD_Position(uint8 row, uint8 column);
+void isr_adcAmp_Disable(void);
+
+#define TRACE_ENABLED 0  // trace.h needs the cycle counter and PRIMASK of the Cortex-M3
+
+uint8 helper_check_voltage_source(void);
+
+uint8 CyEnterCriticalSection(void);
+void CyExitCriticalSection(uint8 state);
+void CyGetUniqueId(uint32 *unique_id);
+
+/* the schematic only has CFG1, a test of the other profiles builds with
+   ADC_SigDel_DEFAULT_NUM_CONFIGS set to 3 to have the CFG2 and CFG3 they need */
+#if !defined(ADC_SigDel_DEFAULT_NUM_CONFIGS)
+#define ADC_SigDel_DEFAULT_NUM_CONFIGS 1
+#endif
+#define ADC_SigDel_CFG1_RESOLUTION 16
+#define ADC_SigDel_CFG1_SRATE 12500
+#if (ADC_SigDel_DEFAULT_NUM_CONFIGS > 1)
+#define ADC_SigDel_CFG2_RESOLUTION 12
+#define ADC_SigDel_CFG2_SRATE 48000
+#define ADC_SigDel_CFG3_RESOLUTION 20
+#define ADC_SigDel_CFG3_SRATE 187
+#endif
+void ADC_SigDel_SelectConfiguration(uint8 config, uint8 restart);
+void ADC_SigDel_SetBufferGain(uint8 gain);
+void ADC_SigDel_Sleep(void);
+int16 ADC_SigDel_GetResult16(void);
+int32 ADC_SigDel_GetResult32(void);
+
+
+/***************************************
+* Values saved by psoc_sim.c
+***************************************/
+
+extern uint16 sim_pwm_period;
+extern uint16 sim_clock_divider;
+extern uint16 sim_dac_value;  // last value written to either dac
+extern int32 sim_adc_result;  // what ADC_SigDel reads next, in the bits of the configuration selected
+extern uint32 sim_unique_id[2];  // CyGetUniqueId, tells the simulated boards apart
+
+#endif
+
+/* [] END OF FILE */
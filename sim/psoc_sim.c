@@ -0,0 +1,108 @@
+/*******************************************************************************
+* File Name: psoc_sim.c
+*
+* Description:
+*  Component calls for building the firmware modules on a computer.  They only
+*  save what was written, see project.h
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include "project.h"
+#include "globals.h"
+
+uint16 sim_pwm_period = PWM_CLOCK_HZ / 1000 - 1;
+uint16 sim_clock_divider = BCLK__BUS_CLK__HZ / PWM_CLOCK_HZ;
+uint16 sim_dac_value = 0;
+int32 sim_adc_result = 0;
+uint32 sim_unique_id[2] = {0x53494D00, 0};
+
+union data_usb_union ADC_array[ADC_CHANNELS];  // allocated in main.c on the device
+uint16 waveform_lut[MAX_LUT_SIZE];  // also in main.c
+uint8 adc_ring_channels = ADC_CHANNELS;
+
+
+void PWM_isr_WriteCompare(uint16 compare) {
+    (void)compare;
+}
+
+void PWM_isr_WritePeriod(uint16 period) {
+    sim_pwm_period = period;
+}
+
+uint16 PWM_isr_ReadPeriod(void) {
+    return sim_pwm_period;
+}
+
+void PWM_isr_Sleep(void) {}
+void PWM_isr_Wakeup(void) {}
+void isr_adcAmp_Disable(void) {}
+
+void Clock_PWM_SetDividerValue(uint16 divider) {
+    sim_clock_divider = divider;
+}
+
+void DVDAC_Start(void) {}
+void DVDAC_Sleep(void) {}
+void DVDAC_Wakeup(void) {}
+
+void DVDAC_SetValue(uint16 value) {
+    sim_dac_value = value;
+}
+
+void VDAC_source_Start(void) {}
+void VDAC_source_Sleep(void) {}
+void VDAC_source_Wakeup(void) {}
+
+void VDAC_source_SetValue(uint8 value) {
+    sim_dac_value = value;
+}
+
+void AMux_V_source_Select(uint8 channel) {
+    (void)channel;
+}
+
+void LCD_Position(uint8 row, uint8 column) {
+    (void)row;
+    (void)column;
+}
+
+uint8 helper_check_voltage_source(void) {
+    return VDAC_IS_DVDAC;
+}
+
+uint8 CyEnterCriticalSection(void) {  // the simulated isrs run between the main loop calls
+    return 0;
+}
+
+void CyExitCriticalSection(uint8 state) {
+    (void)state;
+}
+
+void CyGetUniqueId(uint32 *unique_id) {
+    unique_id[0] = sim_unique_id[0];
+    unique_id[1] = sim_unique_id[1];
+}
+
+void ADC_SigDel_SelectConfiguration(uint8 config, uint8 restart) {
+    (void)config;
+    (void)restart;
+}
+
+void ADC_SigDel_SetBufferGain(uint8 gain) {
+    (void)gain;
+}
+
+void ADC_SigDel_Sleep(void) {}
+
+int16 ADC_SigDel_GetResult16(void) {
+    return (int16)sim_adc_result;
+}
+
+int32 ADC_SigDel_GetResult32(void) {
+    return sim_adc_result;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,118 @@
+/*******************************************************************************
+* File Name: sequencer_hal_sim.c
+*
+* Description:
+*  Simulated version of sequencer_hal.c so the sequencer, EIS and OCP modules
+*  can be run on a computer.  The dac goes through the real DAC.c into
+*  psoc_sim.c, the adc reads a model of the cell (sim_cell.c), the blocks are
+*  copied into sim_blocks instead of being sent and the eeprom is a RAM array.
+*  Time only moves on when the test calls SimHAL_Advance after each tick
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include <project.h>
+#include "string.h"
+
+#include "DAC.h"
+#include "sequencer_hal.h"
+#include "sequencer_hal_sim.h"
+
+struct SimCell sim_cell;
+struct SimBlock sim_blocks[SIM_MAX_BLOCKS];
+uint16 sim_block_count;
+uint32 sim_ticks;
+uint8 sim_finished;
+uint8 sim_tia_resistor;
+uint8 sim_adc_buffer;
+uint8 sim_store[SIM_STORE_SIZE];
+
+
+/******************************************************************************
+* Function Name: SimHAL_Reset
+*******************************************************************************
+*
+* Summary:
+*  Clear the saved blocks and time, the cell and the store are kept
+*
+*******************************************************************************/
+
+void SimHAL_Reset(void) {
+    sim_block_count = 0;
+    sim_ticks = 0;
+    sim_finished = false;
+}
+
+/******************************************************************************
+* Function Name: SimHAL_Advance
+*******************************************************************************
+*
+* Summary:
+*  Run the cell for one PWM_isr tick with the dac value that was set
+*
+*******************************************************************************/
+
+void SimHAL_Advance(void) {
+    SimCell_Advance(&sim_cell, sim_dac_value, SimHAL_TickSeconds());
+    sim_ticks++;
+}
+
+float64 SimHAL_TickSeconds(void) {
+    return (float64)sim_clock_divider * ((uint32)sim_pwm_period + 1) / BCLK__BUS_CLK__HZ;
+}
+
+void SeqHAL_SetDAC(uint16 value) {
+    DAC_SetValue(value);
+}
+
+uint16 SeqHAL_MaxDAC(void) {
+    return DAC_MaxValue();
+}
+
+int16 SeqHAL_ReadADC(void) {
+    return SimCell_Reading(&sim_cell);
+}
+
+void SeqHAL_SetGain(uint8 tia_resistor, uint8 adc_buffer) {
+    sim_tia_resistor = tia_resistor;
+    sim_adc_buffer = adc_buffer;
+}
+
+void SeqHAL_ForgetGain(void) {}
+
+void SeqHAL_SetPeriod(uint16 timer_period) {
+    PWM_isr_WriteCompare(timer_period / 2);
+    PWM_isr_WritePeriod(timer_period);
+}
+
+void SeqHAL_BlockReady(uint8 channel, uint8 step, uint16 count) {
+    if (sim_block_count < SIM_MAX_BLOCKS) {
+        struct SimBlock *block = &sim_blocks[sim_block_count];
+        block->channel = channel;
+        block->step = step;
+        block->count = count;
+        block->tick = sim_ticks;
+        memcpy(block->data, ADC_array[channel].data, count*sizeof(int16));
+    }
+    sim_block_count++;
+}
+
+void SeqHAL_Finished(void) {
+    sim_finished = true;
+}
+
+uint8 SeqHAL_WriteStore(const uint8 data[], uint16 offset, uint16 length) {
+    if ((uint32)offset + length > SIM_STORE_SIZE) {
+        return false;
+    }
+    memcpy(&sim_store[offset], data, length);
+    return true;
+}
+
+void SeqHAL_ReadStore(uint8 data[], uint16 offset, uint16 length) {
+    memcpy(data, &sim_store[offset], length);
+}
+
+/* [] END OF FILE */
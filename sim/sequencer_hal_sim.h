@@ -0,0 +1,65 @@
+/*******************************************************************************
+* File Name: sequencer_hal_sim.h
+*
+* Description:
+*  This file contains the structures and function prototypes of the
+*  simulated sequencer hardware, see sequencer_hal_sim.c
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#if !defined(SEQUENCER_HAL_SIM_H)
+#define SEQUENCER_HAL_SIM_H
+
+#include "cytypes.h"
+#include "globals.h"
+#include "sim_cell.h"
+
+/**************************************
+*      Constants
+**************************************/
+
+#define SIM_MAX_BLOCKS 256  // blocks kept in sim_blocks, the rest are only counted
+#define SIM_STORE_SIZE 512  // bytes of simulated eeprom for the saved program
+
+
+/**************************************
+*      Structures
+**************************************/
+
+struct SimBlock {  // a SeqHAL_BlockReady call, with a copy of the data it points to
+    uint8 channel;
+    uint8 step;
+    uint16 count;
+    uint32 tick;  // SimHAL_Advance calls before the block was ready
+    int16 data[MAX_LUT_SIZE];
+};
+
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+void SimHAL_Reset(void);
+void SimHAL_Advance(void);
+float64 SimHAL_TickSeconds(void);
+
+
+/***************************************
+* Global variables external identifier
+***************************************/
+
+extern struct SimCell sim_cell;
+extern struct SimBlock sim_blocks[SIM_MAX_BLOCKS];
+extern uint16 sim_block_count;
+extern uint32 sim_ticks;  // SimHAL_Advance calls since SimHAL_Reset
+extern uint8 sim_finished;
+extern uint8 sim_tia_resistor;
+extern uint8 sim_adc_buffer;
+extern uint8 sim_store[SIM_STORE_SIZE];
+
+#endif
+
+/* [] END OF FILE */
@@ -0,0 +1,131 @@
+/*******************************************************************************
+* File Name: sim_cell.c
+*
+* Description:
+*  A Randles cell for the simulated hardware: the uncompensated resistance
+*  in series with the charge transfer resistance and double layer
+*  capacitance in parallel.  The dac value sets the potential across the
+*  whole cell and the adc reads the current through it.  The dac holds its
+*  value for a whole tick so the double layer is moved with the exact
+*  exponential for a constant voltage, which is stable for any tick length
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include <math.h>
+
+#include "sim_cell.h"
+#include "globals.h"
+
+#define SIM_CELL_ADC_MAX 32767
+
+
+/******************************************************************************
+* Function Name: SimCell_Resistor
+*******************************************************************************
+*
+* Summary:
+*  Set up a cell that is only a resistor, with the DVDAC and 1 nA per adc count
+*
+*******************************************************************************/
+
+void SimCell_Resistor(struct SimCell *cell, float64 ohms) {
+    SimCell_Randles(cell, ohms, 0, 0);
+}
+
+/******************************************************************************
+* Function Name: SimCell_Randles
+*******************************************************************************
+*
+* Summary:
+*  Set up a Randles cell with the DVDAC and 1 nA per adc count, the double
+*  layer starts discharged
+*
+* Parameters:
+*  float64 ru_ohms: uncompensated resistance
+*  float64 rct_ohms: charge transfer resistance, 0 if cdl_farads is 0
+*  float64 cdl_farads: double layer capacitance, 0 for a plain resistor
+*
+*******************************************************************************/
+
+void SimCell_Randles(struct SimCell *cell, float64 ru_ohms, float64 rct_ohms, float64 cdl_farads) {
+    cell->ru_ohms = ru_ohms;
+    cell->rct_ohms = rct_ohms;
+    cell->cdl_farads = cdl_farads;
+    cell->mv_per_dac_count = 1.0;
+    cell->dac_ground = VIRTUAL_GROUND;
+    cell->na_per_adc_count = 1.0;
+    cell->zero_count = 0;
+    cell->interface_mv = 0;
+    cell->current_na = 0;
+}
+
+/******************************************************************************
+* Function Name: SimCell_Advance
+*******************************************************************************
+*
+* Summary:
+*  Run the cell for a time with the dac held at a value
+*
+* Return:
+*  current at the end of the time in nA
+*
+*******************************************************************************/
+
+float64 SimCell_Advance(struct SimCell *cell, uint16 dac_value, float64 seconds) {
+    float64 applied_mv = ((float64)dac_value - cell->dac_ground) * cell->mv_per_dac_count;
+    if (cell->cdl_farads <= 0) {
+        cell->current_na = applied_mv * 1e6 / (cell->ru_ohms + cell->rct_ohms);
+        return cell->current_na;
+    }
+    // C dV/dt = (applied - V)/Ru - V/Rct, so V goes to applied * Rct / (Ru + Rct) with rate 1/((Ru || Rct) C)
+    float64 conductance = 1 / cell->ru_ohms;
+    float64 final_mv = applied_mv;
+    if (cell->rct_ohms > 0) {
+        conductance += 1 / cell->rct_ohms;
+        final_mv = applied_mv * cell->rct_ohms / (cell->ru_ohms + cell->rct_ohms);
+    }
+    float64 decay = exp(-seconds * conductance / cell->cdl_farads);
+    cell->interface_mv = final_mv + (cell->interface_mv - final_mv) * decay;
+    cell->current_na = (applied_mv - cell->interface_mv) * 1e6 / cell->ru_ohms;
+    return cell->current_na;
+}
+
+/******************************************************************************
+* Function Name: SimCell_Reading
+*******************************************************************************
+*
+* Summary:
+*  The adc reading of the current at the end of the last SimCell_Advance
+*
+*******************************************************************************/
+
+int16 SimCell_Reading(struct SimCell *cell) {
+    float64 count = cell->zero_count + cell->current_na / cell->na_per_adc_count;
+    if (count > SIM_CELL_ADC_MAX) {
+        count = SIM_CELL_ADC_MAX;
+    }
+    if (count < -SIM_CELL_ADC_MAX) {
+        count = -SIM_CELL_ADC_MAX;
+    }
+    return (int16)lround(count);
+}
+
+/******************************************************************************
+* Function Name: SimCell_ElectrodeMv
+*******************************************************************************
+*
+* Summary:
+*  Potential that reaches the electrode after the iR drop over the
+*  uncompensated resistance, what the iR compensation tries to correct
+*
+*******************************************************************************/
+
+float64 SimCell_ElectrodeMv(struct SimCell *cell, uint16 dac_value) {
+    float64 applied_mv = ((float64)dac_value - cell->dac_ground) * cell->mv_per_dac_count;
+    return applied_mv - cell->current_na * 1e-6 * cell->ru_ohms;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,47 @@
+/*******************************************************************************
+* File Name: sim_cell.h
+*
+* Description:
+*  This file contains the structures and function prototypes of the model of
+*  an electrochemical cell used by the simulated hardware, see sim_cell.c
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#if !defined(SIM_CELL_H)
+#define SIM_CELL_H
+
+#include "cytypes.h"
+
+/**************************************
+*      Structures
+**************************************/
+
+struct SimCell {
+    float64 ru_ohms;  // uncompensated resistance between the SC block and the electrode
+    float64 rct_ohms;  // charge transfer resistance, in parallel with the double layer
+    float64 cdl_farads;  // double layer capacitance, 0 for a plain resistor
+    float64 mv_per_dac_count;  // 1 for the DVDAC, 16 for the VDAC
+    uint16 dac_ground;  // dac value for 0 V across the cell
+    float64 na_per_adc_count;  // TIA and ADC gain
+    int16 zero_count;  // adc reading with no current
+    float64 interface_mv;  // potential across the double layer, the state of the model
+    float64 current_na;  // current at the end of the last tick
+};
+
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+void SimCell_Resistor(struct SimCell *cell, float64 ohms);
+void SimCell_Randles(struct SimCell *cell, float64 ru_ohms, float64 rct_ohms, float64 cdl_farads);
+float64 SimCell_Advance(struct SimCell *cell, uint16 dac_value, float64 seconds);
+int16 SimCell_Reading(struct SimCell *cell);
+float64 SimCell_ElectrodeMv(struct SimCell *cell, uint16 dac_value);
+
+#endif
+
+/* [] END OF FILE */
@@ -0,0 +1,231 @@
+/*******************************************************************************
+* File Name: sim_device.c
+*
+* Description:
+*  A simulated board for testing the computer side with.  It runs the
+*  amperometry part of the firmware (amperometry.c, the body of the
+*  adcAmpInterrupt and the commands that set up a run, and the commands of
+*  main.c that push its data) with the real data_export.c, sample_clock.c
+*  and adc_profile.c on a model of a cell, in real time.  The USB is a
+*  socket (see usb_sim.c), each command comes in a 64 byte packet like it
+*  does on the OUT endpoint.  The isr is run for every tick that is due each
+*  time the main loop comes around, so a computer that does not read holds up
+*  the main loop and the blocks are written over like on the board
+*
+*  sim_device SOCKET_FD [BOARD_NUMBER]
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <project.h>
+#include "adc_profile.h"
+#include "amperometry.h"
+#include "calibrate_sim.h"
+#include "DAC.h"
+#include "data_export.h"
+#include "sample_clock.h"
+#include "sim_cell.h"
+#include "usb_protocols.h"
+#include "usb_sim.h"
+
+#define SIM_DEVICE_TIA_RESISTOR 3
+#define SIM_DEVICE_ADC_BUFFER 0
+#define SIM_DEVICE_NA_PER_COUNT 0.5
+#define SIM_DEVICE_NOISE 8  // adc counts of noise on each reading, peak to peak
+#define SIM_DEVICE_MIN_WAIT_NS 1000000  // the main loop sleeps for between these before it runs the ticks again
+#define SIM_DEVICE_MAX_WAIT_NS 10000000
+
+uint16 timer_period;  // in main.c, set by sample_clock.c
+
+static uint8 amp_running = false;  // isr_adcAmp is enabled
+static char usb_str[40];
+
+static struct SimCell cell;
+static uint32 noise_state;
+static uint16 push_points_set = 0;
+static uint64 run_start_ns;
+static uint64 run_ticks;  // ticks the isr ran for since the run started
+
+
+static uint64 now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64)now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+static uint16 Convert2Dec(uint8 array[], uint8 len) {  // as in main.c
+    uint16 num = 0;
+    for (int i = 0; i < len; i++) {
+        num = num * 10 + (array[i] - '0');
+    }
+    return num;
+}
+
+static uint32 Convert2Dec32(uint8 array[], uint8 len) {
+    uint32 num = 0;
+    for (int i = 0; i < len; i++) {
+        num = num * 10 + (array[i] - '0');
+    }
+    return num;
+}
+
+// the adc reads the cell at the end of the tick then the isr runs
+static void sim_tick(float64 tick_seconds) {
+    SimCell_Advance(&cell, sim_dac_value, tick_seconds);
+    noise_state ^= noise_state << 13;  // xorshift32
+    noise_state ^= noise_state >> 17;
+    noise_state ^= noise_state << 5;
+    sim_adc_result = SimCell_Reading(&cell) + (int32)(noise_state % (SIM_DEVICE_NOISE + 1)) - SIM_DEVICE_NOISE/2;
+    Amp_Sample();
+}
+
+// ArmAmperometry then FireExperiment of main.c
+static void start_amperometry(uint16 dac_value, uint16 buffer_pts) {
+    if (!AdcProfile_TickAllowed(SampleClock_TickNs())) {
+        USB_Export_Data((uint8*)"Error ADC Rate", 15);
+        return;
+    }
+    if (!Amp_BufferAllowed(buffer_pts)) {
+        return;
+    }
+    Amp_Setup(dac_value, buffer_pts, SIM_DEVICE_TIA_RESISTOR, SIM_DEVICE_ADC_BUFFER);
+    Export_SetSamplePeriod(SampleClock_TickNs());
+    amp_running = true;
+    run_start_ns = now_ns();
+    run_ticks = 0;
+}
+
+// the commands of main.c the simulated board has
+static void sim_command(uint8 OUT_Data_Buffer[]) {
+    switch (OUT_Data_Buffer[0]) {
+        case 'M':  // M|XXXX|YYYY amperometry at dac value XXXX with blocks of YYYY data points
+            start_amperometry(Convert2Dec(&OUT_Data_Buffer[2], 4), Convert2Dec(&OUT_Data_Buffer[7], 4));
+            break;
+        case 'X':  // stop
+            amp_running = false;
+            break;
+        case 'I':
+            amp_running = false;
+            USB_Export_Data((uint8*)"USB Test - v04", 15);
+            break;
+        case 'A':  // AP|N selects an adc profile
+            if (OUT_Data_Buffer[1] == 'P') {
+                uint8 profile = OUT_Data_Buffer[3]-'0';
+                if (amp_running) {
+                    USB_Export_Data((uint8*)"Error ADC Profile", 18);
+                    break;
+                }
+                if (Amp_SelectProfile(profile, SIM_DEVICE_ADC_BUFFER)) {
+                    sim_calibration_fit.adc_profile = profile;  // as if the board was calibrated again
+                }
+            }
+            break;
+        case 'H':  // HR|RRRRRRRRRR sets the rate in mHz, HP|PPPPPPPPPP the period in ns
+            Amp_SetClock(OUT_Data_Buffer[1], Convert2Dec32(&OUT_Data_Buffer[3], 10));
+            break;
+        case 'U':
+            if (OUT_Data_Buffer[1] == 'K') {
+                Export_Format(Export_Pairs(), SIM_DEVICE_TIA_RESISTOR, SIM_DEVICE_ADC_BUFFER);
+            }
+            else if (OUT_Data_Buffer[1] == 'P') {
+                push_points_set = Convert2Dec(&OUT_Data_Buffer[3], 4);
+                Export_SetPush(push_points_set);
+                sprintf(usb_str, "UP|%04d", push_points_set);
+                USB_Export_Data((uint8*)usb_str, strlen(usb_str)+1);
+            }
+            else if (OUT_Data_Buffer[1] == 'H') {
+                Export_DeviceHeader(SIM_DEVICE_TIA_RESISTOR, SIM_DEVICE_ADC_BUFFER);
+            }
+            else if (OUT_Data_Buffer[1] == 'M') {
+                Export_BlockInfo();
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// a Randles cell that the currents of the board are read from, each board a bit different
+static void sim_setup(uint32 board) {
+    selected_voltage_source = VDAC_IS_DVDAC;
+    dac_ground_value = VIRTUAL_GROUND;
+    SimCell_Randles(&cell, 1000, 100000 + 1000*(board % 50), 1e-6);
+    cell.na_per_adc_count = SIM_DEVICE_NA_PER_COUNT;
+    cell.zero_count = 10 + board % 20;
+    sim_unique_id[1] = board;
+    noise_state = 2463534242u + board;
+    SampleClock_Default();
+
+    sim_calibration_fit.valid = true;
+    sim_calibration_fit.tia_resistor = SIM_DEVICE_TIA_RESISTOR;
+    sim_calibration_fit.adc_buffer = SIM_DEVICE_ADC_BUFFER;
+    sim_calibration_fit.adc_profile = AdcProfile_Current();
+    sim_calibration_fit.femtoamps_per_count = (int32)(SIM_DEVICE_NA_PER_COUNT * 1e6);
+    sim_calibration_fit.zero_count = cell.zero_count;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s SOCKET_FD [BOARD_NUMBER]\n", argv[0]);
+        return 2;
+    }
+    sim_usb_fd = atoi(argv[1]);
+    sim_setup((argc > 2) ? (uint32)atoi(argv[2]) : 0);
+
+    uint8 command[MAX_BUFFER_SIZE];
+    uint16 command_size = 0;
+    for (;;) {
+        if (amp_running) {  // the ticks that went by since the main loop was last here
+            uint32 tick_ns = SampleClock_TickNs();
+            uint64 due = (now_ns() - run_start_ns) / tick_ns;
+            while (amp_running && (run_ticks < due)) {
+                sim_tick(tick_ns * 1e-9);
+                run_ticks++;
+            }
+        }
+        Export_Push(!amp_running);
+
+        // sleep until about a quarter of a push is saved, or a command comes
+        uint64 wait_ns = SIM_DEVICE_MAX_WAIT_NS;
+        if (amp_running && push_points_set) {
+            wait_ns = (uint64)push_points_set * SampleClock_TickNs() / 4;
+        }
+        if (wait_ns < SIM_DEVICE_MIN_WAIT_NS) {
+            wait_ns = SIM_DEVICE_MIN_WAIT_NS;
+        }
+        if (wait_ns > SIM_DEVICE_MAX_WAIT_NS) {
+            wait_ns = SIM_DEVICE_MAX_WAIT_NS;
+        }
+        struct pollfd input = {sim_usb_fd, POLLIN, 0};
+        if (poll(&input, 1, (int)(wait_ns / 1000000)) <= 0) {
+            continue;
+        }
+        ssize_t got = read(sim_usb_fd, &command[command_size], MAX_BUFFER_SIZE - command_size);
+        if (got == 0) {  // the computer closed the socket, the board is unplugged
+            return 0;
+        }
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return 1;
+        }
+        command_size += got;
+        if (command_size == MAX_BUFFER_SIZE) {
+            sim_command(command);
+            command_size = 0;
+        }
+    }
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,29 @@
+/*******************************************************************************
+* File Name: sim_test.h
+*
+* Description:
+*  Check macro for the firmware module tests run on a computer, a test
+*  program returns sim_test_failures from main so ctest sees the failures
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#if !defined(SIM_TEST_H)
+#define SIM_TEST_H
+
+#include <stdio.h>
+
+static int sim_test_failures = 0;
+
+#define SIM_CHECK(condition) do {                                               \
+    if (!(condition)) {                                                         \
+        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition);   \
+        sim_test_failures++;                                                    \
+    }                                                                           \
+} while (0)
+
+#endif
+
+/* [] END OF FILE */
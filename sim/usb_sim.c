@@ -0,0 +1,61 @@
+/*******************************************************************************
+* File Name: usb_sim.c
+*
+* Description:
+*  USB_Export_Data of usb_protocols.c for the simulated boards.  The bytes
+*  are written to the socket in packets of MAX_BUFFER_SIZE like the IN
+*  endpoint is loaded, and the write blocks while the computer is not
+*  reading like the wait on the endpoint does
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "usb_protocols.h"
+#include "usb_sim.h"
+
+int sim_usb_fd = -1;
+uint8 sim_usb_log[SIM_USB_LOG_SIZE];
+uint32 sim_usb_log_size = 0;
+uint32 sim_usb_exports = 0;
+
+
+void SimUSB_ClearLog(void) {
+    sim_usb_log_size = 0;
+    sim_usb_exports = 0;
+}
+
+void USB_Export_Data(uint8 array[], uint16 size) {
+    sim_usb_exports++;
+    if (sim_usb_fd < 0) {
+        for (uint16 i = 0; i < size; i++) {
+            if (sim_usb_log_size + i < SIM_USB_LOG_SIZE) {
+                sim_usb_log[sim_usb_log_size + i] = array[i];
+            }
+        }
+        sim_usb_log_size += size;
+        return;
+    }
+    uint16 i = 0;
+    while (i < size) {
+        uint16 size_to_send = size - i;
+        if (size_to_send > MAX_BUFFER_SIZE) {
+            size_to_send = MAX_BUFFER_SIZE;
+        }
+        ssize_t sent = write(sim_usb_fd, &array[i], size_to_send);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;  // the computer went away, like a USB that is not configured
+        }
+        i += sent;
+    }
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,43 @@
+/*******************************************************************************
+* File Name: usb_sim.h
+*
+* Description:
+*  USB_Export_Data for the simulated boards.  With sim_usb_fd set the bytes
+*  go to a socket, otherwise they are saved in sim_usb_log for the tests
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#if !defined(USB_SIM_H)
+#define USB_SIM_H
+
+#include "cytypes.h"
+
+/**************************************
+*      Constants
+**************************************/
+
+#define SIM_USB_LOG_SIZE 65536  // bytes kept in sim_usb_log, the rest are only counted
+
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+void SimUSB_ClearLog(void);
+
+
+/***************************************
+* Global variables external identifier
+***************************************/
+
+extern int sim_usb_fd;  // socket the computer reads, -1 to save in sim_usb_log
+extern uint8 sim_usb_log[SIM_USB_LOG_SIZE];
+extern uint32 sim_usb_log_size;  // bytes sent since SimUSB_ClearLog
+extern uint32 sim_usb_exports;  // USB_Export_Data calls since SimUSB_ClearLog
+
+#endif
+
+/* [] END OF FILE */
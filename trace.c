@@ -0,0 +1,77 @@
+/*******************************************************************************
+* File Name: trace.c
+*
+* Description:
+*  Ring of timestamped binary events for finding firmware problems such as
+*  missing "Done" messages or exports that get stuck.  Events are added with
+*  the TRACE macro in trace.h and sent to the computer with the 'UT' command.
+*  The computer lines the events up by the cycle counter time to make a
+*  timeline
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include "trace.h"
+
+#if TRACE_ENABLED
+
+#include "usb_protocols.h"
+
+struct TraceEvent trace_ring[TRACE_DEPTH];
+uint32 trace_head = 0;  // total events added, the next slot is trace_head % TRACE_DEPTH
+uint8 trace_on = true;
+
+static uint32 trace_dumped = 0;  // trace_head at the last clear
+
+/******************************************************************************
+* Function Name: Trace_Dump
+*******************************************************************************
+*
+* Summary:
+*  Send the events to the computer, oldest first, after a TraceHeader.
+*  Tracing is stopped during the dump so the export does not change the ring
+*
+* Parameters:
+*  uint8 clear: true to start over after the dump so the next dump only has new events
+*
+*******************************************************************************/
+
+void Trace_Dump(uint8 clear) {
+    union {
+        uint8 usb[sizeof(struct TraceHeader)];
+        struct TraceHeader header;
+    } trace_header;
+    
+    trace_on = false;
+    uint32 count = trace_head - trace_dumped;
+    trace_header.header.lost = 0;
+    if (count > TRACE_DEPTH) {
+        trace_header.header.lost = count - TRACE_DEPTH;
+        count = TRACE_DEPTH;
+    }
+    trace_header.header.tag[0] = 'T';
+    trace_header.header.tag[1] = 'R';
+    trace_header.header.count = count;
+    trace_header.header.now = DWT->CYCCNT;
+    USB_Export_Data(trace_header.usb, sizeof(struct TraceHeader));
+    
+    uint16 first = (trace_head - count) & (TRACE_DEPTH-1);
+    uint16 to_end = TRACE_DEPTH - first;  // the oldest events may wrap around the end of the ring
+    if (count <= to_end) {
+        USB_Export_Data((uint8*)&trace_ring[first], count*sizeof(struct TraceEvent));
+    }
+    else {
+        USB_Export_Data((uint8*)&trace_ring[first], to_end*sizeof(struct TraceEvent));
+        USB_Export_Data((uint8*)&trace_ring[0], (count - to_end)*sizeof(struct TraceEvent));
+    }
+    if (clear) {
+        trace_dumped = trace_head;
+    }
+    trace_on = true;
+}
+
+#endif
+
+/* [] END OF FILE */
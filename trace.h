@@ -0,0 +1,103 @@
+/*******************************************************************************
+* File Name: trace.h
+*
+* Description:
+*  This file contains the macros, event codes and structures used for the
+*  in RAM ring of timestamped firmware events.  Set TRACE_ENABLED to 0 to
+*  take all the tracing out of the build
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#if !defined(TRACE_H)
+#define TRACE_H
+
+#include <project.h>
+
+/**************************************
+*      Constants
+**************************************/
+
+#if !defined(TRACE_ENABLED)
+#define TRACE_ENABLED 1
+#endif
+#define TRACE_DEPTH 128  // events kept, has to be a power of 2
+
+// event codes, arg8 and arg16 are given for each
+#define TRACE_COMMAND 1  // command taken from the queue, arg8: command letter, arg16: second byte
+#define TRACE_ISR_ENABLE 2  // arg8: TRACE_ISR_XXX
+#define TRACE_ISR_DISABLE 3  // arg8: TRACE_ISR_XXX
+#define TRACE_BUFFER_FULL 4  // arg8: ADC_array channel, arg16: data points
+#define TRACE_EXPORT_START 5  // arg8: first byte sent, arg16: bytes
+#define TRACE_EXPORT_END 6  // arg16: microseconds spent waiting on the IN endpoint, max 65535
+#define TRACE_EXPORT_NESTED 7  // an export started while another was going, arg16: bytes
+#define TRACE_EXPORT_ABORT 8  // export stopped by a stop command, arg16: bytes not sent
+#define TRACE_QUEUE_DROP 9  // command queue full, arg8: command letter thrown away
+#define TRACE_URGENT_STOP 10  // stop command seen in the OUT endpoint isr
+#define TRACE_RUN_DONE 11  // run finished, arg8: mode letter, arg16: data points
+
+#define TRACE_ISR_DAC 'd'
+#define TRACE_ISR_ADC 'a'
+#define TRACE_ISR_TICK 't'  // isr_adcAmp, arg16 is 1 for amperometry or 2 for another tick mode
+
+
+/**************************************
+*      Structures
+**************************************/
+
+struct TraceEvent {  // 8 bytes, sent as is (little endian) by the 'UT' command
+    uint32 time;  // BUS_CLK cycle counter, wraps about every 179 seconds
+    uint8 event;  // TRACE_XXX
+    uint8 arg8;
+    uint16 arg16;
+};
+
+struct TraceHeader {  // sent before the events
+    char tag[2];  // "TR"
+    uint16 count;  // events that follow, oldest first
+    uint32 now;  // cycle counter when the dump started
+    uint32 lost;  // events that were written over before the dump
+};
+
+
+#if TRACE_ENABLED
+/***************************************
+*        Function Prototypes
+***************************************/
+
+void Trace_Dump(uint8 clear);
+
+
+/***************************************
+* Global variables external identifier
+***************************************/
+
+extern struct TraceEvent trace_ring[TRACE_DEPTH];
+extern uint32 trace_head;
+extern uint8 trace_on;
+
+/* Interrupts are masked while the slot is taken and filled so an isr can not
+   get the same slot, about 10 cycles */
+#define TRACE(event_code, a8, a16) do {                                         \
+    if (trace_on) {                                                             \
+        uint32 trace_primask = __get_PRIMASK();                                 \
+        __disable_irq();                                                        \
+        struct TraceEvent *trace_slot = &trace_ring[trace_head & (TRACE_DEPTH-1)]; \
+        trace_head++;                                                           \
+        trace_slot->time = DWT->CYCCNT;                                         \
+        trace_slot->event = (event_code);                                       \
+        trace_slot->arg8 = (a8);                                                \
+        trace_slot->arg16 = (a16);                                              \
+        __set_PRIMASK(trace_primask);                                           \
+    }                                                                           \
+} while (0)
+
+#else
+#define TRACE(event_code, a8, a16)
+#endif
+
+#endif
+
+/* [] END OF FILE */
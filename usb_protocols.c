@@ -13,6 +13,8 @@ NOTE: WAITING ON USB VENDOR AND PRODUCT ID
 
 #include <project.h>
 #include "USB_protocols.h"
+#include "command_queue.h"
+#include "trace.h"
 #include "stdio.h"
 #include "stdlib.h"
 extern char LCD_str[];  // for debug
@@ -48,12 +50,64 @@ uint8 USB_CheckInput(uint8 buffer[]) {
     return false;
 }
 
+/******************************************************************************
+* Function Name: USB_StartOut
+*******************************************************************************
+*
+* Summary:
+*  Let the OUT endpoint take packets from the computer, called at the start and
+*  when the configuration changes.  With DMA automatic buffer management the
+*  buffer the DMA puts the OUT packets into is given to the component first
+*
+*******************************************************************************/
+
+#if (USBFS_EP_MANAGEMENT_DMA_AUTO)
+static uint8 out_dma_buffer[MAX_BUFFER_SIZE];
+#endif
+
+void USB_StartOut(void) {
+    #if (USBFS_EP_MANAGEMENT_DMA_AUTO)
+    USBFS_ReadOutEP(OUT_ENDPOINT, out_dma_buffer, MAX_BUFFER_SIZE);
+    #endif
+    USBFS_EnableOutEP(OUT_ENDPOINT);
+}
+
+/******************************************************************************
+* Function Name: USB_ReadOut
+*******************************************************************************
+*
+* Summary:
+*  Copy the OUT packet that came in to a buffer, the caller re-enables the endpoint
+*
+* Parameters:
+*  uint8 buffer[]: where to put the packet
+*  uint16 count: bytes to copy, from USBFS_GetEPCount
+*
+*******************************************************************************/
+
+void USB_ReadOut(uint8 buffer[], uint16 count) {
+    #if (USBFS_EP_MANAGEMENT_DMA_AUTO)
+    for (uint16 i = 0; i < count; i++) {  // the DMA already moved it out of the endpoint memory
+        buffer[i] = out_dma_buffer[i];
+    }
+    #else
+    USBFS_ReadOutEP(OUT_ENDPOINT, buffer, count);
+    #endif
+}
+
+static struct USBExportStats export_stats;
+
 /******************************************************************************
 * Function Name: USB_Export_Data
 *************************************************************************************
 *
 * Summary:
-*  Take a buffer as input and export it, the size of bytes to send is also inputted
+*  Take a buffer as input and export it, the size of bytes to send is also inputted.
+*  In manual endpoint management USBFS_LoadInEP copies each packet into the
+*  endpoint memory.  With DMA automatic buffer management USBFS_LoadInEP only
+*  points the DMA at the packet and the DMA moves it while the CPU goes on, so
+*  this waits for the last packet to be read before returning in case the
+*  array is on the stack
 *
 * Parameters:
 *  uint8 array array: array of data to export
@@ -64,6 +118,8 @@ uint8 USB_CheckInput(uint8 buffer[]) {
 *
 * Global variables:
 *  MAX_BUFFER_SIZE:  the number of bytes the UBS device can hold
+*  usb_abort: set by the OUT endpoint isr when a stop command is received, stops the export
+*  Nothing is sent if the USB is not configured so a standalone run does not wait on a computer
 *
 *******************************************************************************************/
 
@@ -71,10 +127,34 @@ void USB_Export_Data(uint8 array[], uint16 size) {
 //    LCD_Position(1,0);
 //    sprintf(LCD_str, "e:%d|%c%c%c%c%c%c| |", size ,array[0], array[1], array[2], array[3], array[4], array[5]);
 //    LCD_PrintString(LCD_str);
-    for (int i=0; i < size; i=i+MAX_BUFFER_SIZE) {
+    if (!USBFS_GetConfiguration()) {  // no computer, the device is running on its own
+        return;
+    }
+    uint32 start_cycles = DWT->CYCCNT;
+    uint32 wait_cycles = 0;
+    #if TRACE_ENABLED
+    static volatile uint8 export_depth = 0;  // more than 1 if an isr exported while the main loop was exporting
+    export_depth++;
+    if (export_depth > 1) {
+        TRACE(TRACE_EXPORT_NESTED, array[0], size);
+    }
+    TRACE(TRACE_EXPORT_START, array[0], size);
+    #endif
+    uint16 i = 0;
+    while (i < size) {
+        uint32 wait_start = DWT->CYCCNT;
         while(USBFS_GetEPState(IN_ENDPOINT) != USBFS_IN_BUFFER_EMPTY)
         {
+            CommandQueue_Poll();  // with DMA automatic buffer management the commands are read here
+            if (usb_abort) {  // the computer sent a stop command, don't wait on it to read the data
+                TRACE(TRACE_EXPORT_ABORT, array[0], size - i);
+                #if TRACE_ENABLED
+                export_depth--;
+                #endif
+                return;
+            }
         }
+        wait_cycles += DWT->CYCCNT - wait_start;
         uint16 size_to_send = size - i;
         if (size_to_send > MAX_BUFFER_SIZE) {
             size_to_send = MAX_BUFFER_SIZE;
@@ -83,17 +163,54 @@ void USB_Export_Data(uint8 array[], uint16 size) {
 //        LCD_Position(0,0);
 //        sprintf(LCD_str, "g:%d |", size_to_send);
 //        LCD_PrintString(LCD_str);
-        if(USBFS_GetEPState(IN_ENDPOINT) == USBFS_IN_BUFFER_EMPTY){
-            USBFS_LoadInEP(IN_ENDPOINT, &array[i], size_to_send);  // TODO: Fix this
-            USBFS_EnableOutEP(OUT_ENDPOINT);
-        }
+        USBFS_LoadInEP(IN_ENDPOINT, &array[i], size_to_send);
+        #if (!USBFS_EP_MANAGEMENT_DMA_AUTO)
+        USBFS_EnableOutEP(OUT_ENDPOINT);
+        #endif
+        i += size_to_send;
+        export_stats.packets++;
+    }
+    #if (USBFS_EP_MANAGEMENT_DMA_AUTO)
+    uint32 wait_start = DWT->CYCCNT;
+    while ((USBFS_GetEPState(IN_ENDPOINT) != USBFS_IN_BUFFER_EMPTY) && !usb_abort) {
+        CommandQueue_Poll();  // the DMA reads array until the last packet is sent
     }
-//    if(USBFS_GetEPState(IN_ENDPOINT) == USBFS_IN_BUFFER_EMPTY){
-//        USBFS_EnableOutEP(OUT_ENDPOINT);
-//    }
+    wait_cycles += DWT->CYCCNT - wait_start;
+    #endif
+    export_stats.bytes += size;
+    export_stats.wait_cycles += wait_cycles;
+    export_stats.cpu_cycles += (DWT->CYCCNT - start_cycles) - wait_cycles;
+    #if TRACE_ENABLED
+    uint32 wait_us = wait_cycles / BCLK__BUS_CLK__MHZ;
+    TRACE(TRACE_EXPORT_END, array[0], (wait_us > 0xFFFF) ? 0xFFFF : wait_us);
+    export_depth--;
+    #endif
     //LCD_Position(1,0);
     //sprintf(LCD_str, "exported:%d", size);
     //LCD_PrintString(LCD_str);
 }
 
+/******************************************************************************
+* Function Name: USB_GetExportStats
+*******************************************************************************
+*
+* Summary:
+*  Get the counters of USB_Export_Data
+*
+* Parameters:
+*  struct USBExportStats *stats: where to put the counters
+*  uint8 clear: true to start the counters over
+*
+*******************************************************************************/
+
+void USB_GetExportStats(struct USBExportStats *stats, uint8 clear) {
+    *stats = export_stats;
+    if (clear) {
+        export_stats.bytes = 0;
+        export_stats.packets = 0;
+        export_stats.cpu_cycles = 0;
+        export_stats.wait_cycles = 0;
+    }
+}
+
 /* [] END OF FILE */
\ No newline at end of file
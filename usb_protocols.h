@@ -32,6 +32,22 @@
 #define MAX_NUM_BYTES 512 // how big to make the IN and OUT ENDPOINT BUFFERS
 #define MAX_DATA_BUFFER 256 // make this MAX_NUM_BYTES / 2
 
+#if !defined(USBFS_EP_MANAGEMENT_DMA_AUTO)
+#define USBFS_EP_MANAGEMENT_DMA_AUTO 0  // set by the USBFS component when it uses DMA with automatic buffer management
+#endif
+
+
+/**************************************
+*      Structures
+**************************************/
+
+struct USBExportStats {  // to compare the endpoint memory management modes
+    uint32 bytes;  // bytes sent by USB_Export_Data
+    uint32 packets;
+    uint32 cpu_cycles;  // BUS_CLK cycles spent in USB_Export_Data not counting the waits on the IN endpoint
+    uint32 wait_cycles;  // BUS_CLK cycles spent waiting on the computer to read the IN endpoint
+};
+
 /* External variable of the device address located in USBFS.h */
 extern uint8 USB_deviceAdress;
     
@@ -40,7 +56,10 @@ extern uint8 USB_deviceAdress;
 ***************************************/  
     
 uint8 USB_CheckInput(uint8 buffer[]);
+void USB_StartOut(void);
+void USB_ReadOut(uint8 buffer[], uint16 count);
 void USB_Export_Data(uint8 array[], uint16 size);
+void USB_GetExportStats(struct USBExportStats *stats, uint8 clear);
 
 #endif
 
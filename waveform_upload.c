@@ -0,0 +1,184 @@
+/*******************************************************************************
+* File Name: waveform_upload.c
+*
+* Description:
+*  Load a waveform made on the computer into waveform_lut.  After the 'UB'
+*  command the OUT packets are not commands but little endian uint16 DAC
+*  values and they are read by the OUT endpoint isr straight into
+*  waveform_lut, so there is no ASCII parsing.  A CRC of the bytes is kept as
+*  they come in and the 'UC' command checks it against the computer's CRC
+*  before the waveform is used.  The waveform is played with the 'R' command
+*  the same as a cyclic voltammetry look up table.  The old table is written
+*  over as the bytes come in, so there is no look up table from the 'UB'
+*  command until a good 'UC' and a run can not play half of each
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include <project.h>
+
+#include "waveform_upload.h"
+#include "DAC.h"
+#include "helper_functions.h"
+#include "usb_protocols.h"
+
+extern uint16 waveform_lut[];  // in main.c
+extern uint16 lut_length;
+extern uint16 lut_value;
+
+static volatile uint8 upload_active = false;
+static uint16 upload_points;
+static volatile uint16 upload_bytes;  // bytes read into waveform_lut so far
+static volatile uint16 upload_crc;
+static volatile uint32 upload_last_packet;  // cycle counter when the last packet came in
+static uint8 upload_discard[MAX_BUFFER_SIZE];
+
+
+/******************************************************************************
+* Function Name: Upload_Begin
+*******************************************************************************
+*
+* Summary:
+*  Get ready to read a waveform, the OUT packets after this are waveform data
+*  until 2 * points bytes have been read.  The look up table length is set to
+*  0 so the 'R' and 'PR' commands are refused until the upload is committed
+*
+* Parameters:
+*  uint16 points: number of DAC values the computer will send
+*
+* Return:
+*  true (1) if the upload can start or false (0) if the waveform is too long
+*  or a cyclic voltammetry run is using the look up table
+*
+*******************************************************************************/
+
+uint8 Upload_Begin(uint16 points) {
+    if ((points == 0) || (points > UPLOAD_MAX_POINTS) || isr_dac_GetState()) {
+        return false;
+    }
+    lut_length = 0;  // waveform_lut is about to be written over
+    upload_points = points;
+    upload_bytes = 0;
+    upload_crc = HELPER_CRC16_START;
+    upload_last_packet = helper_ReadCycleCounter();
+    upload_active = true;
+    return true;
+}
+
+uint8 Upload_IsActive(void) {
+    return upload_active;
+}
+
+/******************************************************************************
+* Function Name: Upload_ReadPacket
+*******************************************************************************
+*
+* Summary:
+*  Called from the command queue while an upload is active.  Read the packet
+*  into the next part of waveform_lut and add it to the CRC, the upload is
+*  done when all the bytes are read and the next packets are commands again
+*
+*******************************************************************************/
+
+void Upload_ReadPacket(void) {
+    uint16 count = USBFS_GetEPCount(OUT_ENDPOINT);
+    uint16 bytes_left = 2*upload_points - upload_bytes;
+    if (count > bytes_left) {  // the computer sent too much, throw away the extra
+        USB_ReadOut(upload_discard, count);
+        count = bytes_left;
+        for (uint16 i = 0; i < count; i++) {
+            ((uint8*)waveform_lut)[upload_bytes + i] = upload_discard[i];
+        }
+    }
+    else {
+        USB_ReadOut(&((uint8*)waveform_lut)[upload_bytes], count);
+    }
+    upload_crc = helper_CRC16(upload_crc, &((uint8*)waveform_lut)[upload_bytes], count);
+    upload_bytes += count;
+    upload_last_packet = helper_ReadCycleCounter();
+    if (upload_bytes >= 2*upload_points) {
+        upload_active = false;
+    }
+}
+
+/******************************************************************************
+* Function Name: Upload_Poll
+*******************************************************************************
+*
+* Summary:
+*  Called from the main loop, cancel an upload if the computer stopped sending
+*  data so the OUT packets are read as commands again
+*
+* Return:
+*  true (1) if the upload was cancelled this call
+*
+*******************************************************************************/
+
+uint8 Upload_Poll(void) {
+    if (upload_active && 
+        (helper_CyclesToUs(helper_ReadCycleCounter() - upload_last_packet) > UPLOAD_TIMEOUT_US)) {
+        Upload_Cancel();
+        return true;
+    }
+    return false;
+}
+
+/******************************************************************************
+* Function Name: Upload_Commit
+*******************************************************************************
+*
+* Summary:
+*  Check the waveform that was read and make it the look up table used by the 'R' command
+*
+* Parameters:
+*  uint16 crc: CRC-16/CCITT the computer worked out for the waveform bytes
+*
+* Return:
+*  UPLOAD_COMMITTED if all the bytes were read, the CRC matches and every value
+*  fits the selected dac, UPLOAD_BAD_CRC or UPLOAD_BAD_VALUE and there is
+*  still no look up table if not
+*
+*******************************************************************************/
+
+uint8 Upload_Commit(uint16 crc) {
+    if (upload_active || (upload_points == 0) || (upload_bytes != 2*upload_points) || (crc != upload_crc)) {
+        return UPLOAD_BAD_CRC;
+    }
+    uint16 max_value = DAC_MaxValue();
+    for (uint16 i = 0; i < upload_points; i++) {
+        if (waveform_lut[i] > max_value) {  // the 8-bit VDAC would wrap it around
+            upload_points = 0;
+            return UPLOAD_BAD_VALUE;
+        }
+    }
+    lut_length = upload_points;
+    lut_value = waveform_lut[0];
+    upload_points = 0;  // only commit once
+    return UPLOAD_COMMITTED;
+}
+
+/******************************************************************************
+* Function Name: Upload_Cancel
+*******************************************************************************
+*
+* Summary:
+*  Stop reading waveform data, the next OUT packets are commands
+*
+*******************************************************************************/
+
+void Upload_Cancel(void) {
+    upload_active = false;
+    upload_points = 0;
+}
+
+uint16 Upload_BytesReceived(void) {
+    return upload_bytes;
+}
+
+uint16 Upload_CRC(void) {
+    return upload_crc;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,47 @@
+/*******************************************************************************
+* File Name: waveform_upload.h
+*
+* Description:
+*  This file contains the function prototypes and constants used for
+*  loading a waveform from the computer into the look up table as binary data
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#if !defined(WAVEFORM_UPLOAD_H)
+#define WAVEFORM_UPLOAD_H
+
+#include "cytypes.h"
+#include "globals.h"
+
+/**************************************
+*      Constants
+**************************************/
+
+#define UPLOAD_MAX_POINTS (MAX_LUT_SIZE - 1)  // leave room for the ADC_DATA_DONE_CODE after the last data point
+#define UPLOAD_TIMEOUT_US 500000  // cancel the upload if no data comes in for this long
+
+// returned by Upload_Commit
+#define UPLOAD_BAD_CRC 0  // the bytes were not all read or the CRC did not match
+#define UPLOAD_COMMITTED 1
+#define UPLOAD_BAD_VALUE 2  // a value is over what the selected dac can take
+
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+uint8 Upload_Begin(uint16 points);
+uint8 Upload_IsActive(void);
+void Upload_ReadPacket(void);
+uint8 Upload_Poll(void);
+uint8 Upload_Commit(uint16 crc);
+void Upload_Cancel(void);
+uint16 Upload_BytesReceived(void);
+uint16 Upload_CRC(void);
+
+#endif
+
+/* [] END OF FILE */